@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 // todo - make faster 128 blocksize version with 128 blocksize hardcoded as necessary
 
@@ -50,46 +51,12 @@ using namespace std;
 
 namespace { // anonymous namespace for local linkage
 
-// tables for inverses, byte sub
-unsigned char gf2_8_inv[256];
-unsigned char byte_sub[256];
-unsigned char inv_byte_sub[256];
-
-// this table needs Nb*(Nr+1)/Nk entries - up to 8*(15)/4 = 60
-// todo - remove table, note cycles every 17(?) elements
-unsigned long Rcon[60];
-
-// long tables for encryption stuff
-unsigned long T0[256];
-unsigned long T1[256];
-unsigned long T2[256];
-unsigned long T3[256];
-
-// long tables for decryption stuff
-unsigned long I0[256];
-unsigned long I1[256];
-unsigned long I2[256];
-unsigned long I3[256];
-
-// huge tables - todo - ifdef out
-unsigned long T4[256];
-unsigned long T5[256];
-unsigned long T6[256];
-unsigned long T7[256];
-unsigned long I4[256];
-unsigned long I5[256];
-unsigned long I6[256];
-unsigned long I7[256];
-
-// have the tables been initialized?
-bool tablesInitialized = false;
-
 // define to mult a byte by x mod the proper poly
 // todo - move magic numbers out?
 #define xmult(a) ((a)<<1) ^ (((a)&128) ? 0x01B : 0)
 
 // make 4 bytes (LSB first) into a 4 byte vector
-#define VEC4(a,b,c,d) (((unsigned long)(a)) | (((unsigned long)(b))<<8) | (((unsigned long)(c))<<16) | (((unsigned long)(d))<<24))
+#define VEC4(a,b,c,d) (((uint32_t)(a)) | (((uint32_t)(b))<<8) | (((uint32_t)(c))<<16) | (((uint32_t)(d))<<24))
 
 // get byte 0 to 3 from word a
 #define GetByte(a,n) ((unsigned char)((a) >> (n<<3)))
@@ -108,7 +75,7 @@ bool tablesInitialized = false;
 #define RotByteL(a) ROTL8(a)
 
 // mult 2 elements using gf2_8_poly as a reduction
-inline unsigned char GF2_8_mult(unsigned char a, unsigned char b)
+constexpr unsigned char GF2_8_mult(unsigned char a, unsigned char b)
 	{ // todo - make 4x4 table for nibbles, use lookup
 	unsigned char result = 0;
 
@@ -132,174 +99,124 @@ inline unsigned char GF2_8_mult(unsigned char a, unsigned char b)
 	return result;
 	} // GF2_8_mult
 
-bool CheckLargeTables(bool create)
-	{
-	unsigned int i;
-	unsigned char a1,a2,a3,b1,b2,b3,b4,b5;
-	for (i = 0; i < 256; i++)
-		{
-		a1 = byte_sub[i];
-		a2 = xmult(a1);
-		a3 = a2^a1;
-
-		b5 = inv_byte_sub[i];
-		b1 = GF2_8_mult(0x0E,b5);
-		b2 = GF2_8_mult(0x09,b5);
-		b3 = GF2_8_mult(0x0D,b5);
-		b4 = GF2_8_mult(0x0B,b5);
-
-		if (create == true)
-			{
-			T0[i] = VEC4(a2,a1,a1,a3);
-			T1[i] = RotByteL(T0[i]);
-			T2[i] = RotByteL(T1[i]);
-			T3[i] = RotByteL(T2[i]);
-
-			T4[i] = VEC4(a1,0,0,0); // identity
-			T5[i] = RotByteL(T4[i]);
-			T6[i] = RotByteL(T5[i]);
-			T7[i] = RotByteL(T6[i]);
-
-			I0[i] = VEC4(b1,b2,b3,b4);
-			I1[i] = RotByteL(I0[i]);
-			I2[i] = RotByteL(I1[i]);
-			I3[i] = RotByteL(I2[i]);
-
-			I4[i] = VEC4(b5,0,0,0); // identity
-			I5[i] = RotByteL(I4[i]);
-			I6[i] = RotByteL(I5[i]);
-			I7[i] = RotByteL(I6[i]);
-			}
-		else
-			{
-			if (T0[i] != VEC4(a2,a1,a1,a3))
-				return false;
-			if (T1[i] != RotByteL(T0[i]))
-				return false;
-			if (T2[i] != RotByteL(T1[i]))
-				return false;
-			if (T3[i] != RotByteL(T2[i]))
-				return false;
-			if (T4[i] != VEC4(a1,0,0,0))
-				return false;
-			if (T5[i] != RotByteL(T4[i]))
-				return false;
-			if (T6[i] != RotByteL(T5[i]))
-				return false;
-			if (T7[i] != RotByteL(T6[i]))
-				return false;
-			if (I0[i] != VEC4(b1,b2,b3,b4))
-				return false;
-			if (I1[i] != RotByte(I0[i]))
-				return false;
-			if (I2[i] != RotByte(I1[i]))
-				return false;
-			if (I3[i] != RotByte(I2[i]))
-				return false;
-			if (I4[i] != VEC4(b5,0,0,0))
-				return false;
-			if (I5[i] != RotByteL(I4[i]))
-				return false;
-			if (I6[i] != RotByteL(I5[i]))
-				return false;
-			if (I7[i] != RotByteL(I6[i]))
-				return false;
-			}
-		}
-	return true;
-	} // CheckLargeTables
-
-// some functions to create/verify table integrity
-bool CheckInverses(bool create)
-	{
-	unsigned int a,b; // need int here to prevent wraps in loop
-	if (create == true)
-		gf2_8_inv[0] = 0;
-	else if (gf2_8_inv[0] != 0)
-		return false;
-	for (a = 1; a <= 255; a++)
-		{
-		b = 1;
-		while (GF2_8_mult(a,b) != 1)
-			b++;
-
-		if (create == true)
-			gf2_8_inv[a] = b;
-		else if (gf2_8_inv[a] != b)
-			return false;
-		}
-	return true;
-	} // CheckInverses
-
-unsigned char BitSum(unsigned char byte)
+constexpr unsigned char BitSum(unsigned char byte)
 	{ // return the sum of bits mod 2
 	byte = (byte>>4)^(byte&15);
 	byte = (byte>>2)^(byte&3);
 	return (byte>>1)^(byte&1);
 	} // BitSum
 
-bool CheckByteSub(bool create)
+// all lookup tables, generated by the compiler and placed in read-only memory
+struct AESTables
 	{
-	if (CheckInverses(create) == false)
-		return false; // we cannot do this without inverses
+	// tables for inverses, byte sub
+	unsigned char gf2_8_inv[256];
+	unsigned char byte_sub[256];
+	unsigned char inv_byte_sub[256];
+
+	// this table needs Nb*(Nr+1)/Nk entries - up to 8*(15)/4 = 60
+	// todo - remove table, note cycles every 17(?) elements
+	uint32_t Rcon[60];
+
+	// long tables for encryption stuff
+	uint32_t T0[256];
+	uint32_t T1[256];
+	uint32_t T2[256];
+	uint32_t T3[256];
+
+	// long tables for decryption stuff
+	uint32_t I0[256];
+	uint32_t I1[256];
+	uint32_t I2[256];
+	uint32_t I3[256];
+	};
+
+constexpr AESTables CreateAESTables()
+	{
+	AESTables t = {};
+	unsigned int a = 0, b = 0, x = 0, y = 0; // need ints here to prevent wraps in loop
+
+	// inverses from the powers of the generator 0x03, much cheaper for the compiler than a search per element
+	unsigned char exp[255] = {}, log[256] = {};
+	for (a = 0, b = 1; a < 255; a++)
+		{
+		exp[a] = b;
+		log[b] = a;
+		b = GF2_8_mult(b,0x03);
+		}
+	t.gf2_8_inv[0] = 0;
+	for (a = 1; a <= 255; a++)
+		t.gf2_8_inv[a] = exp[(255 - log[a]) % 255];
 
-	unsigned int x,y; // need ints here to prevent wrap in loop
+	// byte sub and its inverse
 	for (x = 0; x <= 255; x++)
 		{
-		y = gf2_8_inv[x]; // inverse to start with
+		y = t.gf2_8_inv[x]; // inverse to start with
 
 		// affine transform
 		y = BitSum(y&0xF1) | (BitSum(y&0xE3)<<1) | (BitSum(y&0xC7)<<2) | (BitSum(y&0x8F)<<3) |
 			(BitSum(y&0x1F)<<4) | (BitSum(y&0x3E)<<5) | (BitSum(y&0x7C)<<6) | (BitSum(y&0xF8)<<7);
 		y = y ^ 0x63;
-		if (create == true)
-			byte_sub[x] = y;
-		else if (byte_sub[x] != y)
-			return false;
+		t.byte_sub[x] = y;
+		t.inv_byte_sub[y] = x;
 		}
-	return true;
-	} // CheckByteSub
 
-bool CheckInvByteSub(bool create)
-	{
-	if (CheckInverses(create) == false)
-		return false; // we cannot do this without inverses
-	if (CheckByteSub(create) == false)
-		return false; // we cannot do this without byte_sub
-
-	unsigned int x,y; // need ints here to prevent wrap in loop
-	for (x = 0; x <= 255; x++)
+	// round constants
+	unsigned char Ri = 1; // start here
+	t.Rcon[0] = 0;
+	for (unsigned int i = 1; i < sizeof(t.Rcon)/sizeof(t.Rcon[0])-1; i++)
 		{
-		// we brute force it...
-		y = 0;
-		while (byte_sub[y] != x)
-			y++;
-		if (create == true)
-			inv_byte_sub[x] = y;
-		else if (inv_byte_sub[x] != y)
-			return false;
+		t.Rcon[i] = Ri;
+		Ri = xmult(Ri); // multiply by x
 		}
-	return true;
-	} // CheckInvByteSub
-
-bool CheckRcon(bool create)
-	{
-	unsigned char Ri = 1; // start here
 
-	if (create == true)
-		Rcon[0] = 0;
-	else if (Rcon[0] != 0)
-		return false; // todo - this is unused still check?
-	for (unsigned int i = 1; i < sizeof(Rcon)/sizeof(Rcon[0])-1; i++)
+	// round tables
+	unsigned char a1 = 0, a2 = 0, a3 = 0, b1 = 0, b2 = 0, b3 = 0, b4 = 0, b5 = 0;
+	for (unsigned int i = 0; i < 256; i++)
 		{
-		if (create == true)
-			Rcon[i] = Ri;
-		else if (Rcon[i] != Ri)
-			return false;
-		Ri = GF2_8_mult(Ri,0x02); // multiply by x - todo replace with xmult
+		a1 = t.byte_sub[i];
+		a2 = xmult(a1);
+		a3 = a2^a1;
+
+		b5 = t.inv_byte_sub[i];
+		b1 = GF2_8_mult(0x0E,b5);
+		b2 = GF2_8_mult(0x09,b5);
+		b3 = GF2_8_mult(0x0D,b5);
+		b4 = GF2_8_mult(0x0B,b5);
+
+		t.T0[i] = VEC4(a2,a1,a1,a3);
+		t.T1[i] = RotByteL(t.T0[i]);
+		t.T2[i] = RotByteL(t.T1[i]);
+		t.T3[i] = RotByteL(t.T2[i]);
+
+		t.I0[i] = VEC4(b1,b2,b3,b4);
+		t.I1[i] = RotByteL(t.I0[i]);
+		t.I2[i] = RotByteL(t.I1[i]);
+		t.I3[i] = RotByteL(t.I2[i]);
 		}
-	return true;
-	} // CheckRCon
+	return t;
+	} // CreateAESTables
+
+constexpr AESTables tables = CreateAESTables();
+
+// known values of FIPS-197 to catch a broken table generation at compile time
+static_assert(tables.byte_sub[0x00] == 0x63 && tables.byte_sub[0x53] == 0xED, "S-box");
+static_assert(tables.inv_byte_sub[0xED] == 0x53, "inverse S-box");
+static_assert(tables.Rcon[1] == 0x01 && tables.Rcon[8] == 0x80 && tables.Rcon[10] == 0x36, "Rcon");
+static_assert(tables.T0[0x00] == 0xA56363C6, "T0");
+
+// short names for the round macros
+constexpr const unsigned char (&byte_sub)[256] = tables.byte_sub;
+constexpr const unsigned char (&inv_byte_sub)[256] = tables.inv_byte_sub;
+constexpr const uint32_t (&Rcon)[60] = tables.Rcon;
+constexpr const uint32_t (&T0)[256] = tables.T0;
+constexpr const uint32_t (&T1)[256] = tables.T1;
+constexpr const uint32_t (&T2)[256] = tables.T2;
+constexpr const uint32_t (&T3)[256] = tables.T3;
+constexpr const uint32_t (&I0)[256] = tables.I0;
+constexpr const uint32_t (&I1)[256] = tables.I1;
+constexpr const uint32_t (&I2)[256] = tables.I2;
+constexpr const uint32_t (&I3)[256] = tables.I3;
 
 // key adding for 4,6,8 column cases
 #define AddRoundKey4(dest,src)	\
@@ -332,7 +249,8 @@ bool CheckRcon(bool create)
 	T2[GetByte(src2[((j+C2+Nb)%Nb)],2)]^T3[GetByte(src2[((j+C3+Nb)%Nb)],3)] \
 	^*r_ptr++
 
-// single table version, slower
+// single table version, T1..T3 are T0 rotated by 1..3 bytes
+// a quarter of the cache footprint for three more rotations per column
 #define compute_one_small(dest,src2,j,C1,C2,C3,Nb)	*(dest+j) = *r_ptr++^\
 	T0[GetByte(src2[j],0)]^\
 	RotByteL(T0[GetByte(src2[((j+C1+Nb)%Nb)],1)]^\
@@ -363,11 +281,28 @@ bool CheckRcon(bool create)
 		compute_one(d,s,6,1,3,4,8); \
 		compute_one(d,s,7,1,3,4,8);
 
+#define Round8Small(d,s) \
+		compute_one_small(d,s,0,1,3,4,8); \
+		compute_one_small(d,s,1,1,3,4,8); \
+		compute_one_small(d,s,2,1,3,4,8); \
+		compute_one_small(d,s,3,1,3,4,8); \
+		compute_one_small(d,s,4,1,3,4,8); \
+		compute_one_small(d,s,5,1,3,4,8); \
+		compute_one_small(d,s,6,1,3,4,8); \
+		compute_one_small(d,s,7,1,3,4,8);
+
 #define compute_one_inv(dest,src2,j,C1,C2,C3,Nb)	*(dest+j) = \
 	I0[GetByte(src2[j],0)]^I1[GetByte(src2[((j-C1+Nb)%Nb)],1)]^ \
 	I2[GetByte(src2[((j-C2+Nb)%Nb)],2)]^I3[GetByte(src2[((j-C3+Nb)%Nb)],3)] \
 	^*r_ptr++
 
+// single table version of the inverse cipher
+#define compute_one_inv_small(dest,src2,j,C1,C2,C3,Nb)	*(dest+j) = *r_ptr++^\
+	I0[GetByte(src2[j],0)]^\
+	RotByteL(I0[GetByte(src2[((j-C1+Nb)%Nb)],1)]^\
+	RotByteL(I0[GetByte(src2[((j-C2+Nb)%Nb)],2)]^\
+	RotByteL(I0[GetByte(src2[((j-C3+Nb)%Nb)],3)])))
+
 #define InvRound4(d,s)	\
 		compute_one_inv(d,s,0,1,2,3,4); \
 		compute_one_inv(d,s,1,1,2,3,4);	\
@@ -392,6 +327,16 @@ bool CheckRcon(bool create)
 		compute_one_inv(d,s,6,1,3,4,8);	\
 		compute_one_inv(d,s,7,1,3,4,8);
 
+#define InvRound8Small(d,s)	\
+		compute_one_inv_small(d,s,0,1,3,4,8); \
+		compute_one_inv_small(d,s,1,1,3,4,8);	\
+		compute_one_inv_small(d,s,2,1,3,4,8);	\
+		compute_one_inv_small(d,s,3,1,3,4,8);	\
+		compute_one_inv_small(d,s,4,1,3,4,8);	\
+		compute_one_inv_small(d,s,5,1,3,4,8);	\
+		compute_one_inv_small(d,s,6,1,3,4,8);	\
+		compute_one_inv_small(d,s,7,1,3,4,8);
+
 // this define computes one of the final round vectors
 #define compute_one_final1(dest,src,j,C1,C2,C3,Nb)  *dest++ = \
 	(T3[GetByte(src[j],0)]&0xFF)^\
@@ -399,12 +344,13 @@ bool CheckRcon(bool create)
 	(T1[GetByte(src[((j+C2+Nb)%Nb)],2)]&0xFF0000)^ \
 	(T1[GetByte(src[((j+C3+Nb)%Nb)],3)]&0xFF000000)^*r_ptr++
 
-// for another 4K tables, we save 3 clock cycles - sick
+// the final round has no MixColumns, the S-box bytes are looked up directly
+// instead of in another 4K of shifted tables
 #define compute_one_final(dest,src,j,C1,C2,C3,Nb)  *dest++ = \
-	(T4[GetByte(src[j],0)])^\
-	(T5[GetByte(src[((j+C1+Nb)%Nb)],1)])^ \
-	(T6[GetByte(src[((j+C2+Nb)%Nb)],2)])^ \
-	(T7[GetByte(src[((j+C3+Nb)%Nb)],3)])^*r_ptr++
+	VEC4(byte_sub[GetByte(src[j],0)], \
+	byte_sub[GetByte(src[((j+C1+Nb)%Nb)],1)], \
+	byte_sub[GetByte(src[((j+C2+Nb)%Nb)],2)], \
+	byte_sub[GetByte(src[((j+C3+Nb)%Nb)],3)])^*r_ptr++
 
 // final round defines - this one is for case for 4 columns
 #define FinalRound4(d,s) compute_one_final(d,s,0,1,2,3,4); \
@@ -430,10 +376,10 @@ bool CheckRcon(bool create)
 
 // inverse cipher stuff
 #define compute_one_final_inv(dest,src,j,C1,C2,C3,Nb)  *dest++ = \
-	(I4[GetByte(src[j],0)])^\
-	(I5[GetByte(src[((j-C1+Nb)%Nb)],1)])^ \
-	(I6[GetByte(src[((j-C2+Nb)%Nb)],2)])^ \
-	(I7[GetByte(src[((j-C3+Nb)%Nb)],3)])^*r_ptr++
+	VEC4(inv_byte_sub[GetByte(src[j],0)], \
+	inv_byte_sub[GetByte(src[((j-C1+Nb)%Nb)],1)], \
+	inv_byte_sub[GetByte(src[((j-C2+Nb)%Nb)],2)], \
+	inv_byte_sub[GetByte(src[((j-C3+Nb)%Nb)],3)])^*r_ptr++
 
 // final round defines - this one is for case for 4 columns
 #define InvFinalRound4(d,s) compute_one_final_inv(d,s,0,1,2,3,4); \
@@ -457,7 +403,7 @@ bool CheckRcon(bool create)
 						compute_one_final_inv(d,s,6,1,3,4,8); \
 						compute_one_final_inv(d,s,7,1,3,4,8);
 
-unsigned long SubByte(unsigned long data)
+uint32_t SubByte(uint32_t data)
 	{ // does the SBox on this 4 byte data
 	unsigned result = 0;
 	result = byte_sub[data>>24];
@@ -470,30 +416,13 @@ unsigned long SubByte(unsigned long data)
 	return result;
 	} // SubByte
 
-// return true iff tables are valid. create = true fills them in if not
-bool CreateAESTables(bool create)
-	{
-	bool retval = true;
-	if (CheckInverses(create) == false)
-		retval = false;
-	if (CheckByteSub(create) == false)
-		retval = false;
-	if (CheckInvByteSub(create) == false)
-		retval = false;
-	if (CheckRcon(create) == false)
-		return false;
-	if (CheckLargeTables(create) == false)
-		return false;
-	return retval;
-	} // CreateAESTables
-
 }// end of anonymous namespace
 
 // Key expansion code - makes local copy
 void AES::KeyExpansion(const unsigned char * key)
 	{
 	int i;
-	unsigned long temp, * Wb = reinterpret_cast<unsigned long*>(W); // todo not portable - Endian problems
+	uint32_t temp, * Wb = reinterpret_cast<uint32_t*>(W); // todo not portable - Endian problems
 	if (Nk <= 6)
 		{
 		// todo - memcpy
@@ -555,6 +484,8 @@ void AES::StartEncryption(const unsigned char * key)
 	{
 	memset(iv, 0xff, sizeof(iv));
 	KeyExpansion(key);
+	if (Nb == 8)
+		AESBitsliceKey(reinterpret_cast<uint32_t*>(W), Nr, WS);
 	} // StartEncryption
 
 void AES::EncryptBlock(const unsigned char * datain1, unsigned char * dataout1)
@@ -562,12 +493,18 @@ void AES::EncryptBlock(const unsigned char * datain1, unsigned char * dataout1)
 	  // todo - clean up - lots of repeated macros
 	  // we only encrypt one block from now on
 
-	unsigned long state[8*2]; // 2 buffers
-	unsigned long * r_ptr = reinterpret_cast<unsigned long*>(W);
-	unsigned long * dest  = state;
-	unsigned long * src   = state;
-	const unsigned long * datain = reinterpret_cast<const unsigned long*>(datain1);
-	unsigned long * dataout = reinterpret_cast<unsigned long*>(dataout1);
+	uint32_t state[8*2]; // 2 buffers
+	uint32_t * r_ptr = reinterpret_cast<uint32_t*>(W);
+	uint32_t * dest  = state;
+	uint32_t * src   = state;
+	const uint32_t * datain = reinterpret_cast<const uint32_t*>(datain1);
+	uint32_t * dataout = reinterpret_cast<uint32_t*>(dataout1);
+
+	if ((tableMode == TABLES_NONE) && (Nb == 8))
+		{
+		AESBitsliceEncrypt(WS,Nr,datain1,dataout1,1);
+		return;
+		}
 
 	if (Nb == 4)
 		{
@@ -622,6 +559,26 @@ void AES::EncryptBlock(const unsigned char * datain1, unsigned char * dataout1)
 
 		FinalRound6(dataout,dest);
 		}
+	else if (tableMode == TABLES_COMPACT) // Nb == 8
+		{
+		AddRoundKey8(dest,datain);
+
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+		Round8Small(src,dest);
+		Round8Small(dest,src);
+
+		FinalRound8(dataout,dest);
+		}
 	else // Nb == 8
 		{
 		AddRoundKey8(dest,datain);
@@ -651,6 +608,18 @@ void AES::Encrypt(const unsigned char * datain, unsigned char * dataout, unsigne
 	if (0 == numBlocks)
 		return;
 	unsigned int blocksize = Nb*4;
+	if ((tableMode == TABLES_NONE) && (Nb == 8) && (mode == ECB))
+		{
+		while (numBlocks)
+			{
+			int blocks = numBlocks < AES_BITSLICE_BLOCKS ? numBlocks : AES_BITSLICE_BLOCKS;
+			AESBitsliceEncrypt(WS,Nr,datain,dataout,blocks);
+			datain   += blocks*blocksize;
+			dataout  += blocks*blocksize;
+			numBlocks -= blocks;
+			}
+		return;
+		}
 	switch (mode)
 		{
 		case ECB :
@@ -712,21 +681,30 @@ void AES::StartDecryption(const unsigned char * key)
 		}
 
 	// we reverse the rounds to make decryption faster
-	unsigned long * WL = reinterpret_cast<unsigned long*>(W);
+	uint32_t * WL = reinterpret_cast<uint32_t*>(W);
 	for (int pos = 0; pos < Nr/2; pos++)
 		for (int col = 0; col < Nb; col++)
 			swap(WL[col+pos*Nb],WL[col+(Nr-pos)*Nb]);
+
+	if (Nb == 8)
+		AESBitsliceKey(WL, Nr, WS);
 	} // StartDecryption
 
 void AES::DecryptBlock(const unsigned char * datain1, unsigned char * dataout1)
 	{
-	unsigned long state[8*2]; // 2 buffers
-	unsigned long * r_ptr = reinterpret_cast<unsigned long*>(W);
-	unsigned long * dest  = state;
-	unsigned long * src   = state;
+	uint32_t state[8*2]; // 2 buffers
+	uint32_t * r_ptr = reinterpret_cast<uint32_t*>(W);
+	uint32_t * dest  = state;
+	uint32_t * src   = state;
 
-	const unsigned long * datain = reinterpret_cast<const unsigned long*>(datain1);
-	unsigned long * dataout = reinterpret_cast<unsigned long*>(dataout1);
+	const uint32_t * datain = reinterpret_cast<const uint32_t*>(datain1);
+	uint32_t * dataout = reinterpret_cast<uint32_t*>(dataout1);
+
+	if ((tableMode == TABLES_NONE) && (Nb == 8))
+		{
+		AESBitsliceDecrypt(WS,Nr,datain1,dataout1,1);
+		return;
+		}
 
 	if (Nb == 4)
 		{
@@ -781,6 +759,26 @@ void AES::DecryptBlock(const unsigned char * datain1, unsigned char * dataout1)
 
 		InvFinalRound6(dataout,dest);
 		}
+	else if (tableMode == TABLES_COMPACT) // Nb == 8
+		{
+		AddRoundKey8(dest,datain);
+
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+		InvRound8Small(src,dest);
+		InvRound8Small(dest,src);
+
+		InvFinalRound8(dataout,dest);
+		}
 	else // Nb == 8
 		{
 		AddRoundKey8(dest,datain);
@@ -809,6 +807,11 @@ void AES::Decrypt(const unsigned char * datain, unsigned char * dataout, unsigne
 	if (0 == numBlocks)
 		return;
 	unsigned int blocksize = Nb*4;
+	if ((tableMode == TABLES_NONE) && (Nb == 8))
+		{
+		DecryptBitsliced(datain,dataout,numBlocks,mode);
+		return;
+		}
 	switch (mode)
 		{
 		case ECB :
@@ -848,11 +851,41 @@ void AES::Decrypt(const unsigned char * datain, unsigned char * dataout, unsigne
 		}
 	} // Decrypt
 
-// the constructor - makes sure local things are initialized
-AES::AES(void)
+// the blocks of a CBC chain are independent for decryption, so they are decrypted in parallel
+void AES::DecryptBitsliced(const unsigned char * datain, unsigned char * dataout, unsigned long numBlocks, BlockMode mode)
+	{
+	unsigned char chain[32]; // previous cipher text block
+	unsigned char buffer[32*AES_BITSLICE_BLOCKS];
+	memcpy(chain,iv,32);
+	while (numBlocks)
+		{
+		int blocks = numBlocks < AES_BITSLICE_BLOCKS ? numBlocks : AES_BITSLICE_BLOCKS;
+		// keep the cipher text, the decryption may be in place
+		memcpy(buffer,datain,blocks*32);
+		AESBitsliceDecrypt(WS,Nr,buffer,dataout,blocks);
+		if (mode == CBC)
+			{
+			for (unsigned int pos = 0; pos < 32; ++pos)
+				dataout[pos] ^= chain[pos];
+			for (unsigned int pos = 32; pos < blocks*32u; ++pos)
+				dataout[pos] ^= buffer[pos-32];
+			memcpy(chain,buffer+(blocks-1)*32,32);
+			}
+		datain   += blocks*32;
+		dataout  += blocks*32;
+		numBlocks -= blocks;
+		}
+	} // DecryptBitsliced
+
+// the constructor - the tables are generated at compile time, nothing to initialize
+AES::AES(void) :
+	tableMode(TABLES_FULL)
+	{
+	}
+
+void AES::SetTableMode(TableMode mode)
 	{
-	if (false == tablesInitialized)
-		tablesInitialized = CreateAESTables(true);
+	tableMode = mode;
 	}
 
 // end - AES.cpp
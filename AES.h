@@ -54,6 +54,9 @@
    aes.Encrypt(data,output,3); // note data and output must be at least 48 bytes!
   */
 
+#include <stdint.h>
+#include "AESBitslice.h"
+
 #define ROUNDUP(x, y)				(((x) + (y-1)) & ~(y-1))
 #define ROUNDDOWN(x, y)				((x) & ~(y-1))
 
@@ -62,8 +65,7 @@
 class AES
 	{
 public:
-	// the constructor - makes sure local things are initialized
-	// it if fails, throws the string "Tables failed to initialize"
+	// the constructor - nothing to initialize, the lookup tables are generated at compile time
 	AES(void);
 
 	// multiple block encryption/decryption modes
@@ -78,10 +80,21 @@ public:
 		// todo - GCM = 6, - http://www.cryptobarn.com/papers/gcm-spec.pdf
 		};
 
+	// lookup tables used by the round functions
+	enum TableMode {
+		TABLES_FULL = 0,   // four 1K tables per direction
+		TABLES_COMPACT = 1, // one 1K table per direction plus rotations, a quarter of the
+		                    // cache footprint when many sessions encrypt at once (256 bit blocks only)
+		TABLES_NONE = 2     // bitsliced, constant time and AES_BITSLICE_BLOCKS blocks at once for ECB
+		                    // and CBC decryption (256 bit blocks only, the key schedule still uses tables)
+		};
+
 	// block and key size are in bits, legal values are 128, 192, and 256 independently.
 	// NOTE: the AES standard only uses a blocksize of 128, so we default to that
 	void SetParameters(int keylength, int blocklength = 128);
 	void SetIV(const unsigned char * ucIV, unsigned int iIVsize);
+	// default TABLES_FULL, other block sizes always use the full tables
+	void SetTableMode(TableMode mode);
 
 	// call this before any encryption with the key to use
 	void StartEncryption(const unsigned char * key);
@@ -108,12 +121,16 @@ private:
 
 	int Nb,Nk;    // block and key length / 32, should be 4,6,or 8
 	int Nr;       // number of rounds
+	TableMode tableMode;
 
 	unsigned char W[4*8*15];   // the expanded key
+	uint32_t WS[15*AES_BITSLICE_PLANES]; // the expanded key as bit planes for TABLES_NONE
 	unsigned char iv[32];  	   // initial value which is incremented
 
 	// Key expansion code - makes local copy
 	void KeyExpansion(const unsigned char * key);
+	// ECB and CBC decryption of 256 bit blocks with TABLES_NONE
+	void DecryptBitsliced(const unsigned char * datain, unsigned char * dataout, unsigned long numBlocks, BlockMode mode);
 
 	}; // class AES
 
@@ -0,0 +1,369 @@
+/* AESBitslice.cpp
+
+  Bitsliced Rijndael with 256 bit blocks, see AESBitslice.h.
+
+  Bit layout of a lane: bit 8*r + c holds the bit of the state byte in row r and column c, so a
+  row is one byte of the lane. ShiftRows rotates within the bytes and MixColumns rotates the lane
+  by whole bytes. The S-box is the 113 gate circuit of Boyar and Peralta, the inverse S-box wraps
+  it into the inverse affine transformation.
+*/
+
+#include <string.h>
+#include "AESBitslice.h"
+
+namespace { // anonymous namespace
+
+// one lane per block
+typedef uint32_t slice_t __attribute__ ((vector_size (4*AES_BITSLICE_BLOCKS)));
+
+#define ROTR32(x,n) (((x)>>(n))|((x)<<(32-(n))))
+
+// exchange the bits mask << n of a with the bits mask of b
+#define SWAPN(a,b,mask,n) \
+	{ \
+	T t = (((a)>>(n))^(b))&(mask); \
+	(b) ^= t; \
+	(a) ^= t<<(n); \
+	}
+
+// exchange the word index with the bit index within each byte, q[w] byte j bit b <-> q[b] byte j bit w,
+// the transformation is its own inverse
+template<class T> inline void Ortho(T * q)
+	{
+	SWAPN(q[0],q[1],0x55555555,1);
+	SWAPN(q[2],q[3],0x55555555,1);
+	SWAPN(q[4],q[5],0x55555555,1);
+	SWAPN(q[6],q[7],0x55555555,1);
+
+	SWAPN(q[0],q[2],0x33333333,2);
+	SWAPN(q[1],q[3],0x33333333,2);
+	SWAPN(q[4],q[6],0x33333333,2);
+	SWAPN(q[5],q[7],0x33333333,2);
+
+	SWAPN(q[0],q[4],0x0F0F0F0F,4);
+	SWAPN(q[1],q[5],0x0F0F0F0F,4);
+	SWAPN(q[2],q[6],0x0F0F0F0F,4);
+	SWAPN(q[3],q[7],0x0F0F0F0F,4);
+	}
+
+// column w of each block goes to lane w of q[w] before the transposition
+inline void Load(slice_t * q, const unsigned char * datain, int numBlocks)
+	{
+	uint32_t columns[AES_BITSLICE_PLANES][AES_BITSLICE_BLOCKS];
+	memset(columns, 0, sizeof(columns));
+	for (int block = 0; block < numBlocks; block++)
+		for (int col = 0; col < 8; col++)
+			memcpy(&columns[col][block], datain + 32*block + 4*col, 4);
+	memcpy(q, columns, sizeof(columns));
+	Ortho(q);
+	}
+
+inline void Store(slice_t * q, unsigned char * dataout, int numBlocks)
+	{
+	uint32_t columns[AES_BITSLICE_PLANES][AES_BITSLICE_BLOCKS];
+	Ortho(q);
+	memcpy(columns, q, sizeof(columns));
+	for (int block = 0; block < numBlocks; block++)
+		for (int col = 0; col < 8; col++)
+			memcpy(dataout + 32*block + 4*col, &columns[col][block], 4);
+	}
+
+inline void AddRoundKey(slice_t * q, const uint32_t * planes)
+	{
+	for (int i = 0; i < 8; i++)
+		q[i] ^= planes[i];
+	}
+
+// Boyar, Peralta - "A depth-16 circuit for the AES S-box", q[0] is the least significant bit
+inline void SubBytes(slice_t * q)
+	{
+	slice_t x0, x1, x2, x3, x4, x5, x6, x7;
+	slice_t y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+	slice_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12, z13, z14, z15, z16, z17;
+	slice_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	slice_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	slice_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	slice_t t60, t61, t62, t63, t64, t65, t66, t67;
+	slice_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	// top linear transformation
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	// non-linear section, the inversion in GF(2^8)
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	// bottom linear transformation, includes the affine transformation of the S-box
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0;
+	q[6] = s1;
+	q[5] = s2;
+	q[4] = s3;
+	q[3] = s4;
+	q[2] = s5;
+	q[1] = s6;
+	q[0] = s7;
+	}
+
+// inverse of the affine transformation of the S-box, including its constant
+inline void InvAffine(slice_t * q)
+	{
+	slice_t q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+	// b'[i] = b[i+2] ^ b[i+5] ^ b[i+7] ^ 0x05[i]
+	q[0] = ~(q5 ^ q2 ^ q7);
+	q[1] = q0 ^ q3 ^ q6;
+	q[2] = ~(q7 ^ q1 ^ q4);
+	q[3] = q0 ^ q2 ^ q5;
+	q[4] = q1 ^ q3 ^ q6;
+	q[5] = q2 ^ q4 ^ q7;
+	q[6] = q0 ^ q3 ^ q5;
+	q[7] = q1 ^ q4 ^ q6;
+	}
+
+// InvS(y) = L(S(L(y))) with the inverse affine transformation L
+inline void InvSubBytes(slice_t * q)
+	{
+	InvAffine(q);
+	SubBytes(q);
+	InvAffine(q);
+	}
+
+// row r is rotated left by 0, 1, 3 and 4 columns, columns are the bits within the row byte
+inline void ShiftRows(slice_t * q)
+	{
+	for (int i = 0; i < 8; i++)
+		{
+		slice_t x = q[i];
+		q[i] = (x & 0x000000FF) |
+			((x >> 1) & 0x00007F00) | ((x << 7) & 0x00008000) |
+			((x >> 3) & 0x001F0000) | ((x << 5) & 0x00E00000) |
+			((x >> 4) & 0x0F000000) | ((x << 4) & 0xF0000000);
+		}
+	}
+
+inline void InvShiftRows(slice_t * q)
+	{
+	for (int i = 0; i < 8; i++)
+		{
+		slice_t x = q[i];
+		q[i] = (x & 0x000000FF) |
+			((x << 1) & 0x0000FE00) | ((x >> 7) & 0x00000100) |
+			((x << 3) & 0x00F80000) | ((x >> 5) & 0x00070000) |
+			((x >> 4) & 0x0F000000) | ((x << 4) & 0xF0000000);
+		}
+	}
+
+// multiply each byte by 2 in GF(2^8), across the planes
+inline void XTime(slice_t * d, const slice_t * s)
+	{
+	slice_t hi = s[7];
+	d[7] = s[6];
+	d[6] = s[5];
+	d[5] = s[4];
+	d[4] = s[3] ^ hi;
+	d[3] = s[2] ^ hi;
+	d[2] = s[1];
+	d[1] = s[0] ^ hi;
+	d[0] = hi;
+	}
+
+// out[r] = 2*a[r] ^ 3*a[r+1] ^ a[r+2] ^ a[r+3] = 2*(a[r] ^ a[r+1]) ^ a[r+1] ^ a[r+2] ^ a[r+3],
+// rotating the lane right by 8 bits moves row r+1 to row r
+inline void MixColumns(slice_t * q)
+	{
+	slice_t t[8], x[8];
+	for (int i = 0; i < 8; i++)
+		t[i] = q[i] ^ ROTR32(q[i], 8);
+	XTime(x, t);
+	for (int i = 0; i < 8; i++)
+		q[i] = x[i] ^ ROTR32(q[i], 8) ^ ROTR32(t[i], 16);
+	}
+
+// the inverse matrix (0E 0B 0D 09) is (02 03 01 01) * (05 00 04 00), so
+// a[r] ^= 4*(a[r] ^ a[r+2]) before MixColumns
+inline void InvMixColumns(slice_t * q)
+	{
+	slice_t t[8], x[8];
+	for (int i = 0; i < 8; i++)
+		t[i] = q[i] ^ ROTR32(q[i], 16);
+	XTime(x, t);
+	XTime(t, x);
+	for (int i = 0; i < 8; i++)
+		q[i] ^= t[i];
+	MixColumns(q);
+	}
+
+}// end of anonymous namespace
+
+void AESBitsliceKey(const uint32_t * W, int Nr, uint32_t * planes)
+	{
+	for (int round = 0; round <= Nr; round++)
+		{
+		uint32_t * q = planes + round*AES_BITSLICE_PLANES;
+		memcpy(q, W + round*8, 8*sizeof(uint32_t));
+		Ortho(q);
+		}
+	}
+
+void AESBitsliceEncrypt(const uint32_t * planes, int Nr, const unsigned char * datain, unsigned char * dataout, int numBlocks)
+	{
+	slice_t q[AES_BITSLICE_PLANES];
+
+	Load(q, datain, numBlocks);
+	AddRoundKey(q, planes);
+	for (int round = 1; round < Nr; round++)
+		{
+		SubBytes(q);
+		ShiftRows(q);
+		MixColumns(q);
+		AddRoundKey(q, planes + round*AES_BITSLICE_PLANES);
+		}
+	SubBytes(q);
+	ShiftRows(q);
+	AddRoundKey(q, planes + Nr*AES_BITSLICE_PLANES);
+	Store(q, dataout, numBlocks);
+	} // AESBitsliceEncrypt
+
+void AESBitsliceDecrypt(const uint32_t * planes, int Nr, const unsigned char * datain, unsigned char * dataout, int numBlocks)
+	{
+	slice_t q[AES_BITSLICE_PLANES];
+
+	Load(q, datain, numBlocks);
+	AddRoundKey(q, planes);
+	for (int round = 1; round < Nr; round++)
+		{
+		InvSubBytes(q);
+		InvShiftRows(q);
+		InvMixColumns(q);
+		AddRoundKey(q, planes + round*AES_BITSLICE_PLANES);
+		}
+	InvSubBytes(q);
+	InvShiftRows(q);
+	AddRoundKey(q, planes + Nr*AES_BITSLICE_PLANES);
+	Store(q, dataout, numBlocks);
+	} // AESBitsliceDecrypt
+
+// end - AESBitslice.cpp
@@ -0,0 +1,33 @@
+/* AESBitslice.h
+
+  Bitsliced Rijndael with 256 bit blocks for the AES class, see AES::SetTableMode().
+
+  The cipher state is kept as 8 bit planes, plane b holds bit b of all 32 bytes of a block in one
+  32 bit lane. The planes are GCC vector types of AES_BITSLICE_BLOCKS lanes, so every operation
+  processes that many independent blocks at once with SSE2 or NEON. There are no lookup tables
+  and no secret dependent branches or memory accesses, the run time does not depend on key or data.
+*/
+
+#ifndef _AES_BITSLICE_H
+#define _AES_BITSLICE_H
+
+#include <stdint.h>
+
+// independent blocks processed by one call
+#define AES_BITSLICE_BLOCKS		4
+// round key planes per round
+#define AES_BITSLICE_PLANES		8
+
+// convert the expanded key W of Nr+1 round keys of 8 columns into the bitsliced round keys,
+// planes must hold (Nr+1)*AES_BITSLICE_PLANES words
+void AESBitsliceKey(const uint32_t * W, int Nr, uint32_t * planes);
+
+// encrypt numBlocks (1 to AES_BITSLICE_BLOCKS) independent blocks with the encryption key planes,
+// in place operation is allowed
+void AESBitsliceEncrypt(const uint32_t * planes, int Nr, const unsigned char * datain, unsigned char * dataout, int numBlocks);
+
+// decrypt numBlocks (1 to AES_BITSLICE_BLOCKS) independent blocks with the key planes of the
+// equivalent inverse cipher as set up by AES::StartDecryption(), in place operation is allowed
+void AESBitsliceDecrypt(const uint32_t * planes, int Nr, const unsigned char * datain, unsigned char * dataout, int numBlocks);
+
+#endif //  _AES_BITSLICE_H
@@ -0,0 +1,532 @@
+/*
+ * RscpAlarms.cpp
+ *
+ * Threshold alarms evaluated on the received values.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include "RscpAlarms.h"
+#include "RscpTagPath.h"
+#include "RscpTags.h"
+
+extern char **environ;
+
+// the response bit of a tag, request tag names in a rule path are converted
+#define ALARM_RESPONSE_BIT		0x00800000
+
+static const char *operatorNames[] = { ">", ">=", "<", "<=", "==", "!=", "&" };
+
+RscpAlarms::RscpAlarms() :
+	m_pLog(NULL), m_uDropped(0), m_bStop(false) {
+}
+
+RscpAlarms::~RscpAlarms() {
+	stop();
+}
+
+const char *RscpAlarms::operatorName(uint8_t op) {
+	return (op < sizeof(operatorNames) / sizeof(operatorNames[0])) ? operatorNames[op] : "?";
+}
+
+static bool parseNumber(const char *value, double *result) {
+	char *end = NULL;
+	errno = 0;
+	double d = strtod(value, &end);
+	if((errno != 0) || (end == value) || (*end != '\0')) {
+		return false;
+	}
+	*result = d;
+	return true;
+}
+
+bool RscpAlarms::parseRule(const char *value, SRscpAlarmRule & rule, const char *where) {
+	memset(&rule, 0, sizeof(rule));
+	char name[64], path[256], op[4], threshold[64];
+	int consumed = 0;
+	if(sscanf(value, "%63s %255s %3s %63s%n", name, path, op, threshold, &consumed) != 4) {
+		printf("%s: expected alarm = name path op threshold [clear value] [every seconds]\n", where);
+		return false;
+	}
+	if(strlen(name) >= ALARM_NAME_LENGTH) {
+		printf("%s: alarm name %s is longer than %i characters\n", where, name, ALARM_NAME_LENGTH - 1);
+		return false;
+	}
+	for(const char *c = name; *c; c++) {
+		if(!isalnum((unsigned char) *c) && (*c != '_') && (*c != '-')) {
+			printf("%s: invalid alarm name %s\n", where, name);
+			return false;
+		}
+	}
+	strcpy(rule.name, name);
+
+	char *save = NULL;
+	for(char *element = strtok_r(path, "/", &save); element != NULL; element = strtok_r(NULL, "/", &save)) {
+		if(rule.depth == ALARM_PATH_DEPTH) {
+			printf("%s: alarm path is deeper than %i\n", where, ALARM_PATH_DEPTH);
+			return false;
+		}
+		SRscpAlarmPathPart & part = rule.path[rule.depth++];
+		part.index = -1;
+		char *bracket = strchr(element, '[');
+		if(bracket != NULL) {
+			char *end;
+			long index = strtol(bracket + 1, &end, 0);
+			if((end == bracket + 1) || (strcmp(end, "]") != 0) || (index < 0) || (index > UINT8_MAX)) {
+				printf("%s: invalid index in %s, expected [0..255]\n", where, element);
+				return false;
+			}
+			part.index = index;
+			*bracket = '\0';
+		}
+		if(!RscpTagRequest::tagByName(element, &part.tag)) {
+			printf("%s: unknown tag %s\n", where, element);
+			return false;
+		}
+		// the values are checked in the responses, TAG_EMS_REQ_POWER_GRID names TAG_EMS_POWER_GRID
+		part.tag |= ALARM_RESPONSE_BIT;
+	}
+	if(rule.depth == 0) {
+		printf("%s: alarm path is empty\n", where);
+		return false;
+	}
+
+	rule.op = 0xFF;
+	for(uint8_t i = 0; i < sizeof(operatorNames) / sizeof(operatorNames[0]); i++) {
+		if(strcmp(op, operatorNames[i]) == 0) {
+			rule.op = i;
+		}
+	}
+	if(rule.op == 0xFF) {
+		printf("%s: invalid operator %s, expected one of > >= < <= == != &\n", where, op);
+		return false;
+	}
+	if(!parseNumber(threshold, &rule.threshold)
+		|| ((rule.op == ALARM_BITS) && ((rule.threshold < 1) || (rule.threshold != (uint64_t) rule.threshold)))) {
+		printf("%s: invalid threshold %s\n", where, threshold);
+		return false;
+	}
+	rule.clear = rule.threshold;
+	rule.interval = ALARM_DEFAULT_INTERVAL;
+
+	// optional hysteresis and rate limit
+	const char *rest = value + consumed;
+	char keyword[16], argument[64];
+	int next = 0;
+	while(sscanf(rest, "%15s %63s%n", keyword, argument, &next) == 2) {
+		double number;
+		if(!parseNumber(argument, &number)) {
+			printf("%s: invalid %s value %s\n", where, keyword, argument);
+			return false;
+		}
+		if(strcmp(keyword, "clear") == 0) {
+			if(rule.op > ALARM_LE) {
+				printf("%s: clear is only allowed with > >= < <=\n", where);
+				return false;
+			}
+			if(((rule.op <= ALARM_GE) && (number > rule.threshold)) || ((rule.op >= ALARM_LT) && (number < rule.threshold))) {
+				printf("%s: clear value %s is on the alarm side of the threshold\n", where, argument);
+				return false;
+			}
+			rule.clear = number;
+		}
+		else if(strcmp(keyword, "every") == 0) {
+			if((number < 0) || (number > 7 * 86400) || (number != (uint32_t) number)) {
+				printf("%s: invalid every %s, expected 0..604800 seconds\n", where, argument);
+				return false;
+			}
+			rule.interval = number;
+		}
+		else {
+			printf("%s: unknown alarm option %s\n", where, keyword);
+			return false;
+		}
+		rest += next;
+	}
+	while(isspace((unsigned char) *rest)) {
+		rest++;
+	}
+	if(*rest != '\0') {
+		printf("%s: unexpected %s\n", where, rest);
+		return false;
+	}
+	return true;
+}
+
+bool RscpAlarms::start(const std::vector<SRscpAlarmRule> & rules, const char *logPath, const char *hook,
+	const char *statePath) {
+	stop();
+	if(rules.empty()) {
+		return true;
+	}
+	if((logPath == NULL) || (strcmp(logPath, "-") == 0)) {
+		m_pLog = stdout;
+	}
+	else {
+		m_pLog = fopen(logPath, "a");
+		if(m_pLog == NULL) {
+			printf("Cannot open alarm log %s. errno %i\n", logPath, errno);
+			return false;
+		}
+	}
+	m_rules = rules;
+	m_states.assign(rules.size(), SAlarmState());
+	m_hook = (hook != NULL) ? hook : "";
+	m_statePath = (statePath != NULL) ? statePath : "";
+	m_uDropped = 0;
+
+	// one table entry per checked tag and per container tag of the paths
+	for(uint32_t r = 0; r < m_rules.size(); r++) {
+		const SRscpAlarmRule & rule = m_rules[r];
+		std::string path;
+		for(uint8_t i = 0; i < rule.depth; i++) {
+			std::vector<SAlarmTag> & table = (i + 1 == rule.depth) ? m_values : m_containers;
+			SAlarmTag *entry = NULL;
+			for(size_t j = 0; j < table.size(); j++) {
+				if(table[j].tag == rule.path[i].tag) {
+					entry = &table[j];
+				}
+			}
+			if(entry == NULL) {
+				table.push_back(SAlarmTag());
+				entry = &table.back();
+				entry->tag = rule.path[i].tag;
+				entry->indexTag = 0;
+				if((i + 1 < rule.depth) && !RscpTagRequest::indexTag(entry->tag, &entry->indexTag)) {
+					entry->indexTag = 0;
+				}
+			}
+			if(i + 1 == rule.depth) {
+				entry->rules.push_back(r);
+			}
+			const char *name = RscpTagRequest::tagName(rule.path[i].tag);
+			char part[64];
+			if(name != NULL) {
+				snprintf(part, sizeof(part), "%s", name);
+			}
+			else {
+				snprintf(part, sizeof(part), "0x%08X", rule.path[i].tag);
+			}
+			path += (i > 0) ? "/" : "";
+			path += part;
+			if(rule.path[i].index >= 0) {
+				snprintf(part, sizeof(part), "[%i]", rule.path[i].index);
+				path += part;
+			}
+		}
+		m_paths.push_back(path);
+	}
+	struct {
+		bool operator()(const SAlarmTag & a, const SAlarmTag & b) const {
+			return a.tag < b.tag;
+		}
+	} byTag;
+	std::sort(m_values.begin(), m_values.end(), byTag);
+	std::sort(m_containers.begin(), m_containers.end(), byTag);
+
+	if(!m_statePath.empty()) {
+		loadStates(m_statePath.c_str());
+	}
+	m_bStop = false;
+	m_worker = std::thread(&RscpAlarms::worker, this);
+	return true;
+}
+
+void RscpAlarms::stop() {
+	if(m_worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_condition.notify_one();
+		m_worker.join();
+	}
+	if(!m_statePath.empty() && !m_rules.empty()) {
+		saveStates(m_statePath.c_str());
+	}
+	if((m_pLog != NULL) && (m_pLog != stdout)) {
+		fclose(m_pLog);
+	}
+	m_pLog = NULL;
+	m_rules.clear();
+	m_paths.clear();
+	m_states.clear();
+	m_values.clear();
+	m_containers.clear();
+	m_events.clear();
+}
+
+const RscpAlarms::SAlarmTag *RscpAlarms::findTag(const std::vector<SAlarmTag> & table, SRscpTag tag) const {
+	// the tables hold a few tags, a binary search keeps the lookup cheap for values without rules
+	size_t low = 0, high = table.size();
+	while(low < high) {
+		size_t middle = (low + high) / 2;
+		if(table[middle].tag < tag) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return ((low < table.size()) && (table[low].tag == tag)) ? &table[low] : NULL;
+}
+
+void RscpAlarms::handleValue(const SRscpValueRef & value, int64_t now) {
+	if(m_rules.empty()) {
+		return;
+	}
+	const SAlarmTag *entry = findTag(m_values, value.tag);
+	if(entry != NULL) {
+		evaluate(*entry, value, NULL, 0, now);
+	}
+	if((value.dataType == RSCP::eTypeContainer) && (findTag(m_containers, value.tag) != NULL)) {
+		SAlarmContext context[ALARM_PATH_DEPTH];
+		walk(value, context, 0, now);
+	}
+}
+
+void RscpAlarms::walk(const SRscpValueRef & value, SAlarmContext *context, int depth, int64_t now) {
+	// the checked value is the last element of a path, so containers fill one element less
+	if(depth >= ALARM_PATH_DEPTH - 1) {
+		return;
+	}
+	const SAlarmTag *container = findTag(m_containers, value.tag);
+	context[depth].tag = value.tag;
+	context[depth].index = -1;
+	SRscpValueRef child;
+	if(container->indexTag != 0) {
+		RscpWalker walker = RscpWalker::children(value);
+		while(walker.next(child)) {
+			double index;
+			if((child.tag == container->indexTag) && RscpWalker::asDouble(child, index)) {
+				context[depth].index = (int32_t) index;
+				break;
+			}
+		}
+	}
+	RscpWalker walker = RscpWalker::children(value);
+	while(walker.next(child)) {
+		const SAlarmTag *entry = findTag(m_values, child.tag);
+		if(entry != NULL) {
+			evaluate(*entry, child, context, depth + 1, now);
+		}
+		if((child.dataType == RSCP::eTypeContainer) && (findTag(m_containers, child.tag) != NULL)) {
+			walk(child, context, depth + 1, now);
+		}
+	}
+}
+
+bool RscpAlarms::matches(const SRscpAlarmRule & rule, const SAlarmContext *context, int depth) const {
+	// the containers of the rule are the innermost ones around the value
+	int containers = rule.depth - 1;
+	if(containers > depth) {
+		return false;
+	}
+	for(int i = 0; i < containers; i++) {
+		const SRscpAlarmPathPart & part = rule.path[containers - 1 - i];
+		const SAlarmContext & outer = context[depth - 1 - i];
+		if((part.tag != outer.tag) || ((part.index >= 0) && (part.index != outer.index))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void RscpAlarms::evaluate(const SAlarmTag & entry, const SRscpValueRef & value, const SAlarmContext *context,
+	int depth, int64_t now) {
+	double v;
+	if((value.dataType == RSCP::eTypeError) || !RscpWalker::asDouble(value, v)) {
+		return;
+	}
+	for(size_t i = 0; i < entry.rules.size(); i++) {
+		uint32_t r = entry.rules[i];
+		const SRscpAlarmRule & rule = m_rules[r];
+		if(!matches(rule, context, depth)) {
+			continue;
+		}
+		bool bCondition = false;
+		bool bClear = false;
+		switch(rule.op) {
+		case ALARM_GT:
+			bCondition = v > rule.threshold;
+			bClear = v <= rule.clear;
+			break;
+		case ALARM_GE:
+			bCondition = v >= rule.threshold;
+			bClear = v < rule.clear;
+			break;
+		case ALARM_LT:
+			bCondition = v < rule.threshold;
+			bClear = v >= rule.clear;
+			break;
+		case ALARM_LE:
+			bCondition = v <= rule.threshold;
+			bClear = v > rule.clear;
+			break;
+		case ALARM_EQ:
+			bCondition = v == rule.threshold;
+			bClear = !bCondition;
+			break;
+		case ALARM_NE:
+			bCondition = v != rule.threshold;
+			bClear = !bCondition;
+			break;
+		case ALARM_BITS:
+			bCondition = ((uint64_t) v & (uint64_t) rule.threshold) != 0;
+			bClear = !bCondition;
+			break;
+		}
+		SAlarmState & state = m_states[r];
+		if(!state.bActive && bCondition) {
+			state.bActive = true;
+			notify(r, true, v, now);
+		}
+		else if(state.bActive && bClear) {
+			state.bActive = false;
+			notify(r, false, v, now);
+		}
+	}
+}
+
+void RscpAlarms::notify(uint32_t rule, bool bRaised, double value, int64_t now) {
+	SAlarmState & state = m_states[rule];
+	SAlarmEvent event = { rule, bRaised, value, now, 0 };
+	if(bRaised) {
+		state.raised++;
+		if((state.lastRaise != 0) && (now - state.lastRaise < (int64_t) m_rules[rule].interval)) {
+			state.suppressed++;
+			state.bNotified = false;
+			return;
+		}
+		event.suppressed = state.suppressed;
+		state.suppressed = 0;
+		state.lastRaise = now;
+		state.bNotified = true;
+	}
+	else {
+		state.cleared++;
+		// the clear of a suppressed raise is suppressed as well
+		if(!state.bNotified) {
+			return;
+		}
+		state.bNotified = false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_events.size() >= ALARM_QUEUE_SIZE) {
+			m_uDropped++;
+			return;
+		}
+		m_events.push_back(event);
+	}
+	m_condition.notify_one();
+}
+
+void RscpAlarms::worker() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(true) {
+		m_condition.wait(lock, [this] { return m_bStop || !m_events.empty(); });
+		if(m_events.empty()) {
+			// stopped and all notifications delivered
+			return;
+		}
+		SAlarmEvent event = m_events.front();
+		m_events.pop_front();
+		lock.unlock();
+		deliver(event);
+		lock.lock();
+	}
+}
+
+void RscpAlarms::deliver(const SAlarmEvent & event) {
+	const SRscpAlarmRule & rule = m_rules[event.rule];
+	time_t t = event.time;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	char timeString[32];
+	strftime(timeString, sizeof(timeString), "%Y-%m-%dT%H:%M:%S", &tm);
+	char valueString[32];
+	snprintf(valueString, sizeof(valueString), "%.10g", event.value);
+	fprintf(m_pLog, "%s %s %s %s = %s (%s %.10g)", timeString, event.bRaised ? "raised" : "cleared", rule.name,
+		m_paths[event.rule].c_str(), valueString, operatorName(rule.op), rule.threshold);
+	if(event.suppressed > 0) {
+		fprintf(m_pLog, ", %u raises suppressed", event.suppressed);
+	}
+	fprintf(m_pLog, "\n");
+	fflush(m_pLog);
+	if(m_hook.empty()) {
+		return;
+	}
+	// the hook runs outside of the receive path, a slow hook only delays the following notifications
+	char epoch[24];
+	snprintf(epoch, sizeof(epoch), "%lld", (long long) event.time);
+	char *argv[] = { (char *) m_hook.c_str(), (char *) rule.name, (char *) (event.bRaised ? "raised" : "cleared"),
+		valueString, epoch, NULL };
+	pid_t pid;
+	int iResult = posix_spawn(&pid, m_hook.c_str(), NULL, NULL, argv, environ);
+	if(iResult != 0) {
+		fprintf(m_pLog, "%s cannot run alarm hook %s. errno %i\n", timeString, m_hook.c_str(), iResult);
+		fflush(m_pLog);
+		return;
+	}
+	int status;
+	while((waitpid(pid, &status, 0) < 0) && (errno == EINTR)) {
+	}
+}
+
+void RscpAlarms::loadStates(const char *path) {
+	FILE *file = fopen(path, "r");
+	if(file == NULL) {
+		return;
+	}
+	char name[ALARM_NAME_LENGTH];
+	int active, notified;
+	long long lastRaise;
+	unsigned suppressed;
+	while(fscanf(file, "%31s %i %i %lld %u", name, &active, &notified, &lastRaise, &suppressed) == 5) {
+		for(size_t i = 0; i < m_rules.size(); i++) {
+			if(strcmp(m_rules[i].name, name) == 0) {
+				m_states[i].bActive = active;
+				m_states[i].bNotified = notified;
+				m_states[i].lastRaise = lastRaise;
+				m_states[i].suppressed = suppressed;
+			}
+		}
+	}
+	fclose(file);
+}
+
+void RscpAlarms::saveStates(const char *path) const {
+	std::string temporary = std::string(path) + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "w");
+	if(file == NULL) {
+		printf("Cannot write alarm states %s. errno %i\n", temporary.c_str(), errno);
+		return;
+	}
+	for(size_t i = 0; i < m_rules.size(); i++) {
+		const SAlarmState & state = m_states[i];
+		fprintf(file, "%s %i %i %lld %u\n", m_rules[i].name, state.bActive, state.bNotified,
+			(long long) state.lastRaise, state.suppressed);
+	}
+	if((fclose(file) != 0) || (rename(temporary.c_str(), path) != 0)) {
+		printf("Cannot write alarm states %s. errno %i\n", path, errno);
+	}
+}
+
+void RscpAlarms::print(FILE *file) const {
+	fprintf(file, "%-24s %-8s %10s %10s %10s\n", "# alarm", "state", "raised", "cleared", "suppressed");
+	for(size_t i = 0; i < m_rules.size(); i++) {
+		const SAlarmState & state = m_states[i];
+		fprintf(file, "%-24s %-8s %10llu %10llu %10u\n", m_rules[i].name, state.bActive ? "active" : "clear",
+			(unsigned long long) state.raised, (unsigned long long) state.cleared, state.suppressed);
+	}
+	if(m_uDropped > 0) {
+		fprintf(file, "%llu notifications dropped\n", (unsigned long long) m_uDropped);
+	}
+}
@@ -0,0 +1,150 @@
+/*
+ * RscpAlarms.h
+ *
+ * Threshold alarms evaluated on the received values. The rules of the configuration are compiled
+ * into a table sorted by the tag of the checked value, so a received value costs one lookup and the
+ * evaluation of the rules on its own tag only. Containers are walked only if a rule checks one of
+ * their values. A rule raises when its condition becomes true and clears with a hysteresis, the
+ * raise notifications of a rule are rate limited. Notifications are written to the alarm log and
+ * passed to the alarm hook by a worker thread, so a slow disk or hook never stalls the receive path.
+ */
+
+#ifndef RSCPALARMS_H_
+#define RSCPALARMS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "RscpWalker.h"
+
+#define ALARM_NAME_LENGTH			32
+#define ALARM_PATH_DEPTH			4
+// minimum seconds between two raise notifications of a rule without "every"
+#define ALARM_DEFAULT_INTERVAL		60
+// notifications waiting for the worker thread, more are dropped
+#define ALARM_QUEUE_SIZE			64
+
+enum eRscpAlarmOperators {
+	ALARM_GT		= 0,	// >
+	ALARM_GE,				// >=
+	ALARM_LT,				// <
+	ALARM_LE,				// <=
+	ALARM_EQ,				// ==
+	ALARM_NE,				// !=
+	ALARM_BITS				// &, any bit of the mask is set
+};
+
+struct SRscpAlarmPathPart {
+	SRscpTag tag;			// response tag
+	int16_t index;			// -1 matches any index
+};
+
+struct SRscpAlarmRule {
+	char name[ALARM_NAME_LENGTH];
+	SRscpAlarmPathPart path[ALARM_PATH_DEPTH];	// containers from the outside in, the checked value last
+	uint8_t depth;
+	uint8_t op;				// eRscpAlarmOperators
+	double threshold;
+	double clear;			// the alarm clears below (ALARM_GT, ALARM_GE) or above (ALARM_LT, ALARM_LE) this value
+	uint32_t interval;		// minimum seconds between two raise notifications
+};
+
+class RscpAlarms {
+public:
+	RscpAlarms();
+	virtual ~RscpAlarms();
+	/*
+	 * \brief Parse the value of an alarm configuration line:
+	 *        name path op threshold [clear value] [every seconds]
+	 *        The path names the checked value by its response tags like TAG_BAT_DATA[0]/TAG_BAT_ERROR_CODE,
+	 *        op is one of > >= < <= == != &.
+	 * @return - false if the rule is invalid, the reason is printed after \var where
+	 */
+	static bool parseRule(const char *value, SRscpAlarmRule & rule, const char *where);
+	/*
+	 * \brief Compile \var rules, load the states of \var statePath and start the worker thread which
+	 *        appends to \var logPath (NULL or "-" for stdout) and runs \var hook (NULL for none) with the
+	 *        arguments name, raised or cleared, value and time.
+	 * @return - false if the log cannot be opened
+	 */
+	bool start(const std::vector<SRscpAlarmRule> & rules, const char *logPath, const char *hook, const char *statePath);
+	/*
+	 * \brief Deliver the queued notifications, stop the worker thread and save the states.
+	 */
+	void stop();
+	bool enabled() const {
+		return !m_rules.empty();
+	}
+	/*
+	 * \brief Evaluate the rules on \var value and the values inside if it is a container of a rule path.
+	 * @param now - CLOCK_REALTIME in seconds
+	 */
+	void handleValue(const SRscpValueRef & value, int64_t now);
+	/*
+	 * \brief Print the state and the notification counters of every rule.
+	 */
+	void print(FILE *file) const;
+	static const char *operatorName(uint8_t op);
+private:
+	RscpAlarms(const RscpAlarms &);
+	RscpAlarms & operator=(const RscpAlarms &);
+
+	struct SAlarmState {
+		bool bActive;
+		bool bNotified;			// the raise of the active alarm was notified
+		int64_t lastRaise;		// time of the last raise notification
+		uint32_t suppressed;	// raises within the interval since the last notification
+		uint64_t raised;
+		uint64_t cleared;
+	};
+	struct SAlarmTag {
+		SRscpTag tag;
+		SRscpTag indexTag;		// index tag of a container, 0 for checked values
+		std::vector<uint32_t> rules;
+	};
+	struct SAlarmContext {
+		SRscpTag tag;
+		int32_t index;			// -1 if the container has no index
+	};
+	struct SAlarmEvent {
+		uint32_t rule;
+		bool bRaised;
+		double value;
+		int64_t time;
+		uint32_t suppressed;
+	};
+
+	const SAlarmTag *findTag(const std::vector<SAlarmTag> & table, SRscpTag tag) const;
+	void walk(const SRscpValueRef & value, SAlarmContext *context, int depth, int64_t now);
+	void evaluate(const SAlarmTag & entry, const SRscpValueRef & value, const SAlarmContext *context, int depth,
+		int64_t now);
+	bool matches(const SRscpAlarmRule & rule, const SAlarmContext *context, int depth) const;
+	void notify(uint32_t rule, bool bRaised, double value, int64_t now);
+	void worker();
+	void deliver(const SAlarmEvent & event);
+	void loadStates(const char *path);
+	void saveStates(const char *path) const;
+
+	std::vector<SRscpAlarmRule> m_rules;
+	std::vector<std::string> m_paths;		// path of each rule with tag names for the notifications
+	std::vector<SAlarmState> m_states;
+	std::vector<SAlarmTag> m_values;		// sorted by tag
+	std::vector<SAlarmTag> m_containers;	// sorted by tag
+	std::string m_hook;
+	std::string m_statePath;
+	FILE *m_pLog;
+	uint64_t m_uDropped;
+	// shared with the worker thread
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<SAlarmEvent> m_events;
+	bool m_bStop;
+	std::thread m_worker;
+};
+
+#endif /* RSCPALARMS_H_ */
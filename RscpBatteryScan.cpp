@@ -0,0 +1,269 @@
+/*
+ * RscpBatteryScan.cpp
+ *
+ * Discovery of the batteries and their DCBs and the cell level scan of all of them.
+ */
+
+#include <string.h>
+#include "RscpBatteryScan.h"
+#include "RscpTags.h"
+
+RscpBatteryScan::RscpBatteryScan() :
+	m_bEnabled(false), m_bDiscovered(false), m_uBatteries(0) {
+	for(uint32_t i = 0; i < BAT_SCAN_MAX_BATTERIES; i++) {
+		m_iProbedDcbs[i] = -1;
+	}
+	memset(m_ucBatteryIndex, 0, sizeof(m_ucBatteryIndex));
+	memset(m_uDcbCount, 0, sizeof(m_uDcbCount));
+	memset(m_uFirstSlot, 0, sizeof(m_uFirstSlot));
+	memset(m_fRsoc, 0, sizeof(m_fRsoc));
+	memset(m_fModuleVoltage, 0, sizeof(m_fModuleVoltage));
+	memset(m_fCurrent, 0, sizeof(m_fCurrent));
+}
+
+int32_t RscpBatteryScan::createDiscovery(RscpBuilder & builder) {
+	for(uint32_t i = 0; i < BAT_SCAN_MAX_BATTERIES; i++) {
+		m_iProbedDcbs[i] = -1;
+		builder.open(TAG_BAT_REQ_DATA);
+		builder.add(TAG_BAT_INDEX, (uint8_t) i);
+		builder.add(TAG_BAT_REQ_DCB_COUNT);
+		int32_t iResult = builder.close();
+		if(iResult < 0) {
+			return iResult;
+		}
+	}
+	return RSCP::OK;
+}
+
+void RscpBatteryScan::finishDiscovery() {
+	m_uBatteries = 0;
+	uint32_t uSlots = 0;
+	for(uint32_t i = 0; i < BAT_SCAN_MAX_BATTERIES; i++) {
+		if(m_iProbedDcbs[i] <= 0) {
+			continue;
+		}
+		m_ucBatteryIndex[m_uBatteries] = i;
+		m_uDcbCount[m_uBatteries] = m_iProbedDcbs[i];
+		m_uFirstSlot[m_uBatteries] = uSlots;
+		uSlots += m_iProbedDcbs[i];
+		m_uBatteries++;
+	}
+	// the only allocation of the scan, the responses are decoded into these arrays
+	m_fVoltages.assign(uSlots * BAT_SCAN_MAX_DCB_CELLS, 0.0f);
+	m_fTemperatures.assign(uSlots * BAT_SCAN_MAX_DCB_CELLS, 0.0f);
+	m_ucVoltageCount.assign(uSlots, 0);
+	m_ucTemperatureCount.assign(uSlots, 0);
+	m_bDiscovered = true;
+}
+
+int32_t RscpBatteryScan::createScan(RscpBuilder & builder) {
+	// values of DCBs missing in the next responses are not reported as current
+	memset(m_ucVoltageCount.data(), 0, m_ucVoltageCount.size());
+	memset(m_ucTemperatureCount.data(), 0, m_ucTemperatureCount.size());
+	for(uint32_t battery = 0; battery < m_uBatteries; battery++) {
+		builder.open(TAG_BAT_REQ_DATA);
+		builder.add(TAG_BAT_INDEX, m_ucBatteryIndex[battery]);
+		builder.add(TAG_BAT_REQ_RSOC);
+		builder.add(TAG_BAT_REQ_MODULE_VOLTAGE);
+		builder.add(TAG_BAT_REQ_CURRENT);
+		for(uint32_t dcb = 0; dcb < m_uDcbCount[battery]; dcb++) {
+			builder.add(TAG_BAT_REQ_DCB_ALL_CELL_VOLTAGES, (uint16_t) dcb);
+			builder.add(TAG_BAT_REQ_DCB_ALL_CELL_TEMPERATURES, (uint16_t) dcb);
+		}
+		int32_t iResult = builder.close();
+		if(iResult < 0) {
+			return iResult;
+		}
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpBatteryScan::findBattery(uint8_t index) const {
+	for(uint32_t i = 0; i < m_uBatteries; i++) {
+		if(m_ucBatteryIndex[i] == index) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * \brief Append a cell value of the type \var cellTag, values beyond BAT_SCAN_MAX_DCB_CELLS are dropped.
+ */
+static inline void storeCell(const SRscpValueRef & cell, SRscpTag cellTag, float *values, uint32_t & count) {
+	double value;
+	if((cell.tag == cellTag) && (count < BAT_SCAN_MAX_DCB_CELLS) && RscpWalker::asDouble(cell, value)) {
+		values[count++] = (float) value;
+	}
+}
+
+int32_t RscpBatteryScan::handleCells(uint32_t battery, const SRscpValueRef & cells, bool bVoltages) {
+	SRscpTag cellTag = bVoltages ? TAG_BAT_DCB_CELL_VOLTAGE : TAG_BAT_DCB_CELL_TEMPERATURE;
+	int32_t iSlot = -1;
+	uint32_t uCount = 0;
+	float *values = NULL;
+
+	RscpWalker walker = RscpWalker::children(cells);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		if(value.tag == TAG_BAT_DCB_INDEX) {
+			double dcb;
+			if(!RscpWalker::asDouble(value, dcb) || (dcb < 0) || (dcb >= m_uDcbCount[battery])) {
+				return RSCP::ERR_INVALID_INPUT;
+			}
+			iSlot = slot(battery, (uint32_t) dcb);
+			values = bVoltages ? &m_fVoltages[iSlot * BAT_SCAN_MAX_DCB_CELLS] : &m_fTemperatures[iSlot * BAT_SCAN_MAX_DCB_CELLS];
+			continue;
+		}
+		if(values == NULL) {
+			// the cell values need the DCB index first
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		// the cell values are either packed into a TAG_BAT_DATA container or direct children
+		if(value.dataType != RSCP::eTypeContainer) {
+			storeCell(value, cellTag, values, uCount);
+			continue;
+		}
+		RscpWalker cellWalker = RscpWalker::children(value);
+		SRscpValueRef cell;
+		while(cellWalker.next(cell)) {
+			storeCell(cell, cellTag, values, uCount);
+		}
+		if(cellWalker.error()) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+	}
+	if(walker.error() || (iSlot < 0)) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	if(bVoltages) {
+		m_ucVoltageCount[iSlot] = uCount;
+	}
+	else {
+		m_ucTemperatureCount[iSlot] = uCount;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpBatteryScan::handleBatteryData(const SRscpValueRef & batteryData) {
+	// the index is the first value of the container, responses without index are battery 0
+	uint8_t ucIndex = 0;
+	int32_t iResult = RSCP::OK;
+
+	RscpWalker walker = RscpWalker::children(batteryData);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		double fValue;
+		if(value.tag == TAG_BAT_INDEX) {
+			if(!RscpWalker::asDouble(value, fValue) || (fValue < 0) || (fValue > UINT8_MAX)) {
+				return RSCP::ERR_INVALID_INPUT;
+			}
+			ucIndex = (uint8_t) fValue;
+			continue;
+		}
+		// errors mark missing batteries and unsupported values
+		if(value.dataType == RSCP::eTypeError) {
+			continue;
+		}
+		if(!m_bDiscovered) {
+			if((value.tag == TAG_BAT_DCB_COUNT) && (ucIndex < BAT_SCAN_MAX_BATTERIES) && RscpWalker::asDouble(value, fValue)) {
+				m_iProbedDcbs[ucIndex] = (fValue > BAT_SCAN_MAX_DCBS) ? BAT_SCAN_MAX_DCBS : (fValue < 0) ? 0 : (int32_t) fValue;
+			}
+			continue;
+		}
+		int32_t iBattery = findBattery(ucIndex);
+		if(iBattery < 0) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		switch(value.tag) {
+		case TAG_BAT_RSOC:
+			if(RscpWalker::asDouble(value, fValue)) {
+				m_fRsoc[iBattery] = fValue;
+			}
+			break;
+		case TAG_BAT_MODULE_VOLTAGE:
+			if(RscpWalker::asDouble(value, fValue)) {
+				m_fModuleVoltage[iBattery] = fValue;
+			}
+			break;
+		case TAG_BAT_CURRENT:
+			if(RscpWalker::asDouble(value, fValue)) {
+				m_fCurrent[iBattery] = fValue;
+			}
+			break;
+		case TAG_BAT_DCB_ALL_CELL_VOLTAGES:
+		case TAG_BAT_DCB_ALL_CELL_TEMPERATURES: {
+			int32_t iCells = handleCells(iBattery, value, value.tag == TAG_BAT_DCB_ALL_CELL_VOLTAGES);
+			if(iCells < 0) {
+				iResult = iCells;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return walker.error() ? RSCP::ERR_INVALID_INPUT : iResult;
+}
+
+bool RscpBatteryScan::isScanData(const SRscpValueRef & batteryData) {
+	RscpWalker walker = RscpWalker::children(batteryData);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		if((value.tag == TAG_BAT_DCB_ALL_CELL_VOLTAGES) || (value.tag == TAG_BAT_DCB_ALL_CELL_TEMPERATURES)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * \brief Minimum, maximum and average of \var count values.
+ */
+static void range(const float *values, uint32_t count, float & min, float & max, float & avg) {
+	min = values[0];
+	max = values[0];
+	float sum = 0.0f;
+	for(uint32_t i = 0; i < count; i++) {
+		min = (values[i] < min) ? values[i] : min;
+		max = (values[i] > max) ? values[i] : max;
+		sum += values[i];
+	}
+	avg = sum / count;
+}
+
+void RscpBatteryScan::print(FILE *file) const {
+	float packMin = 0.0f, packMax = 0.0f;
+	bool bPack = false;
+	for(uint32_t battery = 0; battery < m_uBatteries; battery++) {
+		fprintf(file, "Battery %u: %u DCBs, SOC %0.1f %%, %0.1f V, %0.1f A\n", m_ucBatteryIndex[battery],
+			m_uDcbCount[battery], m_fRsoc[battery], m_fModuleVoltage[battery], m_fCurrent[battery]);
+		for(uint32_t dcb = 0; dcb < m_uDcbCount[battery]; dcb++) {
+			float min, max, avg;
+			fprintf(file, "  DCB %2u:", dcb);
+			uint32_t uVoltages = voltageCount(battery, dcb);
+			if(uVoltages > 0) {
+				range(voltages(battery, dcb), uVoltages, min, max, avg);
+				fprintf(file, " %2u cells %0.3f..%0.3f V (avg %0.3f)", uVoltages, min, max, avg);
+				packMin = (!bPack || (min < packMin)) ? min : packMin;
+				packMax = (!bPack || (max > packMax)) ? max : packMax;
+				bPack = true;
+			}
+			else {
+				fprintf(file, " no cell voltages");
+			}
+			uint32_t uTemperatures = temperatureCount(battery, dcb);
+			if(uTemperatures > 0) {
+				range(temperatures(battery, dcb), uTemperatures, min, max, avg);
+				fprintf(file, ", %2u sensors %0.1f..%0.1f C", uTemperatures, min, max);
+			}
+			fprintf(file, "\n");
+		}
+	}
+	if(m_uBatteries == 0) {
+		fprintf(file, "No battery found\n");
+	}
+	else if(bPack) {
+		fprintf(file, "Cell voltage spread of all batteries %0.1f mV\n", (packMax - packMin) * 1000.0f);
+	}
+}
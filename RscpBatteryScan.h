@@ -0,0 +1,131 @@
+/*
+ * RscpBatteryScan.h
+ *
+ * Discovery of the batteries and their DCBs (battery modules) and polling of all cell voltages and
+ * temperatures in one frame. The cell values are decoded straight from the response data into
+ * dense arrays, the arrays are only allocated by the discovery.
+ */
+
+#ifndef RSCPBATTERYSCAN_H_
+#define RSCPBATTERYSCAN_H_
+
+#include <stdio.h>
+#include <vector>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+#include "RscpWalker.h"
+
+// battery indexes probed by the discovery
+#define BAT_SCAN_MAX_BATTERIES		8
+// DCBs per battery
+#define BAT_SCAN_MAX_DCBS			16
+// cell values per DCB, the stride of the cell arrays
+#define BAT_SCAN_MAX_DCB_CELLS		64
+
+class RscpBatteryScan {
+public:
+	RscpBatteryScan();
+	/*
+	 * \brief Enable the scan, the requests and responses of the battery data are handled by the scan.
+	 */
+	void enable() {
+		m_bEnabled = true;
+	}
+	bool enabled() const {
+		return m_bEnabled;
+	}
+	/*
+	 * \brief True after a discovery response was handled, the next requests are scans.
+	 */
+	bool discovered() const {
+		return m_bDiscovered;
+	}
+	/*
+	 * \brief Append the discovery requests, the DCB count of each probed battery index.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createDiscovery(RscpBuilder & builder);
+	/*
+	 * \brief Append the scan requests, state and all cell voltages and temperatures of all batteries.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createScan(RscpBuilder & builder);
+	/*
+	 * \brief Handle a TAG_BAT_DATA response of either request.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT for malformed or unexpected data
+	 */
+	int32_t handleBatteryData(const SRscpValueRef & batteryData);
+	/*
+	 * \brief True if \var batteryData answers a scan request, i.e. carries cell voltages or temperatures.
+	 *        Other TAG_BAT_DATA responses of a scan frame belong to the battery requests of --battery.
+	 */
+	static bool isScanData(const SRscpValueRef & batteryData);
+	/*
+	 * \brief Complete the discovery after all responses of the discovery frame were handled
+	 *        and allocate the cell arrays.
+	 */
+	void finishDiscovery();
+	/*
+	 * \brief Print the discovered layout and the range of the cell values of each DCB.
+	 */
+	void print(FILE *file) const;
+
+	uint32_t batteryCount() const {
+		return m_uBatteries;
+	}
+	uint8_t batteryIndex(uint32_t battery) const {
+		return m_ucBatteryIndex[battery];
+	}
+	uint32_t dcbCount(uint32_t battery) const {
+		return m_uDcbCount[battery];
+	}
+	/*
+	 * \brief Cell values of a DCB, valid up to voltageCount() / temperatureCount().
+	 */
+	const float *voltages(uint32_t battery, uint32_t dcb) const {
+		return &m_fVoltages[slot(battery, dcb) * BAT_SCAN_MAX_DCB_CELLS];
+	}
+	const float *temperatures(uint32_t battery, uint32_t dcb) const {
+		return &m_fTemperatures[slot(battery, dcb) * BAT_SCAN_MAX_DCB_CELLS];
+	}
+	uint32_t voltageCount(uint32_t battery, uint32_t dcb) const {
+		return m_ucVoltageCount[slot(battery, dcb)];
+	}
+	uint32_t temperatureCount(uint32_t battery, uint32_t dcb) const {
+		return m_ucTemperatureCount[slot(battery, dcb)];
+	}
+	float rsoc(uint32_t battery) const {
+		return m_fRsoc[battery];
+	}
+	float moduleVoltage(uint32_t battery) const {
+		return m_fModuleVoltage[battery];
+	}
+	float current(uint32_t battery) const {
+		return m_fCurrent[battery];
+	}
+private:
+	uint32_t slot(uint32_t battery, uint32_t dcb) const {
+		return m_uFirstSlot[battery] + dcb;
+	}
+	int32_t findBattery(uint8_t index) const;
+	int32_t handleCells(uint32_t battery, const SRscpValueRef & cells, bool bVoltages);
+
+	bool m_bEnabled;
+	bool m_bDiscovered;
+	// DCB count of each probed index, -1 if the battery does not exist
+	int32_t m_iProbedDcbs[BAT_SCAN_MAX_BATTERIES];
+	uint32_t m_uBatteries;
+	uint8_t m_ucBatteryIndex[BAT_SCAN_MAX_BATTERIES];
+	uint32_t m_uDcbCount[BAT_SCAN_MAX_BATTERIES];
+	uint32_t m_uFirstSlot[BAT_SCAN_MAX_BATTERIES];
+	float m_fRsoc[BAT_SCAN_MAX_BATTERIES];
+	float m_fModuleVoltage[BAT_SCAN_MAX_BATTERIES];
+	float m_fCurrent[BAT_SCAN_MAX_BATTERIES];
+	// one slot of BAT_SCAN_MAX_DCB_CELLS values per DCB of all batteries
+	std::vector<float> m_fVoltages;
+	std::vector<float> m_fTemperatures;
+	std::vector<uint8_t> m_ucVoltageCount;
+	std::vector<uint8_t> m_ucTemperatureCount;
+};
+
+#endif /* RSCPBATTERYSCAN_H_ */
@@ -0,0 +1,970 @@
+/*
+ * RscpBench.cpp
+ *
+ * Micro-benchmarks of the codec hot paths in the style of Google Benchmark. Each benchmark is
+ * calibrated until one run takes at least the minimum time, the run is repeated and the median
+ * is reported as ns/op, MB/s, heap allocations and L1 data cache misses per operation. The cache
+ * misses are counted with perf_event_open and shown as - where the kernel does not allow it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include "RscpProtocol.h"
+#include "RscpTags.h"
+#include "RscpSession.h"
+#include "AES.h"
+#include "RscpBatteryScan.h"
+#include "RscpPowerMeter.h"
+#include "RscpValue.h"
+#include "RscpTape.h"
+#include "RscpBuilder.h"
+
+#define BENCH_MAX_ITERATIONS    ((uint64_t) 1000000000)
+
+// processReceiveBuffer of RscpMain.cpp, linked without its main function
+int32_t processReceiveBuffer(RscpSession * session, const uint8_t * ucBuffer, uint32_t iLength, void *context);
+
+//---------------------------------------------------------------------------------------------------------
+// heap allocation counter, the glibc allocator is wrapped and every operator new ends up here as well
+//---------------------------------------------------------------------------------------------------------
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+static uint64_t allocations = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+//---------------------------------------------------------------------------------------------------------
+// L1 data cache read misses of this thread, -1 if the counter is not available
+//---------------------------------------------------------------------------------------------------------
+static int cacheMissFd = -1;
+
+static void openCacheMissCounter()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cacheMissFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cacheMissFd >= 0)
+	ioctl(cacheMissFd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static uint64_t cacheMisses()
+{
+    uint64_t value = 0;
+    if (cacheMissFd < 0 || read(cacheMissFd, &value, sizeof(value)) != sizeof(value))
+	return 0;
+    return value;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// harness
+//---------------------------------------------------------------------------------------------------------
+static uint64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// keeps the compiler from removing the benchmarked code
+template<class T> static inline void doNotOptimize(const T & value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchState {
+public:
+    BenchState(uint64_t iterations) :
+	bytes(0), m_uIterations(iterations), m_uRemaining(iterations), m_uStart(0), m_uStop(0),
+	m_uAllocations(0), m_uCacheMisses(0), m_bStarted(false) {
+    }
+    /*
+     * \brief Loop condition of a benchmark, the setup before the first call is not measured.
+     */
+    bool keepRunning() {
+	if (!m_bStarted) {
+	    m_bStarted = true;
+	    m_uAllocations = allocations;
+	    m_uCacheMisses = cacheMisses();
+	    m_uStart = monotonicNs();
+	}
+	if (m_uRemaining > 0) {
+	    m_uRemaining--;
+	    return true;
+	}
+	m_uStop = monotonicNs();
+	m_uCacheMisses = cacheMisses() - m_uCacheMisses;
+	m_uAllocations = allocations - m_uAllocations;
+	return false;
+    }
+    uint64_t iterations() const {
+	return m_uIterations;
+    }
+    uint64_t elapsedNs() const {
+	return m_uStop - m_uStart;
+    }
+    uint64_t allocationCount() const {
+	return m_uAllocations;
+    }
+    uint64_t cacheMissCount() const {
+	return m_uCacheMisses;
+    }
+    // bytes processed per iteration, 0 if throughput does not apply
+    uint64_t bytes;
+private:
+    uint64_t m_uIterations;
+    uint64_t m_uRemaining;
+    uint64_t m_uStart;
+    uint64_t m_uStop;
+    uint64_t m_uAllocations;
+    uint64_t m_uCacheMisses;
+    bool m_bStarted;
+};
+
+typedef void (*BenchFunction)(BenchState & state);
+
+typedef struct {
+    const char *name;
+    BenchFunction function;
+} bench_t;
+
+typedef struct {
+    double min_time;
+    int repetitions;
+    int cpu;
+    const char *filter;
+} bench_config_t;
+
+static bench_config_t bench_config;
+
+//---------------------------------------------------------------------------------------------------------
+// test data, all of it is deterministic so runs on different builds are comparable
+//---------------------------------------------------------------------------------------------------------
+static void fillPattern(uint8_t *data, size_t length)
+{
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < length; i++) {
+	x = x * 1103515245 + 12345;
+	data[i] = x >> 24;
+    }
+}
+
+static void createEmsResponse(RscpProtocol & protocol, SRscpValue & root)
+{
+    protocol.createContainerValue(&root, 0);
+    protocol.appendValue(&root, TAG_EMS_POWER_PV, (int32_t) 4210);
+    protocol.appendValue(&root, TAG_EMS_POWER_BAT, (int32_t) -1250);
+    protocol.appendValue(&root, TAG_EMS_POWER_HOME, (int32_t) 870);
+    protocol.appendValue(&root, TAG_EMS_POWER_GRID, (int32_t) -2090);
+    protocol.appendValue(&root, TAG_EMS_POWER_ADD, (int32_t) 0);
+    SRscpValue settings;
+    protocol.createContainerValue(&settings, TAG_EMS_GET_POWER_SETTINGS);
+    protocol.appendValue(&settings, TAG_EMS_POWER_LIMITS_USED, true);
+    protocol.appendValue(&settings, TAG_EMS_MAX_CHARGE_POWER, (uint32_t) 3000);
+    protocol.appendValue(&settings, TAG_EMS_MAX_DISCHARGE_POWER, (uint32_t) 3000);
+    protocol.appendValue(&settings, TAG_EMS_DISCHARGE_START_POWER, (uint32_t) 65);
+    protocol.appendValue(&settings, TAG_EMS_POWERSAVE_ENABLED, true);
+    protocol.appendValue(&settings, TAG_EMS_WEATHER_REGULATED_CHARGE_ENABLED, false);
+    protocol.appendValue(&root, settings);
+    protocol.destroyValueData(settings);
+}
+
+static void createBatResponse(RscpProtocol & protocol, SRscpValue & root)
+{
+    protocol.createContainerValue(&root, 0);
+    SRscpValue batteryData;
+    protocol.createContainerValue(&batteryData, TAG_BAT_DATA);
+    protocol.appendValue(&batteryData, TAG_BAT_INDEX, (uint8_t) 0);
+    protocol.appendValue(&batteryData, TAG_BAT_RSOC, 63.5f);
+    protocol.appendValue(&batteryData, TAG_BAT_MODULE_VOLTAGE, 51.2f);
+    protocol.appendValue(&batteryData, TAG_BAT_CURRENT, -24.4f);
+    protocol.appendValue(&batteryData, TAG_BAT_STATUS_CODE, (uint32_t) 0);
+    protocol.appendValue(&batteryData, TAG_BAT_ERROR_CODE, (uint32_t) 0);
+    protocol.appendValue(&root, batteryData);
+    protocol.destroyValueData(batteryData);
+}
+
+static void createDbResponse(RscpProtocol & protocol, SRscpValue & root)
+{
+    // one day of history in 15 minute intervals
+    protocol.createContainerValue(&root, 0);
+    SRscpValue history;
+    protocol.createContainerValue(&history, TAG_DB_HISTORY_DATA_DAY);
+    for (int i = 0; i < 96; i++) {
+	SRscpValue values;
+	protocol.createContainerValue(&values, TAG_DB_VALUE_CONTAINER);
+	protocol.appendValue(&values, TAG_DB_GRAPH_INDEX, (float) i);
+	protocol.appendValue(&values, TAG_DB_BAT_POWER_IN, 100.0f + i);
+	protocol.appendValue(&values, TAG_DB_BAT_POWER_OUT, 50.0f + i);
+	protocol.appendValue(&values, TAG_DB_DC_POWER, 1000.0f + i);
+	protocol.appendValue(&values, TAG_DB_GRID_POWER_IN, 20.0f + i);
+	protocol.appendValue(&values, TAG_DB_GRID_POWER_OUT, 800.0f + i);
+	protocol.appendValue(&values, TAG_DB_CONSUMPTION, 400.0f + i);
+	protocol.appendValue(&values, TAG_DB_BAT_CHARGE_LEVEL, 0.5f);
+	protocol.appendValue(&values, TAG_DB_AUTARKY, 90.0f);
+	protocol.appendValue(&history, values);
+	protocol.destroyValueData(values);
+    }
+    protocol.appendValue(&root, history);
+    protocol.destroyValueData(history);
+}
+
+/*
+ * \brief Discovery response of \var batteries batteries with \var dcbs DCBs each.
+ */
+static void createBatDiscoveryResponse(RscpProtocol & protocol, SRscpValue & root, int batteries, int dcbs)
+{
+    protocol.createContainerValue(&root, 0);
+    for (int battery = 0; battery < batteries; battery++) {
+	SRscpValue batteryData;
+	protocol.createContainerValue(&batteryData, TAG_BAT_DATA);
+	protocol.appendValue(&batteryData, TAG_BAT_INDEX, (uint8_t) battery);
+	protocol.appendValue(&batteryData, TAG_BAT_DCB_COUNT, (uint8_t) dcbs);
+	protocol.appendValue(&root, batteryData);
+	protocol.destroyValueData(batteryData);
+    }
+}
+
+/*
+ * \brief Cell scan response of \var batteries batteries with \var dcbs DCBs of 16 cells and 8 sensors each.
+ */
+static void createBatCellResponse(RscpProtocol & protocol, SRscpValue & root, int batteries, int dcbs)
+{
+    protocol.createContainerValue(&root, 0);
+    for (int battery = 0; battery < batteries; battery++) {
+	SRscpValue batteryData;
+	protocol.createContainerValue(&batteryData, TAG_BAT_DATA);
+	protocol.appendValue(&batteryData, TAG_BAT_INDEX, (uint8_t) battery);
+	protocol.appendValue(&batteryData, TAG_BAT_RSOC, 63.5f);
+	protocol.appendValue(&batteryData, TAG_BAT_MODULE_VOLTAGE, 51.2f);
+	protocol.appendValue(&batteryData, TAG_BAT_CURRENT, -24.4f);
+	for (int dcb = 0; dcb < dcbs; dcb++) {
+	    for (int kind = 0; kind < 2; kind++) {
+		SRscpValue cells, cellData;
+		protocol.createContainerValue(&cells, kind ? TAG_BAT_DCB_ALL_CELL_TEMPERATURES : TAG_BAT_DCB_ALL_CELL_VOLTAGES);
+		protocol.appendValue(&cells, TAG_BAT_DCB_INDEX, (uint16_t) dcb);
+		protocol.createContainerValue(&cellData, TAG_BAT_DATA);
+		for (int i = 0; i < (kind ? 8 : 16); i++) {
+		    if (kind)
+			protocol.appendValue(&cellData, TAG_BAT_DCB_CELL_TEMPERATURE, 25.0f + i * 0.1f);
+		    else
+			protocol.appendValue(&cellData, TAG_BAT_DCB_CELL_VOLTAGE, 3.3f + i * 0.001f);
+		}
+		protocol.appendValue(&cells, cellData);
+		protocol.destroyValueData(cellData);
+		protocol.appendValue(&batteryData, cells);
+		protocol.destroyValueData(cells);
+	    }
+	}
+	protocol.appendValue(&root, batteryData);
+	protocol.destroyValueData(batteryData);
+    }
+}
+
+/*
+ * \brief Containers nested \var depth levels deep, each level holds \var leaves values and the next level.
+ */
+static void createNestedContainer(RscpProtocol & protocol, SRscpValue & value, int depth, int leaves)
+{
+    protocol.createContainerValue(&value, TAG_BAT_DATA);
+    for (int i = 0; i < leaves; i++)
+	protocol.appendValue(&value, TAG_BAT_RSOC, (float) i);
+    if (depth > 1) {
+	SRscpValue child;
+	createNestedContainer(protocol, child, depth - 1, leaves);
+	protocol.appendValue(&value, child);
+	protocol.destroyValueData(child);
+    }
+}
+
+static void createFrame(void (*create)(RscpProtocol &, SRscpValue &), std::vector<uint8_t> & frame)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    create(protocol, root);
+    SRscpFrameBuffer frameBuffer;
+    protocol.createFrameAsBuffer(&frameBuffer, root.data, root.length, true);
+    frame.assign(frameBuffer.data, frameBuffer.data + frameBuffer.dataLength);
+    protocol.destroyFrameData(frameBuffer);
+    protocol.destroyValueData(root);
+}
+
+//---------------------------------------------------------------------------------------------------------
+// AES
+//---------------------------------------------------------------------------------------------------------
+static void benchAes(BenchState & state, size_t length, bool bEncrypt, AES::TableMode mode)
+{
+    uint8_t key[AES_KEY_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
+    std::vector<uint8_t> data(length);
+    fillPattern(key, sizeof(key));
+    memset(iv, 0xff, sizeof(iv));
+    fillPattern(&data[0], length);
+    AES aes;
+    aes.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+    aes.SetTableMode(mode);
+    if (bEncrypt)
+	aes.StartEncryption(key);
+    else
+	aes.StartDecryption(key);
+    state.bytes = length;
+    while (state.keepRunning()) {
+	aes.SetIV(iv, AES_BLOCK_SIZE);
+	if (bEncrypt)
+	    aes.Encrypt(&data[0], &data[0], length / AES_BLOCK_SIZE);
+	else
+	    aes.Decrypt(&data[0], &data[0], length / AES_BLOCK_SIZE);
+	doNotOptimize(data[0]);
+    }
+}
+
+static void BM_AesEncrypt64(BenchState & state) { benchAes(state, 64, true, AES::TABLES_FULL); }
+static void BM_AesEncrypt1k(BenchState & state) { benchAes(state, 1024, true, AES::TABLES_FULL); }
+static void BM_AesEncrypt64k(BenchState & state) { benchAes(state, 65536, true, AES::TABLES_FULL); }
+static void BM_AesDecrypt64(BenchState & state) { benchAes(state, 64, false, AES::TABLES_FULL); }
+static void BM_AesDecrypt1k(BenchState & state) { benchAes(state, 1024, false, AES::TABLES_FULL); }
+static void BM_AesDecrypt64k(BenchState & state) { benchAes(state, 65536, false, AES::TABLES_FULL); }
+static void BM_AesEncrypt1kCompact(BenchState & state) { benchAes(state, 1024, true, AES::TABLES_COMPACT); }
+static void BM_AesDecrypt1kCompact(BenchState & state) { benchAes(state, 1024, false, AES::TABLES_COMPACT); }
+static void BM_AesEncrypt1kBitsliced(BenchState & state) { benchAes(state, 1024, true, AES::TABLES_NONE); }
+static void BM_AesDecrypt64Bitsliced(BenchState & state) { benchAes(state, 64, false, AES::TABLES_NONE); }
+static void BM_AesDecrypt1kBitsliced(BenchState & state) { benchAes(state, 1024, false, AES::TABLES_NONE); }
+static void BM_AesDecrypt64kBitsliced(BenchState & state) { benchAes(state, 65536, false, AES::TABLES_NONE); }
+
+// one small response frame per session in turn, the key schedules of the sessions compete with the
+// lookup tables for the L1 cache like in a poller serving many units
+static void benchAesSessions(BenchState & state, int sessions, AES::TableMode mode)
+{
+    uint8_t key[AES_KEY_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
+    std::vector<AES> aes(sessions);
+    std::vector<uint8_t> data(sessions * 2 * AES_BLOCK_SIZE);
+    memset(iv, 0xff, sizeof(iv));
+    fillPattern(&data[0], data.size());
+    for (int i = 0; i < sessions; i++) {
+	fillPattern(key, sizeof(key));
+	key[0] = i;
+	aes[i].SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+	aes[i].SetTableMode(mode);
+	aes[i].StartDecryption(key);
+    }
+    state.bytes = data.size();
+    while (state.keepRunning()) {
+	for (int i = 0; i < sessions; i++) {
+	    uint8_t *frame = &data[i * 2 * AES_BLOCK_SIZE];
+	    aes[i].SetIV(iv, AES_BLOCK_SIZE);
+	    aes[i].Decrypt(frame, frame, 2);
+	}
+	doNotOptimize(data[0]);
+    }
+}
+
+static void BM_AesDecryptSessions64(BenchState & state) { benchAesSessions(state, 64, AES::TABLES_FULL); }
+static void BM_AesDecryptSessions64Compact(BenchState & state) { benchAesSessions(state, 64, AES::TABLES_COMPACT); }
+static void BM_AesDecryptSessions64Bitsliced(BenchState & state) { benchAesSessions(state, 64, AES::TABLES_NONE); }
+
+//---------------------------------------------------------------------------------------------------------
+// CRC32
+//---------------------------------------------------------------------------------------------------------
+static void benchCrc(BenchState & state, size_t length)
+{
+    std::vector<uint8_t> data(length);
+    fillPattern(&data[0], length);
+    RscpProtocol protocol;
+    state.bytes = length;
+    while (state.keepRunning()) {
+	uint32_t crc = protocol.calculateCRC32(&data[0], length);
+	doNotOptimize(crc);
+    }
+}
+
+static void BM_Crc32_64(BenchState & state) { benchCrc(state, 64); }
+static void BM_Crc32_1k(BenchState & state) { benchCrc(state, 1024); }
+static void BM_Crc32_64k(BenchState & state) { benchCrc(state, 65535); }
+
+//---------------------------------------------------------------------------------------------------------
+// frame creation, one benchmark per overload
+//---------------------------------------------------------------------------------------------------------
+static void BM_CreateFrameRaw(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createEmsResponse(protocol, root);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	SRscpFrameBuffer frameBuffer;
+	protocol.createFrameAsBuffer(&frameBuffer, root.data, root.length, true);
+	doNotOptimize(frameBuffer.data);
+	protocol.destroyFrameData(frameBuffer);
+    }
+    protocol.destroyValueData(root);
+}
+
+static void BM_CreateFrameValue(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createEmsResponse(protocol, root);
+    std::vector<SRscpValue> values = protocol.getValueAsContainer(&root);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	SRscpFrameBuffer frameBuffer;
+	protocol.createFrameAsBuffer(&frameBuffer, values.back(), true);
+	doNotOptimize(frameBuffer.data);
+	protocol.destroyFrameData(frameBuffer);
+    }
+    protocol.destroyValueData(values);
+    protocol.destroyValueData(root);
+}
+
+static void BM_CreateFrameVector(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createEmsResponse(protocol, root);
+    std::vector<SRscpValue> values = protocol.getValueAsContainer(&root);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	SRscpFrameBuffer frameBuffer;
+	protocol.createFrameAsBuffer(&frameBuffer, values, true);
+	doNotOptimize(frameBuffer.data);
+	protocol.destroyFrameData(frameBuffer);
+    }
+    protocol.destroyValueData(values);
+    protocol.destroyValueData(root);
+}
+
+static void BM_CreateFrameFrame(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createEmsResponse(protocol, root);
+    SRscpFrame frame;
+    memset(&frame.header, 0, sizeof(frame.header));
+    frame.data = protocol.getValueAsContainer(&root);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	SRscpFrameBuffer frameBuffer;
+	protocol.createFrameAsBuffer(&frameBuffer, frame, true);
+	doNotOptimize(frameBuffer.data);
+	protocol.destroyFrameData(frameBuffer);
+    }
+    protocol.destroyFrameData(frame);
+    protocol.destroyValueData(root);
+}
+
+static void BM_CreateFrameInBuffer(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createEmsResponse(protocol, root);
+    std::vector<uint8_t> buffer(RSCP_MAX_FRAME_LENGTH);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	int32_t iLength = protocol.createFrameInBuffer(&buffer[0], buffer.size(), root.data, root.length, true);
+	doNotOptimize(iLength);
+    }
+    protocol.destroyValueData(root);
+}
+
+//---------------------------------------------------------------------------------------------------------
+// parsing
+//---------------------------------------------------------------------------------------------------------
+static void benchParseFrame(BenchState & state, void (*create)(RscpProtocol &, SRscpValue &))
+{
+    std::vector<uint8_t> frameData;
+    createFrame(create, frameData);
+    RscpProtocol protocol;
+    state.bytes = frameData.size();
+    while (state.keepRunning()) {
+	SRscpFrame frame;
+	int32_t iResult = protocol.parseFrame(&frameData[0], frameData.size(), &frame);
+	doNotOptimize(iResult);
+	protocol.destroyFrameData(frame);
+    }
+}
+
+static void BM_ParseFrameEms(BenchState & state) { benchParseFrame(state, createEmsResponse); }
+static void BM_ParseFrameBat(BenchState & state) { benchParseFrame(state, createBatResponse); }
+static void BM_ParseFrameDb(BenchState & state) { benchParseFrame(state, createDbResponse); }
+
+static void BM_ParseDataDb(BenchState & state)
+{
+    std::vector<uint8_t> frameData;
+    createFrame(createDbResponse, frameData);
+    RscpProtocol protocol;
+    const uint8_t *data = &frameData[sizeof(SRscpFrameHeader)];
+    uint32_t length = frameData.size() - sizeof(SRscpFrameHeader) - sizeof(uint32_t);
+    state.bytes = length;
+    while (state.keepRunning()) {
+	std::vector<SRscpValue> values;
+	int32_t iResult = protocol.parseData(data, length, values);
+	doNotOptimize(iResult);
+	protocol.destroyValueData(values);
+    }
+}
+
+/*
+ * \brief The values of a frame and of its containers as borrowed RscpValue like the response handlers.
+ */
+static void benchParseValues(BenchState & state, void (*create)(RscpProtocol &, SRscpValue &))
+{
+    std::vector<uint8_t> frameData;
+    createFrame(create, frameData);
+    const uint8_t *data = &frameData[sizeof(SRscpFrameHeader)];
+    uint32_t length = frameData.size() - sizeof(SRscpFrameHeader) - sizeof(uint32_t);
+    state.bytes = length;
+    std::vector<RscpValue> values;
+    while (state.keepRunning()) {
+	values.clear();
+	int32_t iResult = RscpValue::parse(data, length, values);
+	for (size_t i = 0; i < values.size(); i++) {
+	    std::vector<RscpValue> children;
+	    iResult += values[i].children(children);
+	}
+	doNotOptimize(iResult);
+    }
+}
+
+static void BM_ParseValuesEms(BenchState & state) { benchParseValues(state, createEmsResponse); }
+static void BM_ParseValuesBat(BenchState & state) { benchParseValues(state, createBatResponse); }
+static void BM_ParseValuesDb(BenchState & state) { benchParseValues(state, createDbResponse); }
+
+/*
+ * \brief The battery response of createBatResponse() built from RscpValue instead of appendValue().
+ */
+static void BM_BuildValuesBat(BenchState & state)
+{
+    state.bytes = 0;
+    while (state.keepRunning()) {
+	RscpValue values[] = {
+	    RscpValue(TAG_BAT_INDEX, (uint8_t) 0),
+	    RscpValue(TAG_BAT_RSOC, 63.5f),
+	    RscpValue(TAG_BAT_MODULE_VOLTAGE, 51.2f),
+	    RscpValue(TAG_BAT_CURRENT, -24.4f),
+	    RscpValue(TAG_BAT_STATUS_CODE, (uint32_t) 0),
+	    RscpValue(TAG_BAT_ERROR_CODE, (uint32_t) 0)
+	};
+	RscpValue batteryData;
+	batteryData.assignContainer(TAG_BAT_DATA, values, sizeof(values) / sizeof(values[0]));
+	state.bytes = batteryData.length();
+	doNotOptimize(batteryData.data()[0]);
+    }
+}
+
+/*
+ * \brief The battery response of createBatResponse() encoded by a reused RscpBuilder like the requests.
+ */
+static void BM_BuildBuilderBat(BenchState & state)
+{
+    RscpBuilder builder;
+    state.bytes = 0;
+    while (state.keepRunning()) {
+	builder.clear();
+	builder.open(TAG_BAT_DATA);
+	builder.add(TAG_BAT_INDEX, (uint8_t) 0);
+	builder.add(TAG_BAT_RSOC, 63.5f);
+	builder.add(TAG_BAT_MODULE_VOLTAGE, 51.2f);
+	builder.add(TAG_BAT_CURRENT, -24.4f);
+	builder.add(TAG_BAT_STATUS_CODE, (uint32_t) 0);
+	builder.add(TAG_BAT_ERROR_CODE, (uint32_t) 0);
+	builder.close();
+	state.bytes = builder.length();
+	doNotOptimize(builder.data()[0]);
+    }
+}
+
+static void BM_BuildAppendBat(BenchState & state)
+{
+    RscpProtocol protocol;
+    state.bytes = 0;
+    while (state.keepRunning()) {
+	SRscpValue root;
+	createBatResponse(protocol, root);
+	state.bytes = root.length;
+	doNotOptimize(root.data[0]);
+	protocol.destroyValueData(root);
+    }
+}
+
+static void benchNestedContainer(BenchState & state, int depth)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createNestedContainer(protocol, root, depth, 4);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	// walk all levels like a response handler does
+	std::vector<SRscpValue> level = protocol.getValueAsContainer(&root);
+	int iLevels = 1;
+	while (!level.empty() && level.back().dataType == RSCP::eTypeContainer) {
+	    std::vector<SRscpValue> next = protocol.getValueAsContainer(&level.back());
+	    protocol.destroyValueData(level);
+	    level.swap(next);
+	    iLevels++;
+	}
+	doNotOptimize(iLevels);
+	protocol.destroyValueData(level);
+    }
+    protocol.destroyValueData(root);
+}
+
+/*
+ * \brief The same nesting indexed once and the innermost value found by its tag path.
+ */
+static void benchTapeFind(BenchState & state, int depth)
+{
+    RscpProtocol protocol;
+    SRscpValue root;
+    createNestedContainer(protocol, root, depth, 4);
+    std::string path;
+    for (int i = 1; i < depth; i++)
+	path += "TAG_BAT_DATA/";
+    path += "TAG_BAT_RSOC";
+    SRscpTapePath compiled;
+    RscpTape::compile(path.c_str(), compiled);
+    RscpTape tape;
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	tape.index(root.data, root.length);
+	int32_t node = tape.find(compiled);
+	doNotOptimize(node);
+    }
+    protocol.destroyValueData(root);
+}
+
+static void BM_TapeFindDepth2(BenchState & state) { benchTapeFind(state, 2); }
+static void BM_TapeFindDepth8(BenchState & state) { benchTapeFind(state, 8); }
+static void BM_TapeFindDepth32(BenchState & state) { benchTapeFind(state, 32); }
+
+static void BM_TapeIndexDb(BenchState & state)
+{
+    std::vector<uint8_t> frameData;
+    createFrame(createDbResponse, frameData);
+    RscpTape tape;
+    state.bytes = frameData.size();
+    while (state.keepRunning()) {
+	int32_t iResult = tape.indexFrame(&frameData[0], frameData.size());
+	doNotOptimize(iResult);
+    }
+}
+
+static void BM_GetValueAsContainerDepth2(BenchState & state) { benchNestedContainer(state, 2); }
+static void BM_GetValueAsContainerDepth8(BenchState & state) { benchNestedContainer(state, 8); }
+static void BM_GetValueAsContainerDepth32(BenchState & state) { benchNestedContainer(state, 32); }
+
+//---------------------------------------------------------------------------------------------------------
+// end to end, parse and handle a response frame like Rscp does (the handler output goes to /dev/null)
+//---------------------------------------------------------------------------------------------------------
+static void benchProcessReceive(BenchState & state, void (*create)(RscpProtocol &, SRscpValue &))
+{
+    std::vector<uint8_t> frameData;
+    createFrame(create, frameData);
+    state.bytes = frameData.size();
+    fflush(stdout);
+    int stdoutCopy = dup(STDOUT_FILENO);
+    if (freopen("/dev/null", "w", stdout) == NULL)
+	return;
+    int isAuthRequest = 0;
+    while (state.keepRunning()) {
+	int32_t iResult = processReceiveBuffer(NULL, &frameData[0], frameData.size(), &isAuthRequest);
+	doNotOptimize(iResult);
+    }
+    fflush(stdout);
+    dup2(stdoutCopy, STDOUT_FILENO);
+    close(stdoutCopy);
+}
+
+static void BM_ProcessReceiveEms(BenchState & state) { benchProcessReceive(state, createEmsResponse); }
+static void BM_ProcessReceiveBat(BenchState & state) { benchProcessReceive(state, createBatResponse); }
+static void BM_ProcessReceiveDb(BenchState & state) { benchProcessReceive(state, createDbResponse); }
+
+//---------------------------------------------------------------------------------------------------------
+// battery cell scan, decoding a full pack response into the dense cell arrays
+//---------------------------------------------------------------------------------------------------------
+static void benchBatteryScan(BenchState & state, int batteries, int dcbs)
+{
+    RscpProtocol protocol;
+    RscpBatteryScan scan;
+    SRscpValue root;
+    createBatDiscoveryResponse(protocol, root, batteries, dcbs);
+    RscpWalker discovery(root.data, root.length);
+    SRscpValueRef value;
+    while (discovery.next(value))
+	scan.handleBatteryData(value);
+    scan.finishDiscovery();
+    protocol.destroyValueData(root);
+
+    createBatCellResponse(protocol, root, batteries, dcbs);
+    state.bytes = root.length;
+    while (state.keepRunning()) {
+	RscpWalker walker(root.data, root.length);
+	int32_t iResult = RSCP::OK;
+	while (walker.next(value))
+	    iResult |= scan.handleBatteryData(value);
+	doNotOptimize(iResult);
+    }
+    protocol.destroyValueData(root);
+}
+
+static void BM_BatteryScan1x4(BenchState & state) { benchBatteryScan(state, 1, 4); }
+static void BM_BatteryScan4x16(BenchState & state) { benchBatteryScan(state, 4, 16); }
+
+//---------------------------------------------------------------------------------------------------------
+// power meter sample, decoding a TAG_PM_DATA response into the sample ring and consuming it
+//---------------------------------------------------------------------------------------------------------
+static void BM_PowerMeterSample(BenchState & state)
+{
+    RscpProtocol protocol;
+    SRscpValue pmData;
+    protocol.createContainerValue(&pmData, TAG_PM_DATA);
+    protocol.appendValue(&pmData, TAG_PM_INDEX, (uint8_t) 0);
+    protocol.appendValue(&pmData, TAG_PM_POWER_L1, 312.0);
+    protocol.appendValue(&pmData, TAG_PM_POWER_L2, 48.5);
+    protocol.appendValue(&pmData, TAG_PM_POWER_L3, 1210.0);
+    protocol.appendValue(&pmData, TAG_PM_ENERGY_L1, 1000123.0);
+    protocol.appendValue(&pmData, TAG_PM_ENERGY_L2, 800456.0);
+    protocol.appendValue(&pmData, TAG_PM_ENERGY_L3, 1200789.0);
+    SRscpValueRef ref = { pmData.tag, pmData.dataType, pmData.length, pmData.data };
+    static RscpPowerMeter meter;
+    SRscpPmSample sample;
+    uint64_t uTime = 0;
+    state.bytes = pmData.length;
+    while (state.keepRunning()) {
+	int32_t iResult = meter.handlePmData(ref, uTime += 1000);
+	meter.ring().pop(sample);
+	doNotOptimize(iResult);
+	doNotOptimize(sample);
+    }
+    protocol.destroyValueData(pmData);
+}
+
+#define BENCH(function) { #function + 3, function }
+
+static const bench_t benchmarks[] = {
+    BENCH(BM_AesEncrypt64),
+    BENCH(BM_AesEncrypt1k),
+    BENCH(BM_AesEncrypt64k),
+    BENCH(BM_AesDecrypt64),
+    BENCH(BM_AesDecrypt1k),
+    BENCH(BM_AesDecrypt64k),
+    BENCH(BM_AesEncrypt1kCompact),
+    BENCH(BM_AesDecrypt1kCompact),
+    BENCH(BM_AesEncrypt1kBitsliced),
+    BENCH(BM_AesDecrypt64Bitsliced),
+    BENCH(BM_AesDecrypt1kBitsliced),
+    BENCH(BM_AesDecrypt64kBitsliced),
+    BENCH(BM_AesDecryptSessions64),
+    BENCH(BM_AesDecryptSessions64Compact),
+    BENCH(BM_AesDecryptSessions64Bitsliced),
+    BENCH(BM_Crc32_64),
+    BENCH(BM_Crc32_1k),
+    BENCH(BM_Crc32_64k),
+    BENCH(BM_CreateFrameRaw),
+    BENCH(BM_CreateFrameValue),
+    BENCH(BM_CreateFrameVector),
+    BENCH(BM_CreateFrameFrame),
+    BENCH(BM_CreateFrameInBuffer),
+    BENCH(BM_ParseFrameEms),
+    BENCH(BM_ParseFrameBat),
+    BENCH(BM_ParseFrameDb),
+    BENCH(BM_ParseDataDb),
+    BENCH(BM_ParseValuesEms),
+    BENCH(BM_ParseValuesBat),
+    BENCH(BM_ParseValuesDb),
+    BENCH(BM_BuildAppendBat),
+    BENCH(BM_BuildValuesBat),
+    BENCH(BM_BuildBuilderBat),
+    BENCH(BM_GetValueAsContainerDepth2),
+    BENCH(BM_GetValueAsContainerDepth8),
+    BENCH(BM_GetValueAsContainerDepth32),
+    BENCH(BM_TapeFindDepth2),
+    BENCH(BM_TapeFindDepth8),
+    BENCH(BM_TapeFindDepth32),
+    BENCH(BM_TapeIndexDb),
+    BENCH(BM_ProcessReceiveEms),
+    BENCH(BM_ProcessReceiveBat),
+    BENCH(BM_ProcessReceiveDb),
+    BENCH(BM_BatteryScan1x4),
+    BENCH(BM_BatteryScan4x16),
+    BENCH(BM_PowerMeterSample),
+};
+
+typedef struct {
+    double ns;
+    double mbytes;
+    double allocs;
+    double misses;
+    uint64_t iterations;
+} bench_result_t;
+
+static bench_result_t runOnce(const bench_t & bench, uint64_t iterations)
+{
+    BenchState state(iterations);
+    bench.function(state);
+    bench_result_t result;
+    double ns = state.elapsedNs();
+    result.iterations = iterations;
+    result.ns = ns / iterations;
+    result.mbytes = (ns > 0) ? state.bytes * iterations * 1e3 / ns : 0.0;
+    result.allocs = (double) state.allocationCount() / iterations;
+    result.misses = (double) state.cacheMissCount() / iterations;
+    return result;
+}
+
+static void runBenchmark(const bench_t & bench)
+{
+    // grow the iteration count until one run takes the minimum time
+    uint64_t iterations = 1;
+    uint64_t minNs = bench_config.min_time * 1e9;
+    while (true) {
+	bench_result_t result = runOnce(bench, iterations);
+	uint64_t elapsed = result.ns * iterations;
+	if (elapsed >= minNs || iterations >= BENCH_MAX_ITERATIONS)
+	    break;
+	uint64_t next = (elapsed > 0) ? (uint64_t) (iterations * 1.4 * minNs / elapsed) : iterations * 100;
+	iterations = std::min(std::max(next, iterations + 1), std::min(iterations * 100, BENCH_MAX_ITERATIONS));
+    }
+    std::vector<bench_result_t> results;
+    for (int i = 0; i < bench_config.repetitions; i++)
+	results.push_back(runOnce(bench, iterations));
+    std::sort(results.begin(), results.end(),
+	[](const bench_result_t & a, const bench_result_t & b) { return a.ns < b.ns; });
+    const bench_result_t & median = results[results.size() / 2];
+    printf("%-32s %12llu %12.1f %12.1f %10.2f", bench.name, (unsigned long long) median.iterations,
+	median.ns, median.mbytes, median.allocs);
+    if (cacheMissFd >= 0)
+	printf(" %12.1f", median.misses);
+    else
+	printf(" %12s", "-");
+    if (results.size() > 1)
+	printf("   (min %.1f, max %.1f)", results.front().ns, results.back().ns);
+    printf("\n");
+    fflush(stdout);
+}
+
+void showhelp(char *prog)
+{
+    printf("Usage:\n");
+    printf("%s [-hl] [-f filter] [-t min_time] [-r repetitions] [-c cpu]\n", prog);
+    printf("  --help, -h         \tshows this help\n");
+    printf("  --list, -l         \tlist the benchmarks\n");
+    printf("  --filter, -f       \trun the benchmarks whose name contains filter\n");
+    printf("  --time, -t         \tminimum time of one run in seconds (default 0.2)\n");
+    printf("  --repetitions, -r  \truns per benchmark, the median is reported (default 5)\n");
+    printf("  --cpu, -c          \tpin the process to a cpu for reproducible results\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    bool bList = false;
+
+    bench_config.min_time = 0.2;
+    bench_config.repetitions = 5;
+    bench_config.cpu = -1;
+    bench_config.filter = NULL;
+
+    while (1) {
+	static struct option long_options[] = {
+	    {"help",		no_argument,		0, 'h'},
+	    {"list",		no_argument,		0, 'l'},
+	    {"filter",		required_argument,	0, 'f'},
+	    {"time",		required_argument,	0, 't'},
+	    {"repetitions",	required_argument,	0, 'r'},
+	    {"cpu",		required_argument,	0, 'c'},
+	    {0,			0,			0, 0 }
+	};
+	int option_index = 0;
+	opt = getopt_long(argc, argv, "hlf:t:r:c:", long_options, &option_index);
+
+	if(opt == -1)
+	    break;
+
+	switch (opt) {
+	case 'h':
+	    showhelp(argv[0]);
+	    return 0;
+	case 'l':
+	    bList = true;
+	    break;
+	case 'f':
+	    bench_config.filter = optarg;
+	    break;
+	case 't':
+	    bench_config.min_time = atof(optarg);
+	    break;
+	case 'r':
+	    bench_config.repetitions = atoi(optarg);
+	    if (bench_config.repetitions < 1)
+		bench_config.repetitions = 1;
+	    break;
+	case 'c':
+	    bench_config.cpu = atoi(optarg);
+	    break;
+	default:
+	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
+	    break;
+	}
+    }
+
+    if (bench_config.cpu >= 0) {
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(bench_config.cpu, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+	    printf("Cannot pin to cpu %i. errno %i\n", bench_config.cpu, errno);
+    }
+
+    if (!bList) {
+	openCacheMissCounter();
+	printf("%-32s %12s %12s %12s %10s %12s\n", "benchmark", "iterations", "ns/op", "MB/s", "allocs/op",
+	    "L1D-miss/op");
+    }
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+	if (bench_config.filter != NULL && strstr(benchmarks[i].name, bench_config.filter) == NULL)
+	    continue;
+	if (bList)
+	    printf("%s\n", benchmarks[i].name);
+	else
+	    runBenchmark(benchmarks[i]);
+    }
+    return 0;
+}
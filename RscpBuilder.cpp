@@ -0,0 +1,97 @@
+/*
+ * RscpBuilder.cpp
+ *
+ * Reusable encoder of request frames.
+ */
+
+#include <stdlib.h>
+#include "RscpBuilder.h"
+
+RscpBuilder::RscpBuilder() :
+	m_pData(NULL), m_uLength(0), m_uCapacity(0), m_uDepth(0), m_iError(RSCP::OK) {
+}
+
+RscpBuilder::~RscpBuilder() {
+	free(m_pData);
+}
+
+void RscpBuilder::clear() {
+	m_uLength = 0;
+	m_uDepth = 0;
+	m_iError = RSCP::OK;
+}
+
+uint8_t *RscpBuilder::reserve(uint32_t length) {
+	if(m_iError != RSCP::OK) {
+		return NULL;
+	}
+	// the whole frame has to fit the 16 bit length of the root container
+	if(m_uLength + length > RSCP_VALUE_MAX_LENGTH) {
+		m_iError = RSCP::ERR_DATA_LIMIT_EXCEEDED;
+		return NULL;
+	}
+	if(m_uLength + length > m_uCapacity) {
+		uint32_t uCapacity = (m_uCapacity == 0) ? RSCP_BUILDER_INITIAL_SIZE : m_uCapacity;
+		while(uCapacity < m_uLength + length) {
+			uCapacity *= 2;
+		}
+		uint8_t *pData = (uint8_t *) realloc(m_pData, uCapacity);
+		if(pData == NULL) {
+			m_iError = RSCP::ERR_NO_MEMORY;
+			return NULL;
+		}
+		m_pData = pData;
+		m_uCapacity = uCapacity;
+	}
+	uint8_t *pData = m_pData + m_uLength;
+	m_uLength += length;
+	return pData;
+}
+
+int32_t RscpBuilder::add(SRscpTag tag, uint8_t dataType, const void *data, uint32_t length) {
+	if(length > RSCP_VALUE_MAX_LENGTH) {
+		if(m_iError == RSCP::OK) {
+			m_iError = RSCP::ERR_DATA_LIMIT_EXCEEDED;
+		}
+		return m_iError;
+	}
+	uint8_t *pData = reserve(RSCP_VALUE_HEADER_LENGTH + length);
+	if(pData == NULL) {
+		return m_iError;
+	}
+	uint16_t uLength = length;
+	memcpy(pData, &tag, sizeof(tag));
+	pData[sizeof(tag)] = dataType;
+	memcpy(pData + sizeof(tag) + sizeof(dataType), &uLength, sizeof(uLength));
+	if(length > 0) {
+		memcpy(pData + RSCP_VALUE_HEADER_LENGTH, data, length);
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpBuilder::open(SRscpTag tag) {
+	if((m_iError == RSCP::OK) && (m_uDepth == RSCP_BUILDER_MAX_DEPTH)) {
+		m_iError = RSCP::ERR_DATA_LIMIT_EXCEEDED;
+	}
+	uint32_t uHeader = m_uLength;
+	// the length is written by close()
+	int32_t iResult = add(tag, RSCP::eTypeContainer, NULL, 0);
+	if(iResult == RSCP::OK) {
+		m_uOpen[m_uDepth++] = uHeader;
+	}
+	return iResult;
+}
+
+int32_t RscpBuilder::close() {
+	if(m_iError != RSCP::OK) {
+		return m_iError;
+	}
+	if(m_uDepth == 0) {
+		m_iError = RSCP::ERR_INVALID_INPUT;
+		return m_iError;
+	}
+	uint32_t uHeader = m_uOpen[--m_uDepth];
+	uint16_t uLength = m_uLength - uHeader - RSCP_VALUE_HEADER_LENGTH;
+	memcpy(m_pData + uHeader + sizeof(SRscpTag) + sizeof(uint8_t), &uLength, sizeof(uLength));
+	return RSCP::OK;
+}
@@ -0,0 +1,108 @@
+/*
+ * RscpBuilder.h
+ *
+ * Reusable encoder of request frames. The values are written in their wire format into one buffer which
+ * keeps its capacity between frames, a container is opened before and closed after its children and gets
+ * its length when it is closed. Unlike RscpProtocol::appendValue(), which reallocates the parent for every
+ * value and copies each sub-container into it, a builder that is reused for the next poll needs no
+ * allocation once its buffer has grown to the frame size.
+ */
+
+#ifndef RSCPBUILDER_H_
+#define RSCPBUILDER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "RscpTypes.h"
+#include "RscpValue.h"
+
+// containers open at the same time, requests nest at most 4 levels
+#define RSCP_BUILDER_MAX_DEPTH		8
+// initial buffer size, enough for the polls of the main loop
+#define RSCP_BUILDER_INITIAL_SIZE	512
+
+class RscpBuilder {
+public:
+	RscpBuilder();
+	~RscpBuilder();
+	/*
+	 * \brief Start a new frame. The buffer is kept, so the next frame of the same size needs no allocation.
+	 */
+	void clear();
+	/*
+	 * \brief Append a value without data, like a request tag.
+	 * @return - RSCP::OK or the first error since clear(), see error()
+	 */
+	int32_t add(SRscpTag tag) { return add(tag, RSCP::eTypeNone, NULL, 0); }
+	int32_t add(SRscpTag tag, bool value) { return add(tag, RSCP::eTypeBool, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, char value) { return add(tag, RSCP::eTypeChar8, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, int8_t value) { return add(tag, RSCP::eTypeChar8, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, uint8_t value) { return add(tag, RSCP::eTypeUChar8, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, int16_t value) { return add(tag, RSCP::eTypeInt16, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, uint16_t value) { return add(tag, RSCP::eTypeUInt16, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, int32_t value) { return add(tag, RSCP::eTypeInt32, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, uint32_t value) { return add(tag, RSCP::eTypeUInt32, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, int64_t value) { return add(tag, RSCP::eTypeInt64, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, uint64_t value) { return add(tag, RSCP::eTypeUInt64, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, float value) { return add(tag, RSCP::eTypeFloat32, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, double value) { return add(tag, RSCP::eTypeDouble64, &value, sizeof(value)); }
+	int32_t add(SRscpTag tag, const SRscpTimestamp & value) {
+		return add(tag, RSCP::eTypeTimestamp, &value, sizeof(value));
+	}
+	int32_t add(SRscpTag tag, const char *value) { return add(tag, RSCP::eTypeString, value, strlen(value)); }
+	/*
+	 * \brief Append a value of \var dataType with \var length bytes of \var data.
+	 */
+	int32_t add(SRscpTag tag, uint8_t dataType, const void *data, uint32_t length);
+	/*
+	 * \brief Open a container of \var tag, the values appended until close() are its children.
+	 */
+	int32_t open(SRscpTag tag);
+	/*
+	 * \brief Close the innermost open container and write its length.
+	 */
+	int32_t close();
+	/*
+	 * \brief The first error since clear(): RSCP::ERR_NO_MEMORY, RSCP::ERR_DATA_LIMIT_EXCEEDED or
+	 *        RSCP::ERR_INVALID_INPUT for unbalanced containers. The values after an error are skipped, so
+	 *        a builder can append all values and check once.
+	 */
+	int32_t error() const {
+		return ((m_iError == RSCP::OK) && (m_uDepth > 0)) ? RSCP::ERR_INVALID_INPUT : m_iError;
+	}
+	/*
+	 * \brief Data region of the frame, the values without frame header and CRC.
+	 */
+	const uint8_t *data() const {
+		return m_pData;
+	}
+	uint32_t length() const {
+		return m_uLength;
+	}
+	/*
+	 * \brief Root container of the frame for RscpSession::queueValue() or RscpProtocol::createFrameAsBuffer().
+	 *        The data stays owned by the builder, never pass the result to RscpProtocol::destroyValueData().
+	 */
+	SRscpValue root() const {
+		SRscpValue value;
+		value.tag = 0;
+		value.dataType = RSCP::eTypeContainer;
+		value.length = m_uLength;
+		value.data = m_pData;
+		return value;
+	}
+private:
+	RscpBuilder(const RscpBuilder &);
+	RscpBuilder & operator=(const RscpBuilder &);
+
+	uint8_t *reserve(uint32_t length);
+
+	uint8_t *m_pData;
+	uint32_t m_uLength;
+	uint32_t m_uCapacity;
+	uint32_t m_uOpen[RSCP_BUILDER_MAX_DEPTH];	// offsets of the headers of the open containers
+	uint32_t m_uDepth;
+	int32_t m_iError;
+};
+
+#endif /* RSCPBUILDER_H_ */
@@ -0,0 +1,107 @@
+/*
+ * RscpCapture.cpp
+ *
+ * Capture file for RSCP traffic.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "RscpCapture.h"
+#include "RscpTypes.h"
+
+// write buffer of the capture file, records are appended with a single fwrite each
+#define RSCP_CAPTURE_BUFFER_SIZE	(64 * 1024)
+
+RscpCapture::RscpCapture() :
+	m_pFile(NULL) {
+}
+
+RscpCapture::~RscpCapture() {
+	close();
+}
+
+bool RscpCapture::openWrite(const char *path) {
+	close();
+	m_pFile = fopen(path, "wb");
+	if(m_pFile == NULL) {
+		return false;
+	}
+	setvbuf(m_pFile, NULL, _IOFBF, RSCP_CAPTURE_BUFFER_SIZE);
+
+	SRscpCaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RSCP_CAPTURE_MAGIC, sizeof(RSCP_CAPTURE_MAGIC));
+	header.version = RSCP_CAPTURE_VERSION;
+	header.headerSize = sizeof(SRscpCaptureHeader);
+	header.recordSize = sizeof(SRscpCaptureRecord);
+	if(fwrite(&header, sizeof(header), 1, m_pFile) != 1) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool RscpCapture::openRead(const char *path) {
+	close();
+	m_pFile = fopen(path, "rb");
+	if(m_pFile == NULL) {
+		return false;
+	}
+	SRscpCaptureHeader header;
+	if((fread(&header, sizeof(header), 1, m_pFile) != 1)
+		|| (memcmp(header.magic, RSCP_CAPTURE_MAGIC, sizeof(RSCP_CAPTURE_MAGIC)) != 0)
+		|| (header.version != RSCP_CAPTURE_VERSION)
+		|| (header.recordSize != sizeof(SRscpCaptureRecord))
+		|| (header.headerSize < sizeof(SRscpCaptureHeader))
+		|| (fseek(m_pFile, header.headerSize, SEEK_SET) != 0)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void RscpCapture::close() {
+	if(m_pFile != NULL) {
+		fclose(m_pFile);
+		m_pFile = NULL;
+	}
+}
+
+int32_t RscpCapture::write(uint8_t direction, uint8_t flags, const uint8_t *data, uint32_t length) {
+	if((m_pFile == NULL) || ((data == NULL) && (length > 0))) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	SRscpCaptureRecord record;
+	record.timestamp = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+	record.length = length;
+	record.direction = direction;
+	record.flags = flags;
+	record.reserved = 0;
+	if(fwrite(&record, sizeof(record), 1, m_pFile) != 1) {
+		return RSCP::ERR_NO_MEMORY;
+	}
+	if((length > 0) && (fwrite(data, length, 1, m_pFile) != 1)) {
+		return RSCP::ERR_NO_MEMORY;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpCapture::read(SRscpCaptureRecord *record, std::vector<uint8_t> & data) {
+	if((m_pFile == NULL) || (record == NULL)) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	if(fread(record, sizeof(SRscpCaptureRecord), 1, m_pFile) != 1) {
+		// a truncated record header at the end is treated as the end of the capture
+		return 0;
+	}
+	if(data.size() < record->length) {
+		data.resize(record->length);
+	}
+	if((record->length > 0) && (fread(&data[0], record->length, 1, m_pFile) != 1)) {
+		return RSCP::ERR_INVALID_FRAME_LENGTH;
+	}
+	return 1;
+}
@@ -0,0 +1,90 @@
+/*
+ * RscpCapture.h
+ *
+ * Capture file for RSCP traffic. The file starts with an SRscpCaptureHeader followed by records,
+ * each record is an SRscpCaptureRecord followed by \var length bytes of frame data.
+ * All values are stored in host byte order (little endian on all supported targets).
+ */
+
+#ifndef RSCPCAPTURE_H_
+#define RSCPCAPTURE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#define RSCP_CAPTURE_MAGIC		"RSCPCAP"
+#define RSCP_CAPTURE_VERSION	1
+
+enum eRscpCaptureDirection {
+	RSCP_CAPTURE_RX			= 0,
+	RSCP_CAPTURE_TX			= 1
+};
+
+enum eRscpCaptureFlags {
+	// the record holds encrypted stream data as received or sent, not necessarily frame aligned
+	RSCP_CAPTURE_ENCRYPTED	= 0x01,
+	// the decrypted data could not be parsed as RSCP frame
+	RSCP_CAPTURE_INVALID	= 0x02
+};
+
+struct SRscpCaptureHeader {
+	char magic[8];				// RSCP_CAPTURE_MAGIC including the terminating zero
+	uint16_t version;			// RSCP_CAPTURE_VERSION
+	uint16_t headerSize;		// sizeof(SRscpCaptureHeader), records start behind
+	uint16_t recordSize;		// sizeof(SRscpCaptureRecord)
+	uint16_t reserved;
+} __attribute__((packed));
+
+struct SRscpCaptureRecord {
+	uint64_t timestamp;			// CLOCK_REALTIME in nanoseconds
+	uint32_t length;			// length of the data following the record header
+	uint8_t direction;			// eRscpCaptureDirection
+	uint8_t flags;				// eRscpCaptureFlags
+	uint16_t reserved;
+} __attribute__((packed));
+
+class RscpCapture {
+public:
+	/*
+	 * Constructor
+	 */
+	RscpCapture();
+	/*
+	 * Destructor
+	 */
+	virtual ~RscpCapture();
+	/*
+	 * \brief Create \var path (an existing file is truncated) and write the file header.
+	 * @return - true on success
+	 */
+	bool openWrite(const char *path);
+	/*
+	 * \brief Open \var path for reading and check the file header.
+	 * @return - true on success
+	 */
+	bool openRead(const char *path);
+	/*
+	 * \brief Flush and close the file.
+	 */
+	void close();
+	bool isOpen() const {
+		return m_pFile != NULL;
+	}
+	/*
+	 * \brief Append one record with the current time.
+	 * @param direction - eRscpCaptureDirection
+	 * @param flags     - eRscpCaptureFlags
+	 * @return          - RSCP::OK or an RSCP error code
+	 */
+	int32_t write(uint8_t direction, uint8_t flags, const uint8_t *data, uint32_t length);
+	/*
+	 * \brief Read the next record into \var record and its data into \var data, the vector is reused by the caller.
+	 * @return - 1 if a record was read, 0 at the end of the file or an RSCP error code
+	 */
+	int32_t read(SRscpCaptureRecord *record, std::vector<uint8_t> & data);
+private:
+	FILE *m_pFile;
+};
+
+#endif /* RSCPCAPTURE_H_ */
@@ -0,0 +1,359 @@
+/*
+ * RscpConfig.cpp
+ *
+ * Configuration file with device sections.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include "RscpConfig.h"
+#include "RscpTagPath.h"
+#include "SocketConnection.h"
+#include "RscpWallbox.h"
+#include "AES.h"
+
+// keys with one value, only these can be overridden by the environment
+static const char *singleKeys[] = {
+	"server_ip", "server_port", "connect_timeout", "e3dc_user", "e3dc_password", "aes_password", "aes_mode",
+	"wb_min_current", "wb_max_current", "wb_phases", "poll_interval", "sink", "alarm_log", "alarm_hook", "alarm_state"
+};
+
+static bool copyString(char *dst, size_t size, const char *value) {
+	size_t length = strlen(value);
+	if(length >= size) {
+		return false;
+	}
+	memcpy(dst, value, length + 1);
+	return true;
+}
+
+static bool parseInt(const char *value, long min, long max, int *result) {
+	char *end = NULL;
+	errno = 0;
+	long l = strtol(value, &end, 10);
+	if((errno != 0) || (end == value) || (*end != '\0') || (l < min) || (l > max)) {
+		return false;
+	}
+	*result = (int) l;
+	return true;
+}
+
+static char *trim(char *s) {
+	while(isspace((unsigned char) *s)) {
+		s++;
+	}
+	size_t length = strlen(s);
+	while((length > 0) && isspace((unsigned char) s[length - 1])) {
+		s[--length] = '\0';
+	}
+	return s;
+}
+
+RscpConfig::RscpConfig() {
+	// without a file the defaults are the only device
+	initDefaults(m_defaults);
+	m_devices.push_back(m_defaults);
+	strcpy(m_devices.back().name, "default");
+}
+
+void RscpConfig::initDefaults(SRscpDeviceConfig & device) {
+	memset(device.name, 0, sizeof(device.name));
+	memset(&device.e3dc, 0, sizeof(device.e3dc));
+	device.e3dc.connect_timeout = SOCKET_CONNECT_TIMEOUT_MS;
+	device.e3dc.wb_min_current = WB_MIN_CURRENT;
+	device.e3dc.wb_max_current = 16;
+	device.e3dc.wb_phases = 3;
+	device.poll.clear();
+	device.pollInterval = CONFIG_DEFAULT_POLL_INTERVAL;
+	strcpy(device.sink, "-");
+}
+
+bool RscpConfig::set(SRscpDeviceConfig & device, SRscpGlobalConfig *globals, const char *key, const char *value,
+	const char *where) const {
+	e3dc_config_t & e3dc = device.e3dc;
+	bool bValid = true;
+	int iValue = 0;
+	if(strcmp(key, "server_ip") == 0) {
+		bValid = copyString(e3dc.server_ip, sizeof(e3dc.server_ip), value);
+	}
+	else if(strcmp(key, "server_port") == 0) {
+		bValid = parseInt(value, 1, 65535, &e3dc.server_port);
+	}
+	else if(strcmp(key, "connect_timeout") == 0) {
+		bValid = parseInt(value, 1, 600000, &e3dc.connect_timeout);
+	}
+	else if(strcmp(key, "e3dc_user") == 0) {
+		bValid = copyString(e3dc.e3dc_user, sizeof(e3dc.e3dc_user), value);
+	}
+	else if(strcmp(key, "e3dc_password") == 0) {
+		bValid = copyString(e3dc.e3dc_password, sizeof(e3dc.e3dc_password), value);
+	}
+	else if(strcmp(key, "aes_password") == 0) {
+		bValid = copyString(e3dc.aes_password, sizeof(e3dc.aes_password), value);
+	}
+	else if(strcmp(key, "aes_mode") == 0) {
+		if(strcmp(value, "tables") == 0) {
+			e3dc.aes_mode = AES::TABLES_FULL;
+		}
+		else if(strcmp(value, "compact") == 0) {
+			e3dc.aes_mode = AES::TABLES_COMPACT;
+		}
+		else if(strcmp(value, "bitsliced") == 0) {
+			e3dc.aes_mode = AES::TABLES_NONE;
+		}
+		else {
+			bValid = false;
+		}
+	}
+	else if(strcmp(key, "wb_min_current") == 0) {
+		bValid = parseInt(value, WB_MIN_CURRENT, WB_MAX_CURRENT, &e3dc.wb_min_current);
+	}
+	else if(strcmp(key, "wb_max_current") == 0) {
+		bValid = parseInt(value, WB_MIN_CURRENT, WB_MAX_CURRENT, &e3dc.wb_max_current);
+	}
+	else if(strcmp(key, "wb_phases") == 0) {
+		bValid = parseInt(value, 1, 3, &e3dc.wb_phases);
+	}
+	else if(strcmp(key, "poll") == 0) {
+		// the tag request prints the reason of an invalid path
+		RscpTagRequest request;
+		bValid = (strlen(value) < TAG_PATH_MAX_LENGTH) && (request.add(value) == RSCP::OK);
+		if(bValid) {
+			device.poll.push_back(value);
+		}
+	}
+	else if(strcmp(key, "poll_interval") == 0) {
+		bValid = parseInt(value, 10, 86400000, &iValue);
+		device.pollInterval = iValue;
+	}
+	else if(strcmp(key, "sink") == 0) {
+		bValid = copyString(device.sink, sizeof(device.sink), value);
+	}
+	else if((strcmp(key, "idle_period") == 0) || (strncmp(key, "alarm", 5) == 0)) {
+		if(globals == NULL) {
+			printf("%s: %s is only allowed before the first device section\n", where, key);
+			return false;
+		}
+		if(strcmp(key, "idle_period") == 0) {
+			idle_period_t period;
+			bValid = RscpIdlePeriods::parse(value, period) && globals->idlePeriods.set(period);
+		}
+		else if(strcmp(key, "alarm") == 0) {
+			// the rule parser prints the reason of an invalid rule
+			SRscpAlarmRule rule;
+			if(!RscpAlarms::parseRule(value, rule, where)) {
+				return false;
+			}
+			for(size_t i = 0; i < globals->alarms.size(); i++) {
+				if(strcmp(globals->alarms[i].name, rule.name) == 0) {
+					printf("%s: alarm %s is already defined\n", where, rule.name);
+					return false;
+				}
+			}
+			globals->alarms.push_back(rule);
+		}
+		else if(strcmp(key, "alarm_log") == 0) {
+			globals->alarmLog = value;
+		}
+		else if(strcmp(key, "alarm_hook") == 0) {
+			bValid = (access(value, X_OK) == 0);
+			globals->alarmHook = value;
+		}
+		else if(strcmp(key, "alarm_state") == 0) {
+			globals->alarmState = value;
+		}
+		else {
+			printf("%s: unknown key %s\n", where, key);
+			return false;
+		}
+	}
+	else {
+		printf("%s: unknown key %s\n", where, key);
+		return false;
+	}
+	if(!bValid) {
+		printf("%s: invalid %s %s\n", where, key, value);
+	}
+	return bValid;
+}
+
+bool RscpConfig::applyEnvironment(SRscpDeviceConfig & device, SRscpGlobalConfig *globals, const char *prefix) const {
+	bool bValid = true;
+	for(size_t i = 0; i < sizeof(singleKeys) / sizeof(singleKeys[0]); i++) {
+		char name[CONFIG_NAME_LENGTH * 2];
+		snprintf(name, sizeof(name), "%s%s", prefix, singleKeys[i]);
+		for(char *c = name; *c; c++) {
+			*c = isalnum((unsigned char) *c) ? toupper((unsigned char) *c) : '_';
+		}
+		const char *value = getenv(name);
+		if(value != NULL) {
+			bValid &= set(device, globals, singleKeys[i], value, name);
+		}
+	}
+	return bValid;
+}
+
+bool RscpConfig::validate(const SRscpDeviceConfig & device, const char *where) const {
+	bool bValid = true;
+	if(device.e3dc.server_ip[0] == '\0') {
+		printf("%s: server_ip is missing\n", where);
+		bValid = false;
+	}
+	if(device.e3dc.aes_password[0] == '\0') {
+		printf("%s: aes_password is missing\n", where);
+		bValid = false;
+	}
+	if(device.e3dc.wb_min_current > device.e3dc.wb_max_current) {
+		printf("%s: wb_min_current is above wb_max_current\n", where);
+		bValid = false;
+	}
+	return bValid;
+}
+
+int32_t RscpConfig::load(const char *path) {
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		return CONFIG_ERR_READ;
+	}
+	std::vector<SConfigEntry> globals;
+	std::vector<SConfigSection> sections;
+	bool bValid = true;
+	char buffer[CONFIG_LINE_LENGTH];
+	int line = 0;
+	while(fgets(buffer, sizeof(buffer), fp)) {
+		line++;
+		size_t length = strlen(buffer);
+		if((length == sizeof(buffer) - 1) && (buffer[length - 1] != '\n') && !feof(fp)) {
+			printf("%s:%i: line is longer than %i characters\n", path, line, CONFIG_LINE_LENGTH - 2);
+			bValid = false;
+			int c;
+			while(((c = fgetc(fp)) != EOF) && (c != '\n')) {
+			}
+			continue;
+		}
+		char *s = trim(buffer);
+		if((*s == '\0') || (*s == '#')) {
+			continue;
+		}
+		if(*s == '[') {
+			char name[CONFIG_NAME_LENGTH];
+			char end = 0;
+			if((sscanf(s, "[device %63[A-Za-z0-9_-]%c", name, &end) != 2) || (end != ']')
+				|| (strlen(s) != strlen("[device ]") + strlen(name))) {
+				printf("%s:%i: invalid section %s, expected [device name]\n", path, line, s);
+				bValid = false;
+				continue;
+			}
+			SConfigSection section;
+			section.name = name;
+			section.line = line;
+			sections.push_back(section);
+			continue;
+		}
+		char *equal = strchr(s, '=');
+		if(equal == NULL) {
+			printf("%s:%i: expected key = value\n", path, line);
+			bValid = false;
+			continue;
+		}
+		*equal = '\0';
+		SConfigEntry entry;
+		entry.key = trim(s);
+		entry.value = trim(equal + 1);
+		entry.line = line;
+		if(entry.key.empty() || entry.value.empty()) {
+			printf("%s:%i: expected key = value\n", path, line);
+			bValid = false;
+			continue;
+		}
+		if(sections.empty()) {
+			globals.push_back(entry);
+		}
+		else {
+			sections.back().entries.push_back(entry);
+		}
+	}
+	fclose(fp);
+
+	char where[CONFIG_SINK_LENGTH + 16];
+	SRscpDeviceConfig defaults;
+	initDefaults(defaults);
+	SRscpGlobalConfig shared;
+	for(size_t i = 0; i < globals.size(); i++) {
+		snprintf(where, sizeof(where), "%s:%i", path, globals[i].line);
+		bValid &= set(defaults, &shared, globals[i].key.c_str(), globals[i].value.c_str(), where);
+	}
+	bValid &= applyEnvironment(defaults, &shared, "E3DC_");
+
+	std::vector<SRscpDeviceConfig> devices;
+	if(sections.empty()) {
+		// the single device of a file without sections may stay incomplete, e.g. for a replay
+		devices.push_back(defaults);
+		strcpy(devices.back().name, "default");
+	}
+	if(sections.size() > CONFIG_MAX_DEVICES) {
+		printf("%s: more than %i devices\n", path, CONFIG_MAX_DEVICES);
+		bValid = false;
+	}
+	for(size_t i = 0; i < sections.size(); i++) {
+		const SConfigSection & section = sections[i];
+		for(size_t j = 0; j < i; j++) {
+			if(sections[j].name == section.name) {
+				printf("%s:%i: device %s is already defined in line %i\n", path, section.line, section.name.c_str(),
+					sections[j].line);
+				bValid = false;
+			}
+		}
+		SRscpDeviceConfig device = defaults;
+		strcpy(device.name, section.name.c_str());
+		// poll paths of a section replace the default ones instead of extending them
+		bool bPoll = false;
+		for(size_t j = 0; j < section.entries.size(); j++) {
+			const SConfigEntry & entry = section.entries[j];
+			if((entry.key == "poll") && !bPoll) {
+				device.poll.clear();
+				bPoll = true;
+			}
+			snprintf(where, sizeof(where), "%s:%i", path, entry.line);
+			bValid &= set(device, NULL, entry.key.c_str(), entry.value.c_str(), where);
+		}
+		char prefix[CONFIG_NAME_LENGTH + 8];
+		snprintf(prefix, sizeof(prefix), "E3DC_%s_", device.name);
+		bValid &= applyEnvironment(device, NULL, prefix);
+		snprintf(where, sizeof(where), "%s:%i: device %s", path, section.line, device.name);
+		bValid &= validate(device, where);
+		devices.push_back(device);
+	}
+	if(!bValid) {
+		return CONFIG_ERR_INVALID;
+	}
+	m_defaults = defaults;
+	m_devices.swap(devices);
+	m_globals = shared;
+	return RSCP::OK;
+}
+
+const SRscpDeviceConfig *RscpConfig::find(const char *name) const {
+	for(size_t i = 0; i < m_devices.size(); i++) {
+		if(strcmp(m_devices[i].name, name) == 0) {
+			return &m_devices[i];
+		}
+	}
+	return NULL;
+}
+
+bool RscpConfig::sameSession(const SRscpDeviceConfig & a, const SRscpDeviceConfig & b) {
+	return (strcmp(a.e3dc.server_ip, b.e3dc.server_ip) == 0) && (a.e3dc.server_port == b.e3dc.server_port)
+		&& (a.e3dc.connect_timeout == b.e3dc.connect_timeout)
+		&& (strcmp(a.e3dc.e3dc_user, b.e3dc.e3dc_user) == 0)
+		&& (strcmp(a.e3dc.e3dc_password, b.e3dc.e3dc_password) == 0)
+		&& (strcmp(a.e3dc.aes_password, b.e3dc.aes_password) == 0) && (a.e3dc.aes_mode == b.e3dc.aes_mode);
+}
+
+bool RscpConfig::samePoll(const SRscpDeviceConfig & a, const SRscpDeviceConfig & b) {
+	return (a.poll == b.poll) && (a.pollInterval == b.pollInterval) && (strcmp(a.sink, b.sink) == 0);
+}
@@ -0,0 +1,119 @@
+/*
+ * RscpConfig.h
+ *
+ * Configuration file with device sections. The keys before the first [device name] section are the
+ * defaults of all devices, each section overrides them for one device. Without sections the defaults
+ * form the only device. Every single value key can be overridden by the environment, E3DC_<KEY> for
+ * the defaults and E3DC_<DEVICE>_<KEY> for one device (names in upper case, other characters as '_'),
+ * the repeatable keys poll, idle_period and alarm are only read from the file. The file is validated
+ * completely: unknown keys, malformed or out of range values and values which do not fit are errors,
+ * the whole file is rejected if one of them occurs.
+ */
+
+#ifndef RSCPCONFIG_H_
+#define RSCPCONFIG_H_
+
+#include <vector>
+#include <string>
+#include "e3dc_config.h"
+#include "RscpIdlePeriods.h"
+#include "RscpAlarms.h"
+
+#define CONFIG_MAX_DEVICES			64
+#define CONFIG_NAME_LENGTH			64
+#define CONFIG_SINK_LENGTH			256
+#define CONFIG_LINE_LENGTH			1024
+// poll interval of a device without poll_interval in milliseconds
+#define CONFIG_DEFAULT_POLL_INTERVAL	1000
+
+enum eRscpConfigReturnCodes {
+	CONFIG_ERR_READ			= -1,	// the file cannot be opened
+	CONFIG_ERR_INVALID		= -2	// at least one error was printed
+};
+
+struct SRscpDeviceConfig {
+	char name[CONFIG_NAME_LENGTH];
+	e3dc_config_t e3dc;				// connection, credentials and the wallbox limits
+	std::vector<std::string> poll;	// tag paths requested every poll interval
+	uint32_t pollInterval;			// milliseconds
+	char sink[CONFIG_SINK_LENGTH];	// file the responses are appended to, "-" for stdout
+};
+
+// keys only allowed before the first device section, they apply to the whole process
+struct SRscpGlobalConfig {
+	RscpIdlePeriods idlePeriods;
+	std::vector<SRscpAlarmRule> alarms;
+	std::string alarmLog;			// empty or "-" for stdout
+	std::string alarmHook;			// empty for none
+	std::string alarmState;			// empty to keep the alarm states in memory only
+};
+
+class RscpConfig {
+public:
+	RscpConfig();
+	/*
+	 * \brief Read and validate \var path and apply the environment overrides. The previous content is
+	 *        replaced only if the file is valid, every error is printed with its line.
+	 * @return - RSCP::OK or an eRscpConfigReturnCodes value
+	 */
+	int32_t load(const char *path);
+	/*
+	 * \brief Values of the keys outside of the device sections.
+	 */
+	const SRscpDeviceConfig & defaults() const {
+		return m_defaults;
+	}
+	uint32_t deviceCount() const {
+		return m_devices.size();
+	}
+	const SRscpDeviceConfig & device(uint32_t index) const {
+		return m_devices[index];
+	}
+	/*
+	 * \brief Device of the section \var name, NULL if there is none.
+	 */
+	const SRscpDeviceConfig *find(const char *name) const;
+	/*
+	 * \brief Schedule of the idle_period keys, they are only allowed outside of the device sections.
+	 */
+	const RscpIdlePeriods & idlePeriods() const {
+		return m_globals.idlePeriods;
+	}
+	/*
+	 * \brief Rules and outputs of the alarm keys, they are only allowed outside of the device sections.
+	 */
+	const SRscpGlobalConfig & globals() const {
+		return m_globals;
+	}
+	/*
+	 * \brief True if a session of \var a can be kept for \var b: same address and credentials.
+	 */
+	static bool sameSession(const SRscpDeviceConfig & a, const SRscpDeviceConfig & b);
+	/*
+	 * \brief True if the poll paths, the interval and the sink are the same.
+	 */
+	static bool samePoll(const SRscpDeviceConfig & a, const SRscpDeviceConfig & b);
+private:
+	struct SConfigEntry {
+		std::string key;
+		std::string value;
+		int line;
+	};
+	struct SConfigSection {
+		std::string name;
+		int line;
+		std::vector<SConfigEntry> entries;
+	};
+
+	static void initDefaults(SRscpDeviceConfig & device);
+	bool set(SRscpDeviceConfig & device, SRscpGlobalConfig *globals, const char *key, const char *value,
+		const char *where) const;
+	bool applyEnvironment(SRscpDeviceConfig & device, SRscpGlobalConfig *globals, const char *prefix) const;
+	bool validate(const SRscpDeviceConfig & device, const char *where) const;
+
+	SRscpDeviceConfig m_defaults;
+	std::vector<SRscpDeviceConfig> m_devices;
+	SRscpGlobalConfig m_globals;
+};
+
+#endif /* RSCPCONFIG_H_ */
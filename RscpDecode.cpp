@@ -0,0 +1,559 @@
+/*
+ * RscpDecode.cpp
+ *
+ * Offline decoder for capture files written by Rscp -c. The capture is mapped into memory,
+ * split into chunks at record boundaries and decoded on all cores without allocating per value.
+ * The selected values are written as CSV or as fixed size binary records in capture order.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "RscpProtocol.h"
+#include "RscpCapture.h"
+#include "RscpWalker.h"
+
+// input bytes per chunk, large enough to amortize the scheduling and small enough to balance the cores
+#define DECODE_CHUNK_SIZE       (4 * 1024 * 1024)
+// decoded chunks per thread which may wait for the ordered output
+#define DECODE_WINDOW_PER_THREAD 4
+
+#define DECODE_DIRECTION_ALL    0xFF
+
+enum eDecodeFormat {
+    DECODE_FORMAT_CSV = 0,
+    DECODE_FORMAT_BINARY = 1
+};
+
+// binary output record, numeric values only
+struct SDecodeRecord {
+    uint64_t timestamp;         // capture record time, CLOCK_REALTIME in nanoseconds
+    uint32_t tag;
+    uint32_t container;         // tag of the enclosing container, 0 on the top level
+    double value;
+} __attribute__((packed));
+
+struct SDecodeStats {
+    uint64_t records;
+    uint64_t frames;
+    uint64_t values;
+    uint64_t invalid;           // frames with bad header, length or CRC
+    uint64_t skipped;           // encrypted, flagged invalid or filtered records
+};
+
+struct SDecodeChunk {
+    const uint8_t *begin;       // first record header
+    const uint8_t *end;         // behind the last complete record
+    std::string output;
+    SDecodeStats stats;
+    bool done;
+};
+
+typedef struct {
+    int format;
+    int threads;
+    int direction;
+    int quiet;
+    std::vector<uint32_t> tags;  // sorted, empty selects all values
+} decode_config_t;
+
+static decode_config_t decode_config;
+
+static std::vector<SDecodeChunk> chunks;
+static std::atomic<size_t> nextChunk(0);
+static size_t writtenChunks = 0;
+static std::mutex chunkMutex;
+static std::condition_variable chunkDone;
+static std::condition_variable chunkWritten;
+
+static bool isSelected(uint32_t tag)
+{
+    if (decode_config.tags.empty())
+	return true;
+    return std::binary_search(decode_config.tags.begin(), decode_config.tags.end(), tag);
+}
+
+static void appendHex32(std::string & out, uint32_t value)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char buffer[10] = { '0', 'x' };
+    for (int i = 0; i < 8; i++)
+	buffer[2 + i] = digits[(value >> (28 - 4 * i)) & 0x0F];
+    out.append(buffer, sizeof(buffer));
+}
+
+static void appendUInt64(std::string & out, uint64_t value)
+{
+    char buffer[20];
+    int i = sizeof(buffer);
+    do {
+	buffer[--i] = '0' + value % 10;
+	value /= 10;
+    } while (value != 0);
+    out.append(buffer + i, sizeof(buffer) - i);
+}
+
+static void appendInt64(std::string & out, int64_t value)
+{
+    if (value < 0) {
+	out.push_back('-');
+	appendUInt64(out, 0 - (uint64_t) value);
+    }
+    else
+	appendUInt64(out, value);
+}
+
+template<class T> static T loadValue(const SRscpValueRef & value)
+{
+    T t;
+    memcpy(&t, value.data, sizeof(T));
+    return t;
+}
+
+/*
+ * \brief Append the value as CSV field, strings are quoted and byte arrays written as hex.
+ */
+static void appendCsvValue(std::string & out, const SRscpValueRef & value)
+{
+    char buffer[64];
+    switch (value.dataType) {
+    case RSCP::eTypeBool:
+    case RSCP::eTypeUChar8:
+    case RSCP::eTypeBitfield:
+	if (value.length >= sizeof(uint8_t))
+	    appendUInt64(out, loadValue<uint8_t>(value));
+	return;
+    case RSCP::eTypeChar8:
+	if (value.length >= sizeof(int8_t))
+	    appendInt64(out, loadValue<int8_t>(value));
+	return;
+    case RSCP::eTypeInt16:
+	if (value.length >= sizeof(int16_t))
+	    appendInt64(out, loadValue<int16_t>(value));
+	return;
+    case RSCP::eTypeUInt16:
+	if (value.length >= sizeof(uint16_t))
+	    appendUInt64(out, loadValue<uint16_t>(value));
+	return;
+    case RSCP::eTypeInt32:
+    case RSCP::eTypeError:
+	if (value.length >= sizeof(int32_t))
+	    appendInt64(out, loadValue<int32_t>(value));
+	return;
+    case RSCP::eTypeUInt32:
+	if (value.length >= sizeof(uint32_t))
+	    appendUInt64(out, loadValue<uint32_t>(value));
+	return;
+    case RSCP::eTypeInt64:
+	if (value.length >= sizeof(int64_t))
+	    appendInt64(out, loadValue<int64_t>(value));
+	return;
+    case RSCP::eTypeUInt64:
+	if (value.length >= sizeof(uint64_t))
+	    appendUInt64(out, loadValue<uint64_t>(value));
+	return;
+    case RSCP::eTypeFloat32:
+	if (value.length >= sizeof(float))
+	    out.append(buffer, snprintf(buffer, sizeof(buffer), "%.9g", loadValue<float>(value)));
+	return;
+    case RSCP::eTypeDouble64:
+	if (value.length >= sizeof(double))
+	    out.append(buffer, snprintf(buffer, sizeof(buffer), "%.17g", loadValue<double>(value)));
+	return;
+    case RSCP::eTypeTimestamp:
+	if (value.length >= sizeof(SRscpTimestamp)) {
+	    SRscpTimestamp timestamp = loadValue<SRscpTimestamp>(value);
+	    out.append(buffer, snprintf(buffer, sizeof(buffer), "%llu.%09u",
+		(unsigned long long) timestamp.seconds, timestamp.nanoseconds));
+	}
+	return;
+    case RSCP::eTypeString:
+	out.push_back('"');
+	for (uint16_t i = 0; i < value.length; i++) {
+	    if (value.data[i] == '"')
+		out.push_back('"');
+	    out.push_back(value.data[i]);
+	}
+	out.push_back('"');
+	return;
+    case RSCP::eTypeByteArray: {
+	static const char digits[] = "0123456789abcdef";
+	for (uint16_t i = 0; i < value.length; i++) {
+	    out.push_back(digits[value.data[i] >> 4]);
+	    out.push_back(digits[value.data[i] & 0x0F]);
+	}
+	return;
+    }
+    default:
+	return;
+    }
+}
+
+/*
+ * \brief Write the selected leaves below \var walker, \var bSelected is set if an enclosing container was selected.
+ */
+static void decodeValues(SDecodeChunk & chunk, RscpWalker & walker, const SRscpCaptureRecord & record,
+    uint32_t container, bool bSelected, int depth)
+{
+    SRscpValueRef value;
+    while (walker.next(value)) {
+	bool bOutput = bSelected || isSelected(value.tag);
+	if (value.dataType == RSCP::eTypeContainer) {
+	    // the length of every child is bounded by its parent, the depth only guards the stack
+	    if (depth < 32) {
+		RscpWalker children = RscpWalker::children(value);
+		decodeValues(chunk, children, record, value.tag, bOutput, depth + 1);
+	    }
+	    continue;
+	}
+	if (!bOutput)
+	    continue;
+	if (decode_config.format == DECODE_FORMAT_BINARY) {
+	    SDecodeRecord out;
+	    double number;
+	    if (!RscpWalker::asDouble(value, number))
+		continue;
+	    out.value = number;
+	    out.timestamp = record.timestamp;
+	    out.tag = value.tag;
+	    out.container = container;
+	    chunk.output.append((const char *) &out, sizeof(out));
+	}
+	else {
+	    std::string & out = chunk.output;
+	    appendUInt64(out, record.timestamp);
+	    out.append(record.direction == RSCP_CAPTURE_TX ? ",tx," : ",rx,");
+	    appendHex32(out, container);
+	    out.push_back(',');
+	    appendHex32(out, value.tag);
+	    out.push_back(',');
+	    appendUInt64(out, value.dataType);
+	    out.push_back(',');
+	    appendCsvValue(out, value);
+	    out.push_back('\n');
+	}
+	chunk.stats.values++;
+    }
+}
+
+static void decodeChunk(RscpProtocol & protocol, SDecodeChunk & chunk)
+{
+    memset(&chunk.stats, 0, sizeof(chunk.stats));
+    chunk.output.reserve((chunk.end - chunk.begin) * (decode_config.format == DECODE_FORMAT_CSV ? 2 : 1));
+
+    const uint8_t *p = chunk.begin;
+    while (p < chunk.end) {
+	SRscpCaptureRecord record;
+	memcpy(&record, p, sizeof(record));
+	const uint8_t *data = p + sizeof(record);
+	p = data + record.length;
+	chunk.stats.records++;
+
+	if ((record.flags & (RSCP_CAPTURE_ENCRYPTED | RSCP_CAPTURE_INVALID))
+	    || ((decode_config.direction != DECODE_DIRECTION_ALL) && (record.direction != decode_config.direction))) {
+	    chunk.stats.skipped++;
+	    continue;
+	}
+	// a record normally holds exactly one frame, more than one is accepted as well
+	uint32_t uOffset = 0;
+	while (uOffset < record.length) {
+	    int32_t iFrameLength = protocol.validateFrame(data + uOffset, record.length - uOffset);
+	    if (iFrameLength < 0) {
+		chunk.stats.invalid++;
+		break;
+	    }
+	    RscpWalker walker = RscpWalker::frame(data + uOffset, iFrameLength);
+	    decodeValues(chunk, walker, record, 0, false, 0);
+	    if (walker.error())
+		chunk.stats.invalid++;
+	    chunk.stats.frames++;
+	    uOffset += iFrameLength;
+	}
+    }
+}
+
+static void decodeWorker(size_t window)
+{
+    RscpProtocol protocol;
+    while (true) {
+	size_t index = nextChunk.fetch_add(1);
+	if (index >= chunks.size())
+	    return;
+	{
+	    // bound the memory of decoded chunks which wait for their turn
+	    std::unique_lock<std::mutex> lock(chunkMutex);
+	    chunkWritten.wait(lock, [&] { return index < writtenChunks + window; });
+	}
+	decodeChunk(protocol, chunks[index]);
+	{
+	    std::lock_guard<std::mutex> lock(chunkMutex);
+	    chunks[index].done = true;
+	}
+	chunkDone.notify_all();
+    }
+}
+
+/*
+ * \brief Split the records between \var begin and \var end into chunks, only the record headers are read.
+ * @return - number of bytes behind the last complete record
+ */
+static size_t splitChunks(const uint8_t *begin, const uint8_t *end)
+{
+    const uint8_t *p = begin;
+    const uint8_t *chunkBegin = begin;
+    while ((size_t) (end - p) >= sizeof(SRscpCaptureRecord)) {
+	SRscpCaptureRecord record;
+	memcpy(&record, p, sizeof(record));
+	if (record.length > (size_t) (end - p) - sizeof(record))
+	    break;
+	p += sizeof(record) + record.length;
+	if (p - chunkBegin >= DECODE_CHUNK_SIZE) {
+	    chunks.push_back(SDecodeChunk());
+	    chunks.back().begin = chunkBegin;
+	    chunks.back().end = p;
+	    chunkBegin = p;
+	}
+    }
+    if (p > chunkBegin) {
+	chunks.push_back(SDecodeChunk());
+	chunks.back().begin = chunkBegin;
+	chunks.back().end = p;
+    }
+    for (size_t i = 0; i < chunks.size(); i++)
+	chunks[i].done = false;
+    return end - p;
+}
+
+static bool parseTag(const char *arg)
+{
+    char *end = NULL;
+    unsigned long tag = strtoul(arg, &end, 0);
+    if (end == arg || *end != '\0' || tag > 0xFFFFFFFFUL)
+	return false;
+    decode_config.tags.push_back(tag);
+    return true;
+}
+
+static bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+	ssize_t written = write(fd, data, length);
+	if (written < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+	data += written;
+	length -= written;
+    }
+    return true;
+}
+
+void showhelp(char *prog)
+{
+    printf("Usage:\n");
+    printf("%s [-hq] [-t tag]... [-f csv|bin] [-d rx|tx|all] [-j threads] [-o output] capture\n", prog);
+    printf("  --help, -h         \tshows this help\n");
+    printf("  --tag, -t          \tselect a tag (hex or decimal), all leaves of a selected container are written,\n");
+    printf("                     \tall values if not set\n");
+    printf("  --format, -f       \tcsv (default): timestamp_ns,direction,container,tag,type,value\n");
+    printf("                     \tbin: packed records of u64 timestamp_ns, u32 tag, u32 container, double value\n");
+    printf("  --direction, -d    \tdecode received (rx, default), sent (tx) or all frames\n");
+    printf("  --threads, -j      \tdecoder threads (default number of cores)\n");
+    printf("  --output, -o       \toutput file (default stdout)\n");
+    printf("  --quiet, -q        \tdo not print the statistics to stderr\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    const char *output = NULL;
+
+    decode_config.format = DECODE_FORMAT_CSV;
+    decode_config.threads = std::thread::hardware_concurrency();
+    decode_config.direction = RSCP_CAPTURE_RX;
+    decode_config.quiet = 0;
+
+    while (1) {
+	static struct option long_options[] = {
+	    {"help",		no_argument,		0, 'h'},
+	    {"tag",		required_argument,	0, 't'},
+	    {"format",		required_argument,	0, 'f'},
+	    {"direction",	required_argument,	0, 'd'},
+	    {"threads",		required_argument,	0, 'j'},
+	    {"output",		required_argument,	0, 'o'},
+	    {"quiet",		no_argument,		0, 'q'},
+	    {0,			0,			0, 0 }
+	};
+	int option_index = 0;
+	opt = getopt_long(argc, argv, "ht:f:d:j:o:q", long_options, &option_index);
+
+	if(opt == -1)
+	    break;
+
+	switch (opt) {
+	case 'h':
+	    showhelp(argv[0]);
+	    return 0;
+	case 't':
+	    if (!parseTag(optarg)) {
+		fprintf(stderr, "Invalid tag %s\n", optarg);
+		return -1;
+	    }
+	    break;
+	case 'f':
+	    if (strcmp(optarg, "csv") == 0)
+		decode_config.format = DECODE_FORMAT_CSV;
+	    else if (strcmp(optarg, "bin") == 0)
+		decode_config.format = DECODE_FORMAT_BINARY;
+	    else {
+		fprintf(stderr, "Invalid format %s\n", optarg);
+		return -1;
+	    }
+	    break;
+	case 'd':
+	    if (strcmp(optarg, "rx") == 0)
+		decode_config.direction = RSCP_CAPTURE_RX;
+	    else if (strcmp(optarg, "tx") == 0)
+		decode_config.direction = RSCP_CAPTURE_TX;
+	    else if (strcmp(optarg, "all") == 0)
+		decode_config.direction = DECODE_DIRECTION_ALL;
+	    else {
+		fprintf(stderr, "Invalid direction %s\n", optarg);
+		return -1;
+	    }
+	    break;
+	case 'j':
+	    decode_config.threads = atoi(optarg);
+	    break;
+	case 'o':
+	    output = optarg;
+	    break;
+	case 'q':
+	    decode_config.quiet = 1;
+	    break;
+	default:
+	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
+	    break;
+	}
+    }
+    if (optind != argc - 1) {
+	showhelp(argv[0]);
+	return -1;
+    }
+    if (decode_config.threads < 1)
+	decode_config.threads = 1;
+    std::sort(decode_config.tags.begin(), decode_config.tags.end());
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+	fprintf(stderr, "Cannot open capture file %s\n", argv[optind]);
+	return -1;
+    }
+    size_t size = st.st_size;
+    SRscpCaptureHeader header;
+    if (size < sizeof(header)) {
+	fprintf(stderr, "%s is not a capture file\n", argv[optind]);
+	return -1;
+    }
+    const uint8_t *file = (const uint8_t *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+	fprintf(stderr, "Cannot map capture file %s. errno %i\n", argv[optind], errno);
+	return -1;
+    }
+    madvise((void *) file, size, MADV_SEQUENTIAL);
+    memcpy(&header, file, sizeof(header));
+    if (memcmp(header.magic, RSCP_CAPTURE_MAGIC, sizeof(RSCP_CAPTURE_MAGIC)) != 0
+	|| header.version != RSCP_CAPTURE_VERSION
+	|| header.recordSize != sizeof(SRscpCaptureRecord)
+	|| header.headerSize < sizeof(SRscpCaptureHeader)
+	|| header.headerSize > size) {
+	fprintf(stderr, "%s is not a capture file\n", argv[optind]);
+	return -1;
+    }
+
+    int out = STDOUT_FILENO;
+    if (output != NULL) {
+	out = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out < 0) {
+	    fprintf(stderr, "Cannot create output file %s\n", output);
+	    return -1;
+	}
+    }
+
+    size_t truncated = splitChunks(file + header.headerSize, file + size);
+    if (decode_config.format == DECODE_FORMAT_CSV) {
+	const char *title = "timestamp_ns,direction,container,tag,type,value\n";
+	writeAll(out, title, strlen(title));
+    }
+
+    size_t window = (size_t) decode_config.threads * DECODE_WINDOW_PER_THREAD;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < decode_config.threads; i++)
+	workers.push_back(std::thread(decodeWorker, window));
+
+    // write the chunks in capture order as soon as each one is decoded
+    SDecodeStats total;
+    memset(&total, 0, sizeof(total));
+    bool bWriteError = false;
+    for (size_t i = 0; i < chunks.size(); i++) {
+	{
+	    std::unique_lock<std::mutex> lock(chunkMutex);
+	    chunkDone.wait(lock, [&] { return chunks[i].done; });
+	}
+	SDecodeChunk & chunk = chunks[i];
+	if (!bWriteError && !writeAll(out, chunk.output.data(), chunk.output.size())) {
+	    fprintf(stderr, "Cannot write output. errno %i\n", errno);
+	    bWriteError = true;
+	}
+	total.records += chunk.stats.records;
+	total.frames += chunk.stats.frames;
+	total.values += chunk.stats.values;
+	total.invalid += chunk.stats.invalid;
+	total.skipped += chunk.stats.skipped;
+	std::string().swap(chunk.output);
+	{
+	    std::lock_guard<std::mutex> lock(chunkMutex);
+	    writtenChunks = i + 1;
+	}
+	chunkWritten.notify_all();
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+	workers[i].join();
+    if (out != STDOUT_FILENO)
+	close(out);
+    munmap((void *) file, size);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    if (!decode_config.quiet) {
+	fprintf(stderr, "records %llu, frames %llu, values %llu, invalid %llu, skipped %llu\n",
+	    (unsigned long long) total.records, (unsigned long long) total.frames,
+	    (unsigned long long) total.values, (unsigned long long) total.invalid,
+	    (unsigned long long) total.skipped);
+	if (truncated > 0)
+	    fprintf(stderr, "ignored %zu bytes of a truncated record at the end\n", truncated);
+	fprintf(stderr, "%zu bytes in %.3f s with %i threads, %.1f MB/s\n", size, seconds,
+	    decode_config.threads, seconds > 0 ? size / seconds / 1e6 : 0.0);
+    }
+    return bWriteError ? -1 : 0;
+}
@@ -0,0 +1,406 @@
+/*
+ * RscpEnergy.cpp
+ *
+ * Daily energy counters integrated from the EMS power values.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "RscpEnergy.h"
+#include "RscpTags.h"
+
+#define NS_PER_SECOND		1000000000LL
+
+static const char *counterNames[ENERGY_COUNTERS] = { "pv", "bat_in", "bat_out", "home", "grid_in", "grid_out" };
+
+RscpEnergy::RscpEnergy() :
+	m_lastCheckpoint(0), m_bDirty(false) {
+	memset(&m_checkpoint, 0, sizeof(m_checkpoint));
+}
+
+bool RscpEnergy::open(const char *path) {
+	close();
+	memset(&m_checkpoint, 0, sizeof(m_checkpoint));
+	FILE *file = fopen(path, "rb");
+	if(file != NULL) {
+		size_t uRead = fread(&m_checkpoint, 1, sizeof(m_checkpoint), file);
+		fclose(file);
+		if((uRead != sizeof(m_checkpoint)) || (memcmp(m_checkpoint.magic, RSCP_ENERGY_MAGIC, sizeof(m_checkpoint.magic)) != 0)
+			|| (m_checkpoint.version != RSCP_ENERGY_VERSION) || (m_checkpoint.size != sizeof(m_checkpoint))) {
+			printf("%s is no energy checkpoint\n", path);
+			memset(&m_checkpoint, 0, sizeof(m_checkpoint));
+			return false;
+		}
+	}
+	else if(errno != ENOENT) {
+		printf("Cannot read energy checkpoint %s. errno %i\n", path, errno);
+		return false;
+	}
+	strcpy(m_checkpoint.magic, RSCP_ENERGY_MAGIC);
+	m_checkpoint.version = RSCP_ENERGY_VERSION;
+	m_checkpoint.size = sizeof(m_checkpoint);
+	m_path = path;
+	m_pending.clear();
+	m_lastCheckpoint = time(NULL);
+	return true;
+}
+
+void RscpEnergy::close() {
+	if(enabled()) {
+		checkpoint(time(NULL), true);
+	}
+	m_path.clear();
+	m_pending.clear();
+}
+
+int RscpEnergy::source(SRscpTag tag) {
+	switch(tag) {
+	case TAG_EMS_POWER_PV:
+		return ENERGY_SOURCE_PV;
+	case TAG_EMS_POWER_BAT:
+		return ENERGY_SOURCE_BAT;
+	case TAG_EMS_POWER_HOME:
+		return ENERGY_SOURCE_HOME;
+	case TAG_EMS_POWER_GRID:
+		return ENERGY_SOURCE_GRID;
+	default:
+		return -1;
+	}
+}
+
+int32_t RscpEnergy::localDay(int64_t time, int64_t *start, int64_t *end) {
+	time_t t = time;
+	struct tm tm;
+	localtime_r(&t, &tm);
+	int32_t id = (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+	dayBounds(id, start, end);
+	return id;
+}
+
+bool RscpEnergy::dayBounds(int32_t id, int64_t *start, int64_t *end) {
+	// mktime normalizes the day behind the end of a month and handles the daylight saving changes
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = id / 10000 - 1900;
+	tm.tm_mon = id / 100 % 100 - 1;
+	tm.tm_mday = id % 100;
+	tm.tm_isdst = -1;
+	time_t t = mktime(&tm);
+	if(t == (time_t) -1) {
+		return false;
+	}
+	if(start != NULL) {
+		*start = t;
+	}
+	tm.tm_year = id / 10000 - 1900;
+	tm.tm_mon = id / 100 % 100 - 1;
+	tm.tm_mday = id % 100 + 1;
+	tm.tm_hour = 0;
+	tm.tm_min = 0;
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+	t = mktime(&tm);
+	if(end != NULL) {
+		*end = t;
+	}
+	return t != (time_t) -1;
+}
+
+const SRscpEnergyDay *RscpEnergy::find(int32_t id) const {
+	for(int i = 0; i < ENERGY_DAYS; i++) {
+		if(m_checkpoint.days[i].day == id) {
+			return &m_checkpoint.days[i];
+		}
+	}
+	return NULL;
+}
+
+SRscpEnergyDay *RscpEnergy::day(int32_t id) {
+	SRscpEnergyDay *oldest = NULL;
+	for(int i = 0; i < ENERGY_DAYS; i++) {
+		SRscpEnergyDay & entry = m_checkpoint.days[i];
+		if(entry.day == id) {
+			return &entry;
+		}
+		if((oldest == NULL) || (entry.day < oldest->day)) {
+			oldest = &entry;
+		}
+	}
+	// a day older than all kept days is dropped instead of replacing a newer one
+	if((oldest->day != 0) && (oldest->day > id)) {
+		return NULL;
+	}
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->day = id;
+	return oldest;
+}
+
+void RscpEnergy::addPower(SRscpTag tag, double power, int64_t time) {
+	int s = source(tag);
+	if(!enabled() || (s < 0)) {
+		return;
+	}
+	// the checkpoint is packed, its fields are copied instead of referenced
+	int64_t lastTime = m_checkpoint.lastTime[s];
+	if(lastTime != 0) {
+		int64_t delta = time - lastTime;
+		if(delta == 0) {
+			// the same value of the same frame
+			return;
+		}
+		if(delta > ENERGY_MAX_GAP * NS_PER_SECOND) {
+			// only the part of the gap on the day of the sample is counted
+			int64_t start;
+			SRscpEnergyDay *entry = day(localDay(time / NS_PER_SECOND, &start, NULL));
+			if(entry != NULL) {
+				int64_t dayDelta = time - start * NS_PER_SECOND;
+				entry->gaps[s] += (double) ((delta < dayDelta) ? delta : dayDelta) / NS_PER_SECOND;
+			}
+		}
+		else if(delta > 0) {
+			integrate(s, lastTime, m_checkpoint.lastPower[s], time, power);
+		}
+		// a clock set back starts a new trapezoid
+	}
+	m_checkpoint.lastTime[s] = time;
+	m_checkpoint.lastPower[s] = power;
+	m_bDirty = true;
+}
+
+void RscpEnergy::integrate(int source, int64_t t0, double p0, int64_t t1, double p1) {
+	while(t0 < t1) {
+		int64_t end;
+		int32_t id = localDay(t0 / NS_PER_SECOND, NULL, &end);
+		int64_t endNs = end * NS_PER_SECOND;
+		SRscpEnergyDay *entry = day(id);
+		if(t1 <= endNs) {
+			if(entry != NULL) {
+				entry->covered[source] += (double) (t1 - t0) / NS_PER_SECOND;
+				addEnergy(source, id, (double) (t1 - t0) / NS_PER_SECOND, p0, p1);
+			}
+			return;
+		}
+		// the power at midnight is interpolated, both days get their part of the trapezoid
+		double pm = p0 + (p1 - p0) * (double) (endNs - t0) / (double) (t1 - t0);
+		if(entry != NULL) {
+			entry->covered[source] += (double) (endNs - t0) / NS_PER_SECOND;
+			addEnergy(source, id, (double) (endNs - t0) / NS_PER_SECOND, p0, pm);
+		}
+		t0 = endNs;
+		p0 = pm;
+	}
+}
+
+void RscpEnergy::addEnergy(int source, int32_t id, double seconds, double p0, double p1) {
+	SRscpEnergyDay *entry = day(id);
+	if(entry == NULL) {
+		return;
+	}
+	// a trapezoid crossing zero is split, the parts go to the counters of both directions
+	if(((p0 > 0.0) && (p1 < 0.0)) || ((p0 < 0.0) && (p1 > 0.0))) {
+		double s0 = seconds * p0 / (p0 - p1);
+		addEnergy(source, id, s0, p0, 0.0);
+		addEnergy(source, id, seconds - s0, 0.0, p1);
+		return;
+	}
+	double wh = (p0 + p1) / 2.0 * seconds / 3600.0;
+	switch(source) {
+	case ENERGY_SOURCE_PV:
+		entry->energy[ENERGY_PV] += wh;
+		break;
+	case ENERGY_SOURCE_HOME:
+		entry->energy[ENERGY_HOME] += wh;
+		break;
+	case ENERGY_SOURCE_BAT:
+		entry->energy[(wh >= 0.0) ? ENERGY_BAT_IN : ENERGY_BAT_OUT] += fabs(wh);
+		break;
+	case ENERGY_SOURCE_GRID:
+		entry->energy[(wh >= 0.0) ? ENERGY_GRID_IN : ENERGY_GRID_OUT] += fabs(wh);
+		break;
+	}
+}
+
+uint32_t RscpEnergy::createHistoryRequests(RscpBuilder & builder, int64_t now) {
+	// responses of an earlier cycle which did not arrive are not expected any more
+	m_pending.clear();
+	if(!enabled()) {
+		return 0;
+	}
+	int64_t start, end;
+	int32_t today = localDay(now, &start, &end);
+	int64_t previousStart, previousEnd;
+	int32_t previous = localDay(start - 1, &previousStart, &previousEnd);
+	const SRscpEnergyDay *entry = find(previous);
+	if((entry == NULL) || (entry->reconciled < previousEnd)) {
+		m_pending.push_back(previous);
+	}
+	entry = find(today);
+	if((entry == NULL) || (now - entry->reconciled >= ENERGY_RECONCILE_SECONDS)) {
+		m_pending.push_back(today);
+	}
+	for(size_t i = 0; i < m_pending.size(); i++) {
+		dayBounds(m_pending[i], &start, &end);
+		builder.open(TAG_DB_REQ_HISTORY_DATA_DAY);
+		SRscpTimestamp timestamp = { (uint64_t) start, 0 };
+		builder.add(TAG_DB_REQ_HISTORY_TIME_START, timestamp);
+		// one interval over the whole day, its sum is the day sum
+		timestamp.seconds = end - start;
+		builder.add(TAG_DB_REQ_HISTORY_TIME_INTERVAL, timestamp);
+		builder.add(TAG_DB_REQ_HISTORY_TIME_SPAN, timestamp);
+		builder.close();
+	}
+	return m_pending.size();
+}
+
+int32_t RscpEnergy::handleHistory(const SRscpValueRef & value, int64_t now) {
+	if(!enabled() || m_pending.empty()) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	int32_t id = m_pending.front();
+	m_pending.pop_front();
+
+	SRscpValueRef sums;
+	bool bFound = false;
+	RscpWalker walker = RscpWalker::children(value);
+	while(!bFound && walker.next(sums)) {
+		bFound = (sums.tag == TAG_DB_SUM_CONTAINER);
+	}
+	if(!bFound) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	double unit[ENERGY_COUNTERS];
+	memset(unit, 0, sizeof(unit));
+	SRscpValueRef sum;
+	walker = RscpWalker::children(sums);
+	while(walker.next(sum)) {
+		int counter;
+		switch(sum.tag) {
+		case TAG_DB_DC_POWER:
+			counter = ENERGY_PV;
+			break;
+		case TAG_DB_BAT_POWER_IN:
+			counter = ENERGY_BAT_IN;
+			break;
+		case TAG_DB_BAT_POWER_OUT:
+			counter = ENERGY_BAT_OUT;
+			break;
+		case TAG_DB_CONSUMPTION:
+			counter = ENERGY_HOME;
+			break;
+		case TAG_DB_GRID_POWER_IN:
+			counter = ENERGY_GRID_IN;
+			break;
+		case TAG_DB_GRID_POWER_OUT:
+			counter = ENERGY_GRID_OUT;
+			break;
+		default:
+			continue;
+		}
+		if(!RscpWalker::asDouble(sum, unit[counter])) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+	}
+	SRscpEnergyDay *entry = day(id);
+	if(entry != NULL) {
+		memcpy(entry->unit, unit, sizeof(unit));
+		entry->reconciled = now;
+		m_bDirty = true;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpEnergy::checkpoint(int64_t now, bool bForce) {
+	if(!enabled() || !m_bDirty || (!bForce && (now - m_lastCheckpoint < ENERGY_CHECKPOINT_SECONDS))) {
+		return RSCP::OK;
+	}
+	// the new checkpoint replaces the old one only when it is complete
+	std::string temporary = m_path + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if(file == NULL) {
+		printf("Cannot write energy checkpoint %s. errno %i\n", temporary.c_str(), errno);
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	bool bWritten = (fwrite(&m_checkpoint, sizeof(m_checkpoint), 1, file) == 1);
+	bWritten = (fclose(file) == 0) && bWritten;
+	if(!bWritten || (rename(temporary.c_str(), m_path.c_str()) != 0)) {
+		printf("Cannot write energy checkpoint %s. errno %i\n", m_path.c_str(), errno);
+		remove(temporary.c_str());
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	m_lastCheckpoint = now;
+	m_bDirty = false;
+	return RSCP::OK;
+}
+
+void RscpEnergy::print(FILE *file, uint32_t days) const {
+	std::vector<const SRscpEnergyDay *> sorted;
+	for(int i = 0; i < ENERGY_DAYS; i++) {
+		if(m_checkpoint.days[i].day != 0) {
+			sorted.push_back(&m_checkpoint.days[i]);
+		}
+	}
+	// newest days first, a selection sort is enough for the few entries
+	for(size_t i = 0; i < sorted.size(); i++) {
+		for(size_t j = i + 1; j < sorted.size(); j++) {
+			if(sorted[j]->day > sorted[i]->day) {
+				std::swap(sorted[i], sorted[j]);
+			}
+		}
+	}
+	if(sorted.size() > days) {
+		sorted.resize(days);
+	}
+	fprintf(file, "%-10s %-9s", "# day", "[kWh]");
+	for(int c = 0; c < ENERGY_COUNTERS; c++) {
+		fprintf(file, " %9s", counterNames[c]);
+	}
+	fprintf(file, " %9s %9s\n", "covered", "gaps");
+	for(size_t i = 0; i < sorted.size(); i++) {
+		const SRscpEnergyDay & entry = *sorted[i];
+		double covered = entry.covered[0];
+		double gaps = 0.0;
+		for(int s = 0; s < ENERGY_SOURCES; s++) {
+			if(entry.covered[s] < covered) {
+				covered = entry.covered[s];
+			}
+			if(entry.gaps[s] > gaps) {
+				gaps = entry.gaps[s];
+			}
+		}
+		fprintf(file, "%-10i %-9s", entry.day, "local");
+		for(int c = 0; c < ENERGY_COUNTERS; c++) {
+			fprintf(file, " %9.3f", entry.energy[c] / 1000.0);
+		}
+		fprintf(file, " %8.2fh %8.2fh\n", covered / 3600.0, gaps / 3600.0);
+		if(entry.reconciled == 0) {
+			continue;
+		}
+		fprintf(file, "%-10s %-9s", "", "unit");
+		for(int c = 0; c < ENERGY_COUNTERS; c++) {
+			fprintf(file, " %9.3f", entry.unit[c] / 1000.0);
+		}
+		fprintf(file, "\n");
+		// the deviation is only meaningful if the samples cover the time of the unit sums
+		int64_t start, end;
+		dayBounds(entry.day, &start, &end);
+		int64_t expected = ((entry.reconciled < end) ? entry.reconciled : end) - start;
+		bool bComplete = covered >= expected - ENERGY_MAX_GAP;
+		bool bCheck = false;
+		fprintf(file, "%-10s %-9s", "", "diff [%]");
+		for(int c = 0; c < ENERGY_COUNTERS; c++) {
+			if(entry.unit[c] > 0.0) {
+				double deviation = (entry.energy[c] - entry.unit[c]) * 100.0 / entry.unit[c];
+				bCheck = bCheck || (fabs(deviation) > ENERGY_TOLERANCE);
+				fprintf(file, " %+9.1f", deviation);
+			}
+			else {
+				fprintf(file, " %9s", "-");
+			}
+		}
+		fprintf(file, " %9s\n", !bComplete ? "partial" : (bCheck ? "check" : "ok"));
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ * RscpEnergy.h
+ *
+ * Daily energy counters integrated from the EMS power values. Each power sample is paired with
+ * the previous one of the same value by the frame timestamp of the unit and the trapezoid between
+ * them is added to the counter of its local day, split at midnight and at the zero crossing of the
+ * battery and grid power. Samples further apart than the maximum gap are not integrated, the time
+ * between them is counted as gap of the day. The last sample and the counters of the recent days
+ * are kept in a small checkpoint file, so a process polling once a minute continues the trapezoids
+ * of the previous run. The counters are reconciled with the day sums of TAG_DB_REQ_HISTORY_DATA_DAY.
+ */
+
+#ifndef RSCPENERGY_H_
+#define RSCPENERGY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+#include "RscpWalker.h"
+
+#define RSCP_ENERGY_MAGIC			"RSCPNRG"
+#define RSCP_ENERGY_VERSION			1
+// days kept in the checkpoint, older days are dropped
+#define ENERGY_DAYS					62
+// samples further apart in seconds are not integrated
+#define ENERGY_MAX_GAP				300
+// the checkpoint is written at most this often in seconds and when closed
+#define ENERGY_CHECKPOINT_SECONDS	60
+// the sums of the current day are fetched again after this many seconds
+#define ENERGY_RECONCILE_SECONDS	3600
+// deviation in percent of a completely covered day which is reported
+#define ENERGY_TOLERANCE			2.0
+
+enum eRscpEnergySources {
+	ENERGY_SOURCE_PV		= 0,	// TAG_EMS_POWER_PV
+	ENERGY_SOURCE_BAT,				// TAG_EMS_POWER_BAT, positive while charging
+	ENERGY_SOURCE_HOME,				// TAG_EMS_POWER_HOME
+	ENERGY_SOURCE_GRID,				// TAG_EMS_POWER_GRID, positive while importing
+	ENERGY_SOURCES
+};
+
+enum eRscpEnergyCounters {
+	ENERGY_PV				= 0,	// TAG_DB_DC_POWER
+	ENERGY_BAT_IN,					// TAG_DB_BAT_POWER_IN
+	ENERGY_BAT_OUT,					// TAG_DB_BAT_POWER_OUT
+	ENERGY_HOME,					// TAG_DB_CONSUMPTION
+	ENERGY_GRID_IN,					// TAG_DB_GRID_POWER_IN, taken from the grid
+	ENERGY_GRID_OUT,				// TAG_DB_GRID_POWER_OUT, fed into the grid
+	ENERGY_COUNTERS
+};
+
+struct SRscpEnergyDay {
+	int32_t day;					// local date as YYYYMMDD, 0 for an unused entry
+	uint32_t reserved;
+	double energy[ENERGY_COUNTERS];	// integrated Wh
+	double covered[ENERGY_SOURCES];	// seconds integrated
+	double gaps[ENERGY_SOURCES];	// seconds between samples further apart than the maximum gap
+	double unit[ENERGY_COUNTERS];	// Wh of the day sums of the unit
+	int64_t reconciled;				// CLOCK_REALTIME in seconds of the last day sums, 0 if none
+} __attribute__((packed));
+
+struct SRscpEnergyCheckpoint {
+	char magic[8];					// RSCP_ENERGY_MAGIC including the terminating zero
+	uint16_t version;				// RSCP_ENERGY_VERSION
+	uint16_t size;					// sizeof(SRscpEnergyCheckpoint)
+	uint32_t reserved;
+	int64_t lastTime[ENERGY_SOURCES];	// frame time of the last sample in nanoseconds, 0 if none
+	double lastPower[ENERGY_SOURCES];	// W
+	SRscpEnergyDay days[ENERGY_DAYS];
+} __attribute__((packed));
+
+class RscpEnergy {
+public:
+	RscpEnergy();
+	/*
+	 * \brief Use the checkpoint file \var path, an existing one is loaded.
+	 * @return - false if the file exists but cannot be read or is no checkpoint
+	 */
+	bool open(const char *path);
+	/*
+	 * \brief Write the checkpoint and stop integrating.
+	 */
+	void close();
+	bool enabled() const {
+		return !m_path.empty();
+	}
+	/*
+	 * \brief Source of a power value tag, -1 for other tags.
+	 */
+	static int source(SRscpTag tag);
+	/*
+	 * \brief Integrate the power \var value of a TAG_EMS_POWER_* tag up to \var time.
+	 * @param time - frame timestamp, CLOCK_REALTIME in nanoseconds
+	 */
+	void addPower(SRscpTag tag, double power, int64_t time);
+	/*
+	 * \brief Append one TAG_DB_REQ_HISTORY_DATA_DAY per day whose sums are due: the current day every
+	 *        ENERGY_RECONCILE_SECONDS and the previous day once after it ended.
+	 * @param now - CLOCK_REALTIME in seconds
+	 * @return    - number of requested days
+	 */
+	uint32_t createHistoryRequests(RscpBuilder & builder, int64_t now);
+	/*
+	 * \brief Store the sums of a TAG_DB_HISTORY_DATA_DAY response for the oldest requested day.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT if no day was requested or the response has no sums
+	 */
+	int32_t handleHistory(const SRscpValueRef & value, int64_t now);
+	/*
+	 * \brief Write the checkpoint if it changed and ENERGY_CHECKPOINT_SECONDS passed or \var bForce is set.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT if the file cannot be written
+	 */
+	int32_t checkpoint(int64_t now, bool bForce);
+	/*
+	 * \brief Print the counters of the last \var days days and their deviation from the unit sums.
+	 */
+	void print(FILE *file, uint32_t days) const;
+	/*
+	 * \brief Local date YYYYMMDD of \var time and the start of the day and the next one in seconds.
+	 */
+	static int32_t localDay(int64_t time, int64_t *start, int64_t *end);
+private:
+	SRscpEnergyDay *day(int32_t id);
+	const SRscpEnergyDay *find(int32_t id) const;
+	static bool dayBounds(int32_t id, int64_t *start, int64_t *end);
+	void integrate(int source, int64_t t0, double p0, int64_t t1, double p1);
+	void addEnergy(int source, int32_t id, double seconds, double p0, double p1);
+
+	std::string m_path;
+	SRscpEnergyCheckpoint m_checkpoint;
+	std::deque<int32_t> m_pending;	// days of the sent history requests in request order
+	int64_t m_lastCheckpoint;
+	bool m_bDirty;
+};
+
+#endif /* RSCPENERGY_H_ */
@@ -0,0 +1,417 @@
+/*
+ * RscpFleet.cpp
+ *
+ * Fan-out of one command to many E3DC units.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <thread>
+#include <chrono>
+#include "RscpFleet.h"
+#include "RscpWalker.h"
+#include "RscpTags.h"
+#include "SocketConnection.h"
+
+RscpFleet::RscpFleet() :
+	m_iParallel(FLEET_DEFAULT_PARALLEL), m_iTimeoutMs(RECEIVE_TIMEOUT_MS), m_uElapsed(0), m_uNext(0),
+	m_iInProgress(0) {
+}
+
+RscpFleet::~RscpFleet() {
+	for(size_t i = 0; i < m_units.size(); i++) {
+		delete m_units[i].session;
+	}
+}
+
+int32_t RscpFleet::load(const char *path, const e3dc_config_t & defaults) {
+	FILE *fp = fopen(path, "r");
+	if(fp == NULL) {
+		return -1;
+	}
+	char line[1024];
+	while(fgets(line, sizeof(line), fp)) {
+		char *comment = strchr(line, '#');
+		if(comment != NULL) {
+			*comment = '\0';
+		}
+		char host[128], port[16], user[128], password[128], aesPassword[128];
+		int iFields = sscanf(line, "%127s %15s %127s %127s %127s", host, port, user, password, aesPassword);
+		if(iFields <= 0) {
+			continue;
+		}
+		SRscpFleetUnit unit;
+		memset(&unit, 0, sizeof(unit));
+		unit.config = defaults;
+		unit.iSocket = -1;
+		strcpy(unit.config.server_ip, host);
+		if(iFields > 1) {
+			unit.config.server_port = atoi(port);
+		}
+		if(iFields > 2) {
+			strcpy(unit.config.e3dc_user, user);
+		}
+		if(iFields > 3) {
+			strcpy(unit.config.e3dc_password, password);
+		}
+		if(iFields > 4) {
+			strcpy(unit.config.aes_password, aesPassword);
+		}
+		m_units.push_back(unit);
+	}
+	fclose(fp);
+	return m_units.size();
+}
+
+uint32_t RscpFleet::run(RscpAuthFrameBuilder authBuilder, const SRscpFrameBuffer & command, int parallel, int timeoutMs) {
+	m_iParallel = (parallel < 1) ? 1 : parallel;
+	m_iTimeoutMs = timeoutMs;
+	m_uNext = 0;
+	m_iInProgress = 0;
+	m_connected.clear();
+
+	// one authentication frame per distinct user and password
+	for(size_t i = 0; i < m_units.size(); i++) {
+		SRscpFleetUnit & unit = m_units[i];
+		size_t j = 0;
+		while((j < i) && ((strcmp(m_units[j].config.e3dc_user, unit.config.e3dc_user) != 0)
+			|| (strcmp(m_units[j].config.e3dc_password, unit.config.e3dc_password) != 0))) {
+			j++;
+		}
+		if(j < i) {
+			unit.uAuthFrame = m_units[j].uAuthFrame;
+		}
+		else {
+			SRscpFrameBuffer frame;
+			memset(&frame, 0, sizeof(frame));
+			authBuilder(&frame, &unit.config);
+			unit.uAuthFrame = m_authFrames.size();
+			m_authFrames.push_back(frame);
+		}
+	}
+
+	uint64_t uStart = RscpStats::now();
+	uint64_t uTimeout = m_iTimeoutMs * 1000000ULL;
+	size_t threadCount = (m_units.size() < (size_t) m_iParallel) ? m_units.size() : m_iParallel;
+	std::vector<std::thread> connectors;
+	for(size_t i = 0; i < threadCount; i++) {
+		connectors.push_back(std::thread(&RscpFleet::connector, this));
+	}
+
+	std::vector<uint32_t> active;
+	size_t finished = 0;
+	while(finished < m_units.size()) {
+		std::vector<uint32_t> connected;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if(active.empty() && m_connected.empty()) {
+				m_condition.wait_for(lock, std::chrono::milliseconds(FLEET_TICK_MS));
+			}
+			connected.swap(m_connected);
+		}
+		for(size_t i = 0; i < connected.size(); i++) {
+			SRscpFleetUnit & unit = m_units[connected[i]];
+			if(unit.iSocket < 0) {
+				finish(unit, FLEET_FAILED, "connect", unit.iSocket);
+				finished++;
+				continue;
+			}
+			startSession(unit);
+			if(unit.state == FLEET_FAILED) {
+				finished++;
+			}
+			else {
+				active.push_back(connected[i]);
+			}
+		}
+		if(active.empty()) {
+			continue;
+		}
+
+		SSocketCompletion completions[FLEET_MAX_COMPLETIONS];
+		int iCount = SocketSubmit(completions, FLEET_MAX_COMPLETIONS, FLEET_TICK_MS);
+		if(iCount > 0) {
+			RscpSession::dispatch(completions, iCount, handleFrame, NULL);
+		}
+		for(size_t i = 0; i < active.size();) {
+			SRscpFleetUnit & unit = m_units[active[i]];
+			if((iCount < 0) && (iCount != -EINTR)) {
+				finish(unit, FLEET_FAILED, "transport", iCount);
+			}
+			else {
+				advance(unit, command, uTimeout);
+			}
+			if((unit.state == FLEET_DONE) || (unit.state == FLEET_FAILED)) {
+				active[i] = active.back();
+				active.pop_back();
+				finished++;
+			}
+			else {
+				i++;
+			}
+		}
+	}
+	for(size_t i = 0; i < connectors.size(); i++) {
+		connectors[i].join();
+	}
+	m_uElapsed = RscpStats::now() - uStart;
+
+	RscpProtocol protocol;
+	for(size_t i = 0; i < m_authFrames.size(); i++) {
+		protocol.destroyFrameData(m_authFrames[i]);
+	}
+	m_authFrames.clear();
+
+	uint32_t uFailed = 0;
+	for(size_t i = 0; i < m_units.size(); i++) {
+		if((m_units[i].state != FLEET_DONE) || (m_units[i].uErrors > 0)) {
+			uFailed++;
+		}
+	}
+	return uFailed;
+}
+
+void RscpFleet::connector() {
+	for(;;) {
+		uint32_t uIndex;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while((m_uNext < m_units.size()) && (m_iInProgress >= m_iParallel)) {
+				m_condition.wait(lock);
+			}
+			if(m_uNext >= m_units.size()) {
+				return;
+			}
+			uIndex = m_uNext++;
+			m_iInProgress++;
+		}
+		// the unit belongs to this thread until it is handed over in m_connected
+		SRscpFleetUnit & unit = m_units[uIndex];
+		unit.state = FLEET_CONNECTING;
+		unit.uStart = RscpStats::now();
+		unit.iSocket = SocketConnect(unit.config.server_ip, unit.config.server_port, unit.config.connect_timeout, NULL);
+		unit.latency[FLEET_LATENCY_CONNECT] = RscpStats::now() - unit.uStart;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_connected.push_back(uIndex);
+		}
+		m_condition.notify_all();
+	}
+}
+
+void RscpFleet::startSession(SRscpFleetUnit & unit) {
+	m_latencies[FLEET_LATENCY_CONNECT].record(unit.latency[FLEET_LATENCY_CONNECT]);
+	unit.session = new RscpSession();
+	unit.session->user = &unit;
+	unit.session->attach(unit.iSocket);
+	unit.session->setPassword(unit.config.aes_password);
+	unit.session->setAesMode((AES::TableMode) unit.config.aes_mode);
+	unit.state = FLEET_AUTHENTICATING;
+	unit.uFrames = 0;
+	unit.uStepStart = RscpStats::now();
+	int32_t iResult = unit.session->queueFrame(m_authFrames[unit.uAuthFrame]);
+	if(iResult == RSCP::OK) {
+		iResult = unit.session->flush();
+	}
+	if(iResult == RSCP::OK) {
+		iResult = unit.session->queueReceive();
+	}
+	if(iResult < 0) {
+		finish(unit, FLEET_FAILED, "send", iResult);
+	}
+}
+
+void RscpFleet::advance(SRscpFleetUnit & unit, const SRscpFrameBuffer & command, uint64_t uTimeout) {
+	if(unit.session->lastResult() < 0) {
+		finish(unit, FLEET_FAILED, (unit.state == FLEET_AUTHENTICATING) ? "authentication" : "command",
+			unit.session->lastResult());
+		return;
+	}
+	uint64_t uNow = RscpStats::now();
+	if(unit.uFrames == 0) {
+		if(uNow - unit.uStepStart > uTimeout) {
+			finish(unit, FLEET_FAILED, "timeout", SOCKET_ERR_TIMEOUT);
+		}
+		return;
+	}
+	if(unit.state == FLEET_COMMAND) {
+		unit.latency[FLEET_LATENCY_COMMAND] = uNow - unit.uStepStart;
+		finish(unit, FLEET_DONE, NULL, 0);
+		return;
+	}
+	unit.latency[FLEET_LATENCY_AUTH] = uNow - unit.uStepStart;
+	if(unit.ucAuthLevel == 0) {
+		finish(unit, FLEET_FAILED, "authentication", 0);
+		return;
+	}
+	m_latencies[FLEET_LATENCY_AUTH].record(unit.latency[FLEET_LATENCY_AUTH]);
+	unit.state = FLEET_COMMAND;
+	unit.uFrames = 0;
+	unit.uStepStart = uNow;
+	int32_t iResult = unit.session->queueFrame(command);
+	if(iResult == RSCP::OK) {
+		iResult = unit.session->flush();
+	}
+	if(iResult == RSCP::OK) {
+		iResult = unit.session->queueReceive();
+	}
+	if(iResult < 0) {
+		finish(unit, FLEET_FAILED, "send", iResult);
+	}
+}
+
+void RscpFleet::finish(SRscpFleetUnit & unit, int state, const char *failure, int32_t iError) {
+	unit.state = state;
+	unit.failure = failure;
+	unit.iError = iError;
+	if(state == FLEET_DONE) {
+		unit.latency[FLEET_LATENCY_TOTAL] = RscpStats::now() - unit.uStart;
+		m_latencies[FLEET_LATENCY_COMMAND].record(unit.latency[FLEET_LATENCY_COMMAND]);
+		m_latencies[FLEET_LATENCY_TOTAL].record(unit.latency[FLEET_LATENCY_TOTAL]);
+	}
+	if(unit.session != NULL) {
+		unit.session->close();
+		delete unit.session;
+		unit.session = NULL;
+	}
+	unit.iSocket = -1;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_iInProgress--;
+	}
+	m_condition.notify_all();
+}
+
+int32_t RscpFleet::handleFrame(RscpSession *session, const uint8_t *data, uint32_t length, void * /* context */) {
+	RscpProtocol protocol;
+	int32_t iResult = protocol.validateFrame(data, length);
+	if(iResult < 0) {
+		// more data is needed for an incomplete frame
+		return (iResult == RSCP::ERR_INVALID_FRAME_LENGTH) ? 0 : iResult;
+	}
+	SRscpFleetUnit *unit = (SRscpFleetUnit *) session->user;
+	unit->uFrames++;
+	if(unit->state == FLEET_AUTHENTICATING) {
+		RscpWalker walker = RscpWalker::frame(data, iResult);
+		SRscpValueRef value;
+		double fLevel = 0.0;
+		while(walker.next(value)) {
+			if((value.tag == TAG_RSCP_AUTHENTICATION) && (value.dataType != RSCP::eTypeError)
+				&& RscpWalker::asDouble(value, fLevel)) {
+				unit->ucAuthLevel = (uint8_t) fLevel;
+			}
+		}
+	}
+	else {
+		countResults(*unit, data, iResult);
+	}
+	return iResult;
+}
+
+/*
+ * Count the values of the command response and the failed ones: error values, a rejected
+ * TAG_EMS_SET_IDLE_PERIODS and negative results of the power settings.
+ */
+static void countErrors(RscpWalker walker, uint32_t & uErrors) {
+	SRscpValueRef value;
+	double fValue = 0.0;
+	while(walker.next(value)) {
+		if(value.dataType == RSCP::eTypeError) {
+			uErrors++;
+		}
+		else if(value.dataType == RSCP::eTypeContainer) {
+			countErrors(RscpWalker::children(value), uErrors);
+		}
+		else if((value.tag == TAG_EMS_SET_IDLE_PERIODS) && RscpWalker::asDouble(value, fValue) && (fValue == 0.0)) {
+			uErrors++;
+		}
+		else if((value.dataType == RSCP::eTypeChar8) && RscpWalker::asDouble(value, fValue) && (fValue < 0.0)) {
+			uErrors++;
+		}
+	}
+	if(walker.error()) {
+		uErrors++;
+	}
+}
+
+void RscpFleet::countResults(SRscpFleetUnit & unit, const uint8_t *data, uint32_t length) {
+	RscpWalker walker = RscpWalker::frame(data, length);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		unit.uValues++;
+	}
+	countErrors(RscpWalker::frame(data, length), unit.uErrors);
+}
+
+const char *RscpFleet::stateName(int state) {
+	switch(state) {
+	case FLEET_WAITING:
+		return "waiting";
+	case FLEET_CONNECTING:
+		return "connecting";
+	case FLEET_AUTHENTICATING:
+		return "auth";
+	case FLEET_COMMAND:
+		return "command";
+	case FLEET_DONE:
+		return "done";
+	case FLEET_FAILED:
+		return "failed";
+	default:
+		return "unknown";
+	}
+}
+
+const char *RscpFleet::latencyName(eRscpFleetLatency latency) {
+	switch(latency) {
+	case FLEET_LATENCY_CONNECT:
+		return "connect";
+	case FLEET_LATENCY_AUTH:
+		return "auth";
+	case FLEET_LATENCY_COMMAND:
+		return "command";
+	case FLEET_LATENCY_TOTAL:
+		return "total";
+	default:
+		return "unknown";
+	}
+}
+
+void RscpFleet::print(FILE *file) const {
+	uint32_t uDone = 0, uErrors = 0, uFailed = 0;
+	fprintf(file, "%-32s %-8s %10s %10s %10s %7s %7s  %s\n", "# unit", "state", "connect ms", "auth ms",
+		"command ms", "values", "errors", "failure");
+	for(size_t i = 0; i < m_units.size(); i++) {
+		const SRscpFleetUnit & unit = m_units[i];
+		char name[160];
+		snprintf(name, sizeof(name), "%s:%i", unit.config.server_ip, unit.config.server_port);
+		fprintf(file, "%-32s %-8s %10.1f %10.1f %10.1f %7u %7u", name, stateName(unit.state),
+			unit.latency[FLEET_LATENCY_CONNECT] / 1e6, unit.latency[FLEET_LATENCY_AUTH] / 1e6,
+			unit.latency[FLEET_LATENCY_COMMAND] / 1e6, unit.uValues, unit.uErrors);
+		if(unit.state == FLEET_FAILED) {
+			if(strcmp(unit.failure, "connect") == 0) {
+				fprintf(file, "  %s: %s", unit.failure, SocketErrorString(unit.iError));
+			}
+			else {
+				fprintf(file, "  %s: %i", unit.failure, unit.iError);
+			}
+			uFailed++;
+		}
+		else if(unit.uErrors > 0) {
+			uErrors++;
+		}
+		else if(unit.state == FLEET_DONE) {
+			uDone++;
+		}
+		fprintf(file, "\n");
+	}
+	fprintf(file, "Fleet: %zu units, %u done, %u with errors, %u failed in %.3f s (%.1f units/s, %i parallel)\n",
+		m_units.size(), uDone, uErrors, uFailed, m_uElapsed / 1e9,
+		(m_uElapsed > 0) ? m_units.size() * 1e9 / m_uElapsed : 0.0, m_iParallel);
+	fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s %10s %10s\n", "# latency [us]",
+		"count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+	for(int i = 0; i < FLEET_LATENCY_COUNT; i++) {
+		m_latencies[i].print(file, latencyName((eRscpFleetLatency) i));
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * RscpFleet.h
+ *
+ * Fan-out of one command to many E3DC units. The units of an inventory file are connected by a pool
+ * of connector threads with bounded parallelism while the main thread drives all connected sessions
+ * through the batched socket transport: authentication, the command frame and its response. The
+ * command frame is built once for all units and the authentication frame once per distinct user and
+ * password, the results and latencies of all units are aggregated into one report.
+ */
+
+#ifndef RSCPFLEET_H_
+#define RSCPFLEET_H_
+
+#include <stdio.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "RscpProtocol.h"
+#include "RscpSession.h"
+#include "RscpStats.h"
+#include "e3dc_config.h"
+
+// default number of units which are connected and in progress at the same time
+#define FLEET_DEFAULT_PARALLEL		16
+#define FLEET_MAX_COMPLETIONS		256
+// transport wait per scheduler tick, connected units are picked up between ticks
+#define FLEET_TICK_MS				10
+
+enum eRscpFleetState {
+	FLEET_WAITING		= 0,	// not started yet
+	FLEET_CONNECTING,			// a connector thread is connecting
+	FLEET_AUTHENTICATING,		// authentication frame sent
+	FLEET_COMMAND,				// command frame sent
+	FLEET_DONE,					// command response received
+	FLEET_FAILED				// see SRscpFleetUnit::failure
+};
+
+enum eRscpFleetLatency {
+	FLEET_LATENCY_CONNECT	= 0,	// resolve and TCP connect
+	FLEET_LATENCY_AUTH,				// authentication request until its response
+	FLEET_LATENCY_COMMAND,			// command request until its response
+	FLEET_LATENCY_TOTAL,			// start of the connect until the command response
+	FLEET_LATENCY_COUNT
+};
+
+struct SRscpFleetUnit {
+	e3dc_config_t config;
+	int state;					// eRscpFleetState
+	int32_t iError;				// socket, session or RSCP error code of a failed unit
+	const char *failure;		// step which failed
+	int iSocket;				// connected socket handed from the connector to the main thread
+	uint8_t ucAuthLevel;
+	uint32_t uAuthFrame;		// index of the authentication frame of the credentials
+	uint32_t uFrames;			// frames received in the current step
+	uint32_t uValues;			// values of the command response
+	uint32_t uErrors;			// error values and rejected settings of the command response
+	uint64_t uStart;			// CLOCK_MONOTONIC in nanoseconds
+	uint64_t uStepStart;
+	uint64_t latency[FLEET_LATENCY_COUNT];
+	RscpSession *session;
+};
+
+/*
+ * \brief Builder of the authentication frame of \var config, see createAuthRequest() of RscpMain.
+ */
+typedef int (*RscpAuthFrameBuilder)(SRscpFrameBuffer *frameBuffer, e3dc_config_t *config);
+
+class RscpFleet {
+public:
+	RscpFleet();
+	virtual ~RscpFleet();
+	/*
+	 * \brief Read the inventory \var path, one unit per line: host [port [user [password [aes_password]]]].
+	 *        Missing columns are taken from \var defaults, # starts a comment.
+	 * @return - Number of units or -1 if the file cannot be read
+	 */
+	int32_t load(const char *path, const e3dc_config_t & defaults);
+	uint32_t size() const {
+		return m_units.size();
+	}
+	/*
+	 * \brief Send \var command to all units with at most \var parallel units in progress, each step has
+	 *        \var timeoutMs. The transport has to be initialized for \var parallel sockets.
+	 * @return - Number of failed units
+	 */
+	uint32_t run(RscpAuthFrameBuilder authBuilder, const SRscpFrameBuffer & command, int parallel, int timeoutMs);
+	/*
+	 * \brief Print one line per unit, the summary and the latency percentiles of the steps.
+	 */
+	void print(FILE *file) const;
+	const SRscpFleetUnit & unit(uint32_t index) const {
+		return m_units[index];
+	}
+	static const char *stateName(int state);
+	static const char *latencyName(eRscpFleetLatency latency);
+private:
+	RscpFleet(const RscpFleet &);
+	RscpFleet & operator=(const RscpFleet &);
+
+	void connector();
+	void startSession(SRscpFleetUnit & unit);
+	void finish(SRscpFleetUnit & unit, int state, const char *failure, int32_t iError);
+	void advance(SRscpFleetUnit & unit, const SRscpFrameBuffer & command, uint64_t uTimeout);
+	static int32_t handleFrame(RscpSession *session, const uint8_t *data, uint32_t length, void *context);
+	static void countResults(SRscpFleetUnit & unit, const uint8_t *data, uint32_t length);
+
+	std::vector<SRscpFleetUnit> m_units;
+	std::vector<SRscpFrameBuffer> m_authFrames;
+	int m_iParallel;
+	int m_iTimeoutMs;
+	uint64_t m_uElapsed;
+	// shared with the connector threads
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	uint32_t m_uNext;				// next unit to connect
+	int m_iInProgress;				// units between the start of their connect and their end
+	std::vector<uint32_t> m_connected;	// units connected (or failed to) but not yet started
+	RscpHistogram m_latencies[FLEET_LATENCY_COUNT];
+};
+
+#endif /* RSCPFLEET_H_ */
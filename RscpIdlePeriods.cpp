@@ -0,0 +1,139 @@
+/*
+ * RscpIdlePeriods.cpp
+ *
+ * Idle period schedule of an E3DC unit.
+ */
+
+#include <string.h>
+#include <strings.h>
+#include "RscpIdlePeriods.h"
+#include "RscpTags.h"
+
+static const char *dayNames[] = {
+	"monday", "tuesday", "wednesday", "thursday", "friday", "saturday", "sunday"
+};
+
+RscpIdlePeriods::RscpIdlePeriods() {
+	clear();
+}
+
+void RscpIdlePeriods::clear() {
+	memset(m_periods, 0, sizeof(m_periods));
+	memset(m_bUsed, 0, sizeof(m_bUsed));
+	m_uCount = 0;
+}
+
+bool RscpIdlePeriods::parse(const char *value, idle_period_t & period) {
+	char day[16], type[16], active[16];
+	unsigned int startHour, startMinute, stopHour, stopMinute;
+	memset(active, 0, sizeof(active));
+	int iFields = sscanf(value, "%15s %15s %u:%u-%u:%u %15s", day, type, &startHour, &startMinute,
+		&stopHour, &stopMinute, active);
+	if(iFields < 6) {
+		return false;
+	}
+	memset(&period, 0, sizeof(period));
+	period.day = 0xFF;
+	for(uint8_t i = 0; i < sizeof(dayNames) / sizeof(dayNames[0]); i++) {
+		if(strcasecmp(day, dayNames[i]) == 0) {
+			period.day = i;
+		}
+	}
+	if(strcasecmp(type, "load") == 0) {
+		period.type = LOAD;
+	}
+	else if(strcasecmp(type, "unload") == 0) {
+		period.type = UNLOAD;
+	}
+	else {
+		return false;
+	}
+	if((period.day > SUNDAY) || (startHour > 23) || (startMinute > 59) || (stopHour > 23) || (stopMinute > 59)) {
+		return false;
+	}
+	if((iFields == 7) && (strcasecmp(active, "active") != 0) && (strcasecmp(active, "inactive") != 0)) {
+		return false;
+	}
+	period.active = ((iFields == 7) && (strcasecmp(active, "inactive") == 0)) ? INACTIVE : ACTIVE;
+	period.start.hour = startHour;
+	period.start.minute = startMinute;
+	period.stop.hour = stopHour;
+	period.stop.minute = stopMinute;
+	return true;
+}
+
+bool RscpIdlePeriods::set(const idle_period_t & period) {
+	if((period.type > UNLOAD) || (period.day > SUNDAY) || (period.start.hour > 23) || (period.start.minute > 59)
+		|| (period.stop.hour > 23) || (period.stop.minute > 59)) {
+		return false;
+	}
+	uint32_t uSlot = slot(period.type, period.day);
+	if(!m_bUsed[uSlot]) {
+		m_bUsed[uSlot] = true;
+		m_uCount++;
+	}
+	m_periods[uSlot] = period;
+	return true;
+}
+
+const idle_period_t *RscpIdlePeriods::find(uint8_t type, uint8_t day) const {
+	if((type > UNLOAD) || (day > SUNDAY) || !m_bUsed[slot(type, day)]) {
+		return NULL;
+	}
+	return &m_periods[slot(type, day)];
+}
+
+bool RscpIdlePeriods::equal(const idle_period_t & a, const idle_period_t & b) {
+	// the times of an inactive period are kept by the unit, they count as well
+	return (a.type == b.type) && (a.day == b.day) && (!!a.active == !!b.active)
+		&& (a.start.hour == b.start.hour) && (a.start.minute == b.start.minute)
+		&& (a.stop.hour == b.stop.hour) && (a.stop.minute == b.stop.minute);
+}
+
+uint32_t RscpIdlePeriods::diff(const RscpIdlePeriods & wanted, RscpIdlePeriods & changes) const {
+	changes.clear();
+	for(uint32_t i = 0; i < IDLE_PERIOD_SLOTS; i++) {
+		if(wanted.m_bUsed[i] && (!m_bUsed[i] || !equal(m_periods[i], wanted.m_periods[i]))) {
+			changes.set(wanted.m_periods[i]);
+		}
+	}
+	return changes.count();
+}
+
+int32_t RscpIdlePeriods::createSet(RscpBuilder & builder) const {
+	builder.open(TAG_EMS_REQ_SET_IDLE_PERIODS);
+	for(uint32_t i = 0; i < IDLE_PERIOD_SLOTS; i++) {
+		if(!m_bUsed[i]) {
+			continue;
+		}
+		const idle_period_t & period = m_periods[i];
+		builder.open(TAG_EMS_IDLE_PERIOD);
+		builder.add(TAG_EMS_IDLE_PERIOD_TYPE, period.type);
+		builder.add(TAG_EMS_IDLE_PERIOD_DAY, period.day);
+		builder.add(TAG_EMS_IDLE_PERIOD_ACTIVE, (bool) period.active);
+		builder.open(TAG_EMS_IDLE_PERIOD_START);
+		builder.add(TAG_EMS_IDLE_PERIOD_MINUTE, period.start.minute);
+		builder.add(TAG_EMS_IDLE_PERIOD_HOUR, period.start.hour);
+		builder.close();
+		builder.open(TAG_EMS_IDLE_PERIOD_END);
+		builder.add(TAG_EMS_IDLE_PERIOD_MINUTE, period.stop.minute);
+		builder.add(TAG_EMS_IDLE_PERIOD_HOUR, period.stop.hour);
+		builder.close();
+		builder.close();
+	}
+	return builder.close();
+}
+
+void RscpIdlePeriods::printPeriod(FILE *file, const idle_period_t & period) {
+	fprintf(file, "%-9s %-6s %02u:%02u-%02u:%02u %s\n", (period.day <= SUNDAY) ? dayNames[period.day] : "unknown",
+		(period.type == LOAD) ? "load" : "unload", period.start.hour, period.start.minute, period.stop.hour,
+		period.stop.minute, period.active ? "active" : "inactive");
+}
+
+void RscpIdlePeriods::print(FILE *file) const {
+	for(uint32_t i = 0; i < IDLE_PERIOD_SLOTS; i++) {
+		if(m_bUsed[i]) {
+			printPeriod(file, m_periods[i]);
+		}
+	}
+}
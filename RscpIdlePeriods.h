@@ -0,0 +1,81 @@
+/*
+ * RscpIdlePeriods.h
+ *
+ * Idle period schedule of an E3DC unit. The unit keeps one period per day and type (charge or
+ * discharge lock), a schedule holds the periods known for these slots. The schedule of the
+ * configuration is compared with the one reported by TAG_EMS_REQ_GET_IDLE_PERIODS and only the
+ * differing periods are written with one TAG_EMS_REQ_SET_IDLE_PERIODS.
+ */
+
+#ifndef RSCPIDLEPERIODS_H_
+#define RSCPIDLEPERIODS_H_
+
+#include <stdio.h>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+#include "RscpTape.h"
+#include "e3dc_config.h"
+
+// one slot per type (LOAD, UNLOAD) and day (MONDAY..SUNDAY)
+#define IDLE_PERIOD_SLOTS			(2 * 7)
+
+class RscpIdlePeriods {
+public:
+	RscpIdlePeriods();
+	/*
+	 * \brief Remove all periods.
+	 */
+	void clear();
+	/*
+	 * \brief Parse the value of an idle_period configuration line like "tuesday load 11:00-12:42",
+	 *        an optional "inactive" keeps the times but disables the period.
+	 * @return - true if \var period was filled
+	 */
+	static bool parse(const char *value, idle_period_t & period);
+	/*
+	 * \brief Store \var period in the slot of its type and day, replacing an earlier period.
+	 * @return - false if type, day or times are out of range
+	 */
+	bool set(const idle_period_t & period);
+	/*
+	 * \brief Period of the slot, NULL if the schedule has none for it.
+	 */
+	const idle_period_t *find(uint8_t type, uint8_t day) const;
+	uint32_t count() const {
+		return m_uCount;
+	}
+	/*
+	 * \brief Collect the periods of \var wanted which differ from this schedule or are missing in it.
+	 * @return - Number of periods in \var changes
+	 */
+	uint32_t diff(const RscpIdlePeriods & wanted, RscpIdlePeriods & changes) const;
+	/*
+	 * \brief Append one TAG_EMS_REQ_SET_IDLE_PERIODS container with all periods of the schedule.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createSet(RscpBuilder & builder) const;
+	static bool equal(const idle_period_t & a, const idle_period_t & b);
+	/*
+	 * \brief Print one line per period.
+	 */
+	void print(FILE *file) const;
+	static void printPeriod(FILE *file, const idle_period_t & period);
+	/*
+	 * \brief Index of the TAG_EMS_GET_IDLE_PERIODS response the schedule is read from. It keeps its
+	 *        capacity, so the next response is indexed without allocation. clear() does not reset it.
+	 */
+	RscpTape & tape() {
+		return m_tape;
+	}
+private:
+	static uint32_t slot(uint8_t type, uint8_t day) {
+		return type * 7 + day;
+	}
+
+	idle_period_t m_periods[IDLE_PERIOD_SLOTS];
+	bool m_bUsed[IDLE_PERIOD_SLOTS];
+	uint32_t m_uCount;
+	RscpTape m_tape;
+};
+
+#endif /* RSCPIDLEPERIODS_H_ */
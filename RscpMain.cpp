@@ -2,58 +2,116 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <getopt.h>
+#include <time.h>
+#include <signal.h>
+#include <string.h>
 #include <unistd.h>
+#include <thread>
 #include "e3dc_config.h"
 #include "RscpProtocol.h"
 #include "RscpTags.h"
 #include "SocketConnection.h"
-#include "AES.h"
-
-static int iSocket = -1;
+#include "RscpSession.h"
+#include "RscpCapture.h"
+#include "RscpStats.h"
+#include "RscpTagPath.h"
+#include "RscpBatteryScan.h"
+#include "RscpPviScan.h"
+#include "RscpPowerMeter.h"
+#include "RscpWallbox.h"
+#include "RscpIdlePeriods.h"
+#include "RscpFleet.h"
+#include "RscpConfig.h"
+#include "RscpRuntime.h"
+#include "RscpRollup.h"
+#include "RscpEnergy.h"
+#include "RscpAlarms.h"
+#include "RscpValue.h"
+#include "RscpTape.h"
+#include "RscpBuilder.h"
+
+static RscpSession session;
+// encoder of the request frames, it keeps its buffer so the polls of the loops need no allocation
+static RscpBuilder requestBuilder;
+static RscpCapture capture;
 static int iAuthenticated = 0;
-static AES aesEncrypter;
-static AES aesDecrypter;
-static uint8_t ucEncryptionIV[AES_BLOCK_SIZE];
-static uint8_t ucDecryptionIV[AES_BLOCK_SIZE];
+static RscpStats stats;
+// destination of the statistics, "-" for stderr, NULL if disabled
+static const char *statsPath = NULL;
+static volatile sig_atomic_t bDumpStats = 0;
+// set by SIGINT and SIGTERM, the loops stop and the files of --rollup and --energy are closed regularly
+static volatile sig_atomic_t bStopRequested = 0;
+// tag paths of --get and --file, their responses are printed by name
+static RscpTagRequest tagRequest;
+// batteries and DCBs found at session start, filled with the cell values of --cells
+static RscpBatteryScan batteryScan;
+// inverters with their strings, phases and sensors found at session start, values of --pvi
+static RscpPviScan pviScan;
+// power meter samples of --pm and the stop flag of their consumer thread
+static RscpPowerMeter powerMeter;
+static bool bPmConsumerStop = false;
+// surplus charging control of --wallbox
+static RscpWallbox wallbox;
+// idle periods of the configuration and the last TAG_EMS_GET_IDLE_PERIODS response
+static RscpIdlePeriods idleSchedule;
+static RscpIdlePeriods idleCurrent;
+// downsampled values of --rollup
+static RscpRollup rollup;
+// daily energy counters of --energy
+static RscpEnergy energy;
+// threshold alarms of the configuration
+static RscpAlarms alarms;
+// timestamp of the frame whose values are handled, CLOCK_REALTIME in nanoseconds
+static int64_t frameTime = 0;
+
+// maximum charge and discharge power in W of --limits
+static uint32_t uMaxChargePower = 0;
+static uint32_t uMaxDischargePower = 0;
+
+static void handleStatsSignal(int /* signal */)
+{
+    bDumpStats = 1;
+}
+
+static void dumpStats()
+{
+    bDumpStats = 0;
+    if (statsPath == NULL)
+	return;
+    if (strcmp(statsPath, "-") == 0)
+	stats.dump(stderr);
+    else if (!stats.dumpToFile(statsPath))
+	printf("Cannot write statistics to %s\n", statsPath);
+}
 
 int createAuthRequest(SRscpFrameBuffer * frameBuffer, e3dc_config_t *e3dc_config)
 {
     RscpProtocol protocol;
-    SRscpValue rootValue;
-    // The root container is create with the TAG ID 0 which is not used by any device.
-    protocol.createContainerValue(&rootValue, 0);
+    // the values of the frame are the children of the root container, it has no header of its own
+    requestBuilder.clear();
 
     //---------------------------------------------------------------------------------------------------------
     // Create a auth request frame
     //---------------------------------------------------------------------------------------------------------
     printf("\nRequest authentication\n");
     // authentication request
-    SRscpValue authenContainer;
-    protocol.createContainerValue(&authenContainer,
-				  TAG_RSCP_REQ_AUTHENTICATION);
-    protocol.appendValue(&authenContainer, TAG_RSCP_AUTHENTICATION_USER,
-			 e3dc_config->e3dc_user);
-    protocol.appendValue(&authenContainer,
-			 TAG_RSCP_AUTHENTICATION_PASSWORD, e3dc_config->e3dc_password);
-    // append sub-container to root container
-    protocol.appendValue(&rootValue, authenContainer);
-    // free memory of sub-container as it is now copied to rootValue
-    protocol.destroyValueData(authenContainer);
+    requestBuilder.open(TAG_RSCP_REQ_AUTHENTICATION);
+    requestBuilder.add(TAG_RSCP_AUTHENTICATION_USER, e3dc_config->e3dc_user);
+    requestBuilder.add(TAG_RSCP_AUTHENTICATION_PASSWORD, e3dc_config->e3dc_password);
+    requestBuilder.close();
+    if (requestBuilder.error() < 0)
+	return requestBuilder.error();
 
     // create buffer frame to send data to the S10
-    protocol.createFrameAsBuffer(frameBuffer, rootValue.data, rootValue.length, true);	// true to calculate CRC on for transfer
-    // the root value object should be destroyed after the data is copied into the frameBuffer and is not needed anymore
-    protocol.destroyValueData(rootValue);
+    protocol.createFrameAsBuffer(frameBuffer, requestBuilder.data(), requestBuilder.length(), true);	// true to calculate CRC on for transfer
 
     return 0;
 }
 
-int createRequest(SRscpFrameBuffer * frameBuffer, int requests)
+int createRequest(RscpBuilder & builder, int requests)
 {
-    RscpProtocol protocol;
-    SRscpValue rootValue;
-    // The root container is create with the TAG ID 0 which is not used by any device.
-    protocol.createContainerValue(&rootValue, 0);
+    // the values of the frame are the children of the root container, it has no header of its own
+    builder.clear();
 
     //---------------------------------------------------------------------------------------------------------
     // Create a request frame
@@ -62,220 +120,140 @@ int createRequest(SRscpFrameBuffer * frameBuffer, int requests)
 
     // request power data information
     if (requests & TAG_EMS) {
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_PV);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_BAT);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_HOME);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_GRID);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_ADD);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_GET_POWER_SETTINGS);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_STATUS);
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_MODE);
+	builder.add(TAG_EMS_REQ_POWER_PV);
+	builder.add(TAG_EMS_REQ_POWER_BAT);
+	builder.add(TAG_EMS_REQ_POWER_HOME);
+	builder.add(TAG_EMS_REQ_POWER_GRID);
+	builder.add(TAG_EMS_REQ_POWER_ADD);
+	builder.add(TAG_EMS_REQ_GET_POWER_SETTINGS);
+	builder.add(TAG_EMS_REQ_STATUS);
+	builder.add(TAG_EMS_REQ_MODE);
+    }
+
+    // the powers of the energy counters and the day sums of the unit to reconcile them
+    if (requests & TAG_ENERGY) {
+	if (!(requests & TAG_EMS)) {
+	    builder.add(TAG_EMS_REQ_POWER_PV);
+	    builder.add(TAG_EMS_REQ_POWER_BAT);
+	    builder.add(TAG_EMS_REQ_POWER_HOME);
+	    builder.add(TAG_EMS_REQ_POWER_GRID);
+	}
+	energy.createHistoryRequests(builder, time(NULL));
+    }
+
+    // request the tag paths of the command line and the request file
+    if (requests & TAG_PATHS) {
+	int iResult = tagRequest.build(builder);
+	if (iResult < 0)
+	    printf("Cannot build the requested tag paths. Error %i\n", iResult);
+    }
+
+    // request the cell voltages and temperatures of all discovered batteries
+    if (requests & TAG_BATTERY_CELLS) {
+	batteryScan.createScan(builder);
+    }
+
+    // request the string, phase and temperature values of all discovered inverters
+    if (requests & TAG_PVI) {
+	pviScan.createScan(builder);
     }
 
     // request idle periods information
     if (requests & TAG_GET_IDLE_PERIODS) {
-	protocol.appendValue(&rootValue, TAG_EMS_REQ_GET_IDLE_PERIODS);
+	builder.add(TAG_EMS_REQ_GET_IDLE_PERIODS);
     }
 
     // request battery information
     if (requests & TAG_BATTERY) {
-	SRscpValue batteryContainer;
-	protocol.createContainerValue(&batteryContainer, TAG_BAT_REQ_DATA);
-	protocol.appendValue(&batteryContainer, TAG_BAT_INDEX, (uint8_t) 0);
-	protocol.appendValue(&batteryContainer, TAG_BAT_REQ_RSOC);
-	protocol.appendValue(&batteryContainer, TAG_BAT_REQ_MODULE_VOLTAGE);
-	protocol.appendValue(&batteryContainer, TAG_BAT_REQ_CURRENT);
-	protocol.appendValue(&batteryContainer, TAG_BAT_REQ_STATUS_CODE);
-	protocol.appendValue(&batteryContainer, TAG_BAT_REQ_ERROR_CODE);
-	// append sub-container to root container
-	protocol.appendValue(&rootValue, batteryContainer);
-	// free memory of sub-container as it is now copied to rootValue
-	protocol.destroyValueData(batteryContainer);
+	builder.open(TAG_BAT_REQ_DATA);
+	builder.add(TAG_BAT_INDEX, (uint8_t) 0);
+	builder.add(TAG_BAT_REQ_RSOC);
+	builder.add(TAG_BAT_REQ_MODULE_VOLTAGE);
+	builder.add(TAG_BAT_REQ_CURRENT);
+	builder.add(TAG_BAT_REQ_STATUS_CODE);
+	builder.add(TAG_BAT_REQ_ERROR_CODE);
+	// the container gets its length when it is closed
+	builder.close();
     }
 
     // request some more power data information
-    if (requests & TAG_WEATHER_ENABLE) {
-	SRscpValue powerContainer;
-	uint8_t enable = !!(requests & TAG_WEATHER_ENABLE_F);
-	protocol.createContainerValue(&powerContainer,
-				      TAG_EMS_REQ_SET_POWER_SETTINGS);
-	protocol.appendValue(&powerContainer,
-			     TAG_EMS_WEATHER_REGULATED_CHARGE_ENABLED,
-			     enable);
-	protocol.appendValue(&rootValue, powerContainer);
-	protocol.destroyValueData(powerContainer);
-    }
-
-    // request setting idle periods
-    // this is WIP and some example values are hardcoded for now
-    // this is not useable for productive environments atm
-    if (requests & TAG_SET_IDLE_PERIODS) {
-	SRscpValue setTimeContainer;
-	protocol.createContainerValue(&setTimeContainer,
-				      TAG_EMS_REQ_SET_IDLE_PERIODS);
-
-	    SRscpValue setDayContainer;
-	    protocol.createContainerValue(&setDayContainer,
-					  TAG_EMS_IDLE_PERIOD);
-	    protocol.appendValue(&setDayContainer,
-				 TAG_EMS_IDLE_PERIOD_TYPE, (uint8_t)LOAD);
-	    protocol.appendValue(&setDayContainer,
-				 TAG_EMS_IDLE_PERIOD_DAY, (uint8_t)TUESDAY);
-	    protocol.appendValue(&setDayContainer,
-				 TAG_EMS_IDLE_PERIOD_ACTIVE, (bool)ACTIVE);
-
-		SRscpValue setStartContainer;
-		protocol.createContainerValue(&setStartContainer,
-					  TAG_EMS_IDLE_PERIOD_START);
-		protocol.appendValue(&setStartContainer,
-				 TAG_EMS_IDLE_PERIOD_MINUTE, (uint8_t)00);
-		protocol.appendValue(&setStartContainer,
-				 TAG_EMS_IDLE_PERIOD_HOUR, (uint8_t)11);
-		protocol.appendValue(&setDayContainer, setStartContainer);
-		protocol.destroyValueData(setStartContainer);
-
-		SRscpValue setStopContainer;
-		protocol.createContainerValue(&setStopContainer,
-					  TAG_EMS_IDLE_PERIOD_END);
-		protocol.appendValue(&setStopContainer,
-				 TAG_EMS_IDLE_PERIOD_MINUTE, (uint8_t)42);
-		protocol.appendValue(&setStopContainer,
-				 TAG_EMS_IDLE_PERIOD_HOUR, (uint8_t)12);
-		protocol.appendValue(&setDayContainer, setStopContainer);
-		protocol.destroyValueData(setStopContainer);
-
-	    protocol.appendValue(&setTimeContainer, setDayContainer);
-	    protocol.destroyValueData(setDayContainer);
-
-	protocol.appendValue(&rootValue, setTimeContainer);
-	protocol.destroyValueData(setTimeContainer);
+    if (requests & (TAG_WEATHER_ENABLE | TAG_POWER_LIMITS)) {
+	builder.open(TAG_EMS_REQ_SET_POWER_SETTINGS);
+	if (requests & TAG_WEATHER_ENABLE) {
+	    uint8_t enable = !!(requests & TAG_WEATHER_ENABLE_F);
+	    builder.add(TAG_EMS_WEATHER_REGULATED_CHARGE_ENABLED, enable);
+	}
+	if (requests & TAG_POWER_LIMITS) {
+	    builder.add(TAG_EMS_POWER_LIMITS_USED, true);
+	    builder.add(TAG_EMS_MAX_CHARGE_POWER, uMaxChargePower);
+	    builder.add(TAG_EMS_MAX_DISCHARGE_POWER, uMaxDischargePower);
+	}
+	builder.close();
     }
 
-    // create buffer frame to send data to the S10
-    protocol.createFrameAsBuffer(frameBuffer, rootValue.data, rootValue.length, true);	// true to calculate CRC on for transfer
-    // the root value object should be destroyed after the data is copied into the frameBuffer and is not needed anymore
-    protocol.destroyValueData(rootValue);
+    // the whole configured schedule, only the fleet mode sends it unchanged (see syncIdlePeriods())
+    if (requests & TAG_SET_IDLE_PERIODS) {
+	idleSchedule.createSet(builder);
+    }
 
+    // the frame is created from the data of the builder, see RscpSession::queueValue()
+    if (builder.error() < 0) {
+	printf("Cannot build the request. Error %i\n", builder.error());
+	return builder.error();
+    }
     return 0;
 }
 
 int
-handleResponseEMSGetIdlePeriods(RscpProtocol * protocol,
-				SRscpValue * emsData,
+handleResponseEMSGetIdlePeriods(const RscpTape & tape,
+				int32_t period,
 				idle_period_t *periods)
 {
     // check each idle periods sub tag
-    switch (emsData->tag) {
+    switch (tape.node(period).tag) {
     case TAG_EMS_IDLE_PERIOD:{
-	    std::vector < SRscpValue > idleData =
-		protocol->getValueAsContainer(emsData);
 	    // check each idle period sub tag
-	    for (size_t j = 0; j < idleData.size(); ++j) {
-		if (idleData[j].dataType == RSCP::eTypeError) {
+	    for (int32_t j = tape.firstChild(period); j >= 0; j = tape.next(j)) {
+		const SRscpTapeNode & idleData = tape.node(j);
+		if (idleData.dataType == RSCP::eTypeError) {
 		    // handle error for example access denied errors
-		    uint32_t uiErrorCode =
-			protocol->getValueAsUInt32(&idleData[j]);
+		    uint32_t uiErrorCode = tape.get<uint32_t>(j);
 		    printf("Tag 0x%08X received error code %u.\n",
-			   idleData[j].tag, uiErrorCode);
+			   idleData.tag, uiErrorCode);
 		    return -1;
 		}
-		switch (idleData[j].tag) {
+		switch (idleData.tag) {
 		case TAG_EMS_IDLE_PERIOD_TYPE:{
-			periods->type = protocol->getValueAsUChar8(&idleData[j]);
+			periods->type = tape.get<uint8_t>(j);
 			break;
 		    }
 		case TAG_EMS_IDLE_PERIOD_DAY:{
-			periods->day = protocol->getValueAsUChar8(&idleData[j]);
+			periods->day = tape.get<uint8_t>(j);
 			break;
 		    }
 		case TAG_EMS_IDLE_PERIOD_ACTIVE:{
-			periods->active = protocol->getValueAsUChar8(&idleData[j]);
-			break;
-		    }
-		case TAG_EMS_IDLE_PERIOD_START:{
-			std::vector < SRscpValue >
-			    periodData =
-			    protocol->getValueAsContainer(&idleData[j]);
-			// check each idle period start sub tag
-			for (size_t k = 0; k < periodData.size(); ++k) {
-			    if (periodData[k].dataType == RSCP::eTypeError) {
-				// handle error for example access denied errors
-				uint32_t
-				    uiErrorCode =
-				    protocol->getValueAsUInt32(&periodData
-							       [k]);
-				printf
-				    ("Tag 0x%08X received error code %u.\n",
-				     periodData[k].tag, uiErrorCode);
-				return -1;
-			    }
-			    switch (periodData[k].tag) {
-			    case TAG_EMS_IDLE_PERIOD_HOUR:{
-				    periods->start.hour =
-					protocol->getValueAsUChar8
-					(&periodData[k]);
-				    break;
-				}
-			    case TAG_EMS_IDLE_PERIOD_MINUTE:{
-				    periods->start.minute =
-					protocol->getValueAsUChar8
-					(&periodData[k]);
-				    break;
-				}
-			    default:
-				// default behaviour
-				uint8_t unknown =
-				    protocol->getValueAsUChar8(&periodData
-							       [k]);
-				printf("Unknown period tag %08X -> %i.\n",
-				       periodData[k].tag, unknown);
-				break;
-			    }
-			}
+			periods->active = tape.get<uint8_t>(j);
 			break;
 		    }
+		case TAG_EMS_IDLE_PERIOD_START:
 		case TAG_EMS_IDLE_PERIOD_END:{
-			std::vector < SRscpValue >
-			    periodData =
-			    protocol->getValueAsContainer(&idleData[j]);
-			// check each idle period stop sub tag
-			for (size_t k = 0; k < periodData.size(); ++k) {
-			    if (periodData[k].dataType == RSCP::eTypeError) {
-				// handle error for example access denied errors
-				uint32_t
-				    uiErrorCode =
-				    protocol->getValueAsUInt32(&periodData
-							       [k]);
-				printf
-				    ("Tag 0x%08X received error code %u.\n",
-				     periodData[k].tag, uiErrorCode);
-				return -1;
-			    }
-			    switch (periodData[k].tag) {
-			    case TAG_EMS_IDLE_PERIOD_HOUR:{
-				    periods->stop.hour =
-					protocol->getValueAsUChar8
-					(&periodData[k]);
-				    break;
-				}
-			    case TAG_EMS_IDLE_PERIOD_MINUTE:{
-				    periods->stop.minute =
-					protocol->getValueAsUChar8
-					(&periodData[k]);
-				    break;
-				}
-			    default:
-				// default behaviour
-				uint8_t unknown =
-				    protocol->getValueAsUChar8(&periodData
-							       [k]);
-				printf("Unknown period tag %08X -> %i.\n",
-				       periodData[k].tag, unknown);
-				break;
-			    }
+			// hour and minute are looked up on the tape instead of parsing the time container
+			idle_time_t *time = (idleData.tag == TAG_EMS_IDLE_PERIOD_START) ? &periods->start : &periods->stop;
+			int32_t hour = tape.child(j, TAG_EMS_IDLE_PERIOD_HOUR);
+			int32_t minute = tape.child(j, TAG_EMS_IDLE_PERIOD_MINUTE);
+			if ((hour < 0) || (minute < 0) || (tape.node(hour).dataType == RSCP::eTypeError)
+			    || (tape.node(minute).dataType == RSCP::eTypeError)) {
+			    printf("Tag 0x%08X has no valid hour and minute.\n", idleData.tag);
+			    return -1;
 			}
+			time->hour = tape.get<uint8_t>(hour);
+			time->minute = tape.get<uint8_t>(minute);
 			break;
 		    }
+		default:
+		    // default behaviour
+		    printf("Unknown period tag %08X -> %i.\n", idleData.tag, tape.get<uint8_t>(j));
+		    break;
 		}
 	    }
 	    // print idle periods summary
@@ -318,34 +296,33 @@ handleResponseEMSGetIdlePeriods(RscpProtocol * protocol,
 	}
     default:
 	// default behaviour
-	uint8_t unknown = protocol->getValueAsUChar8(emsData);
-	printf("Unknown ems tag %08X -> %i.\n", emsData->tag, unknown);
+	uint8_t unknown = tape.get<uint8_t>(period);
+	printf("Unknown ems tag %08X -> %i.\n", tape.node(period).tag, unknown);
 	break;
     }
-    protocol->destroyValueData(emsData);
+    return 0;
 }
 
 int
-handleResponseBatData(RscpProtocol * protocol,
-		      SRscpValue * batteryData)
+handleResponseBatData(const RscpValue & batteryData)
 {
     uint8_t ucBatteryIndex = 0;
     // check each battery sub tag
-    switch (batteryData->tag) {
+    switch (batteryData.tag()) {
     case TAG_BAT_INDEX:{
-	ucBatteryIndex = protocol->getValueAsUChar8(batteryData);
+	ucBatteryIndex = batteryData.get<uint8_t>();
 	printf("Battery Index is %i\n", ucBatteryIndex);
 	break;
     }
     case TAG_BAT_RSOC:{
 	// response for TAG_BAT_REQ_RSOC
-	float fSOC = protocol->getValueAsFloat32(batteryData);
+	float fSOC = batteryData.get<float>();
 	printf("Battery SOC is %0.1f %%\n", fSOC);
 	break;
     }
     case TAG_BAT_MODULE_VOLTAGE:{
 	// response for TAG_BAT_REQ_MODULE_VOLTAGE
-	float fVoltage = protocol->getValueAsFloat32(batteryData);
+	float fVoltage = batteryData.get<float>();
 	printf("Battery total voltage is %0.1f V\n",
 	       fVoltage);
 	break;
@@ -353,14 +330,14 @@ handleResponseBatData(RscpProtocol * protocol,
     case TAG_BAT_CURRENT:{
 	// response for TAG_BAT_REQ_CURRENT
 	float fVoltage =
-	    protocol->getValueAsFloat32(batteryData);
+	    batteryData.get<float>();
 	printf("Battery current is %0.1f A\n", fVoltage);
 	break;
     }
     case TAG_BAT_STATUS_CODE:{
 	// response for TAG_BAT_REQ_STATUS_CODE
 	uint32_t uiErrorCode =
-	    protocol->getValueAsUInt32(batteryData);
+	    batteryData.get<uint32_t>();
 	printf("Battery status code is 0x%08X\n",
 	       uiErrorCode);
 	break;
@@ -368,23 +345,82 @@ handleResponseBatData(RscpProtocol * protocol,
     case TAG_BAT_ERROR_CODE:{
 	// response for TAG_BAT_REQ_ERROR_CODE
 	uint32_t uiErrorCode =
-	    protocol->getValueAsUInt32(batteryData);
+	    batteryData.get<uint32_t>();
 	printf("Battery error code is 0x%08X\n",
 	       uiErrorCode);
 	break;
     }
     default:
 	uint8_t unknown =
-    protocol->getValueAsUChar8(batteryData);
-    printf("Unknown battery tag %08X -> %i\n", batteryData->tag, unknown);
+    batteryData.get<uint8_t>();
+    printf("Unknown battery tag %08X -> %i\n", batteryData.tag(), unknown);
     break;
     }
+    return 0;
 }
 
 
 int handleResponseValue(RscpProtocol * protocol, SRscpValue * response,
 			int *isAuthRequest)
 {
+    // every numeric value is downsampled with the frame time of the unit, so a replay fills the buckets
+    // of the capture, including the values decoded by the scans below
+    if (rollup.enabled() && (response->tag != TAG_RSCP_AUTHENTICATION)) {
+	SRscpValueRef value = { response->tag, response->dataType, response->length, response->data };
+	rollup.addValue(value, frameTime / 1000000000LL);
+    }
+    if (alarms.enabled()) {
+	SRscpValueRef value = { response->tag, response->dataType, response->length, response->data };
+	alarms.handleValue(value, frameTime / 1000000000LL);
+    }
+    // the EMS powers are integrated with the frame time of the unit
+    if (energy.enabled()) {
+	if ((RscpEnergy::source(response->tag) >= 0) && (response->dataType != RSCP::eTypeError))
+	    energy.addPower(response->tag, protocol->getValueAsInt32(response), frameTime);
+	else if (response->tag == TAG_DB_HISTORY_DATA_DAY) {
+	    SRscpValueRef history = { response->tag, response->dataType, response->length, response->data };
+	    if (energy.handleHistory(history, time(NULL)) != RSCP::OK)
+		printf("Invalid history day sums\n");
+	    return 0;
+	}
+	energy.checkpoint(time(NULL), false);
+    }
+    // battery data of the discovery and the cell scan is decoded in place, errors of missing batteries
+    // are part of the discovery, the battery data of --battery goes to its handler below
+    if (batteryScan.enabled() && (response->tag == TAG_BAT_DATA)) {
+	SRscpValueRef batteryData = { response->tag, response->dataType, response->length, response->data };
+	if (!batteryScan.discovered() || RscpBatteryScan::isScanData(batteryData)) {
+	    if (batteryScan.handleBatteryData(batteryData) != RSCP::OK) {
+		printf("Invalid battery data\n");
+		return -1;
+	    }
+	    return 0;
+	}
+    }
+    if (wallbox.enabled() && RscpWallbox::accepts(response->tag)) {
+	SRscpValueRef value = { response->tag, response->dataType, response->length, response->data };
+	if (wallbox.handleValue(value) != RSCP::OK) {
+	    printf("Invalid wallbox value 0x%08X\n", response->tag);
+	    return -1;
+	}
+	return 0;
+    }
+    if (powerMeter.enabled() && (response->tag == TAG_PM_DATA)) {
+	SRscpValueRef pmData = { response->tag, response->dataType, response->length, response->data };
+	if (powerMeter.handlePmData(pmData, RscpStats::now()) != RSCP::OK) {
+	    printf("Invalid power meter data\n");
+	    return -1;
+	}
+	return 0;
+    }
+    if (pviScan.enabled() && (response->tag == TAG_PVI_DATA)) {
+	SRscpValueRef inverterData = { response->tag, response->dataType, response->length, response->data };
+	if (pviScan.handleInverterData(inverterData) != RSCP::OK) {
+	    printf("Invalid inverter data\n");
+	    return -1;
+	}
+	return 0;
+    }
     // check if any of the response has the error flag set and react accordingly
     if (response->dataType == RSCP::eTypeError) {
 	// handle error for example access denied errors
@@ -393,6 +429,11 @@ int handleResponseValue(RscpProtocol * protocol, SRscpValue * response,
 	       response->tag, uiErrorCode);
 	return -1;
     }
+    // responses of tag path requests are printed generically
+    if (!tagRequest.empty() && (response->tag != TAG_RSCP_AUTHENTICATION)) {
+	RscpTagRequest::print(stdout, *protocol, *response);
+	return 0;
+    }
     // check the SRscpValue TAG to detect which response it is
     switch (response->tag) {
     case TAG_RSCP_AUTHENTICATION:{
@@ -439,75 +480,86 @@ int handleResponseValue(RscpProtocol * protocol, SRscpValue * response,
 	}
     case TAG_BAT_DATA:{
 	    // response for TAG_REQ_BAT_DATA
-	    std::vector < SRscpValue > batteryData =
-		protocol->getValueAsContainer(response);
-	    for (size_t i = 0; i < batteryData.size(); ++i) {
-		if (batteryData[i].dataType == RSCP::eTypeError) {
+	    // the values are read in place, malformed data is rejected before any value is handled
+	    if (RscpWalker::count(response->data, response->length) < 0) {
+		printf("Invalid battery data\n");
+		return -1;
+	    }
+	    RscpWalker walker(response->data, response->length);
+	    SRscpValueRef child;
+	    while (walker.next(child)) {
+		RscpValue batteryValue = RscpValue::borrow(child);
+		if (batteryValue.dataType() == RSCP::eTypeError) {
 		    // handle error for example access denied errors
 		    uint32_t uiErrorCode =
-			protocol->getValueAsUInt32(&batteryData[i]);
+			batteryValue.get<uint32_t>();
 		    printf("Tag 0x%08X received error code %u.\n",
-			   batteryData[i].tag, uiErrorCode);
+			   batteryValue.tag(), uiErrorCode);
 		    return -1;
 		}
-		handleResponseBatData(protocol, &batteryData[i]);
+		handleResponseBatData(batteryValue);
 	    }
-	    protocol->destroyValueData(batteryData);
 	    break;
 	}
     case TAG_EMS_GET_POWER_SETTINGS:{
 	    // response for TAG_EMS_REQ_GET_POWER_SETTINGS
-	    std::vector < SRscpValue > emsData =
-		protocol->getValueAsContainer(response);
-	    for (size_t i = 0; i < emsData.size(); ++i) {
-		if (emsData[i].dataType == RSCP::eTypeError) {
+	    // the values are read in place, malformed data is rejected before any value is handled
+	    if (RscpWalker::count(response->data, response->length) < 0) {
+		printf("Invalid power settings\n");
+		return -1;
+	    }
+	    RscpWalker walker(response->data, response->length);
+	    SRscpValueRef child;
+	    while (walker.next(child)) {
+		RscpValue emsValue = RscpValue::borrow(child);
+		if (emsValue.dataType() == RSCP::eTypeError) {
 		    // handle error for example access denied errors
 		    uint32_t uiErrorCode =
-			protocol->getValueAsUInt32(&emsData[i]);
+			emsValue.get<uint32_t>();
 		    printf("Tag 0x%08X received error code %u.\n",
-			   emsData[i].tag, uiErrorCode);
+			   emsValue.tag(), uiErrorCode);
 		    return -1;
 		}
 		// check each ems power settings sub tag
-		switch (emsData[i].tag) {
+		switch (emsValue.tag()) {
 		case TAG_EMS_POWER_LIMITS_USED:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS power limits used is %i.\n",
 			       weather_en);
 			break;
 		    }
 		case TAG_EMS_MAX_CHARGE_POWER:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS max charge power is %i.\n",
 			       weather_en);
 			break;
 		    }
 		case TAG_EMS_MAX_DISCHARGE_POWER:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS max discharge power is %i.\n",
 			       weather_en);
 			break;
 		    }
 		case TAG_EMS_DISCHARGE_START_POWER:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS discharge start power is %i.\n",
 			       weather_en);
 			break;
 		    }
 		case TAG_EMS_POWERSAVE_ENABLED:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS powersave enabled is %i.\n",
 			       weather_en);
 			break;
 		    }
 		case TAG_EMS_WEATHER_REGULATED_CHARGE_ENABLED:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf
 			    ("EMS weather regulated charge enabled is %i.\n",
 			     weather_en);
@@ -515,85 +567,113 @@ int handleResponseValue(RscpProtocol * protocol, SRscpValue * response,
 		    }
 		case TAG_EMS_UNKNOWN:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf("EMS unknown is %i.\n", weather_en);
 			break;
 		    }
 		    // ...
 		default:
 		    // default behaviour
-		    printf("Unknown ems tag %08X\n", emsData[i].tag);
+		    printf("Unknown ems tag %08X\n", emsValue.tag());
 		    break;
 		}
 	    }
-	    protocol->destroyValueData(emsData);
 	    break;
 	}
     case TAG_EMS_SET_POWER_SETTINGS:{
 	    // resposne for TAG_EMS_REQ_SET_POWER_SETTINGS
-	    std::vector < SRscpValue > emsData =
-		protocol->getValueAsContainer(response);
-	    for (size_t i = 0; i < emsData.size(); ++i) {
-		if (emsData[i].dataType == RSCP::eTypeError) {
+	    // the values are read in place, malformed data is rejected before any value is handled
+	    if (RscpWalker::count(response->data, response->length) < 0) {
+		printf("Invalid power settings\n");
+		return -1;
+	    }
+	    RscpWalker walker(response->data, response->length);
+	    SRscpValueRef child;
+	    while (walker.next(child)) {
+		RscpValue emsValue = RscpValue::borrow(child);
+		if (emsValue.dataType() == RSCP::eTypeError) {
 		    // handle error for example access denied errors
 		    uint32_t uiErrorCode =
-			protocol->getValueAsUInt32(&emsData[i]);
+			emsValue.get<uint32_t>();
 		    printf("Tag 0x%08X received error code %u.\n",
-			   emsData[i].tag, uiErrorCode);
+			   emsValue.tag(), uiErrorCode);
 		    return -1;
 		}
 		// check each battery sub tag
-		switch (emsData[i].tag) {
+		switch (emsValue.tag()) {
 		case TAG_EMS_RES_WEATHER_REGULATED_CHARGE_ENABLED:{
 			int8_t weather_en =
-			    protocol->getValueAsInt32(&emsData[i]);
+			    emsValue.get<int32_t>();
 			printf
 			    ("Weather regulated charge response: %i\n",
 			     weather_en);
 			break;
 		    }
+		case TAG_EMS_RES_POWER_LIMITS_USED:
+		case TAG_EMS_RES_MAX_CHARGE_POWER:
+		case TAG_EMS_RES_MAX_DISCHARGE_POWER:{
+			int8_t result = emsValue.get<int8_t>();
+			printf("Power limit 0x%08X response: %i\n", emsValue.tag(), result);
+			break;
+		    }
 		default:
 		    // default behaviour
-		    printf("Unknown ems tag %08X\n", emsData[i].tag);
+		    printf("Unknown ems tag %08X\n", emsValue.tag());
 		    break;
 		}
 	    }
-	    protocol->destroyValueData(emsData);
 	    break;
 	}
     case TAG_EMS_GET_IDLE_PERIODS:{
 	    // resposne for TAG_EMS_REQ_GET_IDLE_PERIODS
-	    std::vector < SRscpValue > emsData =
-		protocol->getValueAsContainer(response);
-	    idle_period_t periods[14];
-	    for (size_t i = 0; i < emsData.size(); ++i) {
-		if (emsData[i].dataType == RSCP::eTypeError) {
+	    // the periods and their times are indexed in one pass and read by following the tape
+	    RscpTape & tape = idleCurrent.tape();
+	    if (tape.index(response->data, response->length) < 0) {
+		printf("Invalid idle periods\n");
+		return -1;
+	    }
+	    idle_period_t periods[IDLE_PERIOD_SLOTS];
+	    memset(periods, 0, sizeof(periods));
+	    idleCurrent.clear();
+	    size_t i = 0;
+	    for (int32_t period = tape.first(); (period >= 0) && (i < IDLE_PERIOD_SLOTS); period = tape.next(period), ++i) {
+		if (tape.node(period).dataType == RSCP::eTypeError) {
 		    // handle error for example access denied errors
-		    uint32_t uiErrorCode =
-			protocol->getValueAsUInt32(&emsData[i]);
+		    uint32_t uiErrorCode = tape.get<uint32_t>(period);
 		    printf("Tag 0x%08X received error code %u.\n",
-			   emsData[i].tag, uiErrorCode);
+			   tape.node(period).tag, uiErrorCode);
 		    return -1;
 		}
-		handleResponseEMSGetIdlePeriods(protocol, &emsData[i], &periods[i]);
+		if (handleResponseEMSGetIdlePeriods(tape, period, &periods[i]) == 0)
+		    idleCurrent.set(periods[i]);
 	    }
 	    break;
 	}
+    case TAG_EMS_SET_IDLE_PERIODS:{
+	    // response for TAG_EMS_REQ_SET_IDLE_PERIODS
+	    bool bSet = protocol->getValueAsBool(response);
+	    printf("Set idle periods %s\n", bSet ? "accepted" : "rejected");
+	    break;
+	}
     default:
 	// default behavior
 	uint8_t unknown = protocol->getValueAsUChar8(response);
 	printf("Unknown tag %08X -> %i.\n", response->tag, unknown);
 	break;
     }
+    return 0;
 }
 
-static int processReceiveBuffer(const unsigned char *ucBuffer,
-				int iLength, int *isAuthRequest)
+int32_t processReceiveBuffer(RscpSession * session,
+				    const uint8_t * ucBuffer,
+				    uint32_t iLength, void *context)
 {
     RscpProtocol protocol;
-    SRscpFrame frame;
+    int *isAuthRequest = (int *) context;
+    RscpStats *pStats = (session != NULL) ? session->stats() : NULL;
+    uint64_t uStart = pStats ? RscpStats::now() : 0;
 
-    int iResult = protocol.parseFrame(ucBuffer, iLength, &frame);
+    int iResult = protocol.validateFrame(ucBuffer, iLength);
     if (iResult < 0) {
 	// check if frame length error occured
 	// in that case the full frame length was not received yet
@@ -608,14 +688,46 @@ static int processReceiveBuffer(const unsigned char *ucBuffer,
     }
 
     int iProcessedBytes = iResult;
+    SRscpFrameHeader header;
+    memcpy(&header, ucBuffer, sizeof(header));
+    // the values are read in place from the frame, nothing is copied or allocated per frame
+    const uint8_t *ucData = ucBuffer + sizeof(header);
+    int32_t iValues = RscpWalker::count(ucData, header.dataLength);
+    if (iValues < 0) {
+	// a value exceeds the frame, skip the whole frame instead of dispatching a part of it
+	printf("Invalid value in frame of %u bytes. Error %i\n", header.dataLength, iValues);
+	return iProcessedBytes;
+    }
+    frameTime = header.timestamp.seconds * 1000000000LL + header.timestamp.nanoseconds;
+    if (frameTime == 0) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	frameTime = now.tv_sec * 1000000000LL + now.tv_nsec;
+    }
+    if (pStats) {
+	uint64_t uParsed = RscpStats::now();
+	pStats->record(STATS_PHASE_PARSE, uParsed - uStart);
+	uStart = uParsed;
+    }
 
-    // process each SRscpValue struct seperately
-    for (unsigned int i; i < frame.data.size(); i++) {
-	handleResponseValue(&protocol, &frame.data[i], isAuthRequest);
+    // process each value seperately, the handlers only read the data of the frame
+    RscpWalker walker(ucData, header.dataLength);
+    SRscpValueRef value;
+    while (walker.next(value)) {
+	SRscpValue response = RscpValue::borrow(value).view();
+	handleResponseValue(&protocol, &response, isAuthRequest);
     }
 
-    // destroy frame data and free memory
-    protocol.destroyFrameData(frame);
+    if (pStats) {
+	uint64_t uHandled = RscpStats::now();
+	pStats->record(STATS_PHASE_DISPATCH, uHandled - uStart);
+	// round trip of each response value grouped by the name space of its tag
+	if (session->flushTime() != 0) {
+	    RscpWalker tags(ucData, header.dataLength);
+	    while (tags.next(value))
+		pStats->recordTag(value.tag, uHandled - session->flushTime());
+	}
+    }
 
     // returned processed amount of bytes
     return iProcessedBytes;
@@ -626,185 +738,321 @@ static void receiveLoop(bool & bStopExecution)
     //--------------------------------------------------------------------------------------------------------------
     // RSCP Receive Frame Block Data
     //--------------------------------------------------------------------------------------------------------------
-    // setup a static dynamic buffer which is dynamically expanded (re-allocated) on demand
-    // the data inside this buffer is not released when this function is left
-    static int iReceivedBytes = 0;
-    static std::vector < uint8_t > vecDynamicBuffer;
+    // the session keeps its receive buffer between calls, so frames which arrive with a big time delay
+    // or several frames in one receive call are handled there
     int isAuthRequest = 0;
 
     // check how many RSCP frames are received, must be at least 1
-    // multiple frames can only occur in this example if one or more frames are received with a big time delay
-    // this should usually not occur but handling this is shown in this example
-    int iReceivedRscpFrames = 0;
-    while (!bStopExecution
-	   && ((iReceivedBytes > 0) || iReceivedRscpFrames == 0)) {
-	// check and expand buffer
-	if ((vecDynamicBuffer.size() - iReceivedBytes) < 4096) {
-	    // check maximum size
-	    if (vecDynamicBuffer.size() > RSCP_MAX_FRAME_LENGTH) {
-		// something went wrong and the size is more than possible by the RSCP protocol
-		printf
-		    ("Maximum buffer size exceeded %i\n",
-		     vecDynamicBuffer.size());
-		bStopExecution = true;
-		break;
-	    }
-	    // increase buffer size by 4096 bytes each time the remaining size is smaller than 4096
-	    vecDynamicBuffer.resize(vecDynamicBuffer.size() + 4096);
-	}
-	// receive data
-	int iResult = SocketRecvData(iSocket,
-				     &vecDynamicBuffer[0] + iReceivedBytes,
-				     vecDynamicBuffer.size() -
-				     iReceivedBytes);
-	if (iResult < 0) {
-	    // check errno for the error code to detect if this is a timeout or a socket error
-	    if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-		// receive timed out -> continue with re-sending the initial block
-		printf("Response receive timeout (retry)\n");
-		break;
-	    }
-	    // socket error -> check errno for failure code if needed
-	    printf("Socket receive error. errno %i\n", errno);
-	    bStopExecution = true;
-	    break;
-	} else if (iResult == 0) {
-	    // connection was closed regularly by peer
-	    // if this happens on startup each time the possible reason is
-	    // wrong AES password or wrong network subnet (adapt hosts.allow file required)
-	    printf("Connection closed by peer\n");
-	    bStopExecution = true;
-	    break;
-	}
-	// increment amount of received bytes
-	iReceivedBytes += iResult;
-
-	// process all received frames
-	while (!bStopExecution) {
-	    // round down to a multiple of AES_BLOCK_SIZE
-	    int iLength = ROUNDDOWN(iReceivedBytes, AES_BLOCK_SIZE);
-	    // if not even 32 bytes were received then the frame is still incomplete
-	    if (iLength == 0) {
-		break;
-	    }
-	    // resize temporary decryption buffer
-	    std::vector < uint8_t > decryptionBuffer;
-	    decryptionBuffer.resize(iLength);
-	    // initialize encryption sequence IV value with value of previous block
-	    aesDecrypter.SetIV(ucDecryptionIV, AES_BLOCK_SIZE);
-	    // decrypt data from vecDynamicBuffer to temporary decryptionBuffer
-	    aesDecrypter.Decrypt(&vecDynamicBuffer[0],
-				 &decryptionBuffer[0],
-				 iLength / AES_BLOCK_SIZE);
-
-	    // data was received, check if we received all data
-	    int iProcessedBytes =
-		processReceiveBuffer(&decryptionBuffer[0],
-				     iLength,
-				     &isAuthRequest);
-	    if (iProcessedBytes < 0) {
-		// an error occured;
-		printf("Error parsing RSCP frame: %i\n", iProcessedBytes);
-		// stop execution as the data received is not RSCP data
-		bStopExecution = true;
-		break;
-
-	    } else if (iProcessedBytes > 0) {
-		// round up the processed bytes as iProcessedBytes does not include the zero padding bytes
-		iProcessedBytes = ROUNDUP(iProcessedBytes, AES_BLOCK_SIZE);
-		// store the IV value from encrypted buffer for next block decryption
-		memcpy(ucDecryptionIV,
-		       &vecDynamicBuffer[0] +
-		       iProcessedBytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
-		// move the encrypted data behind the current frame data (if any received) to the front
-		memcpy(&vecDynamicBuffer[0],
-		       &vecDynamicBuffer[0] +
-		       iProcessedBytes,
-		       vecDynamicBuffer.size() - iProcessedBytes);
-		// decrement the total received bytes by the amount of processed bytes
-		iReceivedBytes -= iProcessedBytes;
-		// increment a counter that a valid frame was received and
-		// continue parsing process in case a 2nd valid frame is in the buffer as well
-		iReceivedRscpFrames++;
-		if (!isAuthRequest) {
-		    printf
-			("Successfully received %i RscpFrames\n",
-			 iReceivedRscpFrames);
-		    bStopExecution = true;
-		}
-	    } else {
-		// iProcessedBytes is 0
-		// not enough data of the next frame received, go back to receive mode if iReceivedRscpFrames == 0
-		// or transmit mode if iReceivedRscpFrames > 0
-		break;
-	    }
-	}
+    int iReceivedRscpFrames =
+	session.receive(processReceiveBuffer, &isAuthRequest,
+			RECEIVE_TIMEOUT_MS);
+    if (bDumpStats)
+	dumpStats();
+    if (iReceivedRscpFrames == 0) {
+	// receive timed out -> continue with re-sending the initial block
+	printf("Response receive timeout (retry)\n");
+	return;
+    } else if (iReceivedRscpFrames == SESSION_ERR_CLOSED) {
+	// connection was closed regularly by peer
+	// if this happens on startup each time the possible reason is
+	// wrong AES password or wrong network subnet (adapt hosts.allow file required)
+	printf("Connection closed by peer\n");
+	bStopExecution = true;
+	return;
+    } else if (iReceivedRscpFrames == SESSION_ERR_BUFFER_OVERFLOW) {
+	// something went wrong and the size is more than possible by the RSCP protocol
+	printf("Maximum buffer size exceeded\n");
+	bStopExecution = true;
+	return;
+    } else if (iReceivedRscpFrames == SESSION_ERR_SOCKET) {
+	// socket error -> check errno for failure code if needed
+	printf("Socket error. errno %i\n", errno);
+	bStopExecution = true;
+	return;
+    } else if (iReceivedRscpFrames < 0) {
+	// an error occured;
+	printf("Error parsing RSCP frame: %i\n", iReceivedRscpFrames);
+	// stop execution as the data received is not RSCP data
+	bStopExecution = true;
+	return;
+    }
+    if (!isAuthRequest) {
+	printf("Successfully received %i RscpFrames\n", iReceivedRscpFrames);
+	bStopExecution = true;
     }
 }
 
 static void mainLoop(int requests)
 {
-    RscpProtocol protocol;
     bool bStopExecution = false;
 
     while (!bStopExecution) {
 	//--------------------------------------------------------------------------------------------------------------
 	// RSCP Transmit Frame Block Data
 	//--------------------------------------------------------------------------------------------------------------
-	SRscpFrameBuffer frameBuffer;
-	memset(&frameBuffer, 0, sizeof(frameBuffer));
-
-	// create an RSCP frame with requests to some example data
-	createRequest(&frameBuffer, requests);
+	// create an RSCP frame with requests to some example data, the builder reuses its buffer
+	int iBuilt = createRequest(requestBuilder, requests);
 
 	// check that frame data was created
-	if (frameBuffer.dataLength > 0) {
-	    // resize temporary encryption buffer to a multiple of AES_BLOCK_SIZE
-	    std::vector < uint8_t > encryptionBuffer;
-	    encryptionBuffer.resize(ROUNDUP
-				    (frameBuffer.dataLength,
-				     AES_BLOCK_SIZE));
-	    // zero padding for data above the desired length
-	    memset(&encryptionBuffer[0] +
-		   frameBuffer.dataLength, 0,
-		   encryptionBuffer.size() - frameBuffer.dataLength);
-	    // copy desired data length
-	    memcpy(&encryptionBuffer[0], frameBuffer.data,
-		   frameBuffer.dataLength);
-	    // set continues encryption IV
-	    aesEncrypter.SetIV(ucEncryptionIV, AES_BLOCK_SIZE);
-	    // start encryption from encryptionBuffer to encryptionBuffer, blocks = encryptionBuffer.size() / AES_BLOCK_SIZE
-	    aesEncrypter.Encrypt(&encryptionBuffer[0],
-				 &encryptionBuffer[0],
-				 encryptionBuffer.size() / AES_BLOCK_SIZE);
-	    // save new IV for next encryption block
-	    memcpy(ucEncryptionIV,
-		   &encryptionBuffer[0] +
-		   encryptionBuffer.size() - AES_BLOCK_SIZE,
-		   AES_BLOCK_SIZE);
-
-	    // send data on socket
-	    int iResult = SocketSendData(iSocket,
-					 &encryptionBuffer[0],
-					 encryptionBuffer.size());
+	if ((iBuilt == 0) && (requestBuilder.length() > 0)) {
+	    // the frame is built and encrypted in the send buffer, it is sent together with the receive request
+	    int iResult = session.queueValue(requestBuilder.root());
 	    if (iResult < 0) {
-		printf("Socket send error %i. errno %i\n", iResult, errno);
+		printf("Socket queue error %i. errno %i\n", iResult, errno);
 		bStopExecution = true;
 	    } else {
 		// go into receive loop and wait for response
 		receiveLoop(bStopExecution);
+		if (requests & TAG_BATTERY_CELLS)
+		    batteryScan.print(stdout);
+		if (requests & TAG_PVI)
+		    pviScan.print(stdout);
 	    }
 	}
-	// free frame buffer memory
-	protocol.destroyFrameData(&frameBuffer);
 
 	// main loop sleep / cycle time before next request
 
+	if (bStopRequested)
+	    bStopExecution = true;
 	if (!bStopExecution)
 	    sleep(1);
     }
 }
 
+/*
+ * Probe the battery and inverter indexes for their DCBs, strings, phases and sensors in one frame,
+ * the scan requests of --cells and --pvi cover the devices found here.
+ */
+static void discoverDevices(int requests)
+{
+    requestBuilder.clear();
+    printf("\nDiscover devices\n");
+    if (requests & TAG_BATTERY_CELLS) {
+	batteryScan.enable();
+	batteryScan.createDiscovery(requestBuilder);
+    }
+    if (requests & TAG_PVI) {
+	pviScan.enable();
+	pviScan.createDiscovery(requestBuilder);
+    }
+
+    bool bStopExecution = false;
+    int iResult = requestBuilder.error();
+    if (iResult == RSCP::OK)
+	iResult = session.queueValue(requestBuilder.root());
+    if (iResult < 0)
+	printf("Socket queue error %i. errno %i\n", iResult, errno);
+    else
+	receiveLoop(bStopExecution);
+
+    if (batteryScan.enabled()) {
+	batteryScan.finishDiscovery();
+	for (uint32_t i = 0; i < batteryScan.batteryCount(); i++)
+	    printf("Battery %u has %u DCBs\n", batteryScan.batteryIndex(i), batteryScan.dcbCount(i));
+    }
+    if (pviScan.enabled()) {
+	pviScan.finishDiscovery();
+	for (uint32_t i = 0; i < pviScan.inverterCount(); i++)
+	    printf("Inverter %u has %u strings, %u phases and %u temperature sensors\n", pviScan.inverterIndex(i),
+		   pviScan.stringCount(i), pviScan.phaseCount(i), pviScan.sensorCount(i));
+    }
+}
+
+/*
+ * Consumer of the power meter samples, writes them as CSV to \var output if it is not NULL.
+ */
+static void pmConsumer(FILE *output, uint64_t *consumed)
+{
+    SRscpPmSample sample;
+    if (output != NULL)
+	fprintf(output, "time_ns,power_l1,power_l2,power_l3,energy_l1,energy_l2,energy_l3\n");
+    while (true) {
+	bool bStop = __atomic_load_n(&bPmConsumerStop, __ATOMIC_ACQUIRE);
+	while (powerMeter.ring().pop(sample)) {
+	    (*consumed)++;
+	    if (output != NULL)
+		fprintf(output, "%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", (unsigned long long) sample.time,
+			sample.power[0], sample.power[1], sample.power[2],
+			sample.energy[0], sample.energy[1], sample.energy[2]);
+	}
+	if (bStop)
+	    break;
+	usleep(1000);
+    }
+}
+
+/*
+ * Sample the power meter as fast as the unit answers for \var seconds. The pre-encoded request is queued
+ * again for every answered one, so \var depth requests stay in flight.
+ */
+static void fastPollLoop(int seconds, int depth, const char *outputPath)
+{
+    if (powerMeter.prepare(0) != RSCP::OK) {
+	printf("Cannot create the power meter request\n");
+	return;
+    }
+    FILE *output = NULL;
+    if ((outputPath != NULL) && ((output = fopen(outputPath, "w")) == NULL)) {
+	printf("Cannot create sample file %s\n", outputPath);
+	return;
+    }
+    printf("\nSample power meter for %i s with %i requests in flight\n", seconds, depth);
+    powerMeter.enable();
+    uint64_t uConsumed = 0;
+    __atomic_store_n(&bPmConsumerStop, false, __ATOMIC_RELEASE);
+    std::thread consumer(pmConsumer, output, &uConsumed);
+
+    int isAuthRequest = 0;
+    int iInFlight = 0;
+    uint64_t uEnd = RscpStats::now() + seconds * 1000000000ULL;
+    while (true) {
+	// keep the pipeline full until the end, then only collect the outstanding responses
+	bool bRunning = (RscpStats::now() < uEnd) && !bStopRequested;
+	if (!bRunning && (iInFlight == 0))
+	    break;
+	for (; bRunning && (iInFlight < depth); iInFlight++) {
+	    int iResult = session.queueFrame(powerMeter.frame());
+	    if (iResult < 0) {
+		printf("Socket queue error %i. errno %i\n", iResult, errno);
+		break;
+	    }
+	}
+	int iReceivedRscpFrames = session.receive(processReceiveBuffer, &isAuthRequest, RECEIVE_TIMEOUT_MS);
+	if (iReceivedRscpFrames == 0) {
+	    // the outstanding requests are considered lost
+	    printf("Response receive timeout, %i requests lost\n", iInFlight);
+	    iInFlight = 0;
+	    continue;
+	}
+	if (iReceivedRscpFrames < 0) {
+	    printf("Receive error %i. errno %i\n", iReceivedRscpFrames, errno);
+	    break;
+	}
+	iInFlight = (iReceivedRscpFrames > iInFlight) ? 0 : iInFlight - iReceivedRscpFrames;
+    }
+
+    __atomic_store_n(&bPmConsumerStop, true, __ATOMIC_RELEASE);
+    consumer.join();
+    if (output != NULL)
+	fclose(output);
+    powerMeter.print(stdout);
+    printf("%llu samples consumed\n", (unsigned long long) uConsumed);
+}
+
+/*
+ * Queue the frame of \var rootValue and wait for its response.
+ * @return - Number of frames handled, 0 on timeout or a negative error code
+ */
+static int requestValue(const SRscpValue & rootValue)
+{
+    int isAuthRequest = 0;
+    int iResult = session.queueValue(rootValue);
+    if (iResult < 0)
+	return iResult;
+    return session.receive(processReceiveBuffer, &isAuthRequest, RECEIVE_TIMEOUT_MS);
+}
+
+/*
+ * Surplus charging control for \var seconds. Every \var periodMs the EMS and wallbox values are polled in
+ * one frame and the charge current is adjusted, the periods are scheduled on absolute times so a slow
+ * period does not shift the following ones.
+ */
+static void wallboxLoop(int seconds, int periodMs)
+{
+    wallbox.enable();
+    printf("\nWallbox control for %i s every %i ms%s\n", seconds, periodMs,
+	   wallbox.dryRun() ? ", dry run" : "");
+    uint64_t uPeriod = periodMs * 1000000ULL;
+    uint64_t uNext = RscpStats::now();
+    uint64_t uEnd = uNext + seconds * 1000000000ULL;
+    while ((uNext < uEnd) && !bStopRequested) {
+	struct timespec next;
+	next.tv_sec = uNext / 1000000000ULL;
+	next.tv_nsec = uNext % 1000000000ULL;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	uint64_t uStart = RscpStats::now();
+	wallbox.record(WB_LATENCY_LATENESS, uStart - uNext);
+
+	// the builder keeps its buffer, a period does not allocate
+	requestBuilder.clear();
+	int iResult = wallbox.createPoll(requestBuilder);
+	if (iResult == RSCP::OK)
+	    iResult = requestValue(requestBuilder.root());
+	if (iResult < 0) {
+	    printf("Wallbox poll error %i. errno %i\n", iResult, errno);
+	    break;
+	}
+	uint64_t uPolled = RscpStats::now();
+	if (iResult == 0) {
+	    // without current values the charge current is kept
+	    printf("Response receive timeout (retry)\n");
+	} else {
+	    wallbox.record(WB_LATENCY_POLL, uPolled - uStart);
+	    bool bChanged = wallbox.control();
+	    uint64_t uControlled = RscpStats::now();
+	    wallbox.record(WB_LATENCY_CONTROL, uControlled - uPolled);
+	    wallbox.printState(stdout);
+	    if (bChanged && !wallbox.dryRun()) {
+		requestBuilder.clear();
+		iResult = wallbox.createSetCurrent(requestBuilder);
+		if (iResult == RSCP::OK)
+		    iResult = requestValue(requestBuilder.root());
+		if (iResult < 0) {
+		    printf("Wallbox set error %i. errno %i\n", iResult, errno);
+		    break;
+		}
+		if (iResult > 0)
+		    wallbox.record(WB_LATENCY_SET, RscpStats::now() - uControlled);
+	    }
+	}
+	wallbox.record(WB_LATENCY_CYCLE, RscpStats::now() - uStart);
+
+	// periods which already passed are skipped
+	uNext += uPeriod;
+	uint64_t uNow = RscpStats::now();
+	while (uNext < uNow) {
+	    uNext += uPeriod;
+	    wallbox.countOverrun();
+	}
+    }
+    wallbox.printLatencies(stdout);
+}
+
+/*
+ * Write the idle periods of the configuration which differ from the schedule of the unit. The
+ * schedule is read first and all changed periods are sent in one frame, nothing is sent if the
+ * unit already has the configured periods.
+ */
+static void syncIdlePeriods()
+{
+    printf("\nSync idle periods\n");
+    if (idleSchedule.count() == 0) {
+	printf("No idle_period in %s\n", CONF_FILE);
+	return;
+    }
+    requestBuilder.clear();
+    requestBuilder.add(TAG_EMS_REQ_GET_IDLE_PERIODS);
+    int iResult = requestValue(requestBuilder.root());
+    if (iResult <= 0) {
+	printf("Get idle periods failed %i. errno %i\n", iResult, errno);
+	return;
+    }
+
+    RscpIdlePeriods changes;
+    if (idleCurrent.diff(idleSchedule, changes) == 0) {
+	printf("All %u configured idle periods are up to date\n", idleSchedule.count());
+	return;
+    }
+    printf("Changing %u of %u configured idle periods:\n", changes.count(), idleSchedule.count());
+    changes.print(stdout);
+    requestBuilder.clear();
+    iResult = changes.createSet(requestBuilder);
+    if (iResult == RSCP::OK)
+	iResult = requestValue(requestBuilder.root());
+    if (iResult <= 0)
+	printf("Set idle periods failed %i. errno %i\n", iResult, errno);
+}
+
 int authLoop(e3dc_config_t *config)
 {
     int auth_retry = MAX_AUTH_RETRY;
@@ -821,40 +1069,17 @@ int authLoop(e3dc_config_t *config)
 	memset(&frameBuffer, 0, sizeof(frameBuffer));
 
 	// create an RSCP frame with requests to some example data
+	uint64_t uStart = RscpStats::now();
 	createAuthRequest(&frameBuffer, config);
+	if (session.stats())
+	    session.stats()->record(STATS_PHASE_BUILD, RscpStats::now() - uStart);
 
 	// check that frame data was created
 	if (frameBuffer.dataLength > 0) {
-	    // resize temporary encryption buffer to a multiple of AES_BLOCK_SIZE
-	    std::vector < uint8_t > encryptionBuffer;
-	    encryptionBuffer.resize(ROUNDUP
-				    (frameBuffer.dataLength,
-				     AES_BLOCK_SIZE));
-	    // zero padding for data above the desired length
-	    memset(&encryptionBuffer[0] +
-		   frameBuffer.dataLength, 0,
-		   encryptionBuffer.size() - frameBuffer.dataLength);
-	    // copy desired data length
-	    memcpy(&encryptionBuffer[0], frameBuffer.data,
-		   frameBuffer.dataLength);
-	    // set continues encryption IV
-	    aesEncrypter.SetIV(ucEncryptionIV, AES_BLOCK_SIZE);
-	    // start encryption from encryptionBuffer to encryptionBuffer, blocks = encryptionBuffer.size() / AES_BLOCK_SIZE
-	    aesEncrypter.Encrypt(&encryptionBuffer[0],
-				 &encryptionBuffer[0],
-				 encryptionBuffer.size() / AES_BLOCK_SIZE);
-	    // save new IV for next encryption block
-	    memcpy(ucEncryptionIV,
-		   &encryptionBuffer[0] +
-		   encryptionBuffer.size() - AES_BLOCK_SIZE,
-		   AES_BLOCK_SIZE);
-
-	    // send data on socket
-	    int iResult = SocketSendData(iSocket,
-					 &encryptionBuffer[0],
-					 encryptionBuffer.size());
+	    // encrypt the frame and queue it, it is sent together with the receive request
+	    int iResult = session.queueFrame(frameBuffer);
 	    if (iResult < 0) {
-		printf("Socket send error %i. errno %i\n", iResult, errno);
+		printf("Socket queue error %i. errno %i\n", iResult, errno);
 		bStopExecution = true;
 		continue;
 	    } else {
@@ -878,16 +1103,214 @@ int authLoop(e3dc_config_t *config)
     return 0;
 }
 
+static long monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/*
+ * Send the frame of \var requests to all units of the inventory \var path with at most \var parallel
+ * units in progress and print the report.
+ * @return - 0 if all units accepted the command, else -1
+ */
+static int runFleet(const char *path, const e3dc_config_t & config, int requests, int backend, int parallel)
+{
+    RscpFleet fleet;
+    if (fleet.load(path, config) < 0) {
+	printf("Cannot read inventory %s\n", path);
+	return -1;
+    }
+    if ((requests & TAG_SET_IDLE_PERIODS) && (idleSchedule.count() == 0)) {
+	printf("No idle_period in %s\n", CONF_FILE);
+	requests &= ~TAG_SET_IDLE_PERIODS;
+    }
+    if ((fleet.size() == 0) || (requests == 0)) {
+	printf("Nothing to send: %u units\n", fleet.size());
+	return -1;
+    }
+    if (parallel > (int) fleet.size())
+	parallel = fleet.size();
+    backend = SocketTransportInit(backend, parallel);
+    if (backend < 0) {
+	printf("Cannot initialize socket transport. errno %i\n", -backend);
+	return -1;
+    }
+    printf("Sending to %u units, %i in parallel, using %s transport\n", fleet.size(), parallel,
+	   SocketBackendName(backend));
+
+    // the command is the same for all units, each session only encrypts it
+    RscpProtocol protocol;
+    SRscpFrameBuffer frameBuffer;
+    memset(&frameBuffer, 0, sizeof(frameBuffer));
+    if (createRequest(requestBuilder, requests) < 0) {
+	SocketTransportClose();
+	return -1;
+    }
+    // the builder is reused for the authentication frames of the units
+    protocol.createFrameAsBuffer(&frameBuffer, requestBuilder.data(), requestBuilder.length(), true);
+    uint32_t uFailed = fleet.run(createAuthRequest, frameBuffer, parallel, RECEIVE_TIMEOUT_MS);
+    protocol.destroyFrameData(&frameBuffer);
+    SocketTransportClose();
+
+    printf("\n");
+    fleet.print(stdout);
+    return (uFailed == 0) ? 0 : -1;
+}
+
+static void handleReloadSignal(int /* signal */)
+{
+    RscpRuntime::requestReload();
+}
+
+static void handleStopSignal(int /* signal */)
+{
+    bStopRequested = 1;
+    RscpRuntime::requestStop();
+}
+
+/*
+ * Poll all devices of \var config for \var seconds, 0 runs until SIGINT or SIGTERM. SIGHUP reloads
+ * the configuration file.
+ */
+static int runDevices(const RscpConfig & config, int backend, int seconds)
+{
+    backend = SocketTransportInit(backend, CONFIG_MAX_DEVICES);
+    if (backend < 0) {
+	printf("Cannot initialize socket transport. errno %i\n", -backend);
+	return -1;
+    }
+    printf("Polling %u devices using %s transport\n", config.deviceCount(), SocketBackendName(backend));
+    signal(SIGHUP, handleReloadSignal);
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    RscpRuntime runtime;
+    runtime.run(CONF_FILE, config, seconds);
+    SocketTransportClose();
+    printf("\n");
+    runtime.print(stdout);
+    return 0;
+}
+
+/*
+ * Feed the received frames of a capture file through processReceiveBuffer.
+ * All frames are loaded first, so the loop only measures the parse and dispatch path.
+ * With bPace the original time between the frames is kept.
+ */
+static int replayCapture(const char *path, bool bPace, int repeat)
+{
+    RscpCapture replay;
+    if (!replay.openRead(path)) {
+	printf("Cannot open capture file %s\n", path);
+	return -1;
+    }
+    std::vector < uint8_t > frames;
+    std::vector < size_t > offsets;
+    std::vector < uint64_t > timestamps;
+    std::vector < uint8_t > data;
+    SRscpCaptureRecord record;
+    int32_t iResult;
+    while ((iResult = replay.read(&record, data)) > 0) {
+	// only decrypted received frames are replayed
+	if ((record.direction != RSCP_CAPTURE_RX) || (record.flags & RSCP_CAPTURE_ENCRYPTED))
+	    continue;
+	offsets.push_back(frames.size());
+	timestamps.push_back(record.timestamp);
+	frames.insert(frames.end(), data.begin(), data.begin() + record.length);
+    }
+    replay.close();
+    if (iResult < 0)
+	printf("Capture file %s is truncated\n", path);
+    offsets.push_back(frames.size());
+
+    long lFrames = 0;
+    long lErrors = 0;
+    long lStart = monotonicNs();
+    for (int run = 0; run < repeat; run++) {
+	long lRunStart = monotonicNs();
+	for (size_t i = 0; i + 1 < offsets.size(); i++) {
+	    if (bPace) {
+		long lDue = lRunStart + (long) (timestamps[i] - timestamps[0]);
+		long lWait = lDue - monotonicNs();
+		if (lWait > 0) {
+		    struct timespec ts = { lWait / 1000000000L, lWait % 1000000000L };
+		    nanosleep(&ts, NULL);
+		}
+	    }
+	    int isAuthRequest = 0;
+	    int iProcessed = processReceiveBuffer(NULL, &frames[offsets[i]],
+						  offsets[i + 1] - offsets[i], &isAuthRequest);
+	    if (iProcessed <= 0)
+		lErrors++;
+	    lFrames++;
+	}
+    }
+    long lElapsed = monotonicNs() - lStart;
+    // statistics go to stderr so the decoded output can be discarded for benchmarks
+    fprintf(stderr, "Replayed %li frames (%zu bytes, %i runs) in %.3f ms, %.0f ns/frame, %li errors\n",
+	    lFrames, (size_t) (frames.size() * (size_t) repeat), repeat, lElapsed / 1e6,
+	    lFrames ? (double) lElapsed / lFrames : 0.0, lErrors);
+    return (lErrors == 0) ? 0 : -1;
+}
+
+// rscp-bench links the request and response handlers without the main function
+#ifndef RSCP_NO_MAIN
+/*
+ * Print and close the rollup, the energy counters and the alarms, their open buckets, samples and
+ * states are written.
+ */
+static void closeOutputs()
+{
+    if (rollup.enabled()) {
+	rollup.print(stdout);
+	rollup.close();
+    }
+    if (energy.enabled()) {
+	energy.print(stdout, 2);
+	energy.close();
+    }
+    if (alarms.enabled()) {
+	alarms.print(stdout);
+	alarms.stop();
+    }
+}
+
 void showhelp(char *prog)
 {
     printf("Usage:\n");
-    printf("%s [-hebts] [-w 0|1]\n", prog);
+    printf("%s [-hebBPtsux] [-w 0|1] [-L charge:discharge] [-F file [-j parallel]] [-d name] [-D seconds] [-g path]... [-f file] [-M seconds [-q depth] [-o file]] [-W seconds [-T ms] [-y]] [-c file] [-R dir] [-E file] [-r file [-p] [-n count]] [-S file|-]\n", prog);
     printf("  --help, -h         \tshows this help\n");
     printf("  --battery, -b      \tshows battery details\n");
     printf("  --ems, -e          \tshows ems details\n");
     printf("  --time, -t         \tshows idle periods\n");
-    printf("  --settime, -s      \tsets idle periods (currently hardcoded values)\n");
+    printf("  --settime, -s      \twrites the idle_period entries of the config which differ from the unit\n");
     printf("  --weather, -w      \tsets weather enable option [on|off]\n");
+    printf("  --get, -g          \trequests a tag path like TAG_BAT_REQ_DATA[0]/TAG_BAT_REQ_RSOC\n");
+    printf("  --file, -f         \trequests the tag paths of a file, one per line\n");
+    printf("  --cells, -B        \tdiscovers all batteries and shows the voltages and temperatures of their cells\n");
+    printf("  --pm, -M           \tsamples the power and energy of the power meter phases as fast as possible for seconds\n");
+    printf("  --pipeline, -q     \trequests in flight of --pm (default 4)\n");
+    printf("  --output, -o       \twrites the samples of --pm as CSV to a file\n");
+    printf("  --wallbox, -W      \truns the wallbox surplus charging control for seconds\n");
+    printf("  --period, -T       \tcontrol period of --wallbox in milliseconds (default 1000)\n");
+    printf("  --dry-run, -y      \tcomputes the charge current of --wallbox without setting it\n");
+    printf("  --pvi, -P          \tdiscovers all inverters and shows the values of their strings, phases and sensors\n");
+    printf("  --limits, -L       \tsets the maximum charge and discharge power in W [charge:discharge]\n");
+    printf("  --fleet, -F        \tsends the requests to all units of an inventory file (host port user password aes_password)\n");
+    printf("  --parallel, -j     \tunits of --fleet in progress at the same time (default 16)\n");
+    printf("  --device, -d       \tuses the device section name of the config instead of the first device\n");
+    printf("  --devices, -D      \tpolls all devices of the config for seconds, 0 until SIGTERM, SIGHUP reloads the config\n");
+    printf("  --uring, -u        \tuse the io_uring transport (falls back to epoll)\n");
+    printf("  --capture, -c      \trecord the decrypted frames into a capture file\n");
+    printf("  --energy, -E       \tintegrates daily energy counters into a checkpoint file and reconciles them with the unit\n");
+    printf("  --rollup, -R       \tkeeps 1 min, 15 min, 1 h and 1 d min/max/mean/last of every value in a directory\n");
+    printf("  --encrypted, -x    \trecord the encrypted stream data as well\n");
+    printf("  --replay, -r       \treplay the received frames of a capture file without connecting\n");
+    printf("  --pace, -p         \treplay at the original pace instead of as fast as possible\n");
+    printf("  --repeat, -n       \treplay the capture count times\n");
+    printf("  --stats, -S        \tprint latency statistics to a file or - for stderr at exit and on SIGUSR1\n");
 }
 
 int main(int argc, char *argv[])
@@ -896,29 +1319,29 @@ int main(int argc, char *argv[])
     int conn_retry = MAX_CONN_RETRY;
     int opt;
     int requests = 0;
-
-    // get conf parameters
-    FILE *fp = fopen(CONF_FILE, "r");
-    char var[128], value[128], line[256];
-    e3dc_config_t e3dc_config;
-    if(fp) {
-	while (fgets(line, sizeof(line), fp)) {
-	    memset(var, 0, sizeof(var));
-	    memset(value, 0, sizeof(value));
-	    if(sscanf(line, "%[^ \t=]%*[\t ]=%*[\t ]%[^\n]", var, value) == 2) {
-		if(strcmp(var, "server_ip") == 0)
-		    strcpy(e3dc_config.server_ip, value);
-		else if(strcmp(var, "server_port") == 0)
-		    e3dc_config.server_port = atoi(value);
-		else if(strcmp(var, "e3dc_user") == 0)
-		    strcpy(e3dc_config.e3dc_user, value);
-		else if(strcmp(var, "e3dc_password") == 0)
-		    strcpy(e3dc_config.e3dc_password, value);
-		else if(strcmp(var, "aes_password") == 0)
-		    strcpy(e3dc_config.aes_password, value);
-	    }
-	}
-	fclose(fp);
+    int backend = SOCKET_BACKEND_EPOLL;
+    const char *capturePath = NULL;
+    const char *rollupPath = NULL;
+    const char *energyPath = NULL;
+    const char *fleetPath = NULL;
+    int fleetParallel = FLEET_DEFAULT_PARALLEL;
+    const char *replayPath = NULL;
+    bool bCaptureEncrypted = false;
+    bool bReplayPace = false;
+    int replayRepeat = 1;
+    int pmSeconds = 0;
+    int pmDepth = 4;
+    const char *pmOutputPath = NULL;
+    int wbSeconds = 0;
+    int wbPeriodMs = 1000;
+    const char *deviceName = NULL;
+    int devicesSeconds = -1;
+
+    // get conf parameters, a missing file leaves the defaults
+    RscpConfig config;
+    if (config.load(CONF_FILE) == CONFIG_ERR_INVALID) {
+	printf("Invalid configuration %s\n", CONF_FILE);
+	return -1;
     }
 
     // get commandline parameters
@@ -930,9 +1353,34 @@ int main(int argc, char *argv[])
 	    {"time",		no_argument,		0, 't'},
 	    {"settime",		no_argument,		0, 's'},
 	    {"weather",		required_argument,	0, 'w' },
+	    {"uring",		no_argument,		0, 'u'},
+	    {"capture",		required_argument,	0, 'c'},
+	    {"rollup",		required_argument,	0, 'R'},
+	    {"energy",		required_argument,	0, 'E'},
+	    {"encrypted",	no_argument,		0, 'x'},
+	    {"replay",		required_argument,	0, 'r'},
+	    {"pace",		no_argument,		0, 'p'},
+	    {"repeat",		required_argument,	0, 'n'},
+	    {"stats",		required_argument,	0, 'S'},
+	    {"get",		required_argument,	0, 'g'},
+	    {"file",		required_argument,	0, 'f'},
+	    {"cells",		no_argument,		0, 'B'},
+	    {"pvi",		no_argument,		0, 'P'},
+	    {"pm",		required_argument,	0, 'M'},
+	    {"pipeline",	required_argument,	0, 'q'},
+	    {"output",		required_argument,	0, 'o'},
+	    {"wallbox",		required_argument,	0, 'W'},
+	    {"limits",		required_argument,	0, 'L'},
+	    {"fleet",		required_argument,	0, 'F'},
+	    {"parallel",	required_argument,	0, 'j'},
+	    {"device",		required_argument,	0, 'd'},
+	    {"devices",		required_argument,	0, 'D'},
+	    {"period",		required_argument,	0, 'T'},
+	    {"dry-run",		no_argument,		0, 'y'},
+	    {0,			0,			0, 0 }
 	};
 	int option_index = 0;
-	opt = getopt_long(argc, argv, "hbetsw:", long_options, &option_index);
+	opt = getopt_long(argc, argv, "hbBPetsw:uc:xr:pn:S:g:f:M:q:o:W:T:yL:F:j:d:D:R:E:", long_options, &option_index);
 
 	if(opt == -1)
 	    break;
@@ -947,6 +1395,42 @@ int main(int argc, char *argv[])
 	    requests |= TAG_BATTERY;
 	    break;
 	    }
+	case 'B': {
+	    requests |= TAG_BATTERY_CELLS;
+	    break;
+	    }
+	case 'P': {
+	    requests |= TAG_PVI;
+	    break;
+	    }
+	case 'M': {
+	    pmSeconds = atoi(optarg);
+	    break;
+	    }
+	case 'q': {
+	    pmDepth = atoi(optarg);
+	    if (pmDepth < 1)
+		pmDepth = 1;
+	    break;
+	    }
+	case 'o': {
+	    pmOutputPath = optarg;
+	    break;
+	    }
+	case 'W': {
+	    wbSeconds = atoi(optarg);
+	    break;
+	    }
+	case 'T': {
+	    wbPeriodMs = atoi(optarg);
+	    if (wbPeriodMs < 1)
+		wbPeriodMs = 1;
+	    break;
+	    }
+	case 'y': {
+	    wallbox.setDryRun(true);
+	    break;
+	    }
 	case 'e': {
 	    requests |= TAG_EMS;
 	    break;
@@ -969,12 +1453,132 @@ int main(int argc, char *argv[])
 		requests &= ~TAG_WEATHER_ENABLE;
 	    break;
 	    }
+	case 'L': {
+	    if (sscanf(optarg, "%u:%u", &uMaxChargePower, &uMaxDischargePower) == 2)
+		requests |= TAG_POWER_LIMITS;
+	    else
+		printf("Invalid power limits %s: ignored\n", optarg);
+	    break;
+	    }
+	case 'F': {
+	    fleetPath = optarg;
+	    break;
+	    }
+	case 'j': {
+	    fleetParallel = atoi(optarg);
+	    if (fleetParallel < 1)
+		fleetParallel = 1;
+	    break;
+	    }
+	case 'd': {
+	    deviceName = optarg;
+	    break;
+	    }
+	case 'D': {
+	    devicesSeconds = atoi(optarg);
+	    if (devicesSeconds < 0)
+		devicesSeconds = 0;
+	    break;
+	    }
+	case 'u': {
+	    backend = SOCKET_BACKEND_IO_URING;
+	    break;
+	    }
+	case 'c': {
+	    capturePath = optarg;
+	    break;
+	    }
+	case 'R': {
+	    rollupPath = optarg;
+	    break;
+	    }
+	case 'E': {
+	    energyPath = optarg;
+	    requests |= TAG_ENERGY;
+	    break;
+	    }
+	case 'x': {
+	    bCaptureEncrypted = true;
+	    break;
+	    }
+	case 'r': {
+	    replayPath = optarg;
+	    break;
+	    }
+	case 'p': {
+	    bReplayPace = true;
+	    break;
+	    }
+	case 'n': {
+	    replayRepeat = atoi(optarg);
+	    if (replayRepeat < 1)
+		replayRepeat = 1;
+	    break;
+	    }
+	case 'S': {
+	    statsPath = optarg;
+	    break;
+	    }
+	case 'g': {
+	    if (tagRequest.add(optarg) != RSCP::OK)
+		return -1;
+	    requests |= TAG_PATHS;
+	    break;
+	    }
+	case 'f': {
+	    if (tagRequest.addFile(optarg) != RSCP::OK)
+		return -1;
+	    requests |= TAG_PATHS;
+	    break;
+	    }
 	default:
 	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
 	    break;
 	}
     }
 
+    // the single session modes use one device of the configuration, the first one by default
+    const SRscpDeviceConfig *device = (deviceName != NULL) ? config.find(deviceName) : &config.device(0);
+    if (device == NULL) {
+	printf("Unknown device %s in %s\n", deviceName, CONF_FILE);
+	return -1;
+    }
+    e3dc_config_t e3dc_config = device->e3dc;
+    idleSchedule = config.idlePeriods();
+
+    // a replay fills the rollup and the energy counters and checks the alarms with the frame times of the capture
+    if ((rollupPath != NULL) && !rollup.open(rollupPath))
+	return -1;
+    if ((energyPath != NULL) && !energy.open(energyPath))
+	return -1;
+    const SRscpGlobalConfig & globals = config.globals();
+    if (!globals.alarms.empty()
+	&& !alarms.start(globals.alarms, globals.alarmLog.empty() ? NULL : globals.alarmLog.c_str(),
+	    globals.alarmHook.empty() ? NULL : globals.alarmHook.c_str(),
+	    globals.alarmState.empty() ? NULL : globals.alarmState.c_str()))
+	return -1;
+    if (replayPath != NULL) {
+	int iResult = replayCapture(replayPath, bReplayPace, replayRepeat);
+	closeOutputs();
+	return iResult;
+    }
+
+    if (capturePath != NULL) {
+	if (!capture.openWrite(capturePath)) {
+	    printf("Cannot create capture file %s\n", capturePath);
+	    return -1;
+	}
+	session.setCapture(&capture, bCaptureEncrypted);
+	printf("Capturing frames to %s\n", capturePath);
+    }
+
+
+    if (statsPath != NULL) {
+	stats.setName(e3dc_config.server_ip);
+	session.setStats(&stats);
+	signal(SIGUSR1, handleStatsSignal);
+    }
+
     if(requests & TAG_BATTERY)
 	printf("Get battery details\n");
     if(requests & TAG_EMS)
@@ -985,64 +1589,93 @@ int main(int argc, char *argv[])
 	printf("Set idle periods details\n");
     if(requests & TAG_WEATHER_ENABLE)
 	printf("Set weather enable option\n");
+    if(requests & TAG_PATHS)
+	printf("Get tag paths\n");
+    if(requests & TAG_BATTERY_CELLS)
+	printf("Get battery cells\n");
+    if(requests & TAG_PVI)
+	printf("Get inverter strings and phases\n");
+    if(requests & TAG_POWER_LIMITS)
+	printf("Set power limits\n");
+
+    if (devicesSeconds >= 0)
+	return runDevices(config, backend, devicesSeconds);
+    if (fleetPath != NULL)
+	return runFleet(fleetPath, e3dc_config, requests, backend, fleetParallel);
+
+    // setup the transport for the single session
+    backend = SocketTransportInit(backend, 1);
+    if (backend < 0) {
+	printf("Cannot initialize socket transport. errno %i\n", -backend);
+	return -1;
+    }
+    printf("Using %s transport\n", SocketBackendName(backend));
 
     // connect to server
     while (!iConnected && (conn_retry + 1) > 0) {
 	printf("Connecting to server %s:%i\n", e3dc_config.server_ip, e3dc_config.server_port);
-	iSocket = SocketConnect(e3dc_config.server_ip, e3dc_config.server_port);
+	SSocketConnectInfo connectInfo;
+	int iSocket = SocketConnect(e3dc_config.server_ip, e3dc_config.server_port,
+				    e3dc_config.connect_timeout, &connectInfo);
 	if (iSocket < 0) {
-	    printf("Connection failed\n");
+	    printf("Connection failed: %s (errno %i, %i of %i addresses tried)\n",
+		   SocketErrorString(iSocket), connectInfo.iErrno,
+		   connectInfo.iAttempts, connectInfo.iAddresses);
 	    sleep(1);
 	    conn_retry--;
 	    continue;
 	}
 	iConnected = 1;
-	printf("Connection success\n");
+	session.attach(iSocket);
+	printf("Connection success to %s (resolve %ld us, connect %ld us)\n",
+	       connectInfo.cAddress, connectInfo.lResolveUs, connectInfo.lConnectUs);
 
     }
     if (!iConnected) {
 	printf("Connection failed due to timeout\n");
+	SocketTransportClose();
 	return -1;
     }
     // create AES key and set AES parameters
-    {
-	// initialize AES encryptor and decryptor IV
-	memset(ucDecryptionIV, 0xff, AES_BLOCK_SIZE);
-	memset(ucEncryptionIV, 0xff, AES_BLOCK_SIZE);
-
-	// limit password length to AES_KEY_SIZE
-	int iPasswordLength = strlen(e3dc_config.aes_password);
-	if (iPasswordLength > AES_KEY_SIZE)
-	    iPasswordLength = AES_KEY_SIZE;
-
-	// copy up to 32 bytes of AES key password
-	uint8_t ucAesKey[AES_KEY_SIZE];
-	memset(ucAesKey, 0xff, AES_KEY_SIZE);
-	memcpy(ucAesKey, e3dc_config.aes_password, iPasswordLength);
-
-	// set encryptor and decryptor parameters
-	aesDecrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
-	aesEncrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
-	aesDecrypter.StartDecryption(ucAesKey);
-	aesEncrypter.StartEncryption(ucAesKey);
-    }
+    session.setPassword(e3dc_config.aes_password);
+    session.setAesMode((AES::TableMode) e3dc_config.aes_mode);
 
     authLoop(&e3dc_config);
     if (iAuthenticated) {
 	printf("Authentication success\n");
+	// the loops end regularly, so the rollup and the energy counters write their open buckets
+	signal(SIGINT, handleStopSignal);
+	signal(SIGTERM, handleStopSignal);
+	if (requests & (TAG_BATTERY_CELLS | TAG_PVI))
+	    discoverDevices(requests);
+	// the idle periods are written once before the other requests
+	int loopRequests = requests & ~TAG_SET_IDLE_PERIODS;
+	if (requests & TAG_SET_IDLE_PERIODS)
+	    syncIdlePeriods();
 	// enter the main transmit / receive loop
-	mainLoop(requests);
+	if ((loopRequests != 0) || ((requests == 0) && (pmSeconds == 0) && (wbSeconds == 0)))
+	    mainLoop(loopRequests);
+	if (pmSeconds > 0)
+	    fastPollLoop(pmSeconds, pmDepth, pmOutputPath);
+	if (wbSeconds > 0) {
+	    wallbox.setLimits(e3dc_config.wb_min_current, e3dc_config.wb_max_current, e3dc_config.wb_phases);
+	    wallboxLoop(wbSeconds, wbPeriodMs);
+	}
     } else {
 	printf("Authentication failed\n");
 	// close socket connection
-	SocketClose(iSocket);
-	iSocket = -1;
+	session.close();
+	SocketTransportClose();
+	dumpStats();
 	return -1;
     }
 
     // close socket connection
-    SocketClose(iSocket);
-    iSocket = -1;
+    session.close();
+    SocketTransportClose();
+    dumpStats();
+    closeOutputs();
 
     return 0;
 }
+#endif /* RSCP_NO_MAIN */
@@ -0,0 +1,863 @@
+/*
+ * RscpMockServer.cpp
+ *
+ * Minimal E3DC unit simulation for local benchmarks and dry runs.
+ * It accepts any number of encrypted RSCP connections, answers the authentication request
+ * and responds to every request tag with a synthetic value which changes over time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <vector>
+#include "e3dc_config.h"
+#include "RscpProtocol.h"
+#include "RscpTags.h"
+#include "AES.h"
+
+#define MOCK_MAX_EVENTS         64
+#define MOCK_AUTH_LEVEL         10
+// simulated batteries, each with its DCB count of mock_dcb_counts
+#define MOCK_BATTERIES          2
+#define MOCK_DCB_CELLS          16
+#define MOCK_DCB_SENSORS        8
+// simulated inverter with index 0
+#define MOCK_PVI_STRINGS        2
+#define MOCK_PVI_PHASES         3
+#define MOCK_PVI_SENSORS        2
+
+// bit which marks a response tag
+#define TAG_RESPONSE_BIT        0x00800000
+
+typedef struct {
+    int  port;
+    char aes_password[128];
+    char user[128];
+    char password[128];
+    int  delay_us;
+    int  verbose;
+}mock_config_t;
+
+typedef struct {
+    int iSocket;
+    int iAuthenticated;
+    AES aesEncrypter;
+    AES aesDecrypter;
+    uint8_t ucEncryptionIV[AES_BLOCK_SIZE];
+    uint8_t ucDecryptionIV[AES_BLOCK_SIZE];
+    std::vector<uint8_t> vecReceiveBuffer;
+    int iReceivedBytes;
+}mock_client_t;
+
+static mock_config_t mock_config;
+// idle periods of the simulated unit, one per type and day
+static idle_period_t mock_idle_periods[2 * 7];
+static const uint8_t mock_dcb_counts[MOCK_BATTERIES] = { 3, 2 };
+// charge current of the simulated wallbox in A, set with TAG_WB_REQ_SET_MODE
+static int mock_wb_current = 0;
+static volatile sig_atomic_t bStop = 0;
+static struct timespec startTime;
+// CLOCK_REALTIME of the start, the history of the simulated unit begins there
+static double startRealTime;
+
+static void handleSignal(int /* sig */)
+{
+    bStop = 1;
+}
+
+static double uptime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startTime.tv_sec) + (now.tv_nsec - startTime.tv_nsec) / 1e9;
+}
+
+// slowly changing value which differs per tag, at \var t seconds after the start
+static double mockWaveAt(SRscpTag tag, double base, double amplitude, double t)
+{
+    return base + amplitude * sin(t / 30.0 + (tag & 0xFF));
+}
+
+static double mockWave(SRscpTag tag, double base, double amplitude)
+{
+    return mockWaveAt(tag, base, amplitude, uptime());
+}
+
+// power of the simulated wallbox, it charges on three phases from the minimum current of 6 A on
+static double mockWallboxPower()
+{
+    return (mock_wb_current >= 6) ? mock_wb_current * 230.0 * 3 : 0.0;
+}
+
+static void appendMockValue(RscpProtocol * protocol, SRscpValue * response,
+			    SRscpTag tag)
+{
+    switch (tag) {
+    case TAG_EMS_POWER_PV:
+	protocol->appendValue(response, tag, (int32_t) mockWave(tag, 3000, 2500));
+	break;
+    case TAG_EMS_POWER_BAT:
+	protocol->appendValue(response, tag, (int32_t) mockWave(tag, 0, 2000));
+	break;
+    case TAG_EMS_POWER_HOME:
+	protocol->appendValue(response, tag, (int32_t) mockWave(tag, 800, 400));
+	break;
+    case TAG_EMS_POWER_GRID:
+	// the balance of the other values, so the wallbox control sees its own effect
+	protocol->appendValue(response, tag, (int32_t) (mockWave(TAG_EMS_POWER_HOME, 800, 400)
+	    + mockWave(TAG_EMS_POWER_BAT, 0, 2000) + mockWallboxPower() - mockWave(TAG_EMS_POWER_PV, 3000, 2500)));
+	break;
+    case TAG_EMS_POWER_WB_ALL:
+	protocol->appendValue(response, tag, (int32_t) mockWallboxPower());
+	break;
+    case TAG_EMS_POWER_WB_SOLAR: {
+	double fPv = mockWave(TAG_EMS_POWER_PV, 3000, 2500);
+	protocol->appendValue(response, tag, (int32_t) ((mockWallboxPower() < fPv) ? mockWallboxPower() : fPv));
+	break;
+    }
+    case TAG_EMS_POWER_ADD:
+	protocol->appendValue(response, tag, (int32_t) 0);
+	break;
+    case TAG_EMS_STATUS:
+	protocol->appendValue(response, tag, (uint32_t) 0);
+	break;
+    case TAG_EMS_MODE:
+	protocol->appendValue(response, tag, (uint8_t) 0);
+	break;
+    case TAG_BAT_RSOC:
+	protocol->appendValue(response, tag, (float) mockWave(tag, 55, 40));
+	break;
+    case TAG_BAT_MODULE_VOLTAGE:
+	protocol->appendValue(response, tag, (float) mockWave(tag, 52, 2));
+	break;
+    case TAG_BAT_CURRENT:
+	protocol->appendValue(response, tag, (float) mockWave(tag, 0, 20));
+	break;
+    case TAG_BAT_STATUS_CODE:
+    case TAG_BAT_ERROR_CODE:
+	protocol->appendValue(response, tag, (uint32_t) 0);
+	break;
+    case TAG_PM_POWER_L1:
+    case TAG_PM_POWER_L2:
+    case TAG_PM_POWER_L3:
+	protocol->appendValue(response, tag, mockWave(tag, 300, 250));
+	break;
+    case TAG_PM_ENERGY_L1:
+    case TAG_PM_ENERGY_L2:
+    case TAG_PM_ENERGY_L3:
+	// meter readings only grow, 300 W average per phase
+	protocol->appendValue(response, tag, 1000000.0 + uptime() * 300.0 / 3600.0);
+	break;
+    default:
+	protocol->appendValue(response, tag, (int32_t) mockWave(tag, 1000, 500));
+	break;
+    }
+}
+
+// cell voltages or temperatures of one DCB, the index is the parameter of the request
+/*
+ * Day sums of the simulated powers since the start of the mock in the requested time range,
+ * integrated in steps of one second. The wallbox is counted with its current charge power.
+ */
+static void appendMockHistoryDay(RscpProtocol * protocol, SRscpValue * response,
+				 SRscpValue * request)
+{
+    double fStart = 0.0, fSpan = 0.0;
+    std::vector < SRscpValue > requestData = protocol->getValueAsContainer(request);
+    for (size_t i = 0; i < requestData.size(); i++) {
+	if (requestData[i].dataType != RSCP::eTypeTimestamp)
+	    continue;
+	SRscpTimestamp timestamp = protocol->getValueAsTimestamp(&requestData[i]);
+	if (requestData[i].tag == TAG_DB_REQ_HISTORY_TIME_START)
+	    fStart = timestamp.seconds;
+	else if (requestData[i].tag == TAG_DB_REQ_HISTORY_TIME_SPAN)
+	    fSpan = timestamp.seconds;
+    }
+    protocol->destroyValueData(requestData);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    double fFrom = (fStart > startRealTime) ? fStart : startRealTime;
+    double fTo = (fStart + fSpan < now.tv_sec) ? fStart + fSpan : now.tv_sec;
+    double fBatIn = 0, fBatOut = 0, fPv = 0, fGridIn = 0, fGridOut = 0, fHome = 0;
+    for (double t = fFrom; t < fTo; t += 1.0) {
+	double u = t - startRealTime;
+	double pv = mockWaveAt(TAG_EMS_POWER_PV, 3000, 2500, u);
+	double bat = mockWaveAt(TAG_EMS_POWER_BAT, 0, 2000, u);
+	double home = mockWaveAt(TAG_EMS_POWER_HOME, 800, 400, u);
+	double grid = home + bat + mockWallboxPower() - pv;
+	fPv += pv;
+	fHome += home;
+	(bat >= 0 ? fBatIn : fBatOut) += fabs(bat);
+	(grid >= 0 ? fGridIn : fGridOut) += fabs(grid);
+    }
+    SRscpValue history, sums;
+    protocol->createContainerValue(&history, TAG_DB_HISTORY_DATA_DAY);
+    protocol->createContainerValue(&sums, TAG_DB_SUM_CONTAINER);
+    protocol->appendValue(&sums, TAG_DB_GRAPH_INDEX, (float) 0);
+    protocol->appendValue(&sums, TAG_DB_BAT_POWER_IN, (float) (fBatIn / 3600.0));
+    protocol->appendValue(&sums, TAG_DB_BAT_POWER_OUT, (float) (fBatOut / 3600.0));
+    protocol->appendValue(&sums, TAG_DB_DC_POWER, (float) (fPv / 3600.0));
+    protocol->appendValue(&sums, TAG_DB_GRID_POWER_IN, (float) (fGridIn / 3600.0));
+    protocol->appendValue(&sums, TAG_DB_GRID_POWER_OUT, (float) (fGridOut / 3600.0));
+    protocol->appendValue(&sums, TAG_DB_CONSUMPTION, (float) (fHome / 3600.0));
+    protocol->appendValue(&history, sums);
+    protocol->appendValue(response, history);
+    protocol->destroyValueData(sums);
+    protocol->destroyValueData(history);
+}
+
+static void appendMockCells(RscpProtocol * protocol, SRscpValue * response,
+			    SRscpValue * request, uint8_t ucBattery, uint8_t ucDcbs)
+{
+    bool bVoltages = (request->tag == TAG_BAT_REQ_DCB_ALL_CELL_VOLTAGES);
+    SRscpTag responseTag = request->tag | TAG_RESPONSE_BIT;
+    uint16_t uDcb = (request->length == sizeof(uint8_t)) ? protocol->getValueAsUChar8(request)
+	: protocol->getValueAsUInt16(request);
+    if (uDcb >= ucDcbs) {
+	protocol->appendErrorValue(response, responseTag, (uint32_t) RSCP_ERR_OUT_OF_BOUNDS);
+	return;
+    }
+    SRscpValue cellsContainer;
+    protocol->createContainerValue(&cellsContainer, responseTag);
+    protocol->appendValue(&cellsContainer, TAG_BAT_DCB_INDEX, uDcb);
+    SRscpValue cellData;
+    protocol->createContainerValue(&cellData, TAG_BAT_DATA);
+    int iCells = bVoltages ? MOCK_DCB_CELLS : MOCK_DCB_SENSORS;
+    for (int i = 0; i < iCells; i++) {
+	SRscpTag cellTag = bVoltages ? TAG_BAT_DCB_CELL_VOLTAGE : TAG_BAT_DCB_CELL_TEMPERATURE;
+	// every cell drifts on its own around the nominal value
+	SRscpTag phase = (ucBattery << 6) + (uDcb << 4) + i;
+	if (bVoltages)
+	    protocol->appendValue(&cellData, cellTag, (float) mockWave(phase, 3.3, 0.02));
+	else
+	    protocol->appendValue(&cellData, cellTag, (float) mockWave(phase, 25, 3));
+    }
+    protocol->appendValue(&cellsContainer, cellData);
+    protocol->destroyValueData(cellData);
+    protocol->appendValue(response, cellsContainer);
+    protocol->destroyValueData(cellsContainer);
+}
+
+// TAG_BAT_REQ_DATA of the simulated batteries, other indexes answer each request with an error
+static void appendMockBatteryData(RscpProtocol * protocol, SRscpValue * response,
+				  SRscpValue * request)
+{
+    std::vector < SRscpValue > requestData = protocol->getValueAsContainer(request);
+    uint8_t ucBattery = 0;
+    for (size_t i = 0; i < requestData.size(); i++) {
+	if (requestData[i].tag == TAG_BAT_INDEX)
+	    ucBattery = protocol->getValueAsUChar8(&requestData[i]);
+    }
+    SRscpValue container;
+    protocol->createContainerValue(&container, TAG_BAT_DATA);
+    for (size_t i = 0; i < requestData.size(); i++) {
+	SRscpValue *value = &requestData[i];
+	if (value->tag == TAG_BAT_INDEX)
+	    protocol->appendValue(&container, TAG_BAT_INDEX, ucBattery);
+	else if (ucBattery >= MOCK_BATTERIES)
+	    protocol->appendErrorValue(&container, value->tag | TAG_RESPONSE_BIT,
+				       (uint32_t) RSCP_ERR_NOT_AVAILABLE);
+	else if (value->tag == TAG_BAT_REQ_DCB_COUNT)
+	    protocol->appendValue(&container, TAG_BAT_DCB_COUNT, mock_dcb_counts[ucBattery]);
+	else if ((value->tag == TAG_BAT_REQ_DCB_ALL_CELL_VOLTAGES)
+		 || (value->tag == TAG_BAT_REQ_DCB_ALL_CELL_TEMPERATURES))
+	    appendMockCells(protocol, &container, value, ucBattery, mock_dcb_counts[ucBattery]);
+	else
+	    appendMockValue(protocol, &container, value->tag | TAG_RESPONSE_BIT);
+    }
+    protocol->destroyValueData(requestData);
+    protocol->appendValue(response, container);
+    protocol->destroyValueData(container);
+}
+
+// value of one string, phase or sensor, the index is the parameter of the request
+static void appendMockPviValue(RscpProtocol * protocol, SRscpValue * response, SRscpValue * request)
+{
+    SRscpTag responseTag = request->tag | TAG_RESPONSE_BIT;
+    uint16_t uIndex = (request->length == sizeof(uint8_t)) ? protocol->getValueAsUChar8(request)
+	: protocol->getValueAsUInt16(request);
+    uint16_t uCount = ((request->tag & 0xFFFFF000) == (TAG_PVI_REQ_DC_POWER & 0xFFFFF000)) ? MOCK_PVI_STRINGS
+	: ((request->tag & 0xFFFFF000) == (TAG_PVI_REQ_AC_POWER & 0xFFFFF000)) ? MOCK_PVI_PHASES : MOCK_PVI_SENSORS;
+    if (uIndex >= uCount) {
+	protocol->appendErrorValue(response, responseTag, (uint32_t) RSCP_ERR_OUT_OF_BOUNDS);
+	return;
+    }
+    double fValue;
+    switch (request->tag) {
+    case TAG_PVI_REQ_DC_POWER:
+	fValue = mockWave(request->tag + uIndex, 1500, 1400);
+	break;
+    case TAG_PVI_REQ_DC_VOLTAGE:
+	fValue = mockWave(request->tag + uIndex, 450, 50);
+	break;
+    case TAG_PVI_REQ_DC_CURRENT:
+	fValue = mockWave(request->tag + uIndex, 3.5, 3);
+	break;
+    case TAG_PVI_REQ_AC_VOLTAGE:
+	fValue = mockWave(request->tag + uIndex, 230, 5);
+	break;
+    case TAG_PVI_REQ_AC_CURRENT:
+	fValue = mockWave(request->tag + uIndex, 4, 3.5);
+	break;
+    case TAG_PVI_REQ_TEMPERATURE:
+	fValue = mockWave(request->tag + uIndex, 40, 10);
+	break;
+    default:
+	fValue = mockWave(request->tag + uIndex, 900, 800);
+	break;
+    }
+    SRscpValue container;
+    protocol->createContainerValue(&container, responseTag);
+    protocol->appendValue(&container, TAG_PVI_INDEX, uIndex);
+    protocol->appendValue(&container, TAG_PVI_VALUE, (float) fValue);
+    protocol->appendValue(response, container);
+    protocol->destroyValueData(container);
+}
+
+// TAG_PVI_REQ_DATA of the simulated inverter, other indexes answer each request with an error
+static void appendMockPviData(RscpProtocol * protocol, SRscpValue * response,
+			      SRscpValue * request)
+{
+    std::vector < SRscpValue > requestData = protocol->getValueAsContainer(request);
+    uint8_t ucInverter = 0;
+    for (size_t i = 0; i < requestData.size(); i++) {
+	if (requestData[i].tag == TAG_PVI_INDEX)
+	    ucInverter = protocol->getValueAsUChar8(&requestData[i]);
+    }
+    SRscpValue container;
+    protocol->createContainerValue(&container, TAG_PVI_DATA);
+    for (size_t i = 0; i < requestData.size(); i++) {
+	SRscpValue *value = &requestData[i];
+	if (value->tag == TAG_PVI_INDEX)
+	    protocol->appendValue(&container, TAG_PVI_INDEX, ucInverter);
+	else if (ucInverter != 0)
+	    protocol->appendErrorValue(&container, value->tag | TAG_RESPONSE_BIT,
+				       (uint32_t) RSCP_ERR_NOT_AVAILABLE);
+	else if (value->tag == TAG_PVI_REQ_DC_MAX_STRING_COUNT)
+	    protocol->appendValue(&container, TAG_PVI_DC_MAX_STRING_COUNT, (uint8_t) MOCK_PVI_STRINGS);
+	else if (value->tag == TAG_PVI_REQ_AC_MAX_PHASE_COUNT)
+	    protocol->appendValue(&container, TAG_PVI_AC_MAX_PHASE_COUNT, (uint8_t) MOCK_PVI_PHASES);
+	else if (value->tag == TAG_PVI_REQ_TEMPERATURE_COUNT)
+	    protocol->appendValue(&container, TAG_PVI_TEMPERATURE_COUNT, (uint8_t) MOCK_PVI_SENSORS);
+	else if (value->dataType != RSCP::eTypeNone)
+	    appendMockPviValue(protocol, &container, value);
+	else
+	    appendMockValue(protocol, &container, value->tag | TAG_RESPONSE_BIT);
+    }
+    protocol->destroyValueData(requestData);
+    protocol->appendValue(response, container);
+    protocol->destroyValueData(container);
+}
+
+// TAG_WB_REQ_DATA of the simulated wallbox 0, other indexes answer each request with an error
+static void appendMockWallboxData(RscpProtocol * protocol, SRscpValue * response,
+				  SRscpValue * request)
+{
+    std::vector < SRscpValue > requestData = protocol->getValueAsContainer(request);
+    uint8_t ucWallbox = 0;
+    for (size_t i = 0; i < requestData.size(); i++) {
+	if (requestData[i].tag == TAG_WB_INDEX)
+	    ucWallbox = protocol->getValueAsUChar8(&requestData[i]);
+    }
+    SRscpValue container;
+    protocol->createContainerValue(&container, TAG_WB_DATA);
+    for (size_t i = 0; i < requestData.size(); i++) {
+	SRscpValue *value = &requestData[i];
+	if (value->tag == TAG_WB_INDEX)
+	    protocol->appendValue(&container, TAG_WB_INDEX, ucWallbox);
+	else if (ucWallbox != 0)
+	    protocol->appendErrorValue(&container, value->tag | TAG_RESPONSE_BIT,
+				       (uint32_t) RSCP_ERR_NOT_AVAILABLE);
+	else if (value->tag == TAG_WB_REQ_SET_MODE) {
+	    std::vector < SRscpValue > modeData = protocol->getValueAsContainer(value);
+	    for (size_t j = 0; j < modeData.size(); j++) {
+		if (modeData[j].tag == TAG_WB_MODE_PARAM_MAX_CURRENT)
+		    mock_wb_current = protocol->getValueAsUChar8(&modeData[j]);
+	    }
+	    protocol->destroyValueData(modeData);
+	    if (mock_config.verbose)
+		printf("Wallbox current %i A\n", mock_wb_current);
+	    protocol->appendValue(&container, TAG_WB_SET_MODE, true);
+	}
+	else if (value->tag == TAG_WB_REQ_STATUS)
+	    // car connected, charging while the current is high enough
+	    protocol->appendValue(&container, TAG_WB_STATUS, (uint8_t) ((mock_wb_current >= 6) ? 0xA8 : 0x88));
+	else if ((value->tag == TAG_WB_REQ_PM_POWER_L1) || (value->tag == TAG_WB_REQ_PM_POWER_L2)
+		 || (value->tag == TAG_WB_REQ_PM_POWER_L3))
+	    protocol->appendValue(&container, value->tag | TAG_RESPONSE_BIT, mockWallboxPower() / 3);
+	else
+	    appendMockValue(protocol, &container, value->tag | TAG_RESPONSE_BIT);
+    }
+    protocol->destroyValueData(requestData);
+    protocol->appendValue(response, container);
+    protocol->destroyValueData(container);
+}
+
+static void appendMockIdlePeriod(RscpProtocol * protocol, SRscpValue * response,
+				 const idle_period_t & period)
+{
+    SRscpValue periodContainer;
+    protocol->createContainerValue(&periodContainer, TAG_EMS_IDLE_PERIOD);
+    protocol->appendValue(&periodContainer, TAG_EMS_IDLE_PERIOD_TYPE, period.type);
+    protocol->appendValue(&periodContainer, TAG_EMS_IDLE_PERIOD_DAY, period.day);
+    protocol->appendValue(&periodContainer, TAG_EMS_IDLE_PERIOD_ACTIVE, (bool) period.active);
+    SRscpValue timeContainer;
+    protocol->createContainerValue(&timeContainer, TAG_EMS_IDLE_PERIOD_START);
+    protocol->appendValue(&timeContainer, TAG_EMS_IDLE_PERIOD_HOUR, period.start.hour);
+    protocol->appendValue(&timeContainer, TAG_EMS_IDLE_PERIOD_MINUTE, period.start.minute);
+    protocol->appendValue(&periodContainer, timeContainer);
+    protocol->destroyValueData(timeContainer);
+    protocol->createContainerValue(&timeContainer, TAG_EMS_IDLE_PERIOD_END);
+    protocol->appendValue(&timeContainer, TAG_EMS_IDLE_PERIOD_HOUR, period.stop.hour);
+    protocol->appendValue(&timeContainer, TAG_EMS_IDLE_PERIOD_MINUTE, period.stop.minute);
+    protocol->appendValue(&periodContainer, timeContainer);
+    protocol->destroyValueData(timeContainer);
+    protocol->appendValue(response, periodContainer);
+    protocol->destroyValueData(periodContainer);
+}
+
+static void readMockIdleTime(RscpProtocol * protocol, SRscpValue * value, idle_time_t * time)
+{
+    std::vector < SRscpValue > timeData = protocol->getValueAsContainer(value);
+    for (size_t i = 0; i < timeData.size(); i++) {
+	if (timeData[i].tag == TAG_EMS_IDLE_PERIOD_HOUR)
+	    time->hour = protocol->getValueAsUChar8(&timeData[i]);
+	else if (timeData[i].tag == TAG_EMS_IDLE_PERIOD_MINUTE)
+	    time->minute = protocol->getValueAsUChar8(&timeData[i]);
+    }
+    protocol->destroyValueData(timeData);
+}
+
+// store the idle periods of a TAG_EMS_REQ_SET_IDLE_PERIODS container, returns false on invalid content
+static bool setMockIdlePeriods(RscpProtocol * protocol, SRscpValue * request)
+{
+    bool bValid = true;
+    std::vector < SRscpValue > periods = protocol->getValueAsContainer(request);
+    for (size_t i = 0; i < periods.size(); i++) {
+	if (periods[i].tag != TAG_EMS_IDLE_PERIOD)
+	    continue;
+	idle_period_t period;
+	memset(&period, 0, sizeof(period));
+	std::vector < SRscpValue > periodData = protocol->getValueAsContainer(&periods[i]);
+	for (size_t j = 0; j < periodData.size(); j++) {
+	    switch (periodData[j].tag) {
+	    case TAG_EMS_IDLE_PERIOD_TYPE:
+		period.type = protocol->getValueAsUChar8(&periodData[j]);
+		break;
+	    case TAG_EMS_IDLE_PERIOD_DAY:
+		period.day = protocol->getValueAsUChar8(&periodData[j]);
+		break;
+	    case TAG_EMS_IDLE_PERIOD_ACTIVE:
+		period.active = protocol->getValueAsBool(&periodData[j]);
+		break;
+	    case TAG_EMS_IDLE_PERIOD_START:
+		readMockIdleTime(protocol, &periodData[j], &period.start);
+		break;
+	    case TAG_EMS_IDLE_PERIOD_END:
+		readMockIdleTime(protocol, &periodData[j], &period.stop);
+		break;
+	    }
+	}
+	protocol->destroyValueData(periodData);
+	if ((period.type > UNLOAD) || (period.day > SUNDAY) || (period.start.hour > 23)
+	    || (period.stop.hour > 23) || (period.start.minute > 59) || (period.stop.minute > 59))
+	    bValid = false;
+	else
+	    mock_idle_periods[period.type * 7 + period.day] = period;
+    }
+    protocol->destroyValueData(periods);
+    return bValid;
+}
+
+static void appendMockResponse(RscpProtocol * protocol, SRscpValue * response,
+			       SRscpValue * request, mock_client_t * client)
+{
+    if (!client->iAuthenticated && (request->tag != TAG_RSCP_REQ_AUTHENTICATION)) {
+	protocol->appendErrorValue(response, request->tag | TAG_RESPONSE_BIT,
+				   (uint32_t) RSCP_ERR_ACCESS_DENIED);
+	return;
+    }
+    switch (request->tag) {
+    case TAG_RSCP_REQ_AUTHENTICATION:{
+	    std::vector < SRscpValue > authData =
+		protocol->getValueAsContainer(request);
+	    std::string user, password;
+	    for (size_t i = 0; i < authData.size(); i++) {
+		if (authData[i].tag == TAG_RSCP_AUTHENTICATION_USER)
+		    user = protocol->getValueAsString(&authData[i]);
+		else if (authData[i].tag == TAG_RSCP_AUTHENTICATION_PASSWORD)
+		    password = protocol->getValueAsString(&authData[i]);
+	    }
+	    protocol->destroyValueData(authData);
+	    // empty credentials in the mock configuration accept everybody
+	    uint8_t ucLevel = MOCK_AUTH_LEVEL;
+	    if ((mock_config.user[0] && user != mock_config.user)
+		|| (mock_config.password[0] && password != mock_config.password))
+		ucLevel = 0;
+	    client->iAuthenticated = (ucLevel > 0);
+	    protocol->appendValue(response, TAG_RSCP_AUTHENTICATION, ucLevel);
+	    break;
+	}
+    case TAG_EMS_REQ_GET_POWER_SETTINGS:{
+	    SRscpValue container;
+	    protocol->createContainerValue(&container, TAG_EMS_GET_POWER_SETTINGS);
+	    protocol->appendValue(&container, TAG_EMS_POWER_LIMITS_USED, true);
+	    protocol->appendValue(&container, TAG_EMS_MAX_CHARGE_POWER, (uint32_t) 3000);
+	    protocol->appendValue(&container, TAG_EMS_MAX_DISCHARGE_POWER, (uint32_t) 3000);
+	    protocol->appendValue(&container, TAG_EMS_DISCHARGE_START_POWER, (uint32_t) 65);
+	    protocol->appendValue(&container, TAG_EMS_POWERSAVE_ENABLED, true);
+	    protocol->appendValue(&container, TAG_EMS_WEATHER_REGULATED_CHARGE_ENABLED, false);
+	    protocol->appendValue(response, container);
+	    protocol->destroyValueData(container);
+	    break;
+	}
+    case TAG_EMS_REQ_SET_POWER_SETTINGS:{
+	    // every accepted setting is answered with its result tag and 0 for success
+	    SRscpValue container;
+	    protocol->createContainerValue(&container, TAG_EMS_SET_POWER_SETTINGS);
+	    std::vector < SRscpValue > settings = protocol->getValueAsContainer(request);
+	    for (size_t i = 0; i < settings.size(); i++)
+		protocol->appendValue(&container, settings[i].tag | TAG_RESPONSE_BIT, (int8_t) 0);
+	    protocol->destroyValueData(settings);
+	    protocol->appendValue(response, container);
+	    protocol->destroyValueData(container);
+	    break;
+	}
+    case TAG_EMS_REQ_GET_IDLE_PERIODS:{
+	    SRscpValue container;
+	    protocol->createContainerValue(&container, TAG_EMS_GET_IDLE_PERIODS);
+	    for (size_t i = 0; i < sizeof(mock_idle_periods) / sizeof(mock_idle_periods[0]); i++)
+		appendMockIdlePeriod(protocol, &container, mock_idle_periods[i]);
+	    protocol->appendValue(response, container);
+	    protocol->destroyValueData(container);
+	    break;
+	}
+    case TAG_EMS_REQ_SET_IDLE_PERIODS:
+	protocol->appendValue(response, TAG_EMS_SET_IDLE_PERIODS,
+			      setMockIdlePeriods(protocol, request));
+	break;
+    case TAG_BAT_REQ_DATA:
+	appendMockBatteryData(protocol, response, request);
+	break;
+    case TAG_PVI_REQ_DATA:
+	appendMockPviData(protocol, response, request);
+	break;
+    case TAG_WB_REQ_DATA:
+	appendMockWallboxData(protocol, response, request);
+	break;
+    case TAG_DB_REQ_HISTORY_DATA_DAY:
+	appendMockHistoryDay(protocol, response, request);
+	break;
+    default:
+	if (request->dataType == RSCP::eTypeContainer) {
+	    // answer each request inside the container, parameters like indexes are echoed
+	    SRscpValue container;
+	    protocol->createContainerValue(&container, request->tag | TAG_RESPONSE_BIT);
+	    std::vector < SRscpValue > requestData =
+		protocol->getValueAsContainer(request);
+	    for (size_t i = 0; i < requestData.size(); i++) {
+		if (requestData[i].dataType == RSCP::eTypeNone
+		    || requestData[i].dataType == RSCP::eTypeContainer)
+		    appendMockResponse(protocol, &container, &requestData[i], client);
+		else
+		    protocol->appendValue(&container, requestData[i].tag,
+					  requestData[i].data, requestData[i].length,
+					  requestData[i].dataType);
+	    }
+	    protocol->destroyValueData(requestData);
+	    protocol->appendValue(response, container);
+	    protocol->destroyValueData(container);
+	}
+	else {
+	    appendMockValue(protocol, response, request->tag | TAG_RESPONSE_BIT);
+	}
+	break;
+    }
+}
+
+static int sendMockFrame(mock_client_t * client, SRscpFrameBuffer * frameBuffer)
+{
+    std::vector < uint8_t > encryptionBuffer;
+    encryptionBuffer.resize(ROUNDUP(frameBuffer->dataLength, AES_BLOCK_SIZE));
+    memset(&encryptionBuffer[0] + frameBuffer->dataLength, 0,
+	   encryptionBuffer.size() - frameBuffer->dataLength);
+    memcpy(&encryptionBuffer[0], frameBuffer->data, frameBuffer->dataLength);
+    client->aesEncrypter.SetIV(client->ucEncryptionIV, AES_BLOCK_SIZE);
+    client->aesEncrypter.Encrypt(&encryptionBuffer[0], &encryptionBuffer[0],
+				 encryptionBuffer.size() / AES_BLOCK_SIZE);
+    memcpy(client->ucEncryptionIV,
+	   &encryptionBuffer[0] + encryptionBuffer.size() - AES_BLOCK_SIZE,
+	   AES_BLOCK_SIZE);
+    size_t sent = 0;
+    while (sent < encryptionBuffer.size()) {
+	int iResult = send(client->iSocket, &encryptionBuffer[0] + sent,
+			   encryptionBuffer.size() - sent, MSG_NOSIGNAL);
+	if (iResult <= 0)
+	    return -1;
+	sent += iResult;
+    }
+    return 0;
+}
+
+// returns the processed bytes, 0 if the frame is incomplete or a negative error code
+static int handleMockFrame(mock_client_t * client, const uint8_t * data, int iLength)
+{
+    RscpProtocol protocol;
+    SRscpFrame frame;
+    int iResult = protocol.parseFrame(data, iLength, &frame);
+    if (iResult == RSCP::ERR_INVALID_FRAME_LENGTH)
+	return 0;
+    if (iResult < 0)
+	return iResult;
+
+    SRscpValue rootValue;
+    protocol.createContainerValue(&rootValue, 0);
+    for (size_t i = 0; i < frame.data.size(); i++)
+	appendMockResponse(&protocol, &rootValue, &frame.data[i], client);
+    protocol.destroyFrameData(frame);
+
+    if (mock_config.delay_us > 0)
+	usleep(mock_config.delay_us);
+
+    SRscpFrameBuffer frameBuffer;
+    memset(&frameBuffer, 0, sizeof(frameBuffer));
+    protocol.createFrameAsBuffer(&frameBuffer, rootValue.data, rootValue.length, true);
+    protocol.destroyValueData(rootValue);
+    int iSendResult = sendMockFrame(client, &frameBuffer);
+    protocol.destroyFrameData(&frameBuffer);
+    if (iSendResult < 0)
+	return -1;
+    return iResult;
+}
+
+// returns false if the client has to be closed
+static bool receiveMockData(mock_client_t * client)
+{
+    if (client->vecReceiveBuffer.size() - client->iReceivedBytes < 4096) {
+	if (client->vecReceiveBuffer.size() > RSCP_MAX_FRAME_LENGTH)
+	    return false;
+	client->vecReceiveBuffer.resize(client->vecReceiveBuffer.size() + 4096);
+    }
+    int iResult = recv(client->iSocket,
+		       &client->vecReceiveBuffer[0] + client->iReceivedBytes,
+		       client->vecReceiveBuffer.size() - client->iReceivedBytes,
+		       MSG_DONTWAIT);
+    if (iResult < 0)
+	return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+    if (iResult == 0)
+	return false;
+    client->iReceivedBytes += iResult;
+
+    while (true) {
+	int iLength = ROUNDDOWN(client->iReceivedBytes, AES_BLOCK_SIZE);
+	if (iLength == 0)
+	    break;
+	std::vector < uint8_t > decryptionBuffer(iLength);
+	client->aesDecrypter.SetIV(client->ucDecryptionIV, AES_BLOCK_SIZE);
+	client->aesDecrypter.Decrypt(&client->vecReceiveBuffer[0],
+				     &decryptionBuffer[0],
+				     iLength / AES_BLOCK_SIZE);
+	int iProcessedBytes = handleMockFrame(client, &decryptionBuffer[0], iLength);
+	if (iProcessedBytes < 0) {
+	    if (mock_config.verbose)
+		printf("Client %i: error parsing RSCP frame: %i\n",
+		       client->iSocket, iProcessedBytes);
+	    return false;
+	}
+	if (iProcessedBytes == 0)
+	    break;
+	iProcessedBytes = ROUNDUP(iProcessedBytes, AES_BLOCK_SIZE);
+	memcpy(client->ucDecryptionIV,
+	       &client->vecReceiveBuffer[0] + iProcessedBytes - AES_BLOCK_SIZE,
+	       AES_BLOCK_SIZE);
+	memmove(&client->vecReceiveBuffer[0],
+		&client->vecReceiveBuffer[0] + iProcessedBytes,
+		client->iReceivedBytes - iProcessedBytes);
+	client->iReceivedBytes -= iProcessedBytes;
+    }
+    return true;
+}
+
+static mock_client_t *acceptMockClient(int iListen)
+{
+    int iSocket = accept4(iListen, NULL, NULL, SOCK_CLOEXEC);
+    if (iSocket < 0)
+	return NULL;
+    int enable = 1;
+    setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, (char *) &enable, sizeof(enable));
+
+    mock_client_t *client = new mock_client_t;
+    client->iSocket = iSocket;
+    client->iAuthenticated = 0;
+    client->iReceivedBytes = 0;
+    memset(client->ucEncryptionIV, 0xff, AES_BLOCK_SIZE);
+    memset(client->ucDecryptionIV, 0xff, AES_BLOCK_SIZE);
+
+    int iPasswordLength = strlen(mock_config.aes_password);
+    if (iPasswordLength > AES_KEY_SIZE)
+	iPasswordLength = AES_KEY_SIZE;
+    uint8_t ucAesKey[AES_KEY_SIZE];
+    memset(ucAesKey, 0xff, AES_KEY_SIZE);
+    memcpy(ucAesKey, mock_config.aes_password, iPasswordLength);
+    client->aesDecrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+    client->aesEncrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+    client->aesDecrypter.StartDecryption(ucAesKey);
+    client->aesEncrypter.StartEncryption(ucAesKey);
+    return client;
+}
+
+void showhelp(char *prog)
+{
+    printf("Usage:\n");
+    printf("%s [-hv] [-p port] [-k aes_password] [-u user] [-w password] [-d delay_us]\n", prog);
+    printf("  --help, -h         \tshows this help\n");
+    printf("  --port, -p         \tlisten port (default 5033)\n");
+    printf("  --aes, -k          \tAES password (default rscp_password)\n");
+    printf("  --user, -u         \taccepted user, any if not set\n");
+    printf("  --password, -w     \taccepted password, any if not set\n");
+    printf("  --delay, -d        \tresponse delay in microseconds\n");
+    printf("  --verbose, -v      \tprint connection events\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    memset(&mock_config, 0, sizeof(mock_config));
+    mock_config.port = 5033;
+    strcpy(mock_config.aes_password, "rscp_password");
+
+    while (1) {
+	static struct option long_options[] = {
+	    {"help",		no_argument,		0, 'h'},
+	    {"port",		required_argument,	0, 'p'},
+	    {"aes",		required_argument,	0, 'k'},
+	    {"user",		required_argument,	0, 'u'},
+	    {"password",	required_argument,	0, 'w'},
+	    {"delay",		required_argument,	0, 'd'},
+	    {"verbose",		no_argument,		0, 'v'},
+	    {0,			0,			0, 0 }
+	};
+	int option_index = 0;
+	opt = getopt_long(argc, argv, "hp:k:u:w:d:v", long_options, &option_index);
+
+	if(opt == -1)
+	    break;
+
+	switch (opt) {
+	case 'h':
+	    showhelp(argv[0]);
+	    return 0;
+	case 'p':
+	    mock_config.port = atoi(optarg);
+	    break;
+	case 'k':
+	    snprintf(mock_config.aes_password, sizeof(mock_config.aes_password), "%s", optarg);
+	    break;
+	case 'u':
+	    snprintf(mock_config.user, sizeof(mock_config.user), "%s", optarg);
+	    break;
+	case 'w':
+	    snprintf(mock_config.password, sizeof(mock_config.password), "%s", optarg);
+	    break;
+	case 'd':
+	    mock_config.delay_us = atoi(optarg);
+	    break;
+	case 'v':
+	    mock_config.verbose = 1;
+	    break;
+	default:
+	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
+	    break;
+	}
+    }
+
+    for (int i = 0; i < 2 * 7; i++) {
+	mock_idle_periods[i].type = i / 7;
+	mock_idle_periods[i].day = i % 7;
+	mock_idle_periods[i].active = INACTIVE;
+	mock_idle_periods[i].stop.hour = 23;
+	mock_idle_periods[i].stop.minute = 59;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    struct timespec realTime;
+    clock_gettime(CLOCK_REALTIME, &realTime);
+    startRealTime = realTime.tv_sec + realTime.tv_nsec / 1e9;
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    int iListen = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (iListen < 0) {
+	printf("Cannot create socket. errno %i\n", errno);
+	return -1;
+    }
+    int enable = 1;
+    int disable = 0;
+    setsockopt(iListen, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    // accept IPv4 and IPv6 connections on the same socket
+    setsockopt(iListen, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable));
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(mock_config.port);
+    if (bind(iListen, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	|| listen(iListen, SOMAXCONN) < 0) {
+	printf("Cannot listen on port %i. errno %i\n", mock_config.port, errno);
+	close(iListen);
+	return -1;
+    }
+
+    int iEpoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(iEpoll, EPOLL_CTL_ADD, iListen, &ev);
+    printf("RSCP mock server listening on port %i\n", mock_config.port);
+    fflush(stdout);
+
+    int iClients = 0;
+    while (!bStop) {
+	struct epoll_event events[MOCK_MAX_EVENTS];
+	int iEvents = epoll_wait(iEpoll, events, MOCK_MAX_EVENTS, 1000);
+	for (int i = 0; i < iEvents; i++) {
+	    mock_client_t *client = (mock_client_t *) events[i].data.ptr;
+	    if (client == NULL) {
+		client = acceptMockClient(iListen);
+		if (client == NULL)
+		    continue;
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.ptr = client;
+		epoll_ctl(iEpoll, EPOLL_CTL_ADD, client->iSocket, &ev);
+		iClients++;
+		if (mock_config.verbose)
+		    printf("Client %i connected (%i clients)\n", client->iSocket, iClients);
+		continue;
+	    }
+	    if (!receiveMockData(client)) {
+		epoll_ctl(iEpoll, EPOLL_CTL_DEL, client->iSocket, NULL);
+		close(client->iSocket);
+		iClients--;
+		if (mock_config.verbose)
+		    printf("Client %i disconnected (%i clients)\n", client->iSocket, iClients);
+		delete client;
+	    }
+	}
+    }
+
+    close(iEpoll);
+    close(iListen);
+    return 0;
+}
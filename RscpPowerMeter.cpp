@@ -0,0 +1,119 @@
+/*
+ * RscpPowerMeter.cpp
+ *
+ * High rate sampling of the per phase power and energy of a power meter.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "RscpPowerMeter.h"
+#include "RscpBuilder.h"
+#include "RscpTags.h"
+
+RscpPowerMeter::RscpPowerMeter() :
+	m_bEnabled(false), m_ucIndex(0), m_uSamples(0), m_uFirstTime(0), m_uLastTime(0),
+	m_fIntervalSum(0.0), m_fIntervalSquares(0.0) {
+	memset(&m_frame, 0, sizeof(m_frame));
+}
+
+RscpPowerMeter::~RscpPowerMeter() {
+	RscpProtocol protocol;
+	protocol.destroyFrameData(m_frame);
+}
+
+int32_t RscpPowerMeter::prepare(uint8_t index) {
+	RscpProtocol protocol;
+	protocol.destroyFrameData(m_frame);
+	m_ucIndex = index;
+
+	// only the values of a sample, the container is about 60 bytes
+	static const SRscpTag requests[] = {
+		TAG_PM_REQ_POWER_L1, TAG_PM_REQ_POWER_L2, TAG_PM_REQ_POWER_L3,
+		TAG_PM_REQ_ENERGY_L1, TAG_PM_REQ_ENERGY_L2, TAG_PM_REQ_ENERGY_L3
+	};
+	RscpBuilder builder;
+	builder.open(TAG_PM_REQ_DATA);
+	builder.add(TAG_PM_INDEX, index);
+	for(size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+		builder.add(requests[i]);
+	}
+	int32_t iResult = builder.close();
+	if(iResult >= 0) {
+		iResult = protocol.createFrameAsBuffer(&m_frame, builder.data(), builder.length(), true);
+	}
+	return (iResult < 0) ? iResult : RSCP::OK;
+}
+
+int32_t RscpPowerMeter::handlePmData(const SRscpValueRef & pmData, uint64_t time) {
+	SRscpPmSample sample;
+	memset(&sample, 0, sizeof(sample));
+	sample.time = time;
+
+	RscpWalker walker = RscpWalker::children(pmData);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		if(value.dataType == RSCP::eTypeError) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		switch(value.tag) {
+		case TAG_PM_POWER_L1:
+		case TAG_PM_POWER_L2:
+		case TAG_PM_POWER_L3:
+			RscpWalker::asDouble(value, sample.power[value.tag - TAG_PM_POWER_L1]);
+			break;
+		case TAG_PM_ENERGY_L1:
+		case TAG_PM_ENERGY_L2:
+		case TAG_PM_ENERGY_L3:
+			RscpWalker::asDouble(value, sample.energy[value.tag - TAG_PM_ENERGY_L1]);
+			break;
+		default:
+			break;
+		}
+	}
+	if(walker.error()) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+
+	if(m_uSamples == 0) {
+		m_uFirstTime = time;
+	}
+	else {
+		uint64_t uInterval = time - m_uLastTime;
+		double fInterval = uInterval / 1e3;
+		m_intervals.record(uInterval);
+		m_fIntervalSum += fInterval;
+		m_fIntervalSquares += fInterval * fInterval;
+	}
+	m_uLastTime = time;
+	m_uSamples++;
+	m_ring.push(sample);
+	return RSCP::OK;
+}
+
+double RscpPowerMeter::rate() const {
+	if((m_uSamples < 2) || (m_uLastTime == m_uFirstTime)) {
+		return 0.0;
+	}
+	return (m_uSamples - 1) * 1e9 / (m_uLastTime - m_uFirstTime);
+}
+
+double RscpPowerMeter::jitter() const {
+	uint64_t uIntervals = m_intervals.count();
+	if(uIntervals < 2) {
+		return 0.0;
+	}
+	double fMean = m_fIntervalSum / uIntervals;
+	double fVariance = m_fIntervalSquares / uIntervals - fMean * fMean;
+	return (fVariance > 0.0) ? sqrt(fVariance) * 1e3 : 0.0;
+}
+
+void RscpPowerMeter::print(FILE *file) const {
+	fprintf(file, "Power meter %u: %llu samples in %.3f s, %.1f samples/s, %llu dropped\n", m_ucIndex,
+		(unsigned long long) m_uSamples, (m_uLastTime - m_uFirstTime) / 1e9, rate(),
+		(unsigned long long) m_ring.dropped());
+	if(m_intervals.count() > 0) {
+		fprintf(file, "Interval [us] min %.1f p50 %.1f p99 %.1f max %.1f mean %.1f jitter %.1f\n",
+			m_intervals.min() / 1e3, m_intervals.percentile(50) / 1e3, m_intervals.percentile(99) / 1e3,
+			m_intervals.max() / 1e3, m_intervals.mean() / 1e3, jitter() / 1e3);
+	}
+}
@@ -0,0 +1,146 @@
+/*
+ * RscpPowerMeter.h
+ *
+ * High rate sampling of the per phase power and energy of a power meter. The request frame is
+ * encoded once and queued again for every sample, several requests are kept in flight to hide the
+ * round trip. Each response becomes a sample in a single producer single consumer ring which is
+ * read by a consumer thread without locks, the intervals between the samples are recorded to
+ * report the achieved rate and the jitter.
+ */
+
+#ifndef RSCPPOWERMETER_H_
+#define RSCPPOWERMETER_H_
+
+#include <stdio.h>
+#include "RscpProtocol.h"
+#include "RscpWalker.h"
+#include "RscpStats.h"
+
+#define PM_PHASES					3
+// samples of the ring, a power of two
+#define PM_SAMPLE_RING_SIZE			4096
+
+struct SRscpPmSample {
+	uint64_t time;					// CLOCK_MONOTONIC of the response in nanoseconds
+	double power[PM_PHASES];		// W
+	double energy[PM_PHASES];		// Wh
+};
+
+/*
+ * \brief Lock free ring of samples for one producer and one consumer thread. The producer
+ *        drops samples while the ring is full instead of waiting for the consumer.
+ */
+class RscpPmSampleRing {
+public:
+	RscpPmSampleRing() :
+		m_uHead(0), m_uTail(0), m_uDropped(0) {
+	}
+	/*
+	 * \brief Append a sample, called by the producer only.
+	 * @return - false if the ring is full and the sample was dropped
+	 */
+	bool push(const SRscpPmSample & sample) {
+		uint64_t uTail = m_uTail;
+		if(uTail - __atomic_load_n(&m_uHead, __ATOMIC_ACQUIRE) == PM_SAMPLE_RING_SIZE) {
+			m_uDropped++;
+			return false;
+		}
+		m_samples[uTail % PM_SAMPLE_RING_SIZE] = sample;
+		__atomic_store_n(&m_uTail, uTail + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+	/*
+	 * \brief Remove the oldest sample, called by the consumer only.
+	 * @return - false if the ring is empty
+	 */
+	bool pop(SRscpPmSample & sample) {
+		uint64_t uHead = m_uHead;
+		if(__atomic_load_n(&m_uTail, __ATOMIC_ACQUIRE) == uHead) {
+			return false;
+		}
+		sample = m_samples[uHead % PM_SAMPLE_RING_SIZE];
+		__atomic_store_n(&m_uHead, uHead + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+	/*
+	 * \brief Samples dropped by the producer, read it after the producer stopped.
+	 */
+	uint64_t dropped() const {
+		return m_uDropped;
+	}
+private:
+	SRscpPmSample m_samples[PM_SAMPLE_RING_SIZE];
+	// the head is written by the consumer, the tail by the producer, each on its own cache line
+	alignas(64) uint64_t m_uHead;
+	alignas(64) uint64_t m_uTail;
+	uint64_t m_uDropped;
+};
+
+class RscpPowerMeter {
+public:
+	RscpPowerMeter();
+	virtual ~RscpPowerMeter();
+	/*
+	 * \brief Encode the request frame of the power meter \var index, the previous frame is released.
+	 * @return - RSCP::OK or an RSCP error code of the protocol
+	 */
+	int32_t prepare(uint8_t index);
+	/*
+	 * \brief Frame with the power and energy requests of all phases, queued unchanged for every sample.
+	 */
+	const SRscpFrameBuffer & frame() const {
+		return m_frame;
+	}
+	/*
+	 * \brief Enable the sampling, TAG_PM_DATA responses are handled by the power meter.
+	 */
+	void enable() {
+		m_bEnabled = true;
+	}
+	bool enabled() const {
+		return m_bEnabled;
+	}
+	/*
+	 * \brief Decode a TAG_PM_DATA response received at \var time into a sample of the ring.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT for malformed data or error values
+	 */
+	int32_t handlePmData(const SRscpValueRef & pmData, uint64_t time);
+	RscpPmSampleRing & ring() {
+		return m_ring;
+	}
+	uint64_t samples() const {
+		return m_uSamples;
+	}
+	/*
+	 * \brief Samples per second between the first and the last sample.
+	 */
+	double rate() const;
+	/*
+	 * \brief Standard deviation of the intervals between the samples in nanoseconds.
+	 */
+	double jitter() const;
+	const RscpHistogram & intervals() const {
+		return m_intervals;
+	}
+	/*
+	 * \brief Print the sample count, the rate and the interval distribution.
+	 */
+	void print(FILE *file) const;
+private:
+	RscpPowerMeter(const RscpPowerMeter &);
+	RscpPowerMeter & operator=(const RscpPowerMeter &);
+
+	bool m_bEnabled;
+	uint8_t m_ucIndex;
+	SRscpFrameBuffer m_frame;
+	RscpPmSampleRing m_ring;
+	uint64_t m_uSamples;
+	uint64_t m_uFirstTime;
+	uint64_t m_uLastTime;
+	RscpHistogram m_intervals;
+	// sums of the intervals for the standard deviation, in microseconds to keep the precision
+	double m_fIntervalSum;
+	double m_fIntervalSquares;
+};
+
+#endif /* RSCPPOWERMETER_H_ */
@@ -52,7 +52,7 @@ bool RscpProtocol::setHeaderTimestamp(SRscpFrame *frame) {
 	return bTimeSet;
 }
 
-uint32_t RscpProtocol::calculateCRC32(const uint8_t *data, uint16_t length) {
+uint32_t RscpProtocol::calculateCRC32(const uint8_t *data, uint32_t length) {
     static const uint32_t crc_table[] = {
       0x4DBDF21C, 0x500AE278, 0x76D3D2D4, 0x6B64C2B0,
       0x3B61B38C, 0x26D6A3E8, 0x000F9344, 0x1DB88320,
@@ -91,22 +91,54 @@ int32_t RscpProtocol::getFrameLength(const uint8_t * data, const uint32_t & leng
 	return frameLength;
 }
 
+int32_t RscpProtocol::validateFrame(const uint8_t * data, const uint32_t & length) {
+	int32_t frameLength = getFrameLength(data, length);
+	if(frameLength < 0) {
+		return frameLength;
+	}
+	if((uint32_t) frameLength > length) {
+		return RSCP::ERR_INVALID_FRAME_LENGTH;
+	}
+	const SRscpFrameHeader *header = reinterpret_cast<const SRscpFrameHeader *>(data);
+	if(header->ctrl.bits.crc != 0) {
+		uint32_t frameCRC32;
+		memcpy(&frameCRC32, data + frameLength - sizeof(uint32_t), sizeof(uint32_t));
+		if(frameCRC32 != calculateCRC32(data, frameLength - sizeof(uint32_t))) {
+			return RSCP::ERR_INVALID_CRC;
+		}
+	}
+	return frameLength;
+}
+
 int32_t RscpProtocol::createFrameAsBuffer(SRscpFrameBuffer* frameBuffer, const uint8_t * data, uint16_t dataLength, bool calcCRC) {
 	if(frameBuffer == NULL) {
 		return RSCP::ERR_INVALID_INPUT;
 	}
 	// calculate the required frame size
-	size_t sFrameSize =  sizeof(SRscpFrameHeader);
+	size_t sFrameSize =  sizeof(SRscpFrameHeader) + dataLength + (calcCRC ? 4 : 0);
 	// allocate the required memory
-	frameBuffer->data = (uint8_t *) malloc(sFrameSize + dataLength + (calcCRC ? 4 : 0));
+	frameBuffer->data = (uint8_t *) malloc(sFrameSize);
 	if(frameBuffer->data == NULL) {
 		return RSCP::ERR_NO_MEMORY;
 	}
 	// set the memory size
-	frameBuffer->dataLength = sFrameSize + dataLength + (calcCRC ? 4 : 0);
+	frameBuffer->dataLength = sFrameSize;
+	int32_t iResult = createFrameInBuffer(frameBuffer->data, sFrameSize, data, dataLength, calcCRC);
+	return (iResult < 0) ? iResult : RSCP::OK;
+}
+
+int32_t RscpProtocol::createFrameInBuffer(uint8_t * buffer, uint32_t bufferSize, const uint8_t * data, uint16_t dataLength, bool calcCRC) {
+	if((buffer == NULL) || ((data == NULL) && (dataLength > 0))) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	// calculate the required frame size
+	uint32_t uFrameSize = sizeof(SRscpFrameHeader) + dataLength + (calcCRC ? 4 : 0);
+	if(uFrameSize > bufferSize) {
+		return RSCP::ERR_DATA_LIMIT_EXCEEDED;
+	}
 	// set initial header values
-	memset(frameBuffer->data, 0, sizeof(SRscpFrameHeader));
-	SRscpFrame* tmpFrame = reinterpret_cast<SRscpFrame*>(frameBuffer->data);
+	memset(buffer, 0, sizeof(SRscpFrameHeader));
+	SRscpFrame* tmpFrame = reinterpret_cast<SRscpFrame*>(buffer);
 	tmpFrame->header.magic = RSCP::MAGIC;
 	tmpFrame->header.ctrl.bits.crc = calcCRC;
 	tmpFrame->header.ctrl.bits.version = RSCP::VERSION;
@@ -114,15 +146,17 @@ int32_t RscpProtocol::createFrameAsBuffer(SRscpFrameBuffer* frameBuffer, const u
 	setHeaderTimestamp(tmpFrame);
 
 	// insert data from the SRscpValues
-	memcpy(&tmpFrame->header + 1, data, dataLength);
+	if(dataLength > 0) {
+		memcpy(&tmpFrame->header + 1, data, dataLength);
+	}
 
 	// calculate CRC if necessary and add to the frame
 	if(calcCRC) {
-		uint32_t uCRC32 = calculateCRC32(frameBuffer->data, frameBuffer->dataLength - sizeof(uint32_t));
-		memcpy(&frameBuffer->data[frameBuffer->dataLength - sizeof(uCRC32)], &uCRC32, sizeof(uCRC32));
+		uint32_t uCRC32 = calculateCRC32(buffer, uFrameSize - sizeof(uint32_t));
+		memcpy(&buffer[uFrameSize - sizeof(uCRC32)], &uCRC32, sizeof(uCRC32));
 	}
 
-	return RSCP::OK;
+	return uFrameSize;
 }
 
 int32_t RscpProtocol::createFrameAsBuffer(SRscpFrameBuffer* frame, const SRscpValue & data, bool calcCRC) {
@@ -32,6 +32,13 @@ public:
      * @return			- RSCP error code if the function fails or the amount of bytes the frame should have to be full.
      */
 	int32_t getFrameLength(const uint8_t * data, const uint32_t & length);
+    /*
+     * \brief Check the header and the CRC of the frame in \var data without parsing the values.
+     * @param data		- Pointer to the raw data frame buffer
+     * @param length	- Length of data buffer in bytes
+     * @return			- RSCP error code if the frame is not valid or complete else the frame length in bytes
+     */
+	int32_t validateFrame(const uint8_t * data, const uint32_t & length);
     /*
      * \brief Create a RSCP frame from one single RscpValue struct into the pre-allocated \var frameBuffer.
      *        The data is aligned in line inside the frameBuffer structure to allow direct send of the complete frame.
@@ -43,6 +50,17 @@ public:
      * @return	          - RSCP error code if the function fails else RSCP::OK
      */
     int32_t createFrameAsBuffer(SRscpFrameBuffer* frameBuffer, const uint8_t * data, uint16_t dataLength, bool calcCRC);
+    /*
+     * \brief Create a RSCP frame from the values in line in \var data into the caller owned \var buffer.
+     *        No memory is allocated, this allows to build the frame directly inside a send buffer.
+     * @param buffer      - Destination of the frame
+     * @param bufferSize  - Size of \var buffer in bytes
+     * @param data        - Pointer to the first RSCP value struct in line.
+     * @param dataLength  - Data length of the data buffer in bytes.
+     * @param calcCRC     - If set TRUE the CRC for the frame is calculated and appended to the frame.
+     * @return	          - RSCP error code if the function fails else the length of the frame in bytes
+     */
+    int32_t createFrameInBuffer(uint8_t * buffer, uint32_t bufferSize, const uint8_t * data, uint16_t dataLength, bool calcCRC);
     /*
      * \brief Create a RSCP frame from one single RscpValue struct into the pre-allocated \var frameBuffer.
      *        The data is aligned in line inside the frameBuffer structure to allow direct send of the complete frame.
@@ -536,14 +554,14 @@ public:
     int32_t destroyFrameData(SRscpFrameBuffer & frameBuffer) {
     	return destroyFrameData(&frameBuffer);
     }
-private:
     /*
      * \brief This function calculates the ethernet protocol CRC32 hash from \var data over \var length bytes.
      * @param - Pointer to a data buffer
      * @param - Length of the buffer data
      * @return The calculated CRC32 value is returned.
      */
-    uint32_t calculateCRC32(const uint8_t *data, uint16_t length);
+    uint32_t calculateCRC32(const uint8_t *data, uint32_t length);
+private:
     /*
      * \brief This function sets the current time in seconds and nanoseconds to the frame.
      * @param - Pointer to an rscp frame object.
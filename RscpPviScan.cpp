@@ -0,0 +1,246 @@
+/*
+ * RscpPviScan.cpp
+ *
+ * Discovery of the PV inverters and the scan of all their strings, phases and temperature sensors.
+ */
+
+#include <string.h>
+#include "RscpPviScan.h"
+#include "RscpTags.h"
+
+// columns of m_ucProbed
+#define PVI_PROBED_STRINGS	0
+#define PVI_PROBED_PHASES	1
+#define PVI_PROBED_SENSORS	2
+
+// request tags of the string and phase columns
+static const SRscpTag dcRequests[PVI_DC_VALUES] = {
+	TAG_PVI_REQ_DC_POWER, TAG_PVI_REQ_DC_VOLTAGE, TAG_PVI_REQ_DC_CURRENT
+};
+static const SRscpTag acRequests[PVI_AC_VALUES] = {
+	TAG_PVI_REQ_AC_POWER, TAG_PVI_REQ_AC_VOLTAGE, TAG_PVI_REQ_AC_CURRENT,
+	TAG_PVI_REQ_AC_APPARENTPOWER, TAG_PVI_REQ_AC_REACTIVEPOWER
+};
+
+RscpPviScan::RscpPviScan() :
+	m_bEnabled(false), m_bDiscovered(false), m_uInverters(0), m_uStringTotal(0), m_uPhaseTotal(0), m_uSensorTotal(0) {
+	memset(m_ucProbed, 0, sizeof(m_ucProbed));
+	memset(m_ucInverterIndex, 0, sizeof(m_ucInverterIndex));
+	memset(m_ucStrings, 0, sizeof(m_ucStrings));
+	memset(m_ucPhases, 0, sizeof(m_ucPhases));
+	memset(m_ucSensors, 0, sizeof(m_ucSensors));
+	memset(m_ucFirstString, 0, sizeof(m_ucFirstString));
+	memset(m_ucFirstPhase, 0, sizeof(m_ucFirstPhase));
+	memset(m_ucFirstSensor, 0, sizeof(m_ucFirstSensor));
+	memset(m_fDc, 0, sizeof(m_fDc));
+	memset(m_fAc, 0, sizeof(m_fAc));
+	memset(m_fTemperature, 0, sizeof(m_fTemperature));
+}
+
+int32_t RscpPviScan::createDiscovery(RscpBuilder & builder) {
+	memset(m_ucProbed, 0, sizeof(m_ucProbed));
+	for(uint32_t i = 0; i < PVI_SCAN_MAX_INVERTERS; i++) {
+		builder.open(TAG_PVI_REQ_DATA);
+		builder.add(TAG_PVI_INDEX, (uint8_t) i);
+		builder.add(TAG_PVI_REQ_DC_MAX_STRING_COUNT);
+		builder.add(TAG_PVI_REQ_AC_MAX_PHASE_COUNT);
+		builder.add(TAG_PVI_REQ_TEMPERATURE_COUNT);
+		int32_t iResult = builder.close();
+		if(iResult < 0) {
+			return iResult;
+		}
+	}
+	return RSCP::OK;
+}
+
+void RscpPviScan::finishDiscovery() {
+	m_uInverters = 0;
+	m_uStringTotal = 0;
+	m_uPhaseTotal = 0;
+	m_uSensorTotal = 0;
+	for(uint32_t i = 0; i < PVI_SCAN_MAX_INVERTERS; i++) {
+		if((m_ucProbed[i][PVI_PROBED_STRINGS] == 0) && (m_ucProbed[i][PVI_PROBED_PHASES] == 0)) {
+			continue;
+		}
+		m_ucInverterIndex[m_uInverters] = i;
+		m_ucStrings[m_uInverters] = m_ucProbed[i][PVI_PROBED_STRINGS];
+		m_ucPhases[m_uInverters] = m_ucProbed[i][PVI_PROBED_PHASES];
+		m_ucSensors[m_uInverters] = m_ucProbed[i][PVI_PROBED_SENSORS];
+		m_ucFirstString[m_uInverters] = m_uStringTotal;
+		m_ucFirstPhase[m_uInverters] = m_uPhaseTotal;
+		m_ucFirstSensor[m_uInverters] = m_uSensorTotal;
+		m_uStringTotal += m_ucStrings[m_uInverters];
+		m_uPhaseTotal += m_ucPhases[m_uInverters];
+		m_uSensorTotal += m_ucSensors[m_uInverters];
+		m_uInverters++;
+	}
+	m_bDiscovered = true;
+}
+
+int32_t RscpPviScan::createScan(RscpBuilder & builder) {
+	for(uint32_t inverter = 0; inverter < m_uInverters; inverter++) {
+		builder.open(TAG_PVI_REQ_DATA);
+		builder.add(TAG_PVI_INDEX, m_ucInverterIndex[inverter]);
+		for(uint16_t string = 0; string < m_ucStrings[inverter]; string++) {
+			for(uint32_t value = 0; value < PVI_DC_VALUES; value++) {
+				builder.add(dcRequests[value], string);
+			}
+		}
+		for(uint16_t phase = 0; phase < m_ucPhases[inverter]; phase++) {
+			for(uint32_t value = 0; value < PVI_AC_VALUES; value++) {
+				builder.add(acRequests[value], phase);
+			}
+		}
+		for(uint16_t sensor = 0; sensor < m_ucSensors[inverter]; sensor++) {
+			builder.add(TAG_PVI_REQ_TEMPERATURE, sensor);
+		}
+		int32_t iResult = builder.close();
+		if(iResult < 0) {
+			return iResult;
+		}
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpPviScan::findInverter(uint8_t index) const {
+	for(uint32_t i = 0; i < m_uInverters; i++) {
+		if(m_ucInverterIndex[i] == index) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int32_t RscpPviScan::handleIndexedValue(uint32_t inverter, const SRscpValueRef & value) {
+	// the column and its entries of the inverter
+	float *column;
+	uint32_t uFirst, uCount;
+	switch(value.tag) {
+	case TAG_PVI_DC_POWER:
+	case TAG_PVI_DC_VOLTAGE:
+	case TAG_PVI_DC_CURRENT:
+		column = m_fDc[(value.tag - TAG_PVI_DC_POWER) + PVI_DC_POWER];
+		uFirst = m_ucFirstString[inverter];
+		uCount = m_ucStrings[inverter];
+		break;
+	case TAG_PVI_AC_POWER:
+	case TAG_PVI_AC_VOLTAGE:
+	case TAG_PVI_AC_CURRENT:
+	case TAG_PVI_AC_APPARENTPOWER:
+	case TAG_PVI_AC_REACTIVEPOWER:
+		column = m_fAc[(value.tag - TAG_PVI_AC_POWER) + PVI_AC_POWER];
+		uFirst = m_ucFirstPhase[inverter];
+		uCount = m_ucPhases[inverter];
+		break;
+	case TAG_PVI_TEMPERATURE:
+		column = m_fTemperature;
+		uFirst = m_ucFirstSensor[inverter];
+		uCount = m_ucSensors[inverter];
+		break;
+	default:
+		// values the scan did not request
+		return RSCP::OK;
+	}
+	// the container holds the index of the string, phase or sensor and the value
+	double fIndex = -1, fValue = 0;
+	bool bValue = false;
+	RscpWalker walker = RscpWalker::children(value);
+	SRscpValueRef child;
+	while(walker.next(child)) {
+		if(child.tag == TAG_PVI_INDEX) {
+			if(!RscpWalker::asDouble(child, fIndex)) {
+				return RSCP::ERR_INVALID_INPUT;
+			}
+		}
+		else if(child.tag == TAG_PVI_VALUE) {
+			bValue = RscpWalker::asDouble(child, fValue);
+		}
+	}
+	if(walker.error() || (fIndex < 0) || (fIndex >= uCount)) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	if(bValue) {
+		column[uFirst + (uint32_t) fIndex] = fValue;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpPviScan::handleInverterData(const SRscpValueRef & inverterData) {
+	// the index is the first value of the container, responses without index are inverter 0
+	uint8_t ucIndex = 0;
+	int32_t iResult = RSCP::OK;
+
+	RscpWalker walker = RscpWalker::children(inverterData);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		double fValue;
+		if(value.tag == TAG_PVI_INDEX) {
+			if(!RscpWalker::asDouble(value, fValue) || (fValue < 0) || (fValue > UINT8_MAX)) {
+				return RSCP::ERR_INVALID_INPUT;
+			}
+			ucIndex = (uint8_t) fValue;
+			continue;
+		}
+		// errors mark missing inverters and unsupported values
+		if(value.dataType == RSCP::eTypeError) {
+			continue;
+		}
+		if(!m_bDiscovered) {
+			if((ucIndex >= PVI_SCAN_MAX_INVERTERS) || !RscpWalker::asDouble(value, fValue) || (fValue < 0)) {
+				continue;
+			}
+			switch(value.tag) {
+			case TAG_PVI_DC_MAX_STRING_COUNT:
+				m_ucProbed[ucIndex][PVI_PROBED_STRINGS] = (fValue > PVI_SCAN_MAX_STRINGS) ? PVI_SCAN_MAX_STRINGS : (uint8_t) fValue;
+				break;
+			case TAG_PVI_AC_MAX_PHASE_COUNT:
+				m_ucProbed[ucIndex][PVI_PROBED_PHASES] = (fValue > PVI_SCAN_MAX_PHASES) ? PVI_SCAN_MAX_PHASES : (uint8_t) fValue;
+				break;
+			case TAG_PVI_TEMPERATURE_COUNT:
+				m_ucProbed[ucIndex][PVI_PROBED_SENSORS] = (fValue > PVI_SCAN_MAX_SENSORS) ? PVI_SCAN_MAX_SENSORS : (uint8_t) fValue;
+				break;
+			default:
+				break;
+			}
+			continue;
+		}
+		int32_t iInverter = findInverter(ucIndex);
+		if(iInverter < 0) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		int32_t iValue = handleIndexedValue(iInverter, value);
+		if(iValue < 0) {
+			iResult = iValue;
+		}
+	}
+	return walker.error() ? RSCP::ERR_INVALID_INPUT : iResult;
+}
+
+void RscpPviScan::print(FILE *file) const {
+	if(m_uInverters == 0) {
+		fprintf(file, "No inverter found\n");
+		return;
+	}
+	for(uint32_t inverter = 0; inverter < m_uInverters; inverter++) {
+		fprintf(file, "Inverter %u: %u strings, %u phases, %u temperature sensors\n", m_ucInverterIndex[inverter],
+			m_ucStrings[inverter], m_ucPhases[inverter], m_ucSensors[inverter]);
+		for(uint32_t string = 0; string < m_ucStrings[inverter]; string++) {
+			uint32_t i = m_ucFirstString[inverter] + string;
+			fprintf(file, "  String %u: %0.0f W, %0.1f V, %0.2f A\n", string,
+				m_fDc[PVI_DC_POWER][i], m_fDc[PVI_DC_VOLTAGE][i], m_fDc[PVI_DC_CURRENT][i]);
+		}
+		for(uint32_t phase = 0; phase < m_ucPhases[inverter]; phase++) {
+			uint32_t i = m_ucFirstPhase[inverter] + phase;
+			fprintf(file, "  Phase %u: %0.0f W, %0.1f V, %0.2f A, %0.0f VA, %0.0f var\n", phase,
+				m_fAc[PVI_AC_POWER][i], m_fAc[PVI_AC_VOLTAGE][i], m_fAc[PVI_AC_CURRENT][i],
+				m_fAc[PVI_AC_APPARENTPOWER][i], m_fAc[PVI_AC_REACTIVEPOWER][i]);
+		}
+		if(m_ucSensors[inverter] > 0) {
+			fprintf(file, "  Temperatures");
+			for(uint32_t sensor = 0; sensor < m_ucSensors[inverter]; sensor++) {
+				fprintf(file, " %0.1f", m_fTemperature[m_ucFirstSensor[inverter] + sensor]);
+			}
+			fprintf(file, " C\n");
+		}
+	}
+}
@@ -0,0 +1,160 @@
+/*
+ * RscpPviScan.h
+ *
+ * Discovery of the PV inverters with their string (tracker), phase and temperature sensor counts and
+ * polling of the values of all of them in one frame. The values are kept as structure of arrays, one
+ * dense column per quantity over the strings, phases or sensors of all inverters, so a cycle can be
+ * stored as a row of columns without reordering.
+ */
+
+#ifndef RSCPPVISCAN_H_
+#define RSCPPVISCAN_H_
+
+#include <stdio.h>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+#include "RscpWalker.h"
+
+// inverter indexes probed by the discovery
+#define PVI_SCAN_MAX_INVERTERS		4
+// strings, phases and temperature sensors per inverter
+#define PVI_SCAN_MAX_STRINGS		8
+#define PVI_SCAN_MAX_PHASES			4
+#define PVI_SCAN_MAX_SENSORS		8
+
+// columns of the string values
+enum PviDcValue {
+	PVI_DC_POWER = 0,
+	PVI_DC_VOLTAGE,
+	PVI_DC_CURRENT,
+	PVI_DC_VALUES
+};
+
+// columns of the phase values
+enum PviAcValue {
+	PVI_AC_POWER = 0,
+	PVI_AC_VOLTAGE,
+	PVI_AC_CURRENT,
+	PVI_AC_APPARENTPOWER,
+	PVI_AC_REACTIVEPOWER,
+	PVI_AC_VALUES
+};
+
+class RscpPviScan {
+public:
+	RscpPviScan();
+	/*
+	 * \brief Enable the scan, the requests and responses of the inverter data are handled by the scan.
+	 */
+	void enable() {
+		m_bEnabled = true;
+	}
+	bool enabled() const {
+		return m_bEnabled;
+	}
+	bool discovered() const {
+		return m_bDiscovered;
+	}
+	/*
+	 * \brief Append the discovery requests, the string, phase and sensor counts of each probed inverter index.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createDiscovery(RscpBuilder & builder);
+	/*
+	 * \brief Complete the discovery after all responses of the discovery frame were handled.
+	 */
+	void finishDiscovery();
+	/*
+	 * \brief Append one TAG_PVI_REQ_DATA per inverter with the requests of all strings, phases and sensors.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createScan(RscpBuilder & builder);
+	/*
+	 * \brief Handle a TAG_PVI_DATA response of either request.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT for malformed or unexpected data
+	 */
+	int32_t handleInverterData(const SRscpValueRef & inverterData);
+	/*
+	 * \brief Print the values of all strings, phases and sensors of each inverter.
+	 */
+	void print(FILE *file) const;
+
+	uint32_t inverterCount() const {
+		return m_uInverters;
+	}
+	uint8_t inverterIndex(uint32_t inverter) const {
+		return m_ucInverterIndex[inverter];
+	}
+	/*
+	 * \brief Strings, phases and sensors of one inverter, its values start at the first column entry.
+	 */
+	uint32_t stringCount(uint32_t inverter) const {
+		return m_ucStrings[inverter];
+	}
+	uint32_t phaseCount(uint32_t inverter) const {
+		return m_ucPhases[inverter];
+	}
+	uint32_t sensorCount(uint32_t inverter) const {
+		return m_ucSensors[inverter];
+	}
+	uint32_t firstString(uint32_t inverter) const {
+		return m_ucFirstString[inverter];
+	}
+	uint32_t firstPhase(uint32_t inverter) const {
+		return m_ucFirstPhase[inverter];
+	}
+	uint32_t firstSensor(uint32_t inverter) const {
+		return m_ucFirstSensor[inverter];
+	}
+	/*
+	 * \brief Column of a string value over the strings of all inverters, stringTotal() entries.
+	 */
+	const float *dc(PviDcValue value) const {
+		return m_fDc[value];
+	}
+	/*
+	 * \brief Column of a phase value over the phases of all inverters, phaseTotal() entries.
+	 */
+	const float *ac(PviAcValue value) const {
+		return m_fAc[value];
+	}
+	/*
+	 * \brief Temperatures of the sensors of all inverters, sensorTotal() entries.
+	 */
+	const float *temperatures() const {
+		return m_fTemperature;
+	}
+	uint32_t stringTotal() const {
+		return m_uStringTotal;
+	}
+	uint32_t phaseTotal() const {
+		return m_uPhaseTotal;
+	}
+	uint32_t sensorTotal() const {
+		return m_uSensorTotal;
+	}
+private:
+	int32_t findInverter(uint8_t index) const;
+	int32_t handleIndexedValue(uint32_t inverter, const SRscpValueRef & value);
+
+	bool m_bEnabled;
+	bool m_bDiscovered;
+	// counts of each probed index, a missing inverter has no strings and phases
+	uint8_t m_ucProbed[PVI_SCAN_MAX_INVERTERS][3];
+	uint32_t m_uInverters;
+	uint8_t m_ucInverterIndex[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucStrings[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucPhases[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucSensors[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucFirstString[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucFirstPhase[PVI_SCAN_MAX_INVERTERS];
+	uint8_t m_ucFirstSensor[PVI_SCAN_MAX_INVERTERS];
+	uint32_t m_uStringTotal;
+	uint32_t m_uPhaseTotal;
+	uint32_t m_uSensorTotal;
+	float m_fDc[PVI_DC_VALUES][PVI_SCAN_MAX_INVERTERS * PVI_SCAN_MAX_STRINGS];
+	float m_fAc[PVI_AC_VALUES][PVI_SCAN_MAX_INVERTERS * PVI_SCAN_MAX_PHASES];
+	float m_fTemperature[PVI_SCAN_MAX_INVERTERS * PVI_SCAN_MAX_SENSORS];
+};
+
+#endif /* RSCPPVISCAN_H_ */
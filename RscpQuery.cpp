@@ -0,0 +1,223 @@
+/*
+ * RscpQuery.cpp
+ *
+ * Range queries over the rollup files of RscpRollup.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <thread>
+#include "RscpQuery.h"
+#include "RscpTypes.h"
+
+// points of one query, bounds the memory of the result
+#define QUERY_MAX_POINTS			(16 * 1024 * 1024)
+
+RscpQuery::RscpQuery() :
+	m_fd(-1), m_records(0), m_uPerPoint(0), m_uResolution(0), m_uRecordsRead(0), m_uRecordsRetried(0) {
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+uint32_t RscpQuery::resolution(uint32_t step) {
+	for(int i = ROLLUP_RESOLUTIONS - 1; i >= 0; i--) {
+		if((step >= RscpRollup::resolutions[i]) && (step % RscpRollup::resolutions[i] == 0)) {
+			return RscpRollup::resolutions[i];
+		}
+	}
+	return 0;
+}
+
+bool RscpQuery::seriesName(const char *name, char *buffer, size_t size) {
+	size_t length = 0;
+	const char *part = name;
+	while(true) {
+		const char *end = strchr(part, '/');
+		size_t partLength = end ? (size_t) (end - part) : strlen(part);
+		bool bTag = (partLength >= 4) && (strncmp(part, "TAG_", 4) == 0);
+		if(!bTag) {
+			if(length + 4 >= size) {
+				return false;
+			}
+			memcpy(buffer + length, "TAG_", 4);
+			length += 4;
+		}
+		for(size_t i = 0; i < partLength; i++) {
+			if(length + 1 >= size) {
+				return false;
+			}
+			char c = part[i];
+			// the index of a part is kept as it is, ems.power_grid is TAG_EMS_POWER_GRID
+			buffer[length++] = bTag ? c : ((c == '.') ? '_' : toupper((unsigned char) c));
+		}
+		if(end == NULL) {
+			break;
+		}
+		if(length + 1 >= size) {
+			return false;
+		}
+		buffer[length++] = '/';
+		part = end + 1;
+	}
+	buffer[length] = 0;
+	return true;
+}
+
+bool RscpQuery::consistent(const SRscpRollupRecord & record) {
+	if(record.count == 0) {
+		return (record.min == 0.0f) && (record.max == 0.0f) && (record.mean == 0.0f) && (record.last == 0.0f);
+	}
+	// the mean of a completely written record is between min and max, allow its rounding to float
+	float slack = (fabsf(record.min) + fabsf(record.max)) * 1e-6f;
+	return !isnan(record.mean) && (record.min <= record.max) && (record.last >= record.min)
+		&& (record.last <= record.max) && (record.mean >= record.min - slack) && (record.mean <= record.max + slack);
+}
+
+int32_t RscpQuery::run(const char *directory, const char *series, int64_t from, int64_t to, uint32_t step,
+	int threads, std::vector<SRscpQueryPoint> & points) {
+	points.clear();
+	m_uRecordsRead = 0;
+	m_uRecordsRetried = 0;
+	m_uResolution = resolution(step);
+	if(m_uResolution == 0) {
+		return QUERY_ERR_STEP;
+	}
+	from -= ((from % step) + step) % step;
+	to += (step - ((to % step) + step) % step) % step;
+	if((to <= from) || ((to - from) / step > QUERY_MAX_POINTS)) {
+		return QUERY_ERR_RANGE;
+	}
+
+	char path[1024];
+	if(!RscpRollup::fileName(path, sizeof(path), directory, series, m_uResolution)) {
+		return QUERY_ERR_SERIES;
+	}
+	m_fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(m_fd < 0) {
+		return (errno == ENOENT) ? QUERY_ERR_SERIES : QUERY_ERR_FILE;
+	}
+	struct stat st;
+	if((pread(m_fd, &m_header, sizeof(m_header), 0) != (ssize_t) sizeof(m_header))
+		|| !RscpRollup::checkHeader(m_header, series, m_uResolution) || (fstat(m_fd, &st) != 0)) {
+		close(m_fd);
+		m_fd = -1;
+		return QUERY_ERR_FORMAT;
+	}
+	// records appended by the writer after this point are not part of the query
+	m_records = (st.st_size > m_header.headerSize) ? (st.st_size - m_header.headerSize) / m_header.recordSize : 0;
+	m_uPerPoint = step / m_uResolution;
+
+	uint32_t uPoints = (to - from) / step;
+	points.resize(uPoints);
+	for(uint32_t i = 0; i < uPoints; i++) {
+		memset(&points[i], 0, sizeof(SRscpQueryPoint));
+		points[i].time = from + (int64_t) i * step;
+	}
+
+	// only the records inside the file have to be read, the slices split them evenly
+	uint64_t uRecords = (uint64_t) uPoints * m_uPerPoint;
+	int slices = (threads > 1) ? (int) (uRecords / QUERY_RECORDS_PER_THREAD) : 1;
+	if(slices > threads) {
+		slices = threads;
+	}
+	if(slices < 1) {
+		slices = 1;
+	}
+	std::vector<SQuerySlice> slice(slices);
+	uint32_t uFirst = 0;
+	for(int i = 0; i < slices; i++) {
+		slice[i].first = uFirst;
+		slice[i].count = uPoints / slices + (((uint32_t) i < uPoints % slices) ? 1 : 0);
+		slice[i].result = RSCP::OK;
+		slice[i].read = 0;
+		slice[i].retried = 0;
+		uFirst += slice[i].count;
+	}
+	std::vector<std::thread> workers;
+	for(int i = 1; i < slices; i++) {
+		workers.push_back(std::thread(&RscpQuery::readSlice, this, std::ref(slice[i]), std::ref(points)));
+	}
+	readSlice(slice[0], points);
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	close(m_fd);
+	m_fd = -1;
+
+	int32_t iResult = (int32_t) uPoints;
+	for(int i = 0; i < slices; i++) {
+		m_uRecordsRead += slice[i].read;
+		m_uRecordsRetried += slice[i].retried;
+		if(slice[i].result != RSCP::OK) {
+			iResult = slice[i].result;
+		}
+	}
+	if(iResult < 0) {
+		points.clear();
+	}
+	return iResult;
+}
+
+void RscpQuery::readSlice(SQuerySlice & slice, std::vector<SRscpQueryPoint> & points) {
+	SRscpRollupRecord buffer[QUERY_READ_RECORDS];
+	int64_t first = (points[slice.first].time - m_header.origin) / (int64_t) m_uResolution;
+	int64_t end = first + (int64_t) slice.count * m_uPerPoint;
+	// records before the origin and behind the end of the file have no samples
+	int64_t record = (first < 0) ? 0 : first;
+	if(end > m_records) {
+		end = m_records;
+	}
+	std::vector<double> sums(slice.count, 0.0);
+	while(record < end) {
+		size_t uCount = (end - record < QUERY_READ_RECORDS) ? end - record : QUERY_READ_RECORDS;
+		off_t offset = m_header.headerSize + record * m_header.recordSize;
+		ssize_t iRead = pread(m_fd, buffer, uCount * sizeof(SRscpRollupRecord), offset);
+		if(iRead < 0) {
+			slice.result = QUERY_ERR_FILE;
+			return;
+		}
+		uCount = iRead / sizeof(SRscpRollupRecord);
+		if(uCount == 0) {
+			// the file was truncated meanwhile
+			break;
+		}
+		slice.read += uCount;
+		for(size_t i = 0; i < uCount; i++) {
+			SRscpRollupRecord & r = buffer[i];
+			if(!consistent(r)) {
+				// read while the writer updated it, the second read sees the complete update
+				slice.retried++;
+				slice.read++;
+				off_t recordOffset = offset + i * sizeof(SRscpRollupRecord);
+				if((pread(m_fd, &r, sizeof(r), recordOffset) != (ssize_t) sizeof(r)) || !consistent(r)) {
+					continue;
+				}
+			}
+			if(r.count == 0) {
+				continue;
+			}
+			uint32_t index = (uint32_t) ((record + i - first) / m_uPerPoint);
+			SRscpQueryPoint & point = points[slice.first + index];
+			if((point.count == 0) || (r.min < point.min)) {
+				point.min = r.min;
+			}
+			if((point.count == 0) || (r.max > point.max)) {
+				point.max = r.max;
+			}
+			point.last = r.last;
+			point.count += r.count;
+			sums[index] += (double) r.mean * r.count;
+		}
+		record += uCount;
+	}
+	for(uint32_t i = 0; i < slice.count; i++) {
+		SRscpQueryPoint & point = points[slice.first + i];
+		if(point.count > 0) {
+			point.mean = sums[i] / point.count;
+		}
+	}
+}
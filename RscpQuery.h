@@ -0,0 +1,101 @@
+/*
+ * RscpQuery.h
+ *
+ * Range queries over the rollup files of RscpRollup. A query reads the file with the coarsest
+ * resolution that divides the step, the records of the range are located by their offset and
+ * merged into one point per step. Long ranges are split into slices which are read and merged by
+ * several threads. The files may be written while they are queried: records behind the end of the
+ * file are empty and a record which is inconsistent because it was read during its update is read
+ * again.
+ */
+
+#ifndef RSCPQUERY_H_
+#define RSCPQUERY_H_
+
+#include <stdint.h>
+#include <vector>
+#include "RscpRollup.h"
+
+// records a thread reads at least, shorter ranges are read by the calling thread only
+#define QUERY_RECORDS_PER_THREAD	(64 * 1024)
+// read buffer of a slice in records
+#define QUERY_READ_RECORDS			4096
+
+enum eRscpQueryReturnCodes {
+	QUERY_ERR_SERIES		= -1,	// the series has no rollup file
+	QUERY_ERR_FILE			= -2,	// the file cannot be read
+	QUERY_ERR_FORMAT		= -3,	// the file is no rollup file of the series
+	QUERY_ERR_STEP			= -4,	// the step is no multiple of a stored resolution
+	QUERY_ERR_RANGE			= -5	// the range is empty or too long
+};
+
+// one point of the result, also the record of the binary output
+struct SRscpQueryPoint {
+	int64_t time;				// start of the step, CLOCK_REALTIME in seconds
+	float min;
+	float max;
+	float mean;					// weighted by the sample counts of the merged buckets
+	float last;					// last value of the latest bucket with samples
+	uint32_t count;				// samples of the step, 0 if the step has no samples
+} __attribute__((packed));
+
+class RscpQuery {
+public:
+	RscpQuery();
+	/*
+	 * \brief Read \var series of \var directory between \var from and \var to in points of \var step
+	 *        seconds. \var from is rounded down and \var to up to a multiple of \var step, every step of
+	 *        the range is a point, steps without samples have a count of 0.
+	 * @param threads - threads for long ranges, 1 reads in the calling thread only
+	 * @return        - number of points or an eRscpQueryReturnCodes value
+	 */
+	int32_t run(const char *directory, const char *series, int64_t from, int64_t to, uint32_t step,
+		int threads, std::vector<SRscpQueryPoint> & points);
+	/*
+	 * \brief Resolution of the file a query of \var step reads, 0 if \var step is no multiple of any.
+	 */
+	static uint32_t resolution(uint32_t step);
+	/*
+	 * \brief Convert a short series name like ems.power_grid or bat_data[0]/bat_rsoc into the tag path
+	 *        of the rollup files, TAG_EMS_POWER_GRID and TAG_BAT_DATA[0]/TAG_BAT_RSOC. Parts starting
+	 *        with TAG_ are kept.
+	 * @return - false if the name does not fit into \var size bytes
+	 */
+	static bool seriesName(const char *name, char *buffer, size_t size);
+	/*
+	 * \brief Records read by the last query, including the ones read again.
+	 */
+	uint64_t recordsRead() const {
+		return m_uRecordsRead;
+	}
+	uint64_t recordsRetried() const {
+		return m_uRecordsRetried;
+	}
+	/*
+	 * \brief Resolution of the file read by the last query.
+	 */
+	uint32_t fileResolution() const {
+		return m_uResolution;
+	}
+private:
+	struct SQuerySlice {
+		uint32_t first;			// index of the first point
+		uint32_t count;			// points of the slice
+		int32_t result;
+		uint64_t read;
+		uint64_t retried;
+	};
+
+	void readSlice(SQuerySlice & slice, std::vector<SRscpQueryPoint> & points);
+	static bool consistent(const SRscpRollupRecord & record);
+
+	int m_fd;
+	SRscpRollupHeader m_header;
+	int64_t m_records;			// complete records of the file when the query started
+	uint32_t m_uPerPoint;		// records merged into one point
+	uint32_t m_uResolution;
+	uint64_t m_uRecordsRead;
+	uint64_t m_uRecordsRetried;
+};
+
+#endif /* RSCPQUERY_H_ */
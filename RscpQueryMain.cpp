@@ -0,0 +1,351 @@
+/*
+ * RscpQueryMain.cpp
+ *
+ * Command line tool for range queries over the rollup files written by Rscp -R. The points of a
+ * series are written as CSV or as fixed size binary records, see SRscpQueryPoint.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "RscpQuery.h"
+
+enum eQueryFormat {
+    QUERY_FORMAT_CSV = 0,
+    QUERY_FORMAT_BINARY = 1
+};
+
+/*
+ * \brief Parse a duration of seconds with an optional unit s, m, h, d or w.
+ */
+static bool parseDuration(const char *arg, int64_t *seconds)
+{
+    char *end = NULL;
+    long long value = strtoll(arg, &end, 10);
+    if (end == arg || value < 0)
+	return false;
+    int64_t unit = 1;
+    switch (*end) {
+    case '\0':
+    case 's':
+	break;
+    case 'm':
+	unit = 60;
+	break;
+    case 'h':
+	unit = 60 * 60;
+	break;
+    case 'd':
+	unit = 24 * 60 * 60;
+	break;
+    case 'w':
+	unit = 7 * 24 * 60 * 60;
+	break;
+    default:
+	return false;
+    }
+    if (*end != '\0' && end[1] != '\0')
+	return false;
+    *seconds = value * unit;
+    return true;
+}
+
+/*
+ * \brief Parse a time: now, seconds since the epoch, a duration before now like -30d or a UTC date
+ *        YYYY-MM-DD with an optional THH:MM[:SS].
+ */
+static bool parseTime(const char *arg, int64_t now, int64_t *result)
+{
+    if (strcmp(arg, "now") == 0) {
+	*result = now;
+	return true;
+    }
+    if (arg[0] == '-') {
+	int64_t seconds;
+	if (!parseDuration(arg + 1, &seconds))
+	    return false;
+	*result = now - seconds;
+	return true;
+    }
+    if (strchr(arg, '-') == NULL) {
+	char *end = NULL;
+	long long value = strtoll(arg, &end, 10);
+	if (end == arg || *end != '\0')
+	    return false;
+	*result = value;
+	return true;
+    }
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char separator = 0;
+    int consumed = 0;
+    int fields = sscanf(arg, "%4d-%2d-%2d%n%c%2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &consumed,
+	&separator, &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (fields < 3 || (fields == 3 && arg[consumed] != '\0') || (fields > 3 && separator != 'T') || fields == 4
+	|| fields == 5)
+	return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    *result = timegm(&tm);
+    return true;
+}
+
+static bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0) {
+	ssize_t written = write(fd, data, length);
+	if (written < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return false;
+	}
+	data += written;
+	length -= written;
+    }
+    return true;
+}
+
+static bool writeCsv(int fd, const std::vector<SRscpQueryPoint> & points)
+{
+    std::string out = "time,min,max,mean,last,count\n";
+    char buffer[160];
+    for (size_t i = 0; i < points.size(); i++) {
+	const SRscpQueryPoint & point = points[i];
+	if (point.count == 0)
+	    out.append(buffer, snprintf(buffer, sizeof(buffer), "%lld,,,,,0\n", (long long) point.time));
+	else
+	    out.append(buffer, snprintf(buffer, sizeof(buffer), "%lld,%.9g,%.9g,%.9g,%.9g,%u\n",
+		(long long) point.time, point.min, point.max, point.mean, point.last, point.count));
+	if (out.size() >= 64 * 1024) {
+	    if (!writeAll(fd, out.data(), out.size()))
+		return false;
+	    out.clear();
+	}
+    }
+    return writeAll(fd, out.data(), out.size());
+}
+
+/*
+ * \brief Print the series of \var directory, each series has a file of the 1 min resolution.
+ */
+static int listSeries(const char *directory)
+{
+    DIR *dir = opendir(directory);
+    if (dir == NULL) {
+	fprintf(stderr, "Cannot open %s. errno %i\n", directory, errno);
+	return -1;
+    }
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%u.roll", RscpRollup::resolutions[0]);
+    std::vector<std::string> series;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+	size_t length = strlen(entry->d_name);
+	if (length <= strlen(suffix) || strcmp(entry->d_name + length - strlen(suffix), suffix) != 0)
+	    continue;
+	std::string path = std::string(directory) + "/" + entry->d_name;
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	    continue;
+	SRscpRollupHeader header;
+	if (pread(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header)
+	    && RscpRollup::checkHeader(header, NULL, RscpRollup::resolutions[0])) {
+	    header.series[sizeof(header.series) - 1] = 0;
+	    series.push_back(header.series);
+	}
+	close(fd);
+    }
+    closedir(dir);
+    std::sort(series.begin(), series.end());
+    for (size_t i = 0; i < series.size(); i++)
+	printf("%s\n", series[i].c_str());
+    return 0;
+}
+
+static void showhelp(char *prog)
+{
+    printf("Usage:\n");
+    printf("%s [-d dir] -s series [-b from] [-e to] [-i step] [-f csv|bin] [-j threads] [-o file] [-q]\n", prog);
+    printf("%s [-d dir] -l\n", prog);
+    printf("  --help, -h         \tshows this help\n");
+    printf("  --dir, -d          \tdirectory of the rollup files written by Rscp -R, default .\n");
+    printf("  --list, -l         \tlists the series of the directory\n");
+    printf("  --series, -s       \ttag path like TAG_BAT_DATA[0]/TAG_BAT_RSOC or short like ems.power_grid\n");
+    printf("  --from, -b         \tstart: now, seconds since the epoch, -30d before now or UTC 2024-05-01[T12:00[:00]], default -1d\n");
+    printf("  --to, -e           \tend of the range, same forms as --from, default now\n");
+    printf("  --step, -i         \tseconds per point with an optional unit m, h, d or w, a multiple of 1m, default 1h\n");
+    printf("  --format, -f       \tcsv (default) or bin, fixed size records of time, min, max, mean, last and count\n");
+    printf("  --threads, -j      \tthreads for long ranges, default the number of cores\n");
+    printf("  --output, -o       \twrites the points to a file instead of stdout\n");
+    printf("  --quiet, -q        \tno statistics on stderr\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *directory = ".";
+    const char *seriesArg = NULL;
+    const char *output = NULL;
+    const char *fromArg = "-1d";
+    const char *toArg = "now";
+    int64_t step = 60 * 60;
+    int format = QUERY_FORMAT_CSV;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    bool bQuiet = false;
+    bool bList = false;
+    int opt;
+
+    while (1) {
+	static struct option long_options[] = {
+	    {"help",		no_argument,		0, 'h'},
+	    {"dir",		required_argument,	0, 'd'},
+	    {"list",		no_argument,		0, 'l'},
+	    {"series",		required_argument,	0, 's'},
+	    {"from",		required_argument,	0, 'b'},
+	    {"to",		required_argument,	0, 'e'},
+	    {"step",		required_argument,	0, 'i'},
+	    {"format",		required_argument,	0, 'f'},
+	    {"threads",		required_argument,	0, 'j'},
+	    {"output",		required_argument,	0, 'o'},
+	    {"quiet",		no_argument,		0, 'q'},
+	    {0,			0,			0, 0 }
+	};
+	int option_index = 0;
+	opt = getopt_long(argc, argv, "hd:ls:b:e:i:f:j:o:q", long_options, &option_index);
+
+	if(opt == -1)
+	    break;
+
+	switch (opt) {
+	case 'h':
+	    showhelp(argv[0]);
+	    return 0;
+	case 'd':
+	    directory = optarg;
+	    break;
+	case 'l':
+	    bList = true;
+	    break;
+	case 's':
+	    seriesArg = optarg;
+	    break;
+	case 'b':
+	    fromArg = optarg;
+	    break;
+	case 'e':
+	    toArg = optarg;
+	    break;
+	case 'i':
+	    if (!parseDuration(optarg, &step) || step <= 0 || step > UINT32_MAX) {
+		fprintf(stderr, "Invalid step %s\n", optarg);
+		return -1;
+	    }
+	    break;
+	case 'f':
+	    if (strcmp(optarg, "csv") == 0)
+		format = QUERY_FORMAT_CSV;
+	    else if (strcmp(optarg, "bin") == 0)
+		format = QUERY_FORMAT_BINARY;
+	    else {
+		fprintf(stderr, "Invalid format %s\n", optarg);
+		return -1;
+	    }
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 'o':
+	    output = optarg;
+	    break;
+	case 'q':
+	    bQuiet = true;
+	    break;
+	default:
+	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
+	    break;
+	}
+    }
+    if (bList)
+	return listSeries(directory);
+    if (seriesArg == NULL || optind != argc) {
+	showhelp(argv[0]);
+	return -1;
+    }
+    if (threads < 1)
+	threads = 1;
+
+    int64_t now = time(NULL);
+    int64_t from, to;
+    if (!parseTime(fromArg, now, &from)) {
+	fprintf(stderr, "Invalid time %s\n", fromArg);
+	return -1;
+    }
+    if (!parseTime(toArg, now, &to)) {
+	fprintf(stderr, "Invalid time %s\n", toArg);
+	return -1;
+    }
+    char series[ROLLUP_SERIES_LENGTH];
+    if (!RscpQuery::seriesName(seriesArg, series, sizeof(series))) {
+	fprintf(stderr, "Series name %s is too long\n", seriesArg);
+	return -1;
+    }
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RscpQuery query;
+    std::vector<SRscpQueryPoint> points;
+    int32_t iResult = query.run(directory, series, from, to, step, threads, points);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    switch (iResult) {
+    case QUERY_ERR_SERIES:
+	fprintf(stderr, "No rollup of %s in %s\n", series, directory);
+	return -1;
+    case QUERY_ERR_FILE:
+	fprintf(stderr, "Cannot read the rollup of %s. errno %i\n", series, errno);
+	return -1;
+    case QUERY_ERR_FORMAT:
+	fprintf(stderr, "Invalid rollup file of %s\n", series);
+	return -1;
+    case QUERY_ERR_STEP:
+	fprintf(stderr, "Step %lld s is no multiple of %u s\n", (long long) step, RscpRollup::resolutions[0]);
+	return -1;
+    case QUERY_ERR_RANGE:
+	fprintf(stderr, "Invalid range %s to %s\n", fromArg, toArg);
+	return -1;
+    default:
+	break;
+    }
+
+    int out = STDOUT_FILENO;
+    if (output != NULL) {
+	out = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out < 0) {
+	    fprintf(stderr, "Cannot create output file %s\n", output);
+	    return -1;
+	}
+    }
+    bool bWritten;
+    if (format == QUERY_FORMAT_BINARY)
+	bWritten = writeAll(out, (const char *) points.data(), points.size() * sizeof(SRscpQueryPoint));
+    else
+	bWritten = writeCsv(out, points);
+    if (!bWritten)
+	fprintf(stderr, "Cannot write output. errno %i\n", errno);
+    if (out != STDOUT_FILENO)
+	close(out);
+
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    if (!bQuiet)
+	fprintf(stderr, "%s: %i points of %lld s from the %u s rollup, %llu records read (%llu again) in %.3f ms\n",
+	    series, iResult, (long long) step, query.fileResolution(), (unsigned long long) query.recordsRead(),
+	    (unsigned long long) query.recordsRetried(), seconds * 1e3);
+    return bWritten ? 0 : -1;
+}
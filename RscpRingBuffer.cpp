@@ -0,0 +1,102 @@
+/*
+ * RscpRingBuffer.cpp
+ *
+ * Receive ring buffer whose memory is mapped twice back to back.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "RscpRingBuffer.h"
+
+RscpRingBuffer::RscpRingBuffer() :
+	m_pBase(NULL),
+	m_uSize(0),
+	m_uRead(0),
+	m_uWrite(0),
+	m_bMirrored(false) {
+}
+
+RscpRingBuffer::~RscpRingBuffer() {
+	destroy();
+}
+
+bool RscpRingBuffer::create(size_t size) {
+	destroy();
+	size_t uPage = sysconf(_SC_PAGESIZE);
+	size = (size + uPage - 1) / uPage * uPage;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+	// map the same anonymous file twice into one reserved range of twice the size
+	int fd = syscall(SYS_memfd_create, "rscp-ring", 1 /* MFD_CLOEXEC */);
+	if(fd >= 0) {
+		uint8_t *pRange = NULL;
+		if(ftruncate(fd, size) == 0) {
+			void *pReserved = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if(pReserved != MAP_FAILED) {
+				pRange = (uint8_t *) pReserved;
+				void *pFirst = mmap(pRange, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+				void *pSecond = mmap(pRange + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+				if((pFirst == MAP_FAILED) || (pSecond == MAP_FAILED)) {
+					munmap(pRange, 2 * size);
+					pRange = NULL;
+				}
+			}
+		}
+		close(fd);
+		if(pRange != NULL) {
+			m_pBase = pRange;
+			m_uSize = size;
+			m_bMirrored = true;
+			reset();
+			return true;
+		}
+	}
+#endif
+	m_pBase = (uint8_t *) malloc(size);
+	if(m_pBase == NULL) {
+		return false;
+	}
+	m_uSize = size;
+	m_bMirrored = false;
+	reset();
+	return true;
+}
+
+void RscpRingBuffer::destroy() {
+	if(m_pBase != NULL) {
+		if(m_bMirrored) {
+			munmap(m_pBase, 2 * m_uSize);
+		}
+		else {
+			free(m_pBase);
+		}
+	}
+	m_pBase = NULL;
+	m_uSize = 0;
+	m_bMirrored = false;
+	reset();
+}
+
+void RscpRingBuffer::consume(size_t length) {
+	m_uRead += length;
+	if(m_uRead == m_uWrite) {
+		// start at the beginning again, keeps the linear buffer from moving data at all in the common case
+		reset();
+	}
+	else if(m_uSize - m_uWrite < m_uSize / 4) {
+		// linear fallback, the free space at the end is getting small
+		compact();
+	}
+}
+
+void RscpRingBuffer::compact() {
+	if(m_bMirrored || (m_uRead == 0)) {
+		return;
+	}
+	memmove(m_pBase, m_pBase + m_uRead, m_uWrite - m_uRead);
+	m_uWrite -= m_uRead;
+	m_uRead = 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * RscpRingBuffer.h
+ *
+ * Receive ring buffer whose memory is mapped twice back to back. Data which wraps around the end
+ * of the ring is still readable and writable as one contiguous block, so received frames are
+ * consumed by advancing the read position and never have to be moved.
+ */
+
+#ifndef RSCPRINGBUFFER_H_
+#define RSCPRINGBUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class RscpRingBuffer {
+public:
+	/*
+	 * Constructor
+	 */
+	RscpRingBuffer();
+	/*
+	 * Destructor
+	 */
+	virtual ~RscpRingBuffer();
+	/*
+	 * \brief Allocate the ring with at least \var size bytes, the size is rounded up to the page size.
+	 *        If the mirror mapping is not available a linear buffer is used which moves the unread data
+	 *        to the front when the free space at the end is exhausted.
+	 * @return - true on success
+	 */
+	bool create(size_t size);
+	/*
+	 * \brief Release the memory of the ring.
+	 */
+	void destroy();
+	/*
+	 * \brief Drop all data, the memory is kept.
+	 */
+	void reset() {
+		m_uRead = m_uWrite = 0;
+	}
+	/*
+	 * \brief Start of the unread data, readable() bytes are contiguous.
+	 */
+	uint8_t *readPtr() const {
+		return m_pBase + (m_uRead % m_uSize);
+	}
+	size_t readable() const {
+		return m_uWrite - m_uRead;
+	}
+	/*
+	 * \brief Start of the free space, writable() bytes are contiguous.
+	 */
+	uint8_t *writePtr() const {
+		return m_pBase + (m_uWrite % m_uSize);
+	}
+	size_t writable() const {
+		return m_bMirrored ? (m_uSize - readable()) : (m_uSize - m_uWrite);
+	}
+	/*
+	 * \brief Mark \var length bytes behind writePtr() as written.
+	 */
+	void produce(size_t length) {
+		m_uWrite += length;
+	}
+	/*
+	 * \brief Release \var length bytes at readPtr().
+	 */
+	void consume(size_t length);
+	/*
+	 * \brief Move the unread data of the linear fallback to the front, nothing to do for the mirrored ring.
+	 */
+	void compact();
+	size_t size() const {
+		return m_uSize;
+	}
+	bool isMirrored() const {
+		return m_bMirrored;
+	}
+	/*
+	 * \brief Whole mapping of the ring, both halves if it is mirrored, for SocketRegisterBuffer().
+	 */
+	uint8_t *base() const {
+		return m_pBase;
+	}
+	size_t mappedSize() const {
+		return m_bMirrored ? (2 * m_uSize) : m_uSize;
+	}
+private:
+	uint8_t *m_pBase;
+	size_t m_uSize;
+	// absolute positions, only the offset modulo m_uSize is used for addressing
+	uint64_t m_uRead;
+	uint64_t m_uWrite;
+	bool m_bMirrored;
+};
+
+#endif /* RSCPRINGBUFFER_H_ */
@@ -0,0 +1,295 @@
+/*
+ * RscpRollup.cpp
+ *
+ * Downsampled history of the received values.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "RscpRollup.h"
+#include "RscpTagPath.h"
+#include "RscpTypes.h"
+
+const uint32_t RscpRollup::resolutions[ROLLUP_RESOLUTIONS] = { 60, 15 * 60, 60 * 60, 24 * 60 * 60 };
+
+RscpRollup::RscpRollup() :
+	m_lastFlush(0), m_uSamples(0), m_uLate(0), m_uErrors(0) {
+}
+
+RscpRollup::~RscpRollup() {
+	close();
+}
+
+bool RscpRollup::open(const char *directory) {
+	close();
+	if((mkdir(directory, 0755) != 0) && (errno != EEXIST)) {
+		printf("Cannot create rollup directory %s. errno %i\n", directory, errno);
+		return false;
+	}
+	m_directory = directory;
+	return true;
+}
+
+void RscpRollup::close() {
+	flush();
+	for(std::map<std::string, SRollupSeries *>::iterator it = m_series.begin(); it != m_series.end(); ++it) {
+		for(int i = 0; i < ROLLUP_RESOLUTIONS; i++) {
+			if(it->second->files[i].fd >= 0) {
+				::close(it->second->files[i].fd);
+			}
+		}
+		delete it->second;
+	}
+	m_series.clear();
+	m_directory.clear();
+}
+
+bool RscpRollup::fileName(char *buffer, size_t size, const char *directory, const char *series, uint32_t resolution) {
+	int length = snprintf(buffer, size, "%s/%s.%u.roll", directory, series, resolution);
+	if((length < 0) || ((size_t) length >= size)) {
+		return false;
+	}
+	// the tag path separators of the series, the directory keeps its own
+	for(char *p = buffer + strlen(directory) + 1; *p != 0; p++) {
+		if(*p == '/') {
+			*p = '.';
+		}
+	}
+	return true;
+}
+
+void RscpRollup::addValue(const SRscpValueRef & value, int64_t time) {
+	if(!enabled()) {
+		return;
+	}
+	addChildren(value, time, NULL);
+}
+
+void RscpRollup::addChildren(const SRscpValueRef & value, int64_t time, const char *prefix) {
+	char name[ROLLUP_SERIES_LENGTH];
+	const char *tagName = RscpTagRequest::tagName(value.tag);
+	int length;
+	if(tagName != NULL) {
+		length = snprintf(name, sizeof(name), "%s%s%s", prefix ? prefix : "", prefix ? "/" : "", tagName);
+	}
+	else {
+		length = snprintf(name, sizeof(name), "%s%s0x%08X", prefix ? prefix : "", prefix ? "/" : "", value.tag);
+	}
+	if((length < 0) || ((size_t) length >= sizeof(name))) {
+		m_uErrors++;
+		return;
+	}
+
+	if(value.dataType != RSCP::eTypeContainer) {
+		double d;
+		if((value.dataType != RSCP::eTypeError) && (value.dataType != RSCP::eTypeTimestamp)
+			&& RscpWalker::asDouble(value, d)) {
+			add(name, time, d);
+		}
+		return;
+	}
+	// the index of a device container is part of the name like in a tag path, TAG_BAT_DATA[0]
+	SRscpValueRef child;
+	SRscpTag indexTag = 0;
+	RscpWalker walker = RscpWalker::children(value);
+	while(walker.next(child)) {
+		const char *childName = RscpTagRequest::tagName(child.tag);
+		size_t childLength = childName ? strlen(childName) : 0;
+		double index;
+		if((childLength > 6) && (strcmp(childName + childLength - 6, "_INDEX") == 0)
+			&& RscpWalker::asDouble(child, index)) {
+			length += snprintf(name + length, sizeof(name) - length, "[%u]", (uint32_t) index);
+			if((size_t) length >= sizeof(name)) {
+				m_uErrors++;
+				return;
+			}
+			indexTag = child.tag;
+			break;
+		}
+	}
+	walker = RscpWalker::children(value);
+	while(walker.next(child)) {
+		if(child.tag != indexTag) {
+			addChildren(child, time, name);
+		}
+	}
+}
+
+int32_t RscpRollup::add(const char *series, int64_t time, double value) {
+	if(!enabled() || (time < 0)) {
+		return RSCP::OK;
+	}
+	SRollupSeries *entry;
+	std::map<std::string, SRollupSeries *>::iterator it = m_series.find(series);
+	if(it != m_series.end()) {
+		entry = it->second;
+	}
+	else {
+		if((strlen(series) >= ROLLUP_SERIES_LENGTH) || (m_series.size() >= ROLLUP_MAX_SERIES)) {
+			m_uErrors++;
+			return ROLLUP_ERR_SERIES;
+		}
+		// a series which cannot be opened stays in the map with closed files and is not retried
+		entry = new SRollupSeries;
+		m_series[series] = entry;
+		for(int i = 0; i < ROLLUP_RESOLUTIONS; i++) {
+			entry->files[i].fd = -1;
+		}
+		for(int i = 0; i < ROLLUP_RESOLUTIONS; i++) {
+			int32_t iResult = openFile(entry->files[i], series, resolutions[i], time);
+			if(iResult != RSCP::OK) {
+				m_uErrors++;
+				return iResult;
+			}
+		}
+	}
+
+	m_uSamples++;
+	int32_t iResult = RSCP::OK;
+	for(int i = 0; i < ROLLUP_RESOLUTIONS; i++) {
+		SRollupFile & file = entry->files[i];
+		if(file.fd < 0) {
+			return ROLLUP_ERR_FILE;
+		}
+		int64_t bucket = time - time % file.header.resolution;
+		if(bucket < file.header.origin) {
+			m_uLate++;
+			continue;
+		}
+		if((bucket != file.bucket) && (store(file) != RSCP::OK)) {
+			iResult = ROLLUP_ERR_FILE;
+			m_uErrors++;
+			continue;
+		}
+		SRscpRollupRecord & pending = file.pending;
+		if((pending.count == 0) || (value < pending.min)) {
+			pending.min = value;
+		}
+		if((pending.count == 0) || (value > pending.max)) {
+			pending.max = value;
+		}
+		pending.last = value;
+		pending.count++;
+		file.sum += value;
+		file.bucket = bucket;
+	}
+	// a killed process loses at most one interval and readers see the open buckets
+	if(time >= m_lastFlush + ROLLUP_FLUSH_INTERVAL) {
+		m_lastFlush = time;
+		if(flush() != RSCP::OK) {
+			iResult = ROLLUP_ERR_FILE;
+		}
+	}
+	return iResult;
+}
+
+int32_t RscpRollup::openFile(SRollupFile & file, const char *series, uint32_t resolution, int64_t time) {
+	file.fd = -1;
+	file.bucket = -1;
+	file.sum = 0.0;
+	memset(&file.pending, 0, sizeof(file.pending));
+	char path[1024];
+	if(!fileName(path, sizeof(path), m_directory.c_str(), series, resolution)) {
+		printf("Rollup file name of %s is too long\n", series);
+		return ROLLUP_ERR_SERIES;
+	}
+	int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0) {
+		printf("Cannot open rollup file %s. errno %i\n", path, errno);
+		return ROLLUP_ERR_FILE;
+	}
+	// another process may create the same file, the header is written once under the lock
+	flock(fd, LOCK_EX);
+	SRscpRollupHeader & header = file.header;
+	ssize_t iRead = pread(fd, &header, sizeof(header), 0);
+	if(iRead == 0) {
+		// a new file starts with the bucket of its first sample
+		memset(&header, 0, sizeof(header));
+		strcpy(header.magic, RSCP_ROLLUP_MAGIC);
+		header.version = RSCP_ROLLUP_VERSION;
+		header.headerSize = sizeof(SRscpRollupHeader);
+		header.recordSize = sizeof(SRscpRollupRecord);
+		header.resolution = resolution;
+		header.origin = time - time % resolution;
+		strcpy(header.series, series);
+		if(pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+			printf("Cannot write rollup file %s. errno %i\n", path, errno);
+			::close(fd);
+			return ROLLUP_ERR_FILE;
+		}
+	}
+	else if((iRead != (ssize_t) sizeof(header)) || !checkHeader(header, series, resolution)) {
+		printf("Invalid rollup file %s\n", path);
+		::close(fd);
+		return ROLLUP_ERR_FORMAT;
+	}
+	flock(fd, LOCK_UN);
+	file.fd = fd;
+	return RSCP::OK;
+}
+
+bool RscpRollup::checkHeader(const SRscpRollupHeader & header, const char *series, uint32_t resolution) {
+	return (memcmp(header.magic, RSCP_ROLLUP_MAGIC, sizeof(header.magic)) == 0)
+		&& (header.version == RSCP_ROLLUP_VERSION) && (header.headerSize >= sizeof(SRscpRollupHeader))
+		&& (header.recordSize == sizeof(SRscpRollupRecord)) && (header.resolution == resolution)
+		&& ((series == NULL) || (strncmp(header.series, series, sizeof(header.series)) == 0))
+		&& (header.origin % resolution == 0);
+}
+
+int32_t RscpRollup::store(SRollupFile & file) {
+	if(file.pending.count == 0) {
+		return RSCP::OK;
+	}
+	// merge the pending samples into the stored bucket under the lock, so processes which write the
+	// same files do not overwrite each other, a bucket behind the end of the file has no samples yet
+	int64_t offset = recordOffset(file.header, file.bucket);
+	SRscpRollupRecord record;
+	flock(file.fd, LOCK_EX);
+	ssize_t iRead = pread(file.fd, &record, sizeof(record), offset);
+	if(iRead != (ssize_t) sizeof(record)) {
+		memset(&record, 0, sizeof(record));
+	}
+	const SRscpRollupRecord & pending = file.pending;
+	double sum = (double) record.mean * record.count + file.sum;
+	if((record.count == 0) || (pending.min < record.min)) {
+		record.min = pending.min;
+	}
+	if((record.count == 0) || (pending.max > record.max)) {
+		record.max = pending.max;
+	}
+	record.last = pending.last;
+	record.count += pending.count;
+	record.mean = sum / record.count;
+	ssize_t iWritten = (iRead >= 0) ? pwrite(file.fd, &record, sizeof(record), offset) : -1;
+	flock(file.fd, LOCK_UN);
+	if(iWritten != (ssize_t) sizeof(record)) {
+		printf("Cannot write rollup of %s. errno %i\n", file.header.series, errno);
+		return ROLLUP_ERR_FILE;
+	}
+	memset(&file.pending, 0, sizeof(file.pending));
+	file.sum = 0.0;
+	return RSCP::OK;
+}
+
+int32_t RscpRollup::flush() {
+	int32_t iResult = RSCP::OK;
+	for(std::map<std::string, SRollupSeries *>::iterator it = m_series.begin(); it != m_series.end(); ++it) {
+		for(int i = 0; i < ROLLUP_RESOLUTIONS; i++) {
+			SRollupFile & file = it->second->files[i];
+			if((file.fd >= 0) && (store(file) != RSCP::OK)) {
+				iResult = ROLLUP_ERR_FILE;
+			}
+		}
+	}
+	return iResult;
+}
+
+void RscpRollup::print(FILE *file) const {
+	fprintf(file, "Rollup %s: %u series, %llu samples, %llu late, %llu errors\n", m_directory.c_str(),
+		(uint32_t) m_series.size(), (unsigned long long) m_uSamples, (unsigned long long) m_uLate,
+		(unsigned long long) m_uErrors);
+}
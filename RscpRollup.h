@@ -0,0 +1,146 @@
+/*
+ * RscpRollup.h
+ *
+ * Downsampled history of the received values. Every numeric response value is a series named by
+ * its tag path (TAG_BAT_DATA[0]/TAG_BAT_RSOC), each series has one file per resolution with the
+ * min, max, mean and last value and the sample count of every bucket. The files have a fixed
+ * stride: an SRscpRollupHeader followed by one SRscpRollupRecord per bucket from the origin on, so
+ * the record of a time is read at a computed offset and buckets without samples have a count of 0.
+ * The samples of a bucket are merged into its record when the bucket changes and at least every
+ * ROLLUP_FLUSH_INTERVAL, under an exclusive flock() of the file, so a process polling once and a
+ * long running one continue the same buckets. Buckets start at multiples of the resolution in UTC.
+ * All values are stored in host byte order (little endian on all supported targets).
+ */
+
+#ifndef RSCPROLLUP_H_
+#define RSCPROLLUP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include "RscpWalker.h"
+
+#define RSCP_ROLLUP_MAGIC		"RSCPROL"
+#define RSCP_ROLLUP_VERSION		1
+#define ROLLUP_RESOLUTIONS		4
+#define ROLLUP_SERIES_LENGTH	128
+// every series keeps ROLLUP_RESOLUTIONS files open
+#define ROLLUP_MAX_SERIES		128
+// seconds of sample time after which the pending samples are written
+#define ROLLUP_FLUSH_INTERVAL	60
+
+enum eRscpRollupReturnCodes {
+	ROLLUP_ERR_FILE			= -1,	// a file cannot be created, read or written
+	ROLLUP_ERR_FORMAT		= -2,	// a file exists but is no rollup file of the series and resolution
+	ROLLUP_ERR_SERIES		= -3	// the series name is too long or there are too many series
+};
+
+struct SRscpRollupHeader {
+	char magic[8];				// RSCP_ROLLUP_MAGIC including the terminating zero
+	uint16_t version;			// RSCP_ROLLUP_VERSION
+	uint16_t headerSize;		// sizeof(SRscpRollupHeader), records start behind
+	uint16_t recordSize;		// sizeof(SRscpRollupRecord)
+	uint16_t reserved;
+	uint32_t resolution;		// seconds per bucket
+	uint32_t reserved2;
+	int64_t origin;				// start of the first bucket, CLOCK_REALTIME in seconds
+	char series[ROLLUP_SERIES_LENGTH];
+} __attribute__((packed));
+
+struct SRscpRollupRecord {
+	float min;
+	float max;
+	float mean;
+	float last;
+	uint32_t count;				// samples of the bucket, 0 if the bucket has no samples
+} __attribute__((packed));
+
+class RscpRollup {
+public:
+	/*
+	 * Constructor
+	 */
+	RscpRollup();
+	/*
+	 * Destructor
+	 */
+	virtual ~RscpRollup();
+	/*
+	 * \brief Store the series in \var directory, it is created if missing.
+	 * @return - true on success
+	 */
+	bool open(const char *directory);
+	/*
+	 * \brief Write the pending samples and close all files.
+	 */
+	void close();
+	bool enabled() const {
+		return !m_directory.empty();
+	}
+	/*
+	 * \brief Add every numeric value of \var value and its children, each to the series of its tag path.
+	 *        Errors, strings, byte arrays and timestamps are skipped, index tags become part of the name.
+	 * @param time - CLOCK_REALTIME in seconds
+	 */
+	void addValue(const SRscpValueRef & value, int64_t time);
+	/*
+	 * \brief Add a sample to all resolutions of \var series. Samples before the origin of a file are
+	 *        counted as late and dropped.
+	 * @return - RSCP::OK or an eRscpRollupReturnCodes value
+	 */
+	int32_t add(const char *series, int64_t time, double value);
+	/*
+	 * \brief Merge the pending samples of all series into their files.
+	 * @return - RSCP::OK or ROLLUP_ERR_FILE
+	 */
+	int32_t flush();
+	void print(FILE *file) const;
+	/*
+	 * \brief Resolutions of the files in seconds: 1 min, 15 min, 1 h and 1 d.
+	 */
+	static const uint32_t resolutions[ROLLUP_RESOLUTIONS];
+	/*
+	 * \brief Name of the file of \var series with \var resolution in \var directory, '/' of the tag
+	 *        path is stored as '.'.
+	 * @return - false if the name does not fit into \var size bytes
+	 */
+	static bool fileName(char *buffer, size_t size, const char *directory, const char *series, uint32_t resolution);
+	/*
+	 * \brief True if \var header belongs to a rollup file of \var series (any series if NULL) with \var resolution.
+	 */
+	static bool checkHeader(const SRscpRollupHeader & header, const char *series, uint32_t resolution);
+	/*
+	 * \brief Offset of the record of the bucket starting at \var bucket.
+	 */
+	static int64_t recordOffset(const SRscpRollupHeader & header, int64_t bucket) {
+		return header.headerSize + (bucket - header.origin) / header.resolution * header.recordSize;
+	}
+private:
+	RscpRollup(const RscpRollup &);
+	RscpRollup & operator=(const RscpRollup &);
+
+	struct SRollupFile {
+		int fd;
+		SRscpRollupHeader header;
+		int64_t bucket;			// start of the bucket of the pending samples, -1 if none
+		SRscpRollupRecord pending;	// samples not yet merged into the file, mean is unused
+		double sum;				// of the pending samples
+	};
+	struct SRollupSeries {
+		SRollupFile files[ROLLUP_RESOLUTIONS];
+	};
+
+	void addChildren(const SRscpValueRef & value, int64_t time, const char *prefix);
+	int32_t openFile(SRollupFile & file, const char *series, uint32_t resolution, int64_t time);
+	int32_t store(SRollupFile & file);
+
+	std::string m_directory;
+	std::map<std::string, SRollupSeries *> m_series;
+	int64_t m_lastFlush;
+	uint64_t m_uSamples;
+	uint64_t m_uLate;
+	uint64_t m_uErrors;
+};
+
+#endif /* RSCPROLLUP_H_ */
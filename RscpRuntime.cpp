@@ -0,0 +1,497 @@
+/*
+ * RscpRuntime.cpp
+ *
+ * Polls all devices of the configuration concurrently.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <chrono>
+#include "RscpRuntime.h"
+#include "RscpProtocol.h"
+#include "RscpWalker.h"
+#include "RscpTags.h"
+#include "SocketConnection.h"
+
+volatile sig_atomic_t RscpRuntime::s_bReload = 0;
+volatile sig_atomic_t RscpRuntime::s_bStop = 0;
+
+RscpRuntime::RscpRuntime() :
+	m_uNextId(1), m_bConnectorStop(false), m_uFreeConnectors(0) {
+}
+
+RscpRuntime::~RscpRuntime() {
+	while(!m_devices.empty()) {
+		remove(m_devices.size() - 1);
+	}
+}
+
+void RscpRuntime::run(const char *path, const RscpConfig & config, int seconds) {
+	s_bReload = 0;
+	s_bStop = 0;
+	m_bConnectorStop = false;
+	apply(config);
+
+	uint64_t uEnd = (seconds > 0) ? RscpStats::now() + seconds * 1000000000ULL : 0;
+	uint64_t uTimeout = RECEIVE_TIMEOUT_MS * 1000000ULL;
+	while(!s_bStop) {
+		if(s_bReload) {
+			s_bReload = 0;
+			RscpConfig reloaded;
+			if(reloaded.load(path) == RSCP::OK) {
+				printf("Reloaded %s\n", path);
+				apply(reloaded);
+			}
+			else {
+				printf("Reload of %s failed, the configuration is kept\n", path);
+			}
+		}
+
+		std::vector<SConnectJob> results;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			results.swap(m_results);
+		}
+		for(size_t i = 0; i < results.size(); i++) {
+			SRscpRuntimeDevice *device = NULL;
+			for(size_t j = 0; (device == NULL) && (j < m_devices.size()); j++) {
+				if((m_devices[j]->id == results[i].id) && (m_devices[j]->state == RUNTIME_CONNECTING)) {
+					device = m_devices[j];
+				}
+			}
+			if(device == NULL) {
+				// the device was removed or restarted while it was connecting
+				if(results[i].iSocket >= 0) {
+					SocketClose(results[i].iSocket);
+				}
+			}
+			else if(results[i].iSocket < 0) {
+				fail(*device, "connect", results[i].iSocket);
+			}
+			else {
+				startSession(*device, results[i].iSocket);
+			}
+		}
+
+		uint64_t uNow = RscpStats::now();
+		if((uEnd != 0) && (uNow >= uEnd)) {
+			break;
+		}
+		uint64_t uWake = uNow + RUNTIME_TICK_MS * 1000000ULL;
+		bool bSessions = false;
+		for(size_t i = 0; i < m_devices.size(); i++) {
+			SRscpRuntimeDevice & device = *m_devices[i];
+			schedule(device, uNow);
+			uint64_t uDue = uWake;
+			if(device.state == RUNTIME_RETRY) {
+				uDue = device.uRetryAt;
+			}
+			else if(device.bAwaiting) {
+				uDue = device.uSent + uTimeout;
+			}
+			else if(device.state == RUNTIME_RUNNING) {
+				uDue = device.uNextPoll;
+			}
+			if(uDue < uWake) {
+				uWake = uDue;
+			}
+			bSessions |= (device.session != NULL);
+		}
+		if((uEnd != 0) && (uEnd < uWake)) {
+			uWake = uEnd;
+		}
+		int iWaitMs = (uWake > uNow) ? (int) ((uWake - uNow + 999999) / 1000000) : 0;
+
+		if(!bSessions) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if(m_results.empty()) {
+				m_condition.wait_for(lock, std::chrono::milliseconds(iWaitMs));
+			}
+			continue;
+		}
+		SSocketCompletion completions[RUNTIME_MAX_COMPLETIONS];
+		int iCount = SocketSubmit(completions, RUNTIME_MAX_COMPLETIONS, iWaitMs);
+		if((iCount < 0) && (iCount != -EINTR)) {
+			printf("Transport error %i\n", iCount);
+			break;
+		}
+		if(iCount > 0) {
+			RscpSession::dispatch(completions, iCount, handleFrame, NULL);
+		}
+		for(size_t i = 0; i < m_devices.size(); i++) {
+			SRscpRuntimeDevice & device = *m_devices[i];
+			if(device.session == NULL) {
+				continue;
+			}
+			if(device.session->lastResult() < 0) {
+				fail(device, "receive", device.session->lastResult());
+			}
+			else if((device.state == RUNTIME_AUTHENTICATING) && !device.bAwaiting) {
+				fail(device, "authentication", 0);
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bConnectorStop = true;
+	}
+	m_condition.notify_all();
+	// a connector in SocketConnect() returns after the connect timeout at the latest
+	for(size_t i = 0; i < m_connectors.size(); i++) {
+		m_connectors[i].join();
+	}
+	m_connectors.clear();
+	m_uFreeConnectors = 0;
+	for(size_t i = 0; i < m_results.size(); i++) {
+		if(m_results[i].iSocket >= 0) {
+			SocketClose(m_results[i].iSocket);
+		}
+	}
+	m_results.clear();
+	m_jobs.clear();
+	// the states stay for print()
+	for(size_t i = 0; i < m_devices.size(); i++) {
+		if(m_devices[i]->session != NULL) {
+			m_devices[i]->session->close();
+			delete m_devices[i]->session;
+			m_devices[i]->session = NULL;
+		}
+	}
+}
+
+void RscpRuntime::apply(const RscpConfig & config) {
+	uint32_t uAdded = 0, uUnchanged = 0, uUpdated = 0, uRestarted = 0, uRemoved = 0;
+	for(size_t i = 0; i < m_devices.size();) {
+		SRscpRuntimeDevice & device = *m_devices[i];
+		const SRscpDeviceConfig *next = config.find(device.config.name);
+		if((next == NULL) || next->poll.empty()) {
+			printf("Device %s removed\n", device.config.name);
+			remove(i);
+			uRemoved++;
+			continue;
+		}
+		if(!RscpConfig::sameSession(device.config, *next)) {
+			printf("Device %s restarted\n", device.config.name);
+			stop(device);
+			device.config = *next;
+			device.uFailures = 0;
+			device.uRetryAt = 0;
+			device.uRestarts++;
+			preparePoll(device);
+			uRestarted++;
+		}
+		else if(!RscpConfig::samePoll(device.config, *next)) {
+			// the session is kept, the next poll uses the new frame
+			printf("Device %s updated\n", device.config.name);
+			device.config = *next;
+			preparePoll(device);
+			device.uNextPoll = RscpStats::now();
+			uUpdated++;
+		}
+		else {
+			device.config = *next;
+			uUnchanged++;
+		}
+		i++;
+	}
+	for(uint32_t i = 0; i < config.deviceCount(); i++) {
+		const SRscpDeviceConfig & next = config.device(i);
+		bool bKnown = false;
+		for(size_t j = 0; !bKnown && (j < m_devices.size()); j++) {
+			bKnown = (strcmp(m_devices[j]->config.name, next.name) == 0);
+		}
+		if(bKnown) {
+			continue;
+		}
+		if(next.poll.empty()) {
+			printf("Device %s has no poll paths: not started\n", next.name);
+			continue;
+		}
+		add(next);
+		uAdded++;
+	}
+	printf("Devices: %u added, %u unchanged, %u updated, %u restarted, %u removed\n", uAdded, uUnchanged, uUpdated,
+		uRestarted, uRemoved);
+}
+
+bool RscpRuntime::preparePoll(SRscpRuntimeDevice & device) {
+	RscpProtocol protocol;
+	protocol.destroyFrameData(device.authFrame);
+	protocol.destroyFrameData(device.pollFrame);
+	memset(&device.authFrame, 0, sizeof(device.authFrame));
+	memset(&device.pollFrame, 0, sizeof(device.pollFrame));
+
+	m_builder.clear();
+	m_builder.open(TAG_RSCP_REQ_AUTHENTICATION);
+	m_builder.add(TAG_RSCP_AUTHENTICATION_USER, device.config.e3dc.e3dc_user);
+	m_builder.add(TAG_RSCP_AUTHENTICATION_PASSWORD, device.config.e3dc.e3dc_password);
+	m_builder.close();
+	protocol.createFrameAsBuffer(&device.authFrame, m_builder.data(), m_builder.length(), true);
+
+	// the paths were validated by the configuration
+	RscpTagRequest request;
+	for(size_t i = 0; i < device.config.poll.size(); i++) {
+		request.add(device.config.poll[i].c_str());
+	}
+	m_builder.clear();
+	request.build(m_builder);
+	protocol.createFrameAsBuffer(&device.pollFrame, m_builder.data(), m_builder.length(), true);
+
+	if((device.sink != NULL) && (device.sink != stdout)) {
+		fclose(device.sink);
+	}
+	device.sink = stdout;
+	if(strcmp(device.config.sink, "-") != 0) {
+		device.sink = fopen(device.config.sink, "a");
+		if(device.sink == NULL) {
+			printf("Device %s: cannot open sink %s (errno %i), using stdout\n", device.config.name, device.config.sink,
+				errno);
+			device.sink = stdout;
+			return false;
+		}
+	}
+	return true;
+}
+
+void RscpRuntime::add(const SRscpDeviceConfig & config) {
+	SRscpRuntimeDevice *device = new SRscpRuntimeDevice();
+	device->config = config;
+	device->id = m_uNextId++;
+	device->state = RUNTIME_RETRY;
+	device->session = NULL;
+	memset(&device->authFrame, 0, sizeof(device->authFrame));
+	memset(&device->pollFrame, 0, sizeof(device->pollFrame));
+	device->sink = NULL;
+	device->bAwaiting = false;
+	device->ucAuthLevel = 0;
+	device->uFailures = 0;
+	device->uNextPoll = 0;
+	device->uRetryAt = 0;
+	device->uSent = 0;
+	device->uPolls = 0;
+	device->uResponses = 0;
+	device->uRestarts = 0;
+	preparePoll(*device);
+	m_devices.push_back(device);
+}
+
+void RscpRuntime::stop(SRscpRuntimeDevice & device) {
+	if(device.state == RUNTIME_CONNECTING) {
+		// a new id drops the pending connect result
+		device.id = m_uNextId++;
+	}
+	if(device.session != NULL) {
+		device.session->close();
+		delete device.session;
+		device.session = NULL;
+	}
+	device.bAwaiting = false;
+	device.state = RUNTIME_RETRY;
+}
+
+void RscpRuntime::remove(size_t index) {
+	SRscpRuntimeDevice *device = m_devices[index];
+	stop(*device);
+	RscpProtocol protocol;
+	protocol.destroyFrameData(device->authFrame);
+	protocol.destroyFrameData(device->pollFrame);
+	if((device->sink != NULL) && (device->sink != stdout)) {
+		fclose(device->sink);
+	}
+	delete device;
+	m_devices.erase(m_devices.begin() + index);
+}
+
+void RscpRuntime::connect(SRscpRuntimeDevice & device) {
+	SConnectJob job;
+	memset(&job, 0, sizeof(job));
+	job.id = device.id;
+	strcpy(job.host, device.config.e3dc.server_ip);
+	job.port = device.config.e3dc.server_port;
+	job.timeoutMs = device.config.e3dc.connect_timeout;
+	job.iSocket = -1;
+	device.state = RUNTIME_CONNECTING;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+		// every pending connect has its own connector, a slow device does not delay the others
+		if(m_jobs.size() > m_uFreeConnectors) {
+			m_uFreeConnectors++;
+			m_connectors.push_back(std::thread(&RscpRuntime::connector, this));
+		}
+	}
+	m_condition.notify_all();
+}
+
+void RscpRuntime::fail(SRscpRuntimeDevice & device, const char *reason, int32_t iError) {
+	stop(device);
+	device.uFailures++;
+	uint64_t uDelay = RUNTIME_RETRY_MS;
+	for(uint32_t i = 1; (i < device.uFailures) && (uDelay < RUNTIME_MAX_RETRY_MS); i++) {
+		uDelay *= 2;
+	}
+	if(uDelay > RUNTIME_MAX_RETRY_MS) {
+		uDelay = RUNTIME_MAX_RETRY_MS;
+	}
+	device.uRetryAt = RscpStats::now() + uDelay * 1000000ULL;
+	printf("Device %s: %s failed (%i), retry in %llu ms\n", device.config.name, reason, iError,
+		(unsigned long long) uDelay);
+}
+
+void RscpRuntime::startSession(SRscpRuntimeDevice & device, int iSocket) {
+	device.session = new RscpSession();
+	device.session->user = &device;
+	device.session->attach(iSocket);
+	device.session->setPassword(device.config.e3dc.aes_password);
+	device.session->setAesMode((AES::TableMode) device.config.e3dc.aes_mode);
+	device.state = RUNTIME_AUTHENTICATING;
+	device.ucAuthLevel = 0;
+	int32_t iResult = send(device, device.authFrame, RscpStats::now());
+	if(iResult < 0) {
+		fail(device, "send", iResult);
+	}
+}
+
+int32_t RscpRuntime::send(SRscpRuntimeDevice & device, const SRscpFrameBuffer & frame, uint64_t uNow) {
+	int32_t iResult = device.session->queueFrame(frame);
+	if(iResult == RSCP::OK) {
+		iResult = device.session->flush();
+	}
+	if(iResult == RSCP::OK) {
+		iResult = device.session->queueReceive();
+	}
+	device.bAwaiting = (iResult == RSCP::OK);
+	device.uSent = uNow;
+	return iResult;
+}
+
+void RscpRuntime::schedule(SRscpRuntimeDevice & device, uint64_t uNow) {
+	switch(device.state) {
+	case RUNTIME_RETRY:
+		if(uNow >= device.uRetryAt) {
+			connect(device);
+		}
+		break;
+	case RUNTIME_AUTHENTICATING:
+	case RUNTIME_RUNNING:
+		if(device.bAwaiting) {
+			if(uNow - device.uSent > RECEIVE_TIMEOUT_MS * 1000000ULL) {
+				fail(device, "response", SOCKET_ERR_TIMEOUT);
+			}
+		}
+		else if((device.state == RUNTIME_RUNNING) && (uNow >= device.uNextPoll)) {
+			int32_t iResult = send(device, device.pollFrame, uNow);
+			if(iResult < 0) {
+				fail(device, "send", iResult);
+				break;
+			}
+			device.uPolls++;
+			// polls which were missed are skipped
+			uint64_t uInterval = device.config.pollInterval * 1000000ULL;
+			device.uNextPoll += uInterval;
+			if(device.uNextPoll <= uNow) {
+				device.uNextPoll = uNow + uInterval;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void RscpRuntime::connector() {
+	for(;;) {
+		SConnectJob job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_jobs.empty() && !m_bConnectorStop) {
+				m_condition.wait(lock);
+			}
+			if(m_bConnectorStop) {
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.erase(m_jobs.begin());
+			m_uFreeConnectors--;
+		}
+		job.iSocket = SocketConnect(job.host, job.port, job.timeoutMs, NULL);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_results.push_back(job);
+			m_uFreeConnectors++;
+		}
+		m_condition.notify_all();
+	}
+}
+
+int32_t RscpRuntime::handleFrame(RscpSession *session, const uint8_t *data, uint32_t length, void * /* context */) {
+	RscpProtocol protocol;
+	SRscpFrame frame;
+	int32_t iResult = protocol.parseFrame(data, length, &frame);
+	if(iResult < 0) {
+		// more data is needed for an incomplete frame
+		return (iResult == RSCP::ERR_INVALID_FRAME_LENGTH) ? 0 : iResult;
+	}
+	SRscpRuntimeDevice *device = (SRscpRuntimeDevice *) session->user;
+	uint64_t uNow = RscpStats::now();
+	device->bAwaiting = false;
+	if(device->state == RUNTIME_AUTHENTICATING) {
+		for(size_t i = 0; i < frame.data.size(); i++) {
+			if((frame.data[i].tag == TAG_RSCP_AUTHENTICATION) && (frame.data[i].dataType != RSCP::eTypeError)) {
+				device->ucAuthLevel = protocol.getValueAsUChar8(&frame.data[i]);
+			}
+		}
+		if(device->ucAuthLevel > 0) {
+			printf("Device %s authenticated with level %u\n", device->config.name, device->ucAuthLevel);
+			device->state = RUNTIME_RUNNING;
+			device->uFailures = 0;
+			device->uNextPoll = uNow;
+		}
+	}
+	else {
+		device->roundTrip.record(uNow - device->uSent);
+		device->uResponses++;
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		fprintf(device->sink, "# %s %ld.%03ld\n", device->config.name, (long) now.tv_sec, now.tv_nsec / 1000000L);
+		for(size_t i = 0; i < frame.data.size(); i++) {
+			RscpTagRequest::print(device->sink, protocol, frame.data[i]);
+		}
+		fflush(device->sink);
+	}
+	protocol.destroyFrameData(frame);
+	return iResult;
+}
+
+const char *RscpRuntime::stateName(int state) {
+	switch(state) {
+	case RUNTIME_RETRY:
+		return "retry";
+	case RUNTIME_CONNECTING:
+		return "connecting";
+	case RUNTIME_AUTHENTICATING:
+		return "auth";
+	case RUNTIME_RUNNING:
+		return "running";
+	default:
+		return "unknown";
+	}
+}
+
+void RscpRuntime::print(FILE *file) const {
+	fprintf(file, "%-24s %-10s %10s %10s %10s %10s\n", "# device", "state", "polls", "responses", "restarts",
+		"failures");
+	for(size_t i = 0; i < m_devices.size(); i++) {
+		const SRscpRuntimeDevice & device = *m_devices[i];
+		fprintf(file, "%-24s %-10s %10llu %10llu %10llu %10u\n", device.config.name, stateName(device.state),
+			(unsigned long long) device.uPolls, (unsigned long long) device.uResponses,
+			(unsigned long long) device.uRestarts, device.uFailures);
+	}
+	fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s %10s %10s\n", "# round trip [us]",
+		"count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+	for(size_t i = 0; i < m_devices.size(); i++) {
+		m_devices[i]->roundTrip.print(file, m_devices[i]->config.name);
+	}
+}
@@ -0,0 +1,128 @@
+/*
+ * RscpRuntime.h
+ *
+ * Polls all devices of the configuration concurrently. Every device has its own session on the shared
+ * batched transport, a request frame built once from its poll paths and a sink the responses are
+ * written to by name. Connections are opened by connector threads, one for every pending connect, so
+ * an unreachable device does not stall the others, failed devices are reconnected with a growing
+ * delay. On SIGHUP the configuration is read again: sessions of devices with changed address or
+ * credentials are restarted, devices with changed poll paths, interval or sink keep their session and
+ * all others are not touched.
+ */
+
+#ifndef RSCPRUNTIME_H_
+#define RSCPRUNTIME_H_
+
+#include <stdio.h>
+#include <signal.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "RscpConfig.h"
+#include "RscpTagPath.h"
+#include "RscpSession.h"
+#include "RscpStats.h"
+
+#define RUNTIME_MAX_COMPLETIONS		256
+// longest wait of the scheduler, reload and stop requests are checked at least this often
+#define RUNTIME_TICK_MS				100
+// reconnect delay after a failure, doubled up to the maximum while the device keeps failing
+#define RUNTIME_RETRY_MS			1000
+#define RUNTIME_MAX_RETRY_MS		60000
+
+enum eRscpRuntimeState {
+	RUNTIME_RETRY		= 0,	// waiting for the next connect
+	RUNTIME_CONNECTING,			// queued to a connector thread
+	RUNTIME_AUTHENTICATING,		// authentication frame sent
+	RUNTIME_RUNNING				// polling
+};
+
+struct SRscpRuntimeDevice {
+	SRscpDeviceConfig config;
+	uint32_t id;				// identifies the device between the main and the connector threads
+	int state;					// eRscpRuntimeState
+	RscpSession *session;
+	SRscpFrameBuffer authFrame;
+	SRscpFrameBuffer pollFrame;
+	FILE *sink;
+	bool bAwaiting;				// a request was sent and its response is outstanding
+	uint8_t ucAuthLevel;
+	uint32_t uFailures;			// failures since the last successful authentication
+	uint64_t uNextPoll;			// CLOCK_MONOTONIC in nanoseconds
+	uint64_t uRetryAt;
+	uint64_t uSent;
+	uint64_t uPolls;
+	uint64_t uResponses;
+	uint64_t uRestarts;
+	RscpHistogram roundTrip;
+};
+
+class RscpRuntime {
+public:
+	RscpRuntime();
+	virtual ~RscpRuntime();
+	/*
+	 * \brief Start the devices of \var config and poll them for \var seconds, 0 runs until requestStop().
+	 *        The transport has to be initialized for CONFIG_MAX_DEVICES sockets. \var path is read again
+	 *        after requestReload().
+	 */
+	void run(const char *path, const RscpConfig & config, int seconds);
+	/*
+	 * \brief Signal safe requests for the running loop, e.g. from SIGHUP and SIGTERM handlers.
+	 */
+	static void requestReload() {
+		s_bReload = 1;
+	}
+	static void requestStop() {
+		s_bStop = 1;
+	}
+	/*
+	 * \brief Print the poll counters and round trip percentiles of all devices.
+	 */
+	void print(FILE *file) const;
+	static const char *stateName(int state);
+private:
+	RscpRuntime(const RscpRuntime &);
+	RscpRuntime & operator=(const RscpRuntime &);
+
+	struct SConnectJob {
+		uint32_t id;
+		char host[128];
+		int port;
+		int timeoutMs;
+		int iSocket;
+	};
+
+	void apply(const RscpConfig & config);
+	bool preparePoll(SRscpRuntimeDevice & device);
+	void add(const SRscpDeviceConfig & config);
+	void stop(SRscpRuntimeDevice & device);
+	void remove(size_t index);
+	void connect(SRscpRuntimeDevice & device);
+	void fail(SRscpRuntimeDevice & device, const char *reason, int32_t iError);
+	void startSession(SRscpRuntimeDevice & device, int iSocket);
+	void schedule(SRscpRuntimeDevice & device, uint64_t uNow);
+	int32_t send(SRscpRuntimeDevice & device, const SRscpFrameBuffer & frame, uint64_t uNow);
+	void connector();
+	static int32_t handleFrame(RscpSession *session, const uint8_t *data, uint32_t length, void *context);
+
+	std::vector<SRscpRuntimeDevice *> m_devices;
+	uint32_t m_uNextId;
+	// encoder of the authentication and poll frames of all devices, used by the runtime thread only
+	RscpBuilder m_builder;
+	// shared with the connector threads
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<SConnectJob> m_jobs;
+	std::vector<SConnectJob> m_results;
+	bool m_bConnectorStop;
+	uint32_t m_uFreeConnectors;			// connector threads which do not run a connect
+	// a connector is added when more connects are queued than connectors are free, they are kept until the end
+	std::vector<std::thread> m_connectors;
+
+	static volatile sig_atomic_t s_bReload;
+	static volatile sig_atomic_t s_bStop;
+};
+
+#endif /* RSCPRUNTIME_H_ */
@@ -0,0 +1,446 @@
+/*
+ * RscpSession.cpp
+ *
+ * Encrypted RSCP connection to one E3DC unit on top of the batched socket transport.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "RscpSession.h"
+#include "RscpProtocol.h"
+
+RscpSession::RscpSession() :
+	user(NULL),
+	m_iSocket(-1),
+	m_iLastResult(RSCP::OK),
+	m_bSendPending(false),
+	m_bReceivePending(false),
+	m_pSendBuffer(NULL),
+	m_uSendCapacity(0),
+	m_uSendLength(0),
+	m_uSendFlushed(0),
+	m_pCapture(NULL),
+	m_bCaptureEncrypted(false),
+	m_pStats(NULL),
+	m_uFlushTime(0),
+	m_bAwaitFirstByte(false),
+	m_bRingRegistered(false),
+	m_uDecrypted(0) {
+	memset(m_ucEncryptionIV, 0xff, AES_BLOCK_SIZE);
+	memset(m_ucDecryptionIV, 0xff, AES_BLOCK_SIZE);
+}
+
+RscpSession::~RscpSession() {
+	close();
+	if(m_bRingRegistered) {
+		SocketUnregisterBuffer(m_ring.base());
+	}
+	free(m_pSendBuffer);
+}
+
+void RscpSession::attach(int iSocket) {
+	close();
+	m_iSocket = iSocket;
+	m_iLastResult = RSCP::OK;
+	m_ring.reset();
+	// the transport may have been initialized again since the last connection
+	m_bRingRegistered = false;
+	m_uDecrypted = 0;
+}
+
+void RscpSession::close() {
+	if(m_iSocket >= 0) {
+		SocketCancel(m_iSocket);
+		SocketClose(m_iSocket);
+		m_iSocket = -1;
+	}
+	m_bSendPending = false;
+	m_bReceivePending = false;
+	m_uSendLength = 0;
+	m_uSendFlushed = 0;
+	m_ring.reset();
+	m_uDecrypted = 0;
+	m_uFlushTime = 0;
+	m_bAwaitFirstByte = false;
+}
+
+void RscpSession::setPassword(const char *password) {
+	// initialize AES encryptor and decryptor IV
+	memset(m_ucDecryptionIV, 0xff, AES_BLOCK_SIZE);
+	memset(m_ucEncryptionIV, 0xff, AES_BLOCK_SIZE);
+
+	// limit password length to AES_KEY_SIZE
+	int iPasswordLength = strlen(password);
+	if(iPasswordLength > AES_KEY_SIZE) {
+		iPasswordLength = AES_KEY_SIZE;
+	}
+
+	// copy up to 32 bytes of AES key password
+	uint8_t ucAesKey[AES_KEY_SIZE];
+	memset(ucAesKey, 0xff, AES_KEY_SIZE);
+	memcpy(ucAesKey, password, iPasswordLength);
+
+	// set encryptor and decryptor parameters
+	m_aesDecrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+	m_aesEncrypter.SetParameters(AES_KEY_SIZE * 8, AES_BLOCK_SIZE * 8);
+	m_aesDecrypter.StartDecryption(ucAesKey);
+	m_aesEncrypter.StartEncryption(ucAesKey);
+}
+
+uint8_t *RscpSession::reserveSend(uint32_t uLength) {
+	if(!m_bSendPending && (m_uSendFlushed > 0)) {
+		// the flushed frames are sent, move frames queued in the meantime to the front
+		memmove(m_pSendBuffer, m_pSendBuffer + m_uSendFlushed, m_uSendLength - m_uSendFlushed);
+		m_uSendLength -= m_uSendFlushed;
+		m_uSendFlushed = 0;
+	}
+	if(m_uSendLength + uLength > m_uSendCapacity) {
+		// the kernel may still read from the buffer of a pending send
+		if(m_bSendPending) {
+			return NULL;
+		}
+		uint32_t uCapacity = (m_uSendCapacity > 0) ? m_uSendCapacity : SESSION_SEND_BUFFER_SIZE;
+		while(uCapacity < m_uSendLength + uLength) {
+			uCapacity *= 2;
+		}
+		void *pBuffer = NULL;
+		if(posix_memalign(&pBuffer, SESSION_SEND_BUFFER_ALIGNMENT, uCapacity) != 0) {
+			return NULL;
+		}
+		if(m_uSendLength > 0) {
+			memcpy(pBuffer, m_pSendBuffer, m_uSendLength);
+		}
+		free(m_pSendBuffer);
+		m_pSendBuffer = (uint8_t *) pBuffer;
+		m_uSendCapacity = uCapacity;
+	}
+	return m_pSendBuffer + m_uSendLength;
+}
+
+void RscpSession::encryptBlocks(const uint8_t *src, uint8_t *dst, uint32_t uLength) {
+	// set continues encryption IV
+	m_aesEncrypter.SetIV(m_ucEncryptionIV, AES_BLOCK_SIZE);
+	// uLength is a multiple of AES_BLOCK_SIZE, src and dst may be the same buffer
+	m_aesEncrypter.Encrypt(src, dst, uLength / AES_BLOCK_SIZE);
+	// save new IV for next encryption block
+	memcpy(m_ucEncryptionIV, dst + uLength - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+}
+
+int32_t RscpSession::queueFrame(const SRscpFrameBuffer & frameBuffer) {
+	if(m_iSocket < 0) {
+		return SESSION_ERR_NOT_CONNECTED;
+	}
+	if((frameBuffer.data == NULL) || (frameBuffer.dataLength == 0)) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	uint32_t uPadded = ROUNDUP(frameBuffer.dataLength, AES_BLOCK_SIZE);
+	uint8_t *data = reserveSend(uPadded);
+	if(data == NULL) {
+		return SESSION_ERR_BUSY;
+	}
+	if(m_pCapture != NULL) {
+		m_pCapture->write(RSCP_CAPTURE_TX, 0, frameBuffer.data, frameBuffer.dataLength);
+	}
+	uint64_t uStart = m_pStats ? RscpStats::now() : 0;
+	// the full blocks are encrypted straight from the frame buffer into the send buffer
+	uint32_t uFull = ROUNDDOWN(frameBuffer.dataLength, AES_BLOCK_SIZE);
+	if(uFull > 0) {
+		encryptBlocks(frameBuffer.data, data, uFull);
+	}
+	// only the last partial block is copied and zero padded
+	if(uPadded > uFull) {
+		memcpy(data + uFull, frameBuffer.data + uFull, frameBuffer.dataLength - uFull);
+		memset(data + frameBuffer.dataLength, 0, uPadded - frameBuffer.dataLength);
+		encryptBlocks(data + uFull, data + uFull, AES_BLOCK_SIZE);
+	}
+	if(m_pStats != NULL) {
+		m_pStats->record(STATS_PHASE_ENCRYPT, RscpStats::now() - uStart);
+		m_pStats->count(STATS_FRAMES_SENT);
+	}
+	if((m_pCapture != NULL) && m_bCaptureEncrypted) {
+		m_pCapture->write(RSCP_CAPTURE_TX, RSCP_CAPTURE_ENCRYPTED, data, uPadded);
+	}
+	m_uSendLength += uPadded;
+	return RSCP::OK;
+}
+
+int32_t RscpSession::queueValue(const SRscpValue & rootValue) {
+	if(m_iSocket < 0) {
+		return SESSION_ERR_NOT_CONNECTED;
+	}
+	uint32_t uPadded = ROUNDUP(sizeof(SRscpFrameHeader) + rootValue.length + sizeof(uint32_t), AES_BLOCK_SIZE);
+	uint8_t *data = reserveSend(uPadded);
+	if(data == NULL) {
+		return SESSION_ERR_BUSY;
+	}
+	uint64_t uStart = m_pStats ? RscpStats::now() : 0;
+	RscpProtocol protocol;
+	int32_t iLength = protocol.createFrameInBuffer(data, uPadded, rootValue.data, rootValue.length, true);
+	if(iLength < 0) {
+		return iLength;
+	}
+	if(m_pStats != NULL) {
+		uint64_t uNow = RscpStats::now();
+		m_pStats->record(STATS_PHASE_BUILD, uNow - uStart);
+		uStart = uNow;
+	}
+	if(m_pCapture != NULL) {
+		m_pCapture->write(RSCP_CAPTURE_TX, 0, data, iLength);
+	}
+	// zero padding for data above the frame length
+	memset(data + iLength, 0, uPadded - iLength);
+	encryptBlocks(data, data, uPadded);
+	if(m_pStats != NULL) {
+		m_pStats->record(STATS_PHASE_ENCRYPT, RscpStats::now() - uStart);
+		m_pStats->count(STATS_FRAMES_SENT);
+	}
+	if((m_pCapture != NULL) && m_bCaptureEncrypted) {
+		m_pCapture->write(RSCP_CAPTURE_TX, RSCP_CAPTURE_ENCRYPTED, data, uPadded);
+	}
+	m_uSendLength += uPadded;
+	return RSCP::OK;
+}
+
+int32_t RscpSession::flush(bool bMore) {
+	if(m_iSocket < 0) {
+		return SESSION_ERR_NOT_CONNECTED;
+	}
+	if(m_bSendPending || (m_uSendLength == m_uSendFlushed)) {
+		return RSCP::OK;
+	}
+	struct iovec iov;
+	iov.iov_base = m_pSendBuffer + m_uSendFlushed;
+	iov.iov_len = m_uSendLength - m_uSendFlushed;
+	int iResult = SocketQueueSendv(m_iSocket, &iov, 1, bMore ? SOCKET_SEND_MORE : 0, this);
+	if(iResult < 0) {
+		errno = -iResult;
+		return SESSION_ERR_SOCKET;
+	}
+	m_uSendFlushed = m_uSendLength;
+	m_bSendPending = true;
+	if(m_pStats != NULL) {
+		m_uFlushTime = RscpStats::now();
+		m_bAwaitFirstByte = true;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpSession::queueReceive() {
+	if(m_iSocket < 0) {
+		return SESSION_ERR_NOT_CONNECTED;
+	}
+	if(m_bReceivePending) {
+		return RSCP::OK;
+	}
+	// the ring is allocated once and kept for later connections of the session
+	if((m_ring.size() == 0) && !m_ring.create(SESSION_RECEIVE_BUFFER_SIZE)) {
+		return RSCP::ERR_NO_MEMORY;
+	}
+	// receives into a registered ring use IORING_OP_READ_FIXED, without a slot they use a plain receive
+	if(!m_bRingRegistered) {
+		SocketRegisterBuffer(m_ring.base(), m_ring.mappedSize());
+		m_bRingRegistered = true;
+	}
+	if(m_ring.writable() == 0) {
+		m_ring.compact();
+		if(m_ring.writable() == 0) {
+			// something went wrong and the frame is bigger than possible by the RSCP protocol
+			return SESSION_ERR_BUFFER_OVERFLOW;
+		}
+	}
+	int iResult = SocketQueueRecv(m_iSocket, m_ring.writePtr(), m_ring.writable(), this);
+	if(iResult < 0) {
+		errno = -iResult;
+		return SESSION_ERR_SOCKET;
+	}
+	m_bReceivePending = true;
+	return RSCP::OK;
+}
+
+int32_t RscpSession::processReceived(RscpFrameHandler handler, void *context) {
+	int32_t iFrames = 0;
+	while(true) {
+		// decrypt all complete blocks which arrived since the last call in place
+		uint32_t uBlocks = ROUNDDOWN(m_ring.readable(), AES_BLOCK_SIZE) - m_uDecrypted;
+		if(uBlocks > 0) {
+			uint64_t uStart = m_pStats ? RscpStats::now() : 0;
+			uint8_t *data = m_ring.readPtr() + m_uDecrypted;
+			uint8_t ucNextIV[AES_BLOCK_SIZE];
+			// the last encrypted block is the IV of the following data
+			memcpy(ucNextIV, data + uBlocks - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+			m_aesDecrypter.SetIV(m_ucDecryptionIV, AES_BLOCK_SIZE);
+			m_aesDecrypter.Decrypt(data, data, uBlocks / AES_BLOCK_SIZE);
+			memcpy(m_ucDecryptionIV, ucNextIV, AES_BLOCK_SIZE);
+			m_uDecrypted += uBlocks;
+			if(m_pStats != NULL) {
+				m_pStats->record(STATS_PHASE_DECRYPT, RscpStats::now() - uStart);
+			}
+		}
+		// if not even 32 bytes were received then the frame is still incomplete
+		if(m_uDecrypted == 0) {
+			break;
+		}
+
+		// data was received, check if we received all data
+		uint64_t uHandled = m_pStats ? RscpStats::now() : 0;
+		int32_t iProcessedBytes = handler(this, m_ring.readPtr(), m_uDecrypted, context);
+		if(iProcessedBytes < 0) {
+			if(m_pStats != NULL) {
+				m_pStats->count((iProcessedBytes == RSCP::ERR_INVALID_CRC) ? STATS_CRC_ERRORS : STATS_FRAME_ERRORS);
+			}
+			// the data received is not RSCP data, keep it in the capture to reproduce the problem
+			if(m_pCapture != NULL) {
+				m_pCapture->write(RSCP_CAPTURE_RX, RSCP_CAPTURE_INVALID, m_ring.readPtr(), m_uDecrypted);
+			}
+			return iProcessedBytes;
+		}
+		else if(iProcessedBytes == 0) {
+			// not enough data of the next frame received
+			break;
+		}
+		if(m_pCapture != NULL) {
+			m_pCapture->write(RSCP_CAPTURE_RX, 0, m_ring.readPtr(), iProcessedBytes);
+		}
+		if(m_pStats != NULL) {
+			// frames which arrive without a preceding flush are only counted
+			if(m_uFlushTime != 0) {
+				m_pStats->record(STATS_PHASE_LAST_BYTE, uHandled - m_uFlushTime);
+				m_pStats->record(STATS_PHASE_ROUND_TRIP, RscpStats::now() - m_uFlushTime);
+			}
+			m_pStats->count(STATS_FRAMES_RECEIVED);
+		}
+		// round up the processed bytes as iProcessedBytes does not include the zero padding bytes
+		iProcessedBytes = ROUNDUP(iProcessedBytes, AES_BLOCK_SIZE);
+		// the next frame starts behind the padding, no data is moved
+		m_ring.consume(iProcessedBytes);
+		m_uDecrypted -= iProcessedBytes;
+		iFrames++;
+	}
+	return iFrames;
+}
+
+int32_t RscpSession::onCompletion(const SSocketCompletion & completion, RscpFrameHandler handler, void *context) {
+	if(completion.iOperation == SOCKET_OP_SEND) {
+		m_bSendPending = false;
+		if(m_uSendFlushed == m_uSendLength) {
+			// nothing was queued while the send was pending
+			m_uSendLength = 0;
+			m_uSendFlushed = 0;
+		}
+		if(completion.iResult < 0) {
+			if(m_pStats != NULL) {
+				m_pStats->count(STATS_SOCKET_ERRORS);
+			}
+			errno = -completion.iResult;
+			m_iLastResult = SESSION_ERR_SOCKET;
+			return m_iLastResult;
+		}
+		if(m_pStats != NULL) {
+			m_pStats->record(STATS_PHASE_SEND, RscpStats::now() - m_uFlushTime);
+			m_pStats->count(STATS_BYTES_SENT, completion.iResult);
+		}
+		m_iLastResult = 0;
+		return m_iLastResult;
+	}
+
+	m_bReceivePending = false;
+	if(completion.iResult == 0) {
+		// connection was closed regularly by peer
+		m_iLastResult = SESSION_ERR_CLOSED;
+		return m_iLastResult;
+	}
+	else if(completion.iResult < 0) {
+		if(m_pStats != NULL) {
+			m_pStats->count(STATS_SOCKET_ERRORS);
+		}
+		errno = -completion.iResult;
+		m_iLastResult = SESSION_ERR_SOCKET;
+		return m_iLastResult;
+	}
+	if(m_pStats != NULL) {
+		if(m_bAwaitFirstByte) {
+			m_pStats->record(STATS_PHASE_FIRST_BYTE, RscpStats::now() - m_uFlushTime);
+			m_bAwaitFirstByte = false;
+		}
+		m_pStats->count(STATS_BYTES_RECEIVED, completion.iResult);
+	}
+	if((m_pCapture != NULL) && m_bCaptureEncrypted) {
+		m_pCapture->write(RSCP_CAPTURE_RX, RSCP_CAPTURE_ENCRYPTED, m_ring.writePtr(), completion.iResult);
+	}
+	// increment amount of received bytes
+	m_ring.produce(completion.iResult);
+	// process all received frames
+	m_iLastResult = processReceived(handler, context);
+	if(m_iLastResult >= 0) {
+		int32_t iResult = queueReceive();
+		if(iResult < 0) {
+			m_iLastResult = iResult;
+		}
+	}
+	return m_iLastResult;
+}
+
+void RscpSession::dispatch(const SSocketCompletion *completions, int count, RscpFrameHandler handler, void *context) {
+	for(int i = 0; i < count; i++) {
+		RscpSession *session = reinterpret_cast<RscpSession *>(completions[i].pUser);
+		if(session != NULL) {
+			session->onCompletion(completions[i], handler, context);
+		}
+	}
+}
+
+int32_t RscpSession::receive(RscpFrameHandler handler, void *context, int iTimeoutMs) {
+	int32_t iResult = flush();
+	if(iResult < 0) {
+		return iResult;
+	}
+	iResult = queueReceive();
+	if(iResult < 0) {
+		return iResult;
+	}
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int32_t iFrames = 0;
+	while(iFrames == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		long lElapsedMs = (now.tv_sec - start.tv_sec) * 1000L + (now.tv_nsec - start.tv_nsec) / 1000000L;
+		if(lElapsedMs >= iTimeoutMs) {
+			break;
+		}
+		SSocketCompletion completions[16];
+		int iCount = SocketSubmit(completions, 16, iTimeoutMs - lElapsedMs);
+		if(iCount == -EINTR) {
+			continue;
+		}
+		else if(iCount < 0) {
+			errno = -iCount;
+			return SESSION_ERR_SOCKET;
+		}
+		// completions of other sessions are dispatched as well, their results are kept in lastResult()
+		int32_t iError = RSCP::OK;
+		for(int i = 0; i < iCount; i++) {
+			RscpSession *session = reinterpret_cast<RscpSession *>(completions[i].pUser);
+			if(session == NULL) {
+				continue;
+			}
+			iResult = session->onCompletion(completions[i], handler, context);
+			if(session == this) {
+				if(iResult < 0) {
+					iError = iResult;
+				}
+				else {
+					iFrames += iResult;
+				}
+			}
+		}
+		if(iError < 0) {
+			return iError;
+		}
+	}
+	if((iFrames == 0) && (m_pStats != NULL)) {
+		m_pStats->count(STATS_TIMEOUTS);
+	}
+	return iFrames;
+}
@@ -0,0 +1,188 @@
+/*
+ * RscpSession.h
+ *
+ * Encrypted RSCP connection to one E3DC unit on top of the batched socket transport.
+ */
+
+#ifndef RSCPSESSION_H_
+#define RSCPSESSION_H_
+
+#include "RscpTypes.h"
+#include "SocketConnection.h"
+#include "e3dc_config.h"
+#include "AES.h"
+#include "RscpRingBuffer.h"
+#include "RscpCapture.h"
+#include "RscpStats.h"
+
+// alignment of the send buffer, frames are encrypted in place at AES_BLOCK_SIZE boundaries
+#define SESSION_SEND_BUFFER_ALIGNMENT	AES_BLOCK_SIZE
+// initial send buffer size, the buffer grows when a frame does not fit
+#define SESSION_SEND_BUFFER_SIZE		4096
+// receive ring size, holds the largest possible encrypted frame
+#define SESSION_RECEIVE_BUFFER_SIZE		ROUNDUP(RSCP_MAX_FRAME_LENGTH, AES_BLOCK_SIZE)
+
+enum eRscpSessionReturnCodes {
+	SESSION_ERR_NOT_CONNECTED	= -100,
+	SESSION_ERR_CLOSED			= -101,
+	SESSION_ERR_SOCKET			= -102,
+	SESSION_ERR_BUSY			= -103,
+	SESSION_ERR_BUFFER_OVERFLOW	= -104
+};
+
+class RscpSession;
+
+/*
+ * \brief Callback for each decrypted frame.
+ * @param session - Session which received the frame
+ * @param data    - Decrypted receive data starting with the frame header
+ * @param length  - Length of \var data in bytes, the frame can be followed by further data
+ * @param context - User context given to RscpSession::onCompletion()
+ * @return        - Processed amount of bytes, 0 if the frame is not complete yet or an RSCP error code
+ */
+typedef int32_t (*RscpFrameHandler)(RscpSession *session, const uint8_t *data, uint32_t length, void *context);
+
+class RscpSession {
+public:
+	/*
+	 * Constructor
+	 */
+	RscpSession();
+	/*
+	 * Destructor
+	 */
+	virtual ~RscpSession();
+	/*
+	 * \brief Attach an already connected socket to the session. The send and receive state is reset.
+	 */
+	void attach(int iSocket);
+	/*
+	 * \brief Cancel all pending transport operations and close the socket.
+	 */
+	void close();
+	/*
+	 * \brief Derive the AES key from \var password and reset the encryption and decryption IVs.
+	 */
+	void setPassword(const char *password);
+	/*
+	 * \brief Select the AES implementation of both directions, see AES::SetTableMode().
+	 */
+	void setAesMode(AES::TableMode mode) {
+		m_aesEncrypter.SetTableMode(mode);
+		m_aesDecrypter.SetTableMode(mode);
+	}
+	/*
+	 * \brief Record the decrypted frames of both directions into \var capture, NULL stops the capture.
+	 *        With \var bEncrypted the encrypted stream data is recorded as well.
+	 *        The capture is not owned by the session and can be shared by several sessions.
+	 */
+	void setCapture(RscpCapture *capture, bool bEncrypted) {
+		m_pCapture = capture;
+		m_bCaptureEncrypted = bEncrypted;
+	}
+	/*
+	 * \brief Record the phase latencies and counters of the session into \var stats, NULL stops the recording.
+	 *        The statistics are not owned by the session.
+	 */
+	void setStats(RscpStats *stats) {
+		m_pStats = stats;
+	}
+	RscpStats *stats() const {
+		return m_pStats;
+	}
+	/*
+	 * \brief CLOCK_MONOTONIC time of the last flush in nanoseconds while statistics are recorded, else 0.
+	 *        Frame handlers use it to measure the round trip of the response values.
+	 */
+	uint64_t flushTime() const {
+		return m_uFlushTime;
+	}
+	/*
+	 * \brief Encrypt the frame in \var frameBuffer into the session send buffer. Frames are collected
+	 *        until flush() hands all of them to the transport at once.
+	 * @return - RSCP::OK or an eRscpSessionReturnCodes value
+	 */
+	int32_t queueFrame(const SRscpFrameBuffer & frameBuffer);
+	/*
+	 * \brief Build the frame for the root container \var rootValue directly in the session send buffer
+	 *        and encrypt it in place. Same as queueFrame() without the intermediate frame buffer.
+	 * @return - RSCP::OK, an RSCP error code or an eRscpSessionReturnCodes value
+	 */
+	int32_t queueValue(const SRscpValue & rootValue);
+	/*
+	 * \brief Queue all frames collected since the last flush as one send on the transport unless a send is
+	 *        still pending, in that case they are flushed with the next call after its completion.
+	 * @param bMore - More frames follow shortly, the kernel may delay a partial segment (MSG_MORE)
+	 * @return      - RSCP::OK or an eRscpSessionReturnCodes value
+	 */
+	int32_t flush(bool bMore = false);
+	/*
+	 * \brief Queue a receive into the session receive buffer unless one is already pending.
+	 * @return - RSCP::OK or an eRscpSessionReturnCodes value
+	 */
+	int32_t queueReceive();
+	/*
+	 * \brief Process a transport completion of this session. Received data is decrypted and each complete
+	 *        frame is passed to \var handler, afterwards the next receive is queued.
+	 * @return - Number of frames handled, an RSCP error code or an eRscpSessionReturnCodes value
+	 */
+	int32_t onCompletion(const SSocketCompletion & completion, RscpFrameHandler handler, void *context);
+	/*
+	 * \brief Flush the queued frames, submit all queued operations and dispatch the completions to their
+	 *        sessions until this session handled at least one frame or \var iTimeoutMs expired.
+	 * @return - Number of frames handled by this session, 0 on timeout or a negative error code
+	 */
+	int32_t receive(RscpFrameHandler handler, void *context, int iTimeoutMs);
+	/*
+	 * \brief Dispatch \var count completions to the sessions stored in their user pointer.
+	 */
+	static void dispatch(const SSocketCompletion *completions, int count, RscpFrameHandler handler, void *context);
+
+	int getSocket() const {
+		return m_iSocket;
+	}
+	bool isConnected() const {
+		return m_iSocket >= 0;
+	}
+	/*
+	 * Result of the last onCompletion() call of the session, used by dispatch() users.
+	 */
+	int32_t lastResult() const {
+		return m_iLastResult;
+	}
+	/*
+	 * User pointer for the owner of the session.
+	 */
+	void *user;
+private:
+	int32_t processReceived(RscpFrameHandler handler, void *context);
+	uint8_t *reserveSend(uint32_t uLength);
+	void encryptBlocks(const uint8_t *src, uint8_t *dst, uint32_t uLength);
+
+	int m_iSocket;
+	int32_t m_iLastResult;
+	AES m_aesEncrypter;
+	AES m_aesDecrypter;
+	uint8_t m_ucEncryptionIV[AES_BLOCK_SIZE];
+	uint8_t m_ucDecryptionIV[AES_BLOCK_SIZE];
+	bool m_bSendPending;
+	bool m_bReceivePending;
+	uint8_t *m_pSendBuffer;
+	uint32_t m_uSendCapacity;
+	// bytes in the send buffer, [0, m_uSendFlushed) belongs to the pending send
+	uint32_t m_uSendLength;
+	uint32_t m_uSendFlushed;
+	RscpCapture *m_pCapture;
+	bool m_bCaptureEncrypted;
+	RscpStats *m_pStats;
+	uint64_t m_uFlushTime;
+	// set by flush(), cleared by the first received bytes afterwards
+	bool m_bAwaitFirstByte;
+	RscpRingBuffer m_ring;
+	// m_ring was offered to the fixed buffer table of the transport since attach()
+	bool m_bRingRegistered;
+	// decrypted bytes at the read position of m_ring, the data behind is still encrypted
+	uint32_t m_uDecrypted;
+};
+
+#endif /* RSCPSESSION_H_ */
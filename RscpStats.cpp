@@ -0,0 +1,245 @@
+/*
+ * RscpStats.cpp
+ *
+ * Latency histograms and counters of RSCP sessions.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <stdio.h>
+#include "RscpStats.h"
+
+RscpHistogram::RscpHistogram() {
+	reset();
+}
+
+void RscpHistogram::reset() {
+	m_uCount = 0;
+	m_uSum = 0;
+	m_uMin = UINT64_MAX;
+	m_uMax = 0;
+	memset(m_uBuckets, 0, sizeof(m_uBuckets));
+}
+
+uint32_t RscpHistogram::bucketIndex(uint64_t value) {
+	if(value < STATS_HISTOGRAM_SUB_BUCKETS) {
+		return value;
+	}
+	uint32_t uExponent = 63 - __builtin_clzll(value);
+	if(uExponent > STATS_HISTOGRAM_MAX_BITS) {
+		return STATS_HISTOGRAM_BUCKETS - 1;
+	}
+	// the mantissa keeps the upper STATS_HISTOGRAM_SUB_BITS bits, its top bit is always set
+	uint32_t uShift = uExponent - (STATS_HISTOGRAM_SUB_BITS - 1);
+	uint32_t uMantissa = value >> uShift;
+	return STATS_HISTOGRAM_SUB_BUCKETS + (uShift - 1) * (STATS_HISTOGRAM_SUB_BUCKETS / 2)
+		+ (uMantissa - STATS_HISTOGRAM_SUB_BUCKETS / 2);
+}
+
+uint64_t RscpHistogram::bucketHighest(uint32_t index) {
+	if(index < STATS_HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+	uint32_t uShift = (index - STATS_HISTOGRAM_SUB_BUCKETS) / (STATS_HISTOGRAM_SUB_BUCKETS / 2) + 1;
+	uint64_t uMantissa = (index - STATS_HISTOGRAM_SUB_BUCKETS) % (STATS_HISTOGRAM_SUB_BUCKETS / 2)
+		+ STATS_HISTOGRAM_SUB_BUCKETS / 2;
+	return ((uMantissa + 1) << uShift) - 1;
+}
+
+void RscpHistogram::record(uint64_t value) {
+	m_uBuckets[bucketIndex(value)]++;
+	m_uCount++;
+	m_uSum += value;
+	if(value < m_uMin) {
+		m_uMin = value;
+	}
+	if(value > m_uMax) {
+		m_uMax = value;
+	}
+}
+
+void RscpHistogram::merge(const RscpHistogram & other) {
+	if(other.m_uCount == 0) {
+		return;
+	}
+	for(uint32_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+		m_uBuckets[i] += other.m_uBuckets[i];
+	}
+	m_uCount += other.m_uCount;
+	m_uSum += other.m_uSum;
+	if(other.m_uMin < m_uMin) {
+		m_uMin = other.m_uMin;
+	}
+	if(other.m_uMax > m_uMax) {
+		m_uMax = other.m_uMax;
+	}
+}
+
+uint64_t RscpHistogram::percentile(double percentile) const {
+	if(m_uCount == 0) {
+		return 0;
+	}
+	uint64_t uRank = (uint64_t) (percentile / 100.0 * m_uCount + 0.5);
+	if(uRank < 1) {
+		uRank = 1;
+	}
+	uint64_t uSeen = 0;
+	for(uint32_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+		uSeen += m_uBuckets[i];
+		if(uSeen >= uRank) {
+			uint64_t uValue = bucketHighest(i);
+			return (uValue < m_uMax) ? uValue : m_uMax;
+		}
+	}
+	return m_uMax;
+}
+
+RscpStats::RscpStats() :
+	m_pName(NULL) {
+	memset(m_pTagGroups, 0, sizeof(m_pTagGroups));
+	reset();
+}
+
+RscpStats::~RscpStats() {
+	for(int i = 0; i < STATS_TAG_GROUPS; i++) {
+		delete m_pTagGroups[i];
+	}
+}
+
+uint64_t RscpStats::now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void RscpStats::reset() {
+	m_uStarted = now();
+	memset(m_uCounters, 0, sizeof(m_uCounters));
+	for(int i = 0; i < STATS_PHASE_COUNT; i++) {
+		m_phases[i].reset();
+	}
+	for(int i = 0; i < STATS_TAG_GROUPS; i++) {
+		if(m_pTagGroups[i] != NULL) {
+			m_pTagGroups[i]->reset();
+		}
+	}
+}
+
+void RscpStats::recordTag(SRscpTag tag, uint64_t ns) {
+	uint8_t group = tag >> 24;
+	if(m_pTagGroups[group] == NULL) {
+		m_pTagGroups[group] = new RscpHistogram();
+	}
+	m_pTagGroups[group]->record(ns);
+}
+
+void RscpStats::merge(const RscpStats & other) {
+	if(other.m_uStarted < m_uStarted) {
+		m_uStarted = other.m_uStarted;
+	}
+	for(int i = 0; i < STATS_COUNTER_COUNT; i++) {
+		m_uCounters[i] += other.m_uCounters[i];
+	}
+	for(int i = 0; i < STATS_PHASE_COUNT; i++) {
+		m_phases[i].merge(other.m_phases[i]);
+	}
+	for(int i = 0; i < STATS_TAG_GROUPS; i++) {
+		if(other.m_pTagGroups[i] == NULL) {
+			continue;
+		}
+		if(m_pTagGroups[i] == NULL) {
+			m_pTagGroups[i] = new RscpHistogram();
+		}
+		m_pTagGroups[i]->merge(*other.m_pTagGroups[i]);
+	}
+}
+
+const char *RscpStats::phaseName(eRscpStatsPhase phase) {
+	static const char *names[STATS_PHASE_COUNT] = {
+		"build", "encrypt", "send", "first_byte", "last_byte", "decrypt", "parse", "dispatch", "round_trip"
+	};
+	return (phase < STATS_PHASE_COUNT) ? names[phase] : "unknown";
+}
+
+const char *RscpStats::counterName(eRscpStatsCounter counter) {
+	static const char *names[STATS_COUNTER_COUNT] = {
+		"bytes_sent", "bytes_received", "frames_sent", "frames_received",
+		"timeouts", "crc_errors", "frame_errors", "socket_errors"
+	};
+	return (counter < STATS_COUNTER_COUNT) ? names[counter] : "unknown";
+}
+
+const char *RscpStats::tagGroupName(uint8_t group) {
+	switch(group) {
+	case 0x00: return "RSCP";
+	case 0x01: return "EMS";
+	case 0x02: return "PVI";
+	case 0x03: return "BAT";
+	case 0x04: return "DCDC";
+	case 0x05: return "PM";
+	case 0x06: return "DB";
+	case 0x08: return "SRV";
+	case 0x09: return "HA";
+	case 0x0A: return "INFO";
+	case 0x0B: return "EP";
+	case 0x0C: return "SYS";
+	case 0x0D: return "UM";
+	case 0x0E: return "WB";
+	default: return NULL;
+	}
+}
+
+void RscpHistogram::print(FILE *file, const char *name) const {
+	if(m_uCount == 0) {
+		return;
+	}
+	fprintf(file, "%-16s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+		(unsigned long long) count(), min() / 1e3, percentile(50.0) / 1e3,
+		percentile(90.0) / 1e3, percentile(99.0) / 1e3, percentile(99.9) / 1e3,
+		max() / 1e3, mean() / 1e3);
+}
+
+void RscpStats::dump(FILE *file) const {
+	fprintf(file, "# RSCP statistics%s%s, %.1f s\n", m_pName ? " of " : "", m_pName ? m_pName : "",
+		(now() - m_uStarted) / 1e9);
+	for(int i = 0; i < STATS_COUNTER_COUNT; i++) {
+		fprintf(file, "%-16s %llu\n", counterName((eRscpStatsCounter) i), (unsigned long long) m_uCounters[i]);
+	}
+	fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s %10s %10s\n", "# latency [us]",
+		"count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+	for(int i = 0; i < STATS_PHASE_COUNT; i++) {
+		m_phases[i].print(file, phaseName((eRscpStatsPhase) i));
+	}
+	for(int i = 0; i < STATS_TAG_GROUPS; i++) {
+		if(m_pTagGroups[i] == NULL) {
+			continue;
+		}
+		char name[32];
+		const char *group = tagGroupName(i);
+		if(group != NULL) {
+			snprintf(name, sizeof(name), "tag_%s", group);
+		}
+		else {
+			snprintf(name, sizeof(name), "tag_0x%02X", i);
+		}
+		m_pTagGroups[i]->print(file, name);
+	}
+	fflush(file);
+}
+
+bool RscpStats::dumpToFile(const char *path) const {
+	char tmp[4096];
+	if(snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int) sizeof(tmp)) {
+		return false;
+	}
+	FILE *file = fopen(tmp, "w");
+	if(file == NULL) {
+		return false;
+	}
+	dump(file);
+	if((fclose(file) != 0) || (rename(tmp, path) != 0)) {
+		remove(tmp);
+		return false;
+	}
+	return true;
+}
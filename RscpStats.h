@@ -0,0 +1,159 @@
+/*
+ * RscpStats.h
+ *
+ * Latency histograms and counters of RSCP sessions. All times are taken from CLOCK_MONOTONIC in
+ * nanoseconds. Recording never allocates except for the first response of a new tag group.
+ */
+
+#ifndef RSCPSTATS_H_
+#define RSCPSTATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "RscpTypes.h"
+
+// linear sub buckets per power of two, the recorded values keep a relative precision of 1 / 32
+#define STATS_HISTOGRAM_SUB_BITS		6
+#define STATS_HISTOGRAM_SUB_BUCKETS		(1 << STATS_HISTOGRAM_SUB_BITS)
+// highest power of two which is resolved, larger values are counted in the last bucket (about 18 minutes)
+#define STATS_HISTOGRAM_MAX_BITS		40
+#define STATS_HISTOGRAM_BUCKETS			(STATS_HISTOGRAM_SUB_BUCKETS + \
+		(STATS_HISTOGRAM_MAX_BITS - STATS_HISTOGRAM_SUB_BITS + 1) * (STATS_HISTOGRAM_SUB_BUCKETS / 2))
+// tag groups are the name spaces in the upper byte of the tag
+#define STATS_TAG_GROUPS				256
+
+enum eRscpStatsPhase {
+	STATS_PHASE_BUILD		= 0,	// creation of the request frame
+	STATS_PHASE_ENCRYPT,			// encryption into the send buffer
+	STATS_PHASE_SEND,				// flush until the send completed
+	STATS_PHASE_FIRST_BYTE,			// flush until the first response bytes arrived
+	STATS_PHASE_LAST_BYTE,			// flush until a response frame was complete
+	STATS_PHASE_DECRYPT,			// decryption of received blocks
+	STATS_PHASE_PARSE,				// parsing of a response frame
+	STATS_PHASE_DISPATCH,			// handling of the parsed response values
+	STATS_PHASE_ROUND_TRIP,			// flush until the response frame was handled
+	STATS_PHASE_COUNT
+};
+
+enum eRscpStatsCounter {
+	STATS_BYTES_SENT		= 0,
+	STATS_BYTES_RECEIVED,
+	STATS_FRAMES_SENT,
+	STATS_FRAMES_RECEIVED,
+	STATS_TIMEOUTS,
+	STATS_CRC_ERRORS,
+	STATS_FRAME_ERRORS,				// invalid frames other than CRC errors
+	STATS_SOCKET_ERRORS,
+	STATS_COUNTER_COUNT
+};
+
+/*
+ * \brief Log-linear histogram in the style of HdrHistogram with a fixed value range and precision.
+ */
+class RscpHistogram {
+public:
+	RscpHistogram();
+	void record(uint64_t value);
+	/*
+	 * \brief Add all values of \var other.
+	 */
+	void merge(const RscpHistogram & other);
+	void reset();
+	uint64_t count() const {
+		return m_uCount;
+	}
+	uint64_t min() const {
+		return m_uCount ? m_uMin : 0;
+	}
+	uint64_t max() const {
+		return m_uMax;
+	}
+	double mean() const {
+		return m_uCount ? (double) m_uSum / m_uCount : 0.0;
+	}
+	/*
+	 * \brief Value below or equal to which \var percentile percent of the recorded values are,
+	 *        reported as the highest value of the bucket and limited by max().
+	 */
+	uint64_t percentile(double percentile) const;
+	/*
+	 * \brief Print count, min, p50, p90, p99, p99.9, max and mean in microseconds as one line
+	 *        below the header of RscpStats::dump(), nothing if the histogram is empty.
+	 */
+	void print(FILE *file, const char *name) const;
+	static uint32_t bucketIndex(uint64_t value);
+	static uint64_t bucketHighest(uint32_t index);
+private:
+	uint64_t m_uCount;
+	uint64_t m_uSum;
+	uint64_t m_uMin;
+	uint64_t m_uMax;
+	uint32_t m_uBuckets[STATS_HISTOGRAM_BUCKETS];
+};
+
+class RscpStats {
+public:
+	/*
+	 * Constructor
+	 */
+	RscpStats();
+	/*
+	 * Destructor
+	 */
+	virtual ~RscpStats();
+	/*
+	 * \brief Current CLOCK_MONOTONIC time in nanoseconds.
+	 */
+	static uint64_t now();
+	/*
+	 * \brief Name printed by dump(), e.g. the address of the unit. The string is not copied.
+	 */
+	void setName(const char *name) {
+		m_pName = name;
+	}
+	void record(eRscpStatsPhase phase, uint64_t ns) {
+		m_phases[phase].record(ns);
+	}
+	/*
+	 * \brief Record the round trip of a response value in the histogram of its tag group.
+	 */
+	void recordTag(SRscpTag tag, uint64_t ns);
+	void count(eRscpStatsCounter counter, uint64_t value = 1) {
+		m_uCounters[counter] += value;
+	}
+	uint64_t counter(eRscpStatsCounter counter) const {
+		return m_uCounters[counter];
+	}
+	const RscpHistogram & phase(eRscpStatsPhase phase) const {
+		return m_phases[phase];
+	}
+	/*
+	 * \brief Add all histograms and counters of \var other, e.g. to aggregate several sessions.
+	 */
+	void merge(const RscpStats & other);
+	void reset();
+	/*
+	 * \brief Print the counters and the latency percentiles in microseconds.
+	 */
+	void dump(FILE *file) const;
+	/*
+	 * \brief Replace \var path with a new dump, readers never see a partially written file.
+	 * @return - true on success
+	 */
+	bool dumpToFile(const char *path) const;
+	static const char *phaseName(eRscpStatsPhase phase);
+	static const char *counterName(eRscpStatsCounter counter);
+	static const char *tagGroupName(uint8_t group);
+private:
+	RscpStats(const RscpStats &);
+	RscpStats & operator=(const RscpStats &);
+
+	const char *m_pName;
+	uint64_t m_uStarted;
+	uint64_t m_uCounters[STATS_COUNTER_COUNT];
+	RscpHistogram m_phases[STATS_PHASE_COUNT];
+	// allocated with the first response of the group
+	RscpHistogram *m_pTagGroups[STATS_TAG_GROUPS];
+};
+
+#endif /* RSCPSTATS_H_ */
@@ -0,0 +1,9 @@
+# RscpTagNames.awk
+#
+# Generates the name to tag table of RscpTagPath.cpp from the defines in RscpTags.h:
+#   awk -f RscpTagNames.awk RscpTags.h | LC_ALL=C sort > RscpTagNames.inc
+# The lines are sorted by name for the binary search.
+
+$1 == "#define" && $2 ~ /^TAG_/ && $3 ~ /^0x[0-9A-Fa-f]+$/ {
+    printf("{ \"%s\", %s },\n", $2, $3)
+}
@@ -0,0 +1,264 @@
+/*
+ * RscpTagPath.cpp
+ *
+ * Requests built from tag paths and tag names resolved through the generated name table.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <algorithm>
+#include "RscpTagPath.h"
+
+typedef struct {
+	const char *name;
+	SRscpTag tag;
+} SRscpTagName;
+
+// generated from RscpTags.h by RscpTagNames.awk and sorted by name
+static const SRscpTagName tagNames[] = {
+#include "RscpTagNames.inc"
+};
+
+#define TAG_NAME_COUNT	(sizeof(tagNames) / sizeof(tagNames[0]))
+
+static bool compareName(const SRscpTagName & entry, const char *name) {
+	return strcmp(entry.name, name) < 0;
+}
+
+static bool compareTag(const SRscpTagName *a, const SRscpTagName *b) {
+	return a->tag < b->tag;
+}
+
+const char *RscpTagRequest::tagName(SRscpTag tag) {
+	// the table sorted by tag is created with the first lookup
+	static std::vector<const SRscpTagName *> byTag;
+	if(byTag.empty()) {
+		for(size_t i = 0; i < TAG_NAME_COUNT; i++) {
+			byTag.push_back(&tagNames[i]);
+		}
+		std::sort(byTag.begin(), byTag.end(), compareTag);
+	}
+	SRscpTagName key = { NULL, tag };
+	std::vector<const SRscpTagName *>::const_iterator it =
+		std::lower_bound(byTag.begin(), byTag.end(), &key, compareTag);
+	return ((it != byTag.end()) && ((*it)->tag == tag)) ? (*it)->name : NULL;
+}
+
+bool RscpTagRequest::tagByName(const char *name, SRscpTag *tag) {
+	if((name[0] == '0') && ((name[1] == 'x') || (name[1] == 'X'))) {
+		char *end;
+		unsigned long value = strtoul(name, &end, 16);
+		if((*end != '\0') || (end == name + 2) || (value > UINT32_MAX)) {
+			return false;
+		}
+		*tag = value;
+		return true;
+	}
+	const SRscpTagName *end = tagNames + TAG_NAME_COUNT;
+	const SRscpTagName *entry = std::lower_bound(tagNames, end, name, compareName);
+	if((entry == end) || (strcmp(entry->name, name) != 0)) {
+		return false;
+	}
+	*tag = entry->tag;
+	return true;
+}
+
+bool RscpTagRequest::indexTag(SRscpTag tag, SRscpTag *index) {
+	const char *name = RscpTagRequest::tagName(tag);
+	if(name == NULL) {
+		return false;
+	}
+	// TAG_<name space>_...
+	const char *separator = strchr(name + 4, '_');
+	if(separator == NULL) {
+		return false;
+	}
+	char indexName[128];
+	snprintf(indexName, sizeof(indexName), "%.*sINDEX", (int) (separator - name + 1), name);
+	return RscpTagRequest::tagByName(indexName, index);
+}
+
+int32_t RscpTagRequest::add(const char *path) {
+	char buffer[TAG_PATH_MAX_LENGTH];
+	if(strlen(path) >= sizeof(buffer)) {
+		printf("Tag path too long: %s\n", path);
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	strcpy(buffer, path);
+
+	std::vector<SRscpTagNode> *nodes = &m_nodes;
+	SRscpTagNode *container = NULL;
+	const char *containerName = NULL;
+	char *save = NULL;
+	for(char *element = strtok_r(buffer, "/", &save); element != NULL; element = strtok_r(NULL, "/", &save)) {
+		// the index of a container is sent as its *_INDEX value, only some name spaces have one
+		if((container != NULL) && (container->index >= 0) && (container->indexTag == 0)
+			&& !indexTag(container->tag, &container->indexTag)) {
+			printf("No index tag for container %s in %s\n", containerName, path);
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		int16_t index = -1;
+		char *bracket = strchr(element, '[');
+		if(bracket != NULL) {
+			char *end;
+			long value = strtol(bracket + 1, &end, 0);
+			if((end == bracket + 1) || (strcmp(end, "]") != 0) || (value < 0) || (value > UINT8_MAX)) {
+				printf("Invalid index in %s, expected [0..255]\n", element);
+				return RSCP::ERR_INVALID_INPUT;
+			}
+			index = value;
+			*bracket = '\0';
+		}
+		SRscpTag tag;
+		if(!tagByName(element, &tag)) {
+			printf("Unknown tag %s in %s\n", element, path);
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		// requests with the same tag and index share the node
+		size_t i;
+		for(i = 0; i < nodes->size(); i++) {
+			if(((*nodes)[i].tag == tag) && ((*nodes)[i].index == index)) {
+				break;
+			}
+		}
+		if(i == nodes->size()) {
+			SRscpTagNode node;
+			node.tag = tag;
+			node.index = index;
+			node.indexTag = 0;
+			nodes->push_back(node);
+		}
+		container = &(*nodes)[i];
+		containerName = element;
+		nodes = &container->children;
+	}
+	return RSCP::OK;
+}
+
+int32_t RscpTagRequest::addFile(const char *fileName) {
+	FILE *file = fopen(fileName, "r");
+	if(file == NULL) {
+		printf("Cannot open request file %s\n", fileName);
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	char line[TAG_PATH_MAX_LENGTH];
+	int32_t iResult = RSCP::OK;
+	while((iResult == RSCP::OK) && (fgets(line, sizeof(line), file) != NULL)) {
+		// strip leading and trailing white space
+		char *path = line + strspn(line, " \t");
+		size_t length = strcspn(path, " \t\r\n");
+		path[length] = '\0';
+		if((length == 0) || (path[0] == '#')) {
+			continue;
+		}
+		iResult = add(path);
+	}
+	fclose(file);
+	return iResult;
+}
+
+int32_t RscpTagRequest::buildNode(RscpBuilder & builder, const SRscpTagNode & node) const {
+	if(node.children.empty()) {
+		if(node.index < 0) {
+			return builder.add(node.tag);
+		}
+		return builder.add(node.tag, (uint8_t) node.index);
+	}
+	builder.open(node.tag);
+	if(node.index >= 0) {
+		builder.add(node.indexTag, (uint8_t) node.index);
+	}
+	for(size_t i = 0; i < node.children.size(); i++) {
+		buildNode(builder, node.children[i]);
+	}
+	return builder.close();
+}
+
+int32_t RscpTagRequest::build(RscpBuilder & builder) const {
+	for(size_t i = 0; i < m_nodes.size(); i++) {
+		int32_t iResult = buildNode(builder, m_nodes[i]);
+		if(iResult < 0) {
+			return iResult;
+		}
+	}
+	return RSCP::OK;
+}
+
+void RscpTagRequest::print(FILE *file, RscpProtocol & protocol, const SRscpValue & value, int depth) {
+	const char *name = tagName(value.tag);
+	fprintf(file, "%*s", depth * 2, "");
+	if(name != NULL) {
+		fprintf(file, "%s", name);
+	}
+	else {
+		fprintf(file, "0x%08X", value.tag);
+	}
+	switch(value.dataType) {
+	case RSCP::eTypeNone:
+		fprintf(file, "\n");
+		break;
+	case RSCP::eTypeBool:
+		fprintf(file, " = %s\n", protocol.getValueAsBool(&value) ? "true" : "false");
+		break;
+	case RSCP::eTypeChar8:
+		fprintf(file, " = %i\n", protocol.getValueAsChar8(&value));
+		break;
+	case RSCP::eTypeUChar8:
+	case RSCP::eTypeBitfield:
+		fprintf(file, " = %u\n", protocol.getValueAsUChar8(&value));
+		break;
+	case RSCP::eTypeInt16:
+		fprintf(file, " = %i\n", protocol.getValueAsInt16(&value));
+		break;
+	case RSCP::eTypeUInt16:
+		fprintf(file, " = %u\n", protocol.getValueAsUInt16(&value));
+		break;
+	case RSCP::eTypeInt32:
+		fprintf(file, " = %i\n", protocol.getValueAsInt32(&value));
+		break;
+	case RSCP::eTypeUInt32:
+		fprintf(file, " = %u\n", protocol.getValueAsUInt32(&value));
+		break;
+	case RSCP::eTypeInt64:
+		fprintf(file, " = %" PRIi64 "\n", protocol.getValueAsInt64(&value));
+		break;
+	case RSCP::eTypeUInt64:
+		fprintf(file, " = %" PRIu64 "\n", protocol.getValueAsUInt64(&value));
+		break;
+	case RSCP::eTypeFloat32:
+		fprintf(file, " = %g\n", protocol.getValueAsFloat32(&value));
+		break;
+	case RSCP::eTypeDouble64:
+		fprintf(file, " = %g\n", protocol.getValueAsDouble64(&value));
+		break;
+	case RSCP::eTypeString:
+		fprintf(file, " = \"%s\"\n", protocol.getValueAsString(&value).c_str());
+		break;
+	case RSCP::eTypeTimestamp: {
+		SRscpTimestamp timestamp = protocol.getValueAsTimestamp(&value);
+		fprintf(file, " = %" PRIu64 ".%09u\n", timestamp.seconds, timestamp.nanoseconds);
+		break;
+	}
+	case RSCP::eTypeError:
+		fprintf(file, " error %u\n", protocol.getValueAsUInt32(&value));
+		break;
+	case RSCP::eTypeContainer: {
+		fprintf(file, "\n");
+		std::vector<SRscpValue> children = protocol.getValueAsContainer(&value);
+		for(size_t i = 0; i < children.size(); i++) {
+			print(file, protocol, children[i], depth + 1);
+		}
+		protocol.destroyValueData(children);
+		break;
+	}
+	default:
+		// byte arrays and unknown types as hex
+		fprintf(file, " =");
+		for(uint16_t i = 0; i < value.length; i++) {
+			fprintf(file, " %02X", value.data[i]);
+		}
+		fprintf(file, "\n");
+		break;
+	}
+}
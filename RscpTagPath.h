@@ -0,0 +1,79 @@
+/*
+ * RscpTagPath.h
+ *
+ * Requests built from tag paths like TAG_BAT_REQ_DATA[0]/TAG_BAT_REQ_RSOC and tag names resolved through
+ * the table generated from RscpTags.h by RscpTagNames.awk.
+ */
+
+#ifndef RSCPTAGPATH_H_
+#define RSCPTAGPATH_H_
+
+#include <stdio.h>
+#include <vector>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+
+// maximum length of a tag path or a line of a request file
+#define TAG_PATH_MAX_LENGTH		1024
+
+/*
+ * \brief Requested tag, its index and the requests inside if it is a container.
+ */
+struct SRscpTagNode {
+	SRscpTag tag;
+	int16_t index;		// -1 without index
+	SRscpTag indexTag;	// resolved by add() for a container with index, else 0
+	std::vector<SRscpTagNode> children;
+};
+
+class RscpTagRequest {
+public:
+	/*
+	 * \brief Add a tag path to the request. The elements of a path are tag names or hexadecimal tags
+	 *        separated by '/', each element is a container of the following ones. An index in brackets
+	 *        selects e.g. the battery of a container: TAG_BAT_REQ_DATA[1] appends TAG_BAT_INDEX 1 as first
+	 *        value of the container, so a container with index needs an index tag in its name space.
+	 *        A leaf like TAG_PVI_REQ_DC_POWER[1] carries its index as value.
+	 *        Paths with a common prefix share the containers, so all of them fit into one frame.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT, the reason is printed
+	 */
+	int32_t add(const char *path);
+	/*
+	 * \brief Add the tag paths of a request file, one path per line. Empty lines and lines
+	 *        starting with '#' are skipped.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT, the reason is printed
+	 */
+	int32_t addFile(const char *fileName);
+	bool empty() const {
+		return m_nodes.empty();
+	}
+	/*
+	 * \brief Append all requested values to \var builder.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t build(RscpBuilder & builder) const;
+	/*
+	 * \brief Name of \var tag, NULL if RscpTags.h does not define it.
+	 */
+	static const char *tagName(SRscpTag tag);
+	/*
+	 * \brief Tag of \var name, either a name of RscpTags.h or a hexadecimal number.
+	 * @return - false if the name is unknown
+	 */
+	static bool tagByName(const char *name, SRscpTag *tag);
+	/*
+	 * \brief Index tag of the name space of \var tag, e.g. TAG_BAT_INDEX for TAG_BAT_REQ_DATA.
+	 * @return - false if the name space has no index tag
+	 */
+	static bool indexTag(SRscpTag tag, SRscpTag *index);
+	/*
+	 * \brief Print \var value with the names of its tags, containers are printed recursively.
+	 */
+	static void print(FILE *file, RscpProtocol & protocol, const SRscpValue & value, int depth = 0);
+private:
+	int32_t buildNode(RscpBuilder & builder, const SRscpTagNode & node) const;
+
+	std::vector<SRscpTagNode> m_nodes;
+};
+
+#endif /* RSCPTAGPATH_H_ */
@@ -196,7 +196,9 @@
 #define TAG_BAT_DCB_COUNT                                   	0x0380000D
 #define TAG_BAT_MAX_DCB_CELL_TEMPERATURE                    	0x03800016
 #define TAG_BAT_MIN_DCB_CELL_TEMPERATURE                    	0x03800017
+#define TAG_BAT_DCB_ALL_CELL_TEMPERATURES                   	0x03800018
 #define TAG_BAT_DCB_CELL_TEMPERATURE                        	0x03800019
+#define TAG_BAT_DCB_ALL_CELL_VOLTAGES                       	0x0380001A
 #define TAG_BAT_DCB_CELL_VOLTAGE                            	0x0380001B
 #define TAG_BAT_READY_FOR_SHUTDOWN                          	0x0380001E
 #define TAG_BAT_INFO                                        	0x03800020
@@ -216,6 +218,8 @@
 #define TAG_BAT_REQ_DCB_COUNT                               	0x0300000D
 #define TAG_BAT_REQ_MAX_DCB_CELL_TEMPERATURE                	0x03000016
 #define TAG_BAT_REQ_MIN_DCB_CELL_TEMPERATURE                	0x03000017
+#define TAG_BAT_REQ_DCB_ALL_CELL_TEMPERATURES               	0x03000018
+#define TAG_BAT_REQ_DCB_ALL_CELL_VOLTAGES                   	0x0300001A
 #define TAG_BAT_REQ_READY_FOR_SHUTDOWN                      	0x0300001E
 #define TAG_BAT_REQ_INFO                                    	0x03000020
 #define TAG_BAT_REQ_TRAINING_MODE                           	0x03000021
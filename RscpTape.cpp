@@ -0,0 +1,175 @@
+/*
+ * RscpTape.cpp
+ *
+ * Flat index of the values of a frame.
+ */
+
+#include <stdlib.h>
+#include "RscpTape.h"
+#include "RscpTagPath.h"
+
+RscpTape::RscpTape() :
+	m_pData(NULL) {
+}
+
+int32_t RscpTape::index(const uint8_t *data, uint32_t length) {
+	m_nodes.clear();
+	m_pData = data;
+	if((data == NULL) && (length > 0)) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	// the enclosing containers of the current position, the region itself at the bottom
+	SOpenContainer open[TAPE_MAX_DEPTH + 1];
+	uint32_t depth = 0;
+	open[0].node = -1;
+	open[0].end = length;
+	open[0].lastChild = -1;
+	uint32_t pos = 0;
+	while(true) {
+		while((depth > 0) && (pos >= open[depth].end)) {
+			depth--;
+		}
+		if(pos >= length) {
+			break;
+		}
+		uint32_t end = open[depth].end;
+		if(end - pos < RSCP_VALUE_HEADER_LENGTH) {
+			m_nodes.clear();
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		SRscpTapeNode node;
+		memcpy(&node.tag, data + pos, sizeof(node.tag));
+		node.dataType = data[pos + sizeof(node.tag)];
+		memcpy(&node.length, data + pos + sizeof(node.tag) + sizeof(node.dataType), sizeof(node.length));
+		node.offset = pos + RSCP_VALUE_HEADER_LENGTH;
+		if(node.length > end - node.offset) {
+			m_nodes.clear();
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		node.depth = depth;
+		node.parent = open[depth].node;
+		node.next = -1;
+		int32_t current = m_nodes.size();
+		if(open[depth].lastChild >= 0) {
+			m_nodes[open[depth].lastChild].next = current;
+		}
+		open[depth].lastChild = current;
+		m_nodes.push_back(node);
+		if((node.dataType == RSCP::eTypeContainer) && (node.length > 0)) {
+			if(depth == TAPE_MAX_DEPTH) {
+				m_nodes.clear();
+				return RSCP::ERR_INVALID_INPUT;
+			}
+			// descend, the children follow the container
+			depth++;
+			open[depth].node = current;
+			open[depth].end = node.offset + node.length;
+			open[depth].lastChild = -1;
+			pos = node.offset;
+		}
+		else {
+			pos = node.offset + node.length;
+		}
+	}
+	return m_nodes.size();
+}
+
+int32_t RscpTape::indexFrame(const uint8_t *frame, uint32_t length) {
+	SRscpFrameHeader header;
+	if((frame == NULL) || (length < sizeof(header))) {
+		m_nodes.clear();
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	memcpy(&header, frame, sizeof(header));
+	if(header.dataLength > length - sizeof(header)) {
+		m_nodes.clear();
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	return index(frame + sizeof(header), header.dataLength);
+}
+
+int32_t RscpTape::child(int32_t node, SRscpTag tag) const {
+	for(int32_t i = (node < 0) ? first() : firstChild(node); i >= 0; i = m_nodes[i].next) {
+		if(m_nodes[i].tag == tag) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool RscpTape::compile(const char *path, SRscpTapePath & result) {
+	memset(&result, 0, sizeof(result));
+	char buffer[TAG_PATH_MAX_LENGTH];
+	if(strlen(path) >= sizeof(buffer)) {
+		return false;
+	}
+	strcpy(buffer, path);
+	char *save = NULL;
+	for(char *element = strtok_r(buffer, "/", &save); element != NULL; element = strtok_r(NULL, "/", &save)) {
+		if(result.depth == TAPE_MAX_DEPTH) {
+			return false;
+		}
+		uint8_t i = result.depth++;
+		result.indexes[i] = -1;
+		char *bracket = strchr(element, '[');
+		if(bracket != NULL) {
+			char *end;
+			long index = strtol(bracket + 1, &end, 0);
+			if((end == bracket + 1) || (strcmp(end, "]") != 0) || (index < 0) || (index > UINT8_MAX)) {
+				return false;
+			}
+			result.indexes[i] = index;
+			*bracket = '\0';
+		}
+		if(!RscpTagRequest::tagByName(element, &result.tags[i])) {
+			return false;
+		}
+		if((result.indexes[i] >= 0) && !RscpTagRequest::indexTag(result.tags[i], &result.indexTags[i])) {
+			return false;
+		}
+	}
+	return result.depth > 0;
+}
+
+bool RscpTape::matches(int32_t node, const SRscpTapePath & path, uint8_t element) const {
+	if(m_nodes[node].tag != path.tags[element]) {
+		return false;
+	}
+	if(path.indexes[element] < 0) {
+		return true;
+	}
+	int32_t index = child(node, path.indexTags[element]);
+	double value;
+	return (index >= 0) && RscpWalker::asDouble(this->value(index), value) && (value == path.indexes[element]);
+}
+
+int32_t RscpTape::findFrom(int32_t first, const SRscpTapePath & path, uint8_t element) const {
+	for(int32_t i = first; i >= 0; i = m_nodes[i].next) {
+		if(!matches(i, path, element)) {
+			continue;
+		}
+		if(element + 1 == path.depth) {
+			return i;
+		}
+		int32_t found = findFrom(firstChild(i), path, element + 1);
+		if(found >= 0) {
+			return found;
+		}
+	}
+	return -1;
+}
+
+int32_t RscpTape::find(const SRscpTapePath & path, int32_t node) const {
+	if(path.depth == 0) {
+		return -1;
+	}
+	return findFrom((node < 0) ? first() : firstChild(node), path, 0);
+}
+
+int32_t RscpTape::find(const char *path, int32_t node) const {
+	SRscpTapePath compiled;
+	if(!compile(path, compiled)) {
+		return -1;
+	}
+	return find(compiled, node);
+}
@@ -0,0 +1,128 @@
+/*
+ * RscpTape.h
+ *
+ * Flat index of the values of a frame. One pass over the data records every value, including the
+ * values inside containers, as a node in pre-order with its parent and its next sibling, so the
+ * first child of a container is the node after it. Lookups by tag path and the iteration over the
+ * children of a node follow these links through one contiguous array instead of parsing and copying
+ * every container level again. The nodes refer to the indexed data, it must outlive the lookups.
+ */
+
+#ifndef RSCPTAPE_H_
+#define RSCPTAPE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "RscpTypes.h"
+#include "RscpWalker.h"
+
+// maximum container depth of an indexed frame and elements of a tape path
+#define TAPE_MAX_DEPTH			32
+
+struct SRscpTapeNode {
+	SRscpTag tag;
+	uint8_t dataType;
+	uint8_t depth;			// 0 for the values of the indexed region
+	uint16_t length;		// data length
+	uint32_t offset;		// of the data in the indexed region
+	int32_t parent;			// -1 for the values of the indexed region
+	int32_t next;			// next sibling, -1 for the last child
+};
+
+struct SRscpTapePath {
+	SRscpTag tags[TAPE_MAX_DEPTH];
+	int16_t indexes[TAPE_MAX_DEPTH];	// value of the *_INDEX child of a container, -1 for any
+	SRscpTag indexTags[TAPE_MAX_DEPTH];	// index tag of the name space, 0 if it has none
+	uint8_t depth;
+};
+
+class RscpTape {
+public:
+	RscpTape();
+	/*
+	 * \brief Index the values of the data region \var data (without frame header and CRC).
+	 * @return - number of nodes or RSCP::ERR_INVALID_INPUT if a value exceeds its container or the
+	 *           containers are nested deeper than TAPE_MAX_DEPTH, the tape is empty then
+	 */
+	int32_t index(const uint8_t *data, uint32_t length);
+	/*
+	 * \brief Index the values of a validated frame, see RscpProtocol::validateFrame().
+	 */
+	int32_t indexFrame(const uint8_t *frame, uint32_t length);
+	uint32_t size() const {
+		return m_nodes.size();
+	}
+	const SRscpTapeNode & node(int32_t node) const {
+		return m_nodes[node];
+	}
+	SRscpValueRef value(int32_t node) const {
+		const SRscpTapeNode & n = m_nodes[node];
+		SRscpValueRef value = { n.tag, n.dataType, n.length, m_pData + n.offset };
+		return value;
+	}
+	/*
+	 * \brief The data of \var node as \var T like RscpProtocol::getValue(): shorter data is zero extended.
+	 */
+	template<class T> T get(int32_t node) const {
+		const SRscpTapeNode & n = m_nodes[node];
+		T result;
+		memset(&result, 0, sizeof(result));
+		memcpy(&result, m_pData + n.offset, (n.length < sizeof(T)) ? n.length : sizeof(T));
+		return result;
+	}
+	/*
+	 * \brief First value of the indexed region, -1 if it is empty.
+	 */
+	int32_t first() const {
+		return m_nodes.empty() ? -1 : 0;
+	}
+	/*
+	 * \brief First child of \var node, -1 if it is no container or empty.
+	 */
+	int32_t firstChild(int32_t node) const {
+		return ((node + 1 < (int32_t) m_nodes.size()) && (m_nodes[node + 1].parent == node)) ? node + 1 : -1;
+	}
+	int32_t next(int32_t node) const {
+		return m_nodes[node].next;
+	}
+	int32_t parent(int32_t node) const {
+		return m_nodes[node].parent;
+	}
+	/*
+	 * \brief First child of \var node with \var tag, with \var node -1 the first value of the region.
+	 * @return - node or -1
+	 */
+	int32_t child(int32_t node, SRscpTag tag) const;
+	/*
+	 * \brief Resolve a path of tag names like TAG_BAT_DATA[0]/TAG_BAT_RSOC, see RscpTagRequest::tagByName().
+	 *        An index selects the container whose *_INDEX child has this value.
+	 * @return - false if a tag is unknown, an index is invalid or the path is too deep
+	 */
+	static bool compile(const char *path, SRscpTapePath & result);
+	/*
+	 * \brief First value of \var path below \var node (-1 for the whole region), a container which
+	 *        matches an element but does not contain the rest of the path is skipped.
+	 * @return - node or -1
+	 */
+	int32_t find(const SRscpTapePath & path, int32_t node = -1) const;
+	/*
+	 * \copydoc RscpTape::find(const SRscpTapePath & path, int32_t node)
+	 *        Compiles \var path on every call, compile() it once for repeated lookups.
+	 */
+	int32_t find(const char *path, int32_t node = -1) const;
+private:
+	struct SOpenContainer {
+		int32_t node;		// -1 for the indexed region
+		uint32_t end;
+		int32_t lastChild;
+	};
+
+	bool matches(int32_t node, const SRscpTapePath & path, uint8_t element) const;
+	int32_t findFrom(int32_t first, const SRscpTapePath & path, uint8_t element) const;
+
+	const uint8_t *m_pData;
+	std::vector<SRscpTapeNode> m_nodes;		// keeps its capacity between frames
+};
+
+#endif /* RSCPTAPE_H_ */
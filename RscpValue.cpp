@@ -0,0 +1,146 @@
+/*
+ * RscpValue.cpp
+ *
+ * Move-only owning RSCP value with inline storage for small data.
+ */
+
+#include <stdlib.h>
+#include "RscpValue.h"
+
+RscpValue::RscpValue(RscpValue && other) noexcept :
+	m_tag(other.m_tag), m_dataType(other.m_dataType), m_storage(other.m_storage), m_length(other.m_length) {
+	// inline data is copied, heap and borrowed data change hands
+	memcpy(m_inline, other.m_inline, sizeof(m_inline));
+	other.m_storage = STORAGE_INLINE;
+	other.m_length = 0;
+}
+
+RscpValue & RscpValue::operator=(RscpValue && other) noexcept {
+	if(this != &other) {
+		release();
+		m_tag = other.m_tag;
+		m_dataType = other.m_dataType;
+		m_storage = other.m_storage;
+		m_length = other.m_length;
+		memcpy(m_inline, other.m_inline, sizeof(m_inline));
+		other.m_storage = STORAGE_INLINE;
+		other.m_length = 0;
+	}
+	return *this;
+}
+
+void RscpValue::release() {
+	if(m_storage == STORAGE_HEAP) {
+		free(const_cast<uint8_t *>(m_pData));
+	}
+	m_storage = STORAGE_INLINE;
+	m_length = 0;
+}
+
+uint8_t *RscpValue::reserve(uint32_t length) {
+	release();
+	if(length <= RSCP_VALUE_INLINE_LENGTH) {
+		return m_inline;
+	}
+	uint8_t *pData = (uint8_t *) malloc(length);
+	if(pData != NULL) {
+		m_pData = pData;
+		m_storage = STORAGE_HEAP;
+	}
+	return pData;
+}
+
+int32_t RscpValue::assign(SRscpTag tag, uint8_t dataType, const void *data, uint32_t length) {
+	if(length > RSCP_VALUE_MAX_LENGTH) {
+		return RSCP::ERR_DATA_LIMIT_EXCEEDED;
+	}
+	// the source may be a part of the data of this value, which reserve() frees or overwrites
+	const uint8_t *source = (const uint8_t *) data;
+	const uint8_t *own = this->data();
+	bool overlaps = (source != NULL) && (length > 0) && (m_length > 0) && (source < own + m_length)
+		&& (own < source + length);
+	if(overlaps && ((m_storage != STORAGE_INLINE) || (length > RSCP_VALUE_INLINE_LENGTH))) {
+		RscpValue copy;
+		int32_t iResult = copy.assign(tag, dataType, data, length);
+		if(iResult == RSCP::OK) {
+			*this = static_cast<RscpValue &&>(copy);
+		}
+		return iResult;
+	}
+	uint8_t *pData = reserve(length);
+	if(pData == NULL) {
+		return RSCP::ERR_NO_MEMORY;
+	}
+	if(length > 0) {
+		// inline data may overlap itself
+		memmove(pData, data, length);
+	}
+	m_tag = tag;
+	m_dataType = dataType;
+	m_length = length;
+	return RSCP::OK;
+}
+
+int32_t RscpValue::assignContainer(SRscpTag tag, const RscpValue *children, size_t count) {
+	uint32_t length = 0;
+	for(size_t i = 0; i < count; i++) {
+		length += children[i].encodedLength();
+		if(length > RSCP_VALUE_MAX_LENGTH) {
+			return RSCP::ERR_DATA_LIMIT_EXCEEDED;
+		}
+	}
+	// the children are encoded in one allocation instead of one reallocation per child
+	RscpValue container;
+	uint8_t *pData = container.reserve(length);
+	if(pData == NULL) {
+		return RSCP::ERR_NO_MEMORY;
+	}
+	uint32_t offset = 0;
+	for(size_t i = 0; i < count; i++) {
+		offset += children[i].encode(pData + offset, length - offset);
+	}
+	container.m_tag = tag;
+	container.m_dataType = RSCP::eTypeContainer;
+	container.m_length = length;
+	*this = static_cast<RscpValue &&>(container);
+	return RSCP::OK;
+}
+
+RscpValue RscpValue::borrow(const SRscpValueRef & value) {
+	RscpValue result(value.tag);
+	result.m_dataType = value.dataType;
+	result.m_length = value.length;
+	if(value.length > 0) {
+		result.m_pData = value.data;
+		result.m_storage = STORAGE_BORROWED;
+	}
+	return result;
+}
+
+int32_t RscpValue::parse(const uint8_t *data, uint32_t length, std::vector<RscpValue> & values) {
+	// count first, so the values of a container cost at most one allocation
+	int32_t count = RscpWalker::count(data, length);
+	if(count < 0) {
+		return count;
+	}
+	values.reserve(values.size() + count);
+	RscpWalker walker(data, length);
+	SRscpValueRef value;
+	while(walker.next(value)) {
+		values.push_back(borrow(value));
+	}
+	return length;
+}
+
+uint32_t RscpValue::encode(uint8_t *buffer, uint32_t size) const {
+	if(size < encodedLength()) {
+		return 0;
+	}
+	memcpy(buffer, &m_tag, sizeof(m_tag));
+	buffer[sizeof(m_tag)] = m_dataType;
+	memcpy(buffer + sizeof(m_tag) + sizeof(m_dataType), &m_length, sizeof(m_length));
+	if(m_length > 0) {
+		memcpy(buffer + RSCP_VALUE_HEADER_LENGTH, data(), m_length);
+	}
+	return encodedLength();
+}
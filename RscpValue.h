@@ -0,0 +1,173 @@
+/*
+ * RscpValue.h
+ *
+ * Move-only owning RSCP value. Almost every value is a scalar of 1 to 12 bytes, so the data of
+ * small values is kept inline in the object and only larger values use the heap. A value can also
+ * borrow the data of a received frame, parse() splits a data region into borrowed values without
+ * copying. The data is released by the destructor, there is no destroyValueData() to forget.
+ */
+
+#ifndef RSCPVALUE_H_
+#define RSCPVALUE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "RscpTypes.h"
+#include "RscpWalker.h"
+
+// data up to this length is stored inline, enough for every scalar and SRscpTimestamp
+#define RSCP_VALUE_INLINE_LENGTH	16
+// maximum data length of a value, see RscpProtocol::createValue()
+#define RSCP_VALUE_MAX_LENGTH		0xFFF8
+
+class RscpValue {
+public:
+	RscpValue() :
+		m_tag(0), m_dataType(RSCP::eTypeNone), m_storage(STORAGE_INLINE), m_length(0) {
+	}
+	/*
+	 * \brief Value of \var tag without data, like a request tag.
+	 */
+	explicit RscpValue(SRscpTag tag) :
+		m_tag(tag), m_dataType(RSCP::eTypeNone), m_storage(STORAGE_INLINE), m_length(0) {
+	}
+	RscpValue(SRscpTag tag, bool value) { setScalar(tag, RSCP::eTypeBool, value); }
+	RscpValue(SRscpTag tag, int8_t value) { setScalar(tag, RSCP::eTypeChar8, value); }
+	RscpValue(SRscpTag tag, uint8_t value) { setScalar(tag, RSCP::eTypeUChar8, value); }
+	RscpValue(SRscpTag tag, int16_t value) { setScalar(tag, RSCP::eTypeInt16, value); }
+	RscpValue(SRscpTag tag, uint16_t value) { setScalar(tag, RSCP::eTypeUInt16, value); }
+	RscpValue(SRscpTag tag, int32_t value) { setScalar(tag, RSCP::eTypeInt32, value); }
+	RscpValue(SRscpTag tag, uint32_t value) { setScalar(tag, RSCP::eTypeUInt32, value); }
+	RscpValue(SRscpTag tag, int64_t value) { setScalar(tag, RSCP::eTypeInt64, value); }
+	RscpValue(SRscpTag tag, uint64_t value) { setScalar(tag, RSCP::eTypeUInt64, value); }
+	RscpValue(SRscpTag tag, float value) { setScalar(tag, RSCP::eTypeFloat32, value); }
+	RscpValue(SRscpTag tag, double value) { setScalar(tag, RSCP::eTypeDouble64, value); }
+	RscpValue(SRscpTag tag, const SRscpTimestamp & value) { setScalar(tag, RSCP::eTypeTimestamp, value); }
+	RscpValue(RscpValue && other) noexcept;
+	RscpValue & operator=(RscpValue && other) noexcept;
+	~RscpValue() {
+		release();
+	}
+	/*
+	 * \brief Own a copy of \var length bytes of \var data, inline if it fits.
+	 * @return - RSCP::OK, RSCP::ERR_DATA_LIMIT_EXCEEDED or RSCP::ERR_NO_MEMORY
+	 */
+	int32_t assign(SRscpTag tag, uint8_t dataType, const void *data, uint32_t length);
+	/*
+	 * \brief Own a container of \var tag with the encoded \var children.
+	 * @return - RSCP::OK, RSCP::ERR_DATA_LIMIT_EXCEEDED or RSCP::ERR_NO_MEMORY
+	 */
+	int32_t assignContainer(SRscpTag tag, const RscpValue *children, size_t count);
+	int32_t assignContainer(SRscpTag tag, const std::vector<RscpValue> & children) {
+		return assignContainer(tag, children.empty() ? NULL : &children[0], children.size());
+	}
+	/*
+	 * \brief Value which refers to the data of \var value, the data must outlive it.
+	 */
+	static RscpValue borrow(const SRscpValueRef & value);
+	/*
+	 * \brief Append the values of the data region \var data as borrowed values to \var values.
+	 * @return - bytes parsed or RSCP::ERR_INVALID_INPUT if a value exceeds the region
+	 */
+	static int32_t parse(const uint8_t *data, uint32_t length, std::vector<RscpValue> & values);
+	/*
+	 * \brief Append the children of this container as borrowed values to \var values.
+	 * @return - see parse(), no children for other types
+	 */
+	int32_t children(std::vector<RscpValue> & values) const {
+		return parse(data(), (m_dataType == RSCP::eTypeContainer) ? m_length : 0, values);
+	}
+	/*
+	 * \brief Owned copy of this value, e.g. of a borrowed value which is kept after the frame.
+	 * @return - RSCP::OK, RSCP::ERR_DATA_LIMIT_EXCEEDED or RSCP::ERR_NO_MEMORY
+	 */
+	int32_t copyTo(RscpValue & value) const {
+		return value.assign(m_tag, m_dataType, data(), m_length);
+	}
+
+	SRscpTag tag() const {
+		return m_tag;
+	}
+	uint8_t dataType() const {
+		return m_dataType;
+	}
+	uint16_t length() const {
+		return m_length;
+	}
+	const uint8_t *data() const {
+		return (m_storage == STORAGE_INLINE) ? m_inline : m_pData;
+	}
+	bool borrowed() const {
+		return m_storage == STORAGE_BORROWED;
+	}
+	bool isInline() const {
+		return m_storage == STORAGE_INLINE;
+	}
+	SRscpValueRef ref() const {
+		SRscpValueRef value = { m_tag, m_dataType, m_length, data() };
+		return value;
+	}
+	/*
+	 * \brief SRscpValue which refers to the data of this value for the RscpProtocol getters. The data
+	 *        stays owned by this value, never pass the result to RscpProtocol::destroyValueData().
+	 */
+	SRscpValue view() const {
+		SRscpValue value;
+		value.tag = m_tag;
+		value.dataType = m_dataType;
+		value.length = m_length;
+		value.data = const_cast<uint8_t *>(data());
+		return value;
+	}
+	/*
+	 * \brief The data as \var T like RscpProtocol::getValue(): shorter data is zero extended.
+	 */
+	template<class T> T get() const {
+		T result;
+		memset(&result, 0, sizeof(result));
+		memcpy(&result, data(), (m_length < sizeof(T)) ? m_length : sizeof(T));
+		return result;
+	}
+	/*
+	 * \brief Length of the value on the wire including the value header.
+	 */
+	uint32_t encodedLength() const {
+		return RSCP_VALUE_HEADER_LENGTH + m_length;
+	}
+	/*
+	 * \brief Write the value with its header to \var buffer.
+	 * @return - bytes written or 0 if \var size is too small
+	 */
+	uint32_t encode(uint8_t *buffer, uint32_t size) const;
+private:
+	RscpValue(const RscpValue &);
+	RscpValue & operator=(const RscpValue &);
+
+	enum eStorage {
+		STORAGE_INLINE = 0,
+		STORAGE_HEAP,
+		STORAGE_BORROWED
+	};
+
+	template<class T> void setScalar(SRscpTag tag, uint8_t dataType, const T & value) {
+		m_tag = tag;
+		m_dataType = dataType;
+		m_storage = STORAGE_INLINE;
+		m_length = sizeof(T);
+		memcpy(m_inline, &value, sizeof(T));
+	}
+	uint8_t *reserve(uint32_t length);
+	void release();
+
+	SRscpTag m_tag;
+	uint8_t m_dataType;
+	uint8_t m_storage;			// eStorage
+	uint16_t m_length;
+	union {
+		uint8_t m_inline[RSCP_VALUE_INLINE_LENGTH];
+		const uint8_t *m_pData;	// heap or borrowed data
+	};
+};
+
+#endif /* RSCPVALUE_H_ */
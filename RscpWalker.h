@@ -0,0 +1,174 @@
+/*
+ * RscpWalker.h
+ *
+ * Non-allocating reader for RSCP frame data. Values are returned as references into the frame
+ * buffer, containers are walked by creating a child walker over the value data.
+ */
+
+#ifndef RSCPWALKER_H_
+#define RSCPWALKER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "RscpTypes.h"
+
+// size of the value header on the wire: tag, data type and length without the data pointer
+#define RSCP_VALUE_HEADER_LENGTH	(sizeof(SRscpValue) - sizeof(uint8_t *))
+
+struct SRscpValueRef {
+	SRscpTag tag;
+	uint8_t dataType;
+	uint16_t length;
+	const uint8_t *data;			// points into the walked buffer, not owned
+};
+
+class RscpWalker {
+public:
+	RscpWalker() :
+		m_pData(NULL), m_pEnd(NULL), m_bError(false) {
+	}
+	/*
+	 * \brief Walk the values of the data region \var data (without frame header and CRC).
+	 */
+	RscpWalker(const uint8_t *data, uint32_t length) :
+		m_pData(data), m_pEnd(data + length), m_bError(false) {
+	}
+	/*
+	 * \brief Walk the values of a validated frame, see RscpProtocol::validateFrame().
+	 * @param frame		- Start of the frame header
+	 * @param length	- Frame length including the optional CRC
+	 */
+	static RscpWalker frame(const uint8_t *frame, uint32_t length) {
+		if(length < sizeof(SRscpFrameHeader)) {
+			RscpWalker walker;
+			walker.m_bError = true;
+			return walker;
+		}
+		const SRscpFrameHeader *header = reinterpret_cast<const SRscpFrameHeader *>(frame);
+		uint32_t dataLength = header->dataLength;
+		if(dataLength > length - sizeof(SRscpFrameHeader)) {
+			RscpWalker walker;
+			walker.m_bError = true;
+			return walker;
+		}
+		return RscpWalker(frame + sizeof(SRscpFrameHeader), dataLength);
+	}
+	/*
+	 * \brief Walk the children of the container \var value.
+	 */
+	static RscpWalker children(const SRscpValueRef & value) {
+		if(value.dataType != RSCP::eTypeContainer) {
+			return RscpWalker(value.data, 0);
+		}
+		return RscpWalker(value.data, value.length);
+	}
+	/*
+	 * \brief Read the next value.
+	 * @return - false at the end of the data or if the next value header does not fit, see error()
+	 */
+	bool next(SRscpValueRef & value) {
+		uint32_t remaining = m_pEnd - m_pData;
+		if(remaining == 0) {
+			return false;
+		}
+		if(remaining < RSCP_VALUE_HEADER_LENGTH) {
+			m_bError = true;
+			m_pData = m_pEnd;
+			return false;
+		}
+		memcpy(&value.tag, m_pData, sizeof(value.tag));
+		value.dataType = m_pData[sizeof(value.tag)];
+		memcpy(&value.length, m_pData + sizeof(value.tag) + sizeof(value.dataType), sizeof(value.length));
+		if(value.length > remaining - RSCP_VALUE_HEADER_LENGTH) {
+			m_bError = true;
+			m_pData = m_pEnd;
+			return false;
+		}
+		value.data = m_pData + RSCP_VALUE_HEADER_LENGTH;
+		m_pData = value.data + value.length;
+		return true;
+	}
+	/*
+	 * \brief True if a value exceeded the walked data, the rest of the data is skipped.
+	 */
+	bool error() const {
+		return m_bError;
+	}
+	/*
+	 * \brief Count the values of the data region \var data without reading them.
+	 * @return - number of values or RSCP::ERR_INVALID_INPUT if a value exceeds the data
+	 */
+	static int32_t count(const uint8_t *data, uint32_t length) {
+		if((data == NULL) && (length > 0)) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		RscpWalker walker(data, length);
+		SRscpValueRef value;
+		int32_t count = 0;
+		while(walker.next(value)) {
+			count++;
+		}
+		if(walker.error()) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		return count;
+	}
+	/*
+	 * \brief Read a numeric value of any integer, float, bool or timestamp type as double.
+	 * @return - false for strings, containers, byte arrays and values which are too short
+	 */
+	static bool asDouble(const SRscpValueRef & value, double & result) {
+		switch(value.dataType) {
+		case RSCP::eTypeBool:
+		case RSCP::eTypeUChar8:
+		case RSCP::eTypeBitfield:
+			return load<uint8_t>(value, result);
+		case RSCP::eTypeChar8:
+			return load<int8_t>(value, result);
+		case RSCP::eTypeInt16:
+			return load<int16_t>(value, result);
+		case RSCP::eTypeUInt16:
+			return load<uint16_t>(value, result);
+		case RSCP::eTypeInt32:
+		case RSCP::eTypeError:
+			return load<int32_t>(value, result);
+		case RSCP::eTypeUInt32:
+			return load<uint32_t>(value, result);
+		case RSCP::eTypeInt64:
+			return load<int64_t>(value, result);
+		case RSCP::eTypeUInt64:
+			return load<uint64_t>(value, result);
+		case RSCP::eTypeFloat32:
+			return load<float>(value, result);
+		case RSCP::eTypeDouble64:
+			return load<double>(value, result);
+		case RSCP::eTypeTimestamp: {
+			SRscpTimestamp timestamp;
+			if(value.length < sizeof(timestamp)) {
+				return false;
+			}
+			memcpy(&timestamp, value.data, sizeof(timestamp));
+			result = (double) timestamp.seconds + (double) timestamp.nanoseconds / 1e9;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+private:
+	template<class T> static bool load(const SRscpValueRef & value, double & result) {
+		T t;
+		if(value.length < sizeof(T)) {
+			return false;
+		}
+		memcpy(&t, value.data, sizeof(T));
+		result = (double) t;
+		return true;
+	}
+
+	const uint8_t *m_pData;
+	const uint8_t *m_pEnd;
+	bool m_bError;
+};
+
+#endif /* RSCPWALKER_H_ */
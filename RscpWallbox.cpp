@@ -0,0 +1,189 @@
+/*
+ * RscpWallbox.cpp
+ *
+ * Surplus charging with a wallbox.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "RscpWallbox.h"
+#include "RscpTags.h"
+
+// value of TAG_WB_MODE_PARAM_MODE for charging with a current limit
+#define WB_MODE_CURRENT_LIMIT		1
+
+RscpWallbox::RscpWallbox() :
+	m_bEnabled(false), m_bDryRun(false), m_iMinCurrent(WB_MIN_CURRENT), m_iMaxCurrent(16), m_iPhases(3),
+	m_fPvPower(0.0), m_fGridPower(0.0), m_fHomePower(0.0), m_fBatteryPower(0.0), m_fWallboxPower(0.0),
+	m_fWallboxSolarPower(0.0), m_ucStatus(0), m_iCurrent(0), m_iLowPeriods(0), m_uChanges(0),
+	m_uOverruns(0) {
+	memset(m_fWallboxPhasePower, 0, sizeof(m_fWallboxPhasePower));
+}
+
+void RscpWallbox::setLimits(int minCurrent, int maxCurrent, int phases) {
+	m_iMinCurrent = (minCurrent < WB_MIN_CURRENT) ? WB_MIN_CURRENT : (minCurrent > WB_MAX_CURRENT) ? WB_MAX_CURRENT : minCurrent;
+	m_iMaxCurrent = (maxCurrent < m_iMinCurrent) ? m_iMinCurrent : (maxCurrent > WB_MAX_CURRENT) ? WB_MAX_CURRENT : maxCurrent;
+	m_iPhases = ((phases < 1) || (phases > 3)) ? 3 : phases;
+}
+
+int32_t RscpWallbox::createPoll(RscpBuilder & builder) {
+	static const SRscpTag emsRequests[] = {
+		TAG_EMS_REQ_POWER_PV, TAG_EMS_REQ_POWER_BAT, TAG_EMS_REQ_POWER_HOME, TAG_EMS_REQ_POWER_GRID,
+		TAG_EMS_REQ_POWER_WB_ALL, TAG_EMS_REQ_POWER_WB_SOLAR
+	};
+	static const SRscpTag wbRequests[] = {
+		TAG_WB_REQ_STATUS, TAG_WB_REQ_PM_POWER_L1, TAG_WB_REQ_PM_POWER_L2, TAG_WB_REQ_PM_POWER_L3
+	};
+	for(size_t i = 0; i < sizeof(emsRequests) / sizeof(emsRequests[0]); i++) {
+		builder.add(emsRequests[i]);
+	}
+	builder.open(TAG_WB_REQ_DATA);
+	builder.add(TAG_WB_INDEX, (uint8_t) 0);
+	for(size_t i = 0; i < sizeof(wbRequests) / sizeof(wbRequests[0]); i++) {
+		builder.add(wbRequests[i]);
+	}
+	return builder.close();
+}
+
+bool RscpWallbox::accepts(SRscpTag tag) {
+	switch(tag) {
+	case TAG_EMS_POWER_PV:
+	case TAG_EMS_POWER_BAT:
+	case TAG_EMS_POWER_HOME:
+	case TAG_EMS_POWER_GRID:
+	case TAG_EMS_POWER_WB_ALL:
+	case TAG_EMS_POWER_WB_SOLAR:
+	case TAG_WB_DATA:
+		return true;
+	default:
+		return false;
+	}
+}
+
+int32_t RscpWallbox::handleValue(const SRscpValueRef & value) {
+	if(value.dataType == RSCP::eTypeError) {
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	double fValue = 0.0;
+	switch(value.tag) {
+	case TAG_EMS_POWER_PV:
+		return RscpWalker::asDouble(value, m_fPvPower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_EMS_POWER_BAT:
+		return RscpWalker::asDouble(value, m_fBatteryPower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_EMS_POWER_HOME:
+		return RscpWalker::asDouble(value, m_fHomePower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_EMS_POWER_GRID:
+		return RscpWalker::asDouble(value, m_fGridPower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_EMS_POWER_WB_ALL:
+		return RscpWalker::asDouble(value, m_fWallboxPower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_EMS_POWER_WB_SOLAR:
+		return RscpWalker::asDouble(value, m_fWallboxSolarPower) ? RSCP::OK : RSCP::ERR_INVALID_INPUT;
+	case TAG_WB_DATA:
+		break;
+	default:
+		return RSCP::ERR_INVALID_INPUT;
+	}
+	RscpWalker walker = RscpWalker::children(value);
+	SRscpValueRef child;
+	while(walker.next(child)) {
+		if(child.dataType == RSCP::eTypeError) {
+			return RSCP::ERR_INVALID_INPUT;
+		}
+		switch(child.tag) {
+		case TAG_WB_STATUS:
+			if(RscpWalker::asDouble(child, fValue)) {
+				m_ucStatus = (uint8_t) fValue;
+			}
+			break;
+		case TAG_WB_PM_POWER_L1:
+		case TAG_WB_PM_POWER_L2:
+		case TAG_WB_PM_POWER_L3:
+			RscpWalker::asDouble(child, m_fWallboxPhasePower[child.tag - TAG_WB_PM_POWER_L1]);
+			break;
+		default:
+			// index and the result of the set request
+			break;
+		}
+	}
+	return walker.error() ? RSCP::ERR_INVALID_INPUT : RSCP::OK;
+}
+
+bool RscpWallbox::control() {
+	// the power fed into the grid and the power the wallbox already draws are available for charging,
+	// the grid power is negative while feeding in
+	double fAvailable = m_fWallboxPower - m_fGridPower;
+	int iTarget = (int) floor(fAvailable / (WB_PHASE_VOLTAGE * m_iPhases));
+	if(iTarget > m_iMaxCurrent) {
+		iTarget = m_iMaxCurrent;
+	}
+	if(iTarget < m_iMinCurrent) {
+		// short clouds do not stop the charging, a started charge continues at the minimum current
+		m_iLowPeriods++;
+		iTarget = ((m_iCurrent > 0) && (m_iLowPeriods < WB_STOP_PERIODS)) ? m_iMinCurrent : 0;
+	}
+	else {
+		m_iLowPeriods = 0;
+	}
+	// limit the step to keep the loop stable against the delayed power measurement
+	if(iTarget > 0) {
+		int iFrom = (m_iCurrent > 0) ? m_iCurrent : m_iMinCurrent;
+		if(iTarget > iFrom + WB_MAX_STEP) {
+			iTarget = iFrom + WB_MAX_STEP;
+		}
+		else if(iTarget < iFrom - WB_MAX_STEP) {
+			iTarget = iFrom - WB_MAX_STEP;
+		}
+	}
+	if(iTarget == m_iCurrent) {
+		return false;
+	}
+	m_iCurrent = iTarget;
+	m_uChanges++;
+	return true;
+}
+
+int32_t RscpWallbox::createSetCurrent(RscpBuilder & builder) {
+	builder.open(TAG_WB_REQ_DATA);
+	builder.add(TAG_WB_INDEX, (uint8_t) 0);
+	builder.open(TAG_WB_REQ_SET_MODE);
+	// a current of 0 stops the charging
+	builder.add(TAG_WB_MODE_PARAM_MODE, (uint8_t) WB_MODE_CURRENT_LIMIT);
+	builder.add(TAG_WB_MODE_PARAM_MAX_CURRENT, (uint8_t) m_iCurrent);
+	builder.close();
+	return builder.close();
+}
+
+void RscpWallbox::printState(FILE *file) const {
+	fprintf(file, "PV %5.0f W, grid %6.0f W, home %5.0f W, battery %6.0f W, wallbox %5.0f W (solar %5.0f W, L1..L3 %.0f/%.0f/%.0f W), current %2i A%s\n",
+		m_fPvPower, m_fGridPower, m_fHomePower, m_fBatteryPower, m_fWallboxPower, m_fWallboxSolarPower,
+		m_fWallboxPhasePower[0], m_fWallboxPhasePower[1], m_fWallboxPhasePower[2], m_iCurrent,
+		m_bDryRun ? " (dry run)" : "");
+}
+
+const char *RscpWallbox::latencyName(eRscpWallboxLatency latency) {
+	switch(latency) {
+	case WB_LATENCY_POLL:
+		return "poll";
+	case WB_LATENCY_CONTROL:
+		return "control";
+	case WB_LATENCY_SET:
+		return "set";
+	case WB_LATENCY_CYCLE:
+		return "cycle";
+	case WB_LATENCY_LATENESS:
+		return "lateness";
+	default:
+		return "unknown";
+	}
+}
+
+void RscpWallbox::printLatencies(FILE *file) const {
+	fprintf(file, "Wallbox control: %llu periods, %llu current changes%s, %llu overruns\n",
+		(unsigned long long) m_latencies[WB_LATENCY_CYCLE].count(), (unsigned long long) m_uChanges,
+		m_bDryRun ? " (dry run, not sent)" : "", (unsigned long long) m_uOverruns);
+	fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s %10s %10s\n", "# latency [us]",
+		"count", "min", "p50", "p90", "p99", "p99.9", "max", "mean");
+	for(int i = 0; i < WB_LATENCY_COUNT; i++) {
+		m_latencies[i].print(file, latencyName((eRscpWallboxLatency) i));
+	}
+}
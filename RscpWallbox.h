@@ -0,0 +1,128 @@
+/*
+ * RscpWallbox.h
+ *
+ * Surplus charging with a wallbox. The EMS power values and the wallbox values are polled in one
+ * frame per control period, the charge current follows the power which would otherwise be fed
+ * into the grid. The latencies of each step of the loop are recorded in histograms.
+ */
+
+#ifndef RSCPWALLBOX_H_
+#define RSCPWALLBOX_H_
+
+#include <stdio.h>
+#include "RscpProtocol.h"
+#include "RscpBuilder.h"
+#include "RscpWalker.h"
+#include "RscpStats.h"
+
+// nominal phase voltage used to convert power into charge current
+#define WB_PHASE_VOLTAGE			230.0
+// charge current limits of IEC 61851 in A
+#define WB_MIN_CURRENT				6
+#define WB_MAX_CURRENT				32
+// largest change of the charge current in one control period in A
+#define WB_MAX_STEP					2
+// periods the surplus has to stay below the minimum current before charging stops
+#define WB_STOP_PERIODS				5
+
+enum eRscpWallboxLatency {
+	WB_LATENCY_POLL		= 0,		// poll frame queued until all its values were handled
+	WB_LATENCY_CONTROL,				// computation of the new charge current
+	WB_LATENCY_SET,					// set request queued until its response was handled
+	WB_LATENCY_CYCLE,				// start of the period until the end of its work
+	WB_LATENCY_LATENESS,			// scheduled start of the period until its actual start
+	WB_LATENCY_COUNT
+};
+
+class RscpWallbox {
+public:
+	RscpWallbox();
+	/*
+	 * \brief Enable the control, the EMS power and wallbox responses are handled by the wallbox.
+	 */
+	void enable() {
+		m_bEnabled = true;
+	}
+	bool enabled() const {
+		return m_bEnabled;
+	}
+	/*
+	 * \brief Charge current range in A and the number of charging phases, values outside of
+	 *        WB_MIN_CURRENT..WB_MAX_CURRENT are limited to it.
+	 */
+	void setLimits(int minCurrent, int maxCurrent, int phases);
+	/*
+	 * \brief Without writes the control only reports the current it would set.
+	 */
+	void setDryRun(bool bDryRun) {
+		m_bDryRun = bDryRun;
+	}
+	bool dryRun() const {
+		return m_bDryRun;
+	}
+	/*
+	 * \brief Append the EMS power requests and the TAG_WB_REQ_DATA of wallbox 0.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createPoll(RscpBuilder & builder);
+	/*
+	 * \brief True for the response tags of the poll and the set request.
+	 */
+	static bool accepts(SRscpTag tag);
+	/*
+	 * \brief Handle a response value of the poll or the set request.
+	 * @return - RSCP::OK or RSCP::ERR_INVALID_INPUT for error values or malformed data
+	 */
+	int32_t handleValue(const SRscpValueRef & value);
+	/*
+	 * \brief Compute the charge current from the last polled values.
+	 * @return - true if the current changed and has to be set
+	 */
+	bool control();
+	/*
+	 * \brief Append the request which sets the charge current of the last control() call.
+	 * @return - RSCP::OK or an RSCP error code of the builder
+	 */
+	int32_t createSetCurrent(RscpBuilder & builder);
+	int current() const {
+		return m_iCurrent;
+	}
+	void record(eRscpWallboxLatency latency, uint64_t ns) {
+		m_latencies[latency].record(ns);
+	}
+	void countOverrun() {
+		m_uOverruns++;
+	}
+	/*
+	 * \brief Print the state of one control period.
+	 */
+	void printState(FILE *file) const;
+	/*
+	 * \brief Print the latency percentiles of the loop.
+	 */
+	void printLatencies(FILE *file) const;
+	static const char *latencyName(eRscpWallboxLatency latency);
+private:
+	bool m_bEnabled;
+	bool m_bDryRun;
+	int m_iMinCurrent;
+	int m_iMaxCurrent;
+	int m_iPhases;
+	// last polled values in W, grid power is positive for import
+	double m_fPvPower;
+	double m_fGridPower;
+	double m_fHomePower;
+	double m_fBatteryPower;
+	double m_fWallboxPower;
+	double m_fWallboxSolarPower;
+	double m_fWallboxPhasePower[3];
+	uint8_t m_ucStatus;
+	// charge current in A, 0 while charging is stopped
+	int m_iCurrent;
+	int m_iLowPeriods;
+	uint64_t m_uChanges;
+	uint64_t m_uOverruns;
+	RscpHistogram m_latencies[WB_LATENCY_COUNT];
+};
+
+#endif /* RSCPWALLBOX_H_ */
@@ -1,6 +1,9 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -9,6 +12,7 @@
 #include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <resolv.h>
+#include "SocketConnection.h"
 
 /*
  * This is a very simple example client socket connection.
@@ -16,26 +20,35 @@
  * A Microsoft Windows implementation is not supplied in this example.
  */
 
-int SocketConnect(const char *cpIpAddress, int iPort) {
-
-    unsigned char ucBuffer[sizeof(struct in6_addr)];
+static long elapsedUs(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000L;
+}
 
-    if(inet_pton(AF_INET, cpIpAddress, ucBuffer) <= 0) {
-        printf("IP address %s cannot be converted.\n", cpIpAddress);
-        return -1;
+static int connectErrorCode(int iErrno)
+{
+    switch (iErrno) {
+    case 0:
+    case ETIMEDOUT:
+        return SOCKET_ERR_TIMEOUT;
+    case ECONNREFUSED:
+        return SOCKET_ERR_REFUSED;
+    case ENETUNREACH:
+    case EHOSTUNREACH:
+    case EADDRNOTAVAIL:
+        return SOCKET_ERR_UNREACHABLE;
+    default:
+        return SOCKET_ERR_CONNECT;
     }
+}
 
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(iPort);
-    server_addr.sin_addr = *((struct in_addr *) ucBuffer);
-
-    int iSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if(iSocket < 0) {
-        printf("Cannot create socket. Error %i errno %i.\n", iSocket, errno);
-        return iSocket;
-    }
+static void setupSocketOptions(int iSocket)
+{
+    // switch back to blocking mode, the send and receive functions rely on the timeouts below
+    int flags = fcntl(iSocket, F_GETFL, 0);
+    fcntl(iSocket, F_SETFL, flags & ~O_NONBLOCK);
 
     // 3 secs receive timeout setup
     struct timeval tv;
@@ -49,19 +62,216 @@ int SocketConnect(const char *cpIpAddress, int iPort) {
 
     int enable = 1;
     setsockopt(iSocket, IPPROTO_TCP, TCP_NODELAY, (char *) &enable, sizeof(enable));
+}
 
+int SocketConnect(const char *cpHost, int iPort, int iTimeoutMs, SSocketConnectInfo *info)
+{
+    SSocketConnectInfo localInfo;
+    if(info == NULL) {
+        info = &localInfo;
+    }
+    memset(info, 0, sizeof(SSocketConnectInfo));
 
-    // wait 3 seconds for connection to get ready
-    int iRetries = 3;
-    if(connect(iSocket, (struct sockaddr *) &server_addr, sizeof(struct sockaddr)) < 0) {
-        printf("Cannot connect to server. errno %i.\n", errno);
-        close(iSocket);
-        return -1;
+    // sanity check
+    if((cpHost == NULL) || (iPort <= 0) || (iPort > 0xFFFF) || (iTimeoutMs <= 0)) {
+        return SOCKET_ERR_INVALID_INPUT;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // resolve host names and numeric IPv4 / IPv6 addresses
+    char cPort[8];
+    snprintf(cPort, sizeof(cPort), "%i", iPort);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_NUMERICSERV;
+    struct addrinfo *result = NULL;
+    int iGaiError = getaddrinfo(cpHost, cPort, &hints, &result);
+    info->lResolveUs = elapsedUs(&start);
+    if((iGaiError != 0) || (result == NULL)) {
+        info->iErrno = (iGaiError == EAI_SYSTEM) ? errno : 0;
+        return SOCKET_ERR_RESOLVE;
+    }
+
+    // interleave the address families, starting with the family the resolver prefers
+    struct addrinfo *addresses[SOCKET_CONNECT_MAX_ADDRESSES];
+    int iAddresses = 0;
+    int iPreferredFamily = result->ai_family;
+    for(int pass = 0; pass < SOCKET_CONNECT_MAX_ADDRESSES && iAddresses < SOCKET_CONNECT_MAX_ADDRESSES; pass++) {
+        struct addrinfo *preferred = NULL, *other = NULL;
+        int iPreferred = 0, iOther = 0;
+        for(struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+            if(ai->ai_family == iPreferredFamily) {
+                if(iPreferred++ == pass) preferred = ai;
+            }
+            else if(iOther++ == pass) {
+                other = ai;
+            }
+        }
+        if((preferred == NULL) && (other == NULL)) {
+            break;
+        }
+        if(preferred != NULL) {
+            addresses[iAddresses++] = preferred;
+        }
+        if((other != NULL) && (iAddresses < SOCKET_CONNECT_MAX_ADDRESSES)) {
+            addresses[iAddresses++] = other;
+        }
+    }
+    info->iAddresses = iAddresses;
+
+    // start the attempts staggered by SOCKET_CONNECT_ATTEMPT_DELAY_MS and wait for the first one to complete
+    struct pollfd pending[SOCKET_CONNECT_MAX_ADDRESSES];
+    struct addrinfo *pendingAddress[SOCKET_CONNECT_MAX_ADDRESSES];
+    int iPending = 0;
+    int iCreated = 0;
+    int iNext = 0;
+    int iSocket = -1;
+    struct addrinfo *connected = NULL;
+    long lNextAttemptUs = 0;
+    struct timespec connectStart;
+    clock_gettime(CLOCK_MONOTONIC, &connectStart);
+    long lDeadlineUs = (long) iTimeoutMs * 1000L;
+
+    while(iSocket < 0) {
+        long lNowUs = elapsedUs(&connectStart);
+        if(lNowUs >= lDeadlineUs) {
+            info->iErrno = ETIMEDOUT;
+            break;
+        }
+        // start the next attempt if its time has come or nothing is pending anymore
+        if((iNext < iAddresses) && ((iPending == 0) || (lNowUs >= lNextAttemptUs))) {
+            struct addrinfo *ai = addresses[iNext++];
+            info->iAttempts++;
+            lNextAttemptUs = lNowUs + SOCKET_CONNECT_ATTEMPT_DELAY_MS * 1000L;
+            int iNewSocket = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+            if(iNewSocket < 0) {
+                info->iErrno = errno;
+                continue;
+            }
+            iCreated++;
+            if(connect(iNewSocket, ai->ai_addr, ai->ai_addrlen) == 0) {
+                iSocket = iNewSocket;
+                connected = ai;
+                break;
+            }
+            if(errno != EINPROGRESS) {
+                info->iErrno = errno;
+                close(iNewSocket);
+                continue;
+            }
+            pending[iPending].fd = iNewSocket;
+            pending[iPending].events = POLLOUT;
+            pending[iPending].revents = 0;
+            pendingAddress[iPending] = ai;
+            iPending++;
+            continue;
+        }
+        if(iPending == 0) {
+            // all addresses failed
+            break;
+        }
+        // wait until an attempt completes, the next attempt is due or the deadline is reached
+        long lWaitUs = lDeadlineUs - lNowUs;
+        if((iNext < iAddresses) && (lNextAttemptUs - lNowUs < lWaitUs)) {
+            lWaitUs = lNextAttemptUs - lNowUs;
+        }
+        int iReady = poll(pending, iPending, (int) ((lWaitUs + 999) / 1000));
+        if(iReady < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            info->iErrno = errno;
+            break;
+        }
+        for(int i = 0; (i < iPending) && (iReady > 0); ) {
+            if(pending[i].revents == 0) {
+                i++;
+                continue;
+            }
+            int iSoError = 0;
+            socklen_t len = sizeof(iSoError);
+            if(getsockopt(pending[i].fd, SOL_SOCKET, SO_ERROR, &iSoError, &len) < 0) {
+                iSoError = errno;
+            }
+            if(iSoError == 0) {
+                iSocket = pending[i].fd;
+                connected = pendingAddress[i];
+            }
+            else {
+                info->iErrno = iSoError;
+                close(pending[i].fd);
+            }
+            // remove the completed attempt from the pending list
+            iPending--;
+            pending[i] = pending[iPending];
+            pendingAddress[i] = pendingAddress[iPending];
+            if(iSocket >= 0) {
+                break;
+            }
+        }
+    }
+
+    // close the attempts which lost the race
+    for(int i = 0; i < iPending; i++) {
+        close(pending[i].fd);
     }
 
+    if(iSocket < 0) {
+        freeaddrinfo(result);
+        if((iCreated == 0) && (info->iAttempts > 0)) {
+            return SOCKET_ERR_CREATE;
+        }
+        return connectErrorCode(info->iErrno);
+    }
+
+    info->lConnectUs = elapsedUs(&connectStart);
+    info->iErrno = 0;
+    info->iFamily = connected->ai_family;
+    if(connected->ai_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((struct sockaddr_in6 *) connected->ai_addr)->sin6_addr, info->cAddress, sizeof(info->cAddress));
+    }
+    else {
+        inet_ntop(AF_INET, &((struct sockaddr_in *) connected->ai_addr)->sin_addr, info->cAddress, sizeof(info->cAddress));
+    }
+    freeaddrinfo(result);
+
+    setupSocketOptions(iSocket);
+
     return iSocket;
 }
 
+int SocketConnect(const char *cpHost, int iPort)
+{
+    return SocketConnect(cpHost, iPort, SOCKET_CONNECT_TIMEOUT_MS, NULL);
+}
+
+const char *SocketErrorString(int iError)
+{
+    switch (iError) {
+    case SOCKET_ERR_INVALID_INPUT:
+        return "invalid input";
+    case SOCKET_ERR_RESOLVE:
+        return "host name cannot be resolved";
+    case SOCKET_ERR_CREATE:
+        return "cannot create socket";
+    case SOCKET_ERR_REFUSED:
+        return "connection refused";
+    case SOCKET_ERR_UNREACHABLE:
+        return "host unreachable";
+    case SOCKET_ERR_TIMEOUT:
+        return "connection timed out";
+    case SOCKET_ERR_CONNECT:
+        return "cannot connect to server";
+    default:
+        return "unknown error";
+    }
+}
+
 void SocketClose(int iSocket)
 {
     // sanity check
@@ -1,6 +1,9 @@
 #ifndef __SOCKET_CONNECTION_H_
 #define __SOCKET_CONNECTION_H_
 
+#include <netinet/in.h>
+#include <sys/uio.h>
+
 /*
  * This is a very simple example client socket connection.
  * Plain functions are used in this example instead of a well formed C++ class.
@@ -8,10 +11,127 @@
  * and the demonstration of the RSCP protocol which is not limited to TCP or Ethernet at all.
  */
 
-int SocketConnect(const char *cpIpAddress, int iPort);
+// default deadline for establishing a connection (all addresses together)
+#define SOCKET_CONNECT_TIMEOUT_MS       3000
+// delay before the next address is tried while earlier attempts are still pending (RFC 8305)
+#define SOCKET_CONNECT_ATTEMPT_DELAY_MS 250
+// maximum number of resolved addresses which are tried
+#define SOCKET_CONNECT_MAX_ADDRESSES    8
+
+/*
+ * Error codes returned by SocketConnect() instead of a socket descriptor.
+ * The errno of the last failed attempt is stored in SSocketConnectInfo::iErrno.
+ */
+enum eSocketErrorCodes {
+    SOCKET_ERR_INVALID_INPUT    = -1,
+    SOCKET_ERR_RESOLVE          = -2,
+    SOCKET_ERR_CREATE           = -3,
+    SOCKET_ERR_REFUSED          = -4,
+    SOCKET_ERR_UNREACHABLE      = -5,
+    SOCKET_ERR_TIMEOUT          = -6,
+    SOCKET_ERR_CONNECT          = -7
+};
+
+/*
+ * Result details of a SocketConnect() call, all times are measured with CLOCK_MONOTONIC.
+ */
+struct SSocketConnectInfo {
+    int  iErrno;                        // errno of the last failed system call, 0 on success
+    int  iAddresses;                    // number of resolved addresses tried, at most SOCKET_CONNECT_MAX_ADDRESSES
+    int  iAttempts;                     // number of connection attempts started
+    int  iFamily;                       // address family of the established connection
+    long lResolveUs;                    // time spent in name resolution
+    long lConnectUs;                    // time from the first attempt until the connection was established
+    char cAddress[INET6_ADDRSTRLEN];    // numeric address of the established connection
+};
+
+/*
+ * \brief Connect to \var cpHost which can be a host name, an IPv4 or an IPv6 address.
+ *        All resolved addresses are tried interleaved by family with non-blocking sockets,
+ *        the first connection which gets established is returned and all others are closed.
+ * @param cpHost     - Host name or numeric address
+ * @param iPort      - TCP port
+ * @param iTimeoutMs - Deadline in milliseconds for the whole connect procedure
+ * @param info       - Optional pointer which receives error and timing details
+ * @return           - Socket descriptor on success else one of eSocketErrorCodes
+ */
+int SocketConnect(const char *cpHost, int iPort, int iTimeoutMs, SSocketConnectInfo *info);
+int SocketConnect(const char *cpHost, int iPort);
+/*
+ * \brief Return a human readable description of an eSocketErrorCodes value.
+ */
+const char *SocketErrorString(int iError);
 void SocketClose(int iSocket);
 int SocketSendData(int iSocket, const unsigned char * ucBuffer, int iLength);
 int SocketRecvData(int iSocket, unsigned char * ucBuffer, int iLength);
 
+/*
+ * Batched transport for many sockets (see SocketTransport.cpp).
+ * Send and receive operations of all sessions are queued and handed to the kernel together with
+ * SocketSubmit(), which then waits for completions. With the io_uring backend this is a single
+ * io_uring_enter() per scheduler tick, the epoll backend is used where io_uring is not available.
+ * Buffers passed to the queue functions must stay valid until their completion was returned.
+ */
+enum eSocketBackend {
+    SOCKET_BACKEND_EPOLL        = 0,
+    SOCKET_BACKEND_IO_URING     = 1
+};
+
+// maximum number of buffers of one SocketQueueSendv() call
+#define SOCKET_MAX_IOV                  8
+// SocketQueueSendv() flag: more data follows soon, the kernel may hold back a partial segment (MSG_MORE)
+#define SOCKET_SEND_MORE                0x01
+
+enum eSocketOperation {
+    SOCKET_OP_SEND              = 0,
+    SOCKET_OP_RECV              = 1
+};
+
+struct SSocketCompletion {
+    int   iSocket;                      // socket the operation was queued for
+    int   iOperation;                   // one of eSocketOperation
+    int   iResult;                      // transferred bytes, 0 if the peer closed the connection or -errno
+    void *pUser;                        // user pointer given when the operation was queued
+};
+
+/*
+ * \brief Initialize the transport for up to \var iMaxSockets sockets with one pending receive and one pending send each.
+ * @return - The backend which is used, SOCKET_BACKEND_EPOLL if io_uring was requested but is not available, or -errno.
+ */
+int SocketTransportInit(int iBackend, int iMaxSockets);
+void SocketTransportClose();
+int SocketTransportBackend();
+const char *SocketBackendName(int iBackend);
+/*
+ * \brief Register a receive buffer in the io_uring fixed buffer table, which has one slot per socket and is
+ *        shared by all sessions. Receives into the buffer use IORING_OP_READ_FIXED and avoid the page
+ *        pinning of every operation. Registering a buffer again does nothing.
+ * @return - 0, -ENOBUFS if all slots are used or -EOPNOTSUPP for the epoll backend and kernels without
+ *           sparse buffer tables, the receives still work without registration
+ */
+int SocketRegisterBuffer(unsigned char *ucBuffer, int iLength);
+/*
+ * \brief Release the slot of \var ucBuffer, must be called before the buffer is freed.
+ */
+void SocketUnregisterBuffer(unsigned char *ucBuffer);
+int SocketQueueSend(int iSocket, const unsigned char *ucBuffer, int iLength, void *pUser);
+/*
+ * \brief Queue a gather send of up to SOCKET_MAX_IOV buffers which is handed to the kernel with a single
+ *        sendmsg() (IORING_OP_SENDMSG with io_uring). The completion reports the total amount of bytes.
+ * @param iFlags - 0 or SOCKET_SEND_MORE
+ */
+int SocketQueueSendv(int iSocket, const struct iovec *iov, int iCount, int iFlags, void *pUser);
+int SocketQueueRecv(int iSocket, unsigned char *ucBuffer, int iLength, void *pUser);
+/*
+ * \brief Cancel all queued or pending operations of \var iSocket. Must be called before the socket is closed.
+ */
+void SocketCancel(int iSocket);
+/*
+ * \brief Hand all queued operations to the kernel and wait up to \var iTimeoutMs for completions.
+ *        Sends are only completed when all bytes were transferred.
+ * @return - Number of completions stored in \var completions, 0 on timeout or -errno.
+ */
+int SocketSubmit(SSocketCompletion *completions, int iMaxCompletions, int iTimeoutMs);
+
 
  #endif // __SOCKET_CONNECTION_H_
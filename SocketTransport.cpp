@@ -0,0 +1,831 @@
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <vector>
+#include "SocketConnection.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+
+/*
+ * Batched socket transport with an io_uring backend and an epoll fallback.
+ * The io_uring ring is driven with the raw system calls so no additional library is needed.
+ */
+
+namespace { // anonymous namespace for local linkage
+
+struct SSocketOp {
+    int iSocket;
+    int iOperation;
+    unsigned char *ucBuffer;
+    int iLength;
+    int iDone;                          // bytes already sent for partially completed sends
+    struct iovec iov[SOCKET_MAX_IOV];   // send buffers, advanced by partial sends
+    int iFirstIov;
+    int iIovCount;
+    int iSendFlags;
+    struct msghdr msg;
+    int iFixedIndex;                    // slot of the registered buffer which holds the receive buffer or -1
+    bool bInUse;
+    bool bSubmitted;                    // handed to the kernel
+    bool bCancelled;                    // completion is dropped
+    void *pUser;
+};
+
+int iBackend = -1;
+std::vector<SSocketOp> vecOps;
+std::vector<int> vecFreeOps;
+std::vector<int> vecQueued;
+std::vector<SSocketCompletion> vecReady;
+
+// epoll backend state
+int iEpoll = -1;
+std::vector<int> vecRecvOpByFd;
+std::vector<char> vecEpollAdded;
+
+#ifdef HAVE_IO_URING
+// user_data of cancel requests, their completions are ignored
+const uint64_t CANCEL_USER_DATA = ~0ULL;
+// maximum number of registered buffers of a ring (IORING_MAX_REG_BUFFERS)
+const int FIXED_MAX_BUFFERS = 1 << 14;
+
+// the sparse fixed buffer table of the ring shared by all sessions, a NULL base marks a free slot
+std::vector<struct iovec> vecFixedBuffers;
+
+struct SUring {
+    int fd;
+    unsigned entries;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    void *sqPtr;
+    size_t sqSize;
+    void *cqPtr;
+    size_t cqSize;
+    size_t sqesSize;
+    unsigned toSubmit;
+    unsigned inFlight;
+};
+
+// the state of a ring which is not set up
+SUring closedRing()
+{
+    SUring closed;
+    memset(&closed, 0, sizeof(closed));
+    closed.fd = -1;
+    return closed;
+}
+
+SUring ring = closedRing();
+#endif
+
+long remainingMs(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (deadline->tv_sec - now.tv_sec) * 1000L + (deadline->tv_nsec - now.tv_nsec) / 1000000L;
+    return (ms < 0) ? 0 : ms;
+}
+
+int allocOp()
+{
+    if(vecFreeOps.empty()) {
+        return -1;
+    }
+    int idx = vecFreeOps.back();
+    vecFreeOps.pop_back();
+    memset(&vecOps[idx], 0, sizeof(SSocketOp));
+    vecOps[idx].bInUse = true;
+    vecOps[idx].iFixedIndex = -1;
+    return idx;
+}
+
+void freeOp(int idx)
+{
+    vecOps[idx].bInUse = false;
+    vecFreeOps.push_back(idx);
+}
+
+void completeOp(int idx, int iResult)
+{
+    SSocketOp & op = vecOps[idx];
+    if(!op.bCancelled) {
+        SSocketCompletion completion;
+        completion.iSocket = op.iSocket;
+        completion.iOperation = op.iOperation;
+        completion.iResult = iResult;
+        completion.pUser = op.pUser;
+        vecReady.push_back(completion);
+    }
+    freeOp(idx);
+}
+
+int queueRecv(int iSocket, unsigned char *ucBuffer, int iLength, void *pUser)
+{
+    if(iBackend < 0) {
+        return -EINVAL;
+    }
+    if((iSocket < 0) || (ucBuffer == NULL) || (iLength <= 0)) {
+        return -EINVAL;
+    }
+    int idx = allocOp();
+    if(idx < 0) {
+        return -ENOBUFS;
+    }
+    SSocketOp & op = vecOps[idx];
+    op.iSocket = iSocket;
+    op.iOperation = SOCKET_OP_RECV;
+    op.ucBuffer = ucBuffer;
+    op.iLength = iLength;
+    op.pUser = pUser;
+#ifdef HAVE_IO_URING
+    for(size_t i = 0; i < vecFixedBuffers.size(); i++) {
+        unsigned char *base = (unsigned char *) vecFixedBuffers[i].iov_base;
+        if((base != NULL) && (ucBuffer >= base) && (ucBuffer + iLength <= base + vecFixedBuffers[i].iov_len)) {
+            op.iFixedIndex = i;
+            break;
+        }
+    }
+#endif
+    vecQueued.push_back(idx);
+    return 0;
+}
+
+int queueSend(int iSocket, const struct iovec *iov, int iCount, int iFlags, void *pUser)
+{
+    if(iBackend < 0) {
+        return -EINVAL;
+    }
+    if((iSocket < 0) || (iov == NULL) || (iCount <= 0) || (iCount > SOCKET_MAX_IOV)) {
+        return -EINVAL;
+    }
+    long lLength = 0;
+    for(int i = 0; i < iCount; i++) {
+        if(iov[i].iov_base == NULL) {
+            return -EINVAL;
+        }
+        lLength += iov[i].iov_len;
+    }
+    if((lLength <= 0) || (lLength > 0x7FFFFFFF)) {
+        return -EINVAL;
+    }
+    int idx = allocOp();
+    if(idx < 0) {
+        return -ENOBUFS;
+    }
+    SSocketOp & op = vecOps[idx];
+    op.iSocket = iSocket;
+    op.iOperation = SOCKET_OP_SEND;
+    op.iLength = lLength;
+    memcpy(op.iov, iov, iCount * sizeof(struct iovec));
+    op.iIovCount = iCount;
+    op.iSendFlags = MSG_NOSIGNAL | ((iFlags & SOCKET_SEND_MORE) ? MSG_MORE : 0);
+    op.pUser = pUser;
+    vecQueued.push_back(idx);
+    return 0;
+}
+
+// skip the bytes of a partial send and point the message header to the remaining buffers
+void advanceSend(SSocketOp & op, int iBytes)
+{
+    op.iDone += iBytes;
+    while((iBytes > 0) && (op.iFirstIov < op.iIovCount)) {
+        struct iovec & iov = op.iov[op.iFirstIov];
+        if((size_t) iBytes < iov.iov_len) {
+            iov.iov_base = (unsigned char *) iov.iov_base + iBytes;
+            iov.iov_len -= iBytes;
+            break;
+        }
+        iBytes -= iov.iov_len;
+        op.iFirstIov++;
+    }
+}
+
+struct msghdr *sendMessage(SSocketOp & op)
+{
+    memset(&op.msg, 0, sizeof(op.msg));
+    op.msg.msg_iov = &op.iov[op.iFirstIov];
+    op.msg.msg_iovlen = op.iIovCount - op.iFirstIov;
+    return &op.msg;
+}
+
+size_t takeReady(SSocketCompletion *completions, int iMaxCompletions)
+{
+    size_t n = vecReady.size();
+    if(n > (size_t) iMaxCompletions) {
+        n = iMaxCompletions;
+    }
+    memcpy(completions, &vecReady[0], n * sizeof(SSocketCompletion));
+    vecReady.erase(vecReady.begin(), vecReady.begin() + n);
+    return n;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// epoll backend
+//---------------------------------------------------------------------------------------------------------
+int epollInit()
+{
+    iEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if(iEpoll < 0) {
+        return -errno;
+    }
+    return SOCKET_BACKEND_EPOLL;
+}
+
+void epollClose()
+{
+    if(iEpoll >= 0) {
+        close(iEpoll);
+        iEpoll = -1;
+    }
+    vecRecvOpByFd.clear();
+    vecEpollAdded.clear();
+}
+
+int epollArm(int idx)
+{
+    int fd = vecOps[idx].iSocket;
+    if((size_t) fd >= vecRecvOpByFd.size()) {
+        vecRecvOpByFd.resize(fd + 1, -1);
+        vecEpollAdded.resize(fd + 1, 0);
+    }
+    vecRecvOpByFd[fd] = idx;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.fd = fd;
+    int iResult = epoll_ctl(iEpoll, vecEpollAdded[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    if((iResult < 0) && (errno == ENOENT)) {
+        // the socket was closed without SocketCancel() and the descriptor got reused
+        iResult = epoll_ctl(iEpoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+    if(iResult < 0) {
+        vecRecvOpByFd[fd] = -1;
+        return -errno;
+    }
+    vecEpollAdded[fd] = 1;
+    return 0;
+}
+
+int epollSubmit(SSocketCompletion *completions, int iMaxCompletions, int iTimeoutMs)
+{
+    // sends are done right away, receives are armed in the epoll set
+    for(size_t i = 0; i < vecQueued.size(); i++) {
+        int idx = vecQueued[i];
+        SSocketOp & op = vecOps[idx];
+        if(op.iOperation == SOCKET_OP_SEND) {
+            int iResult = op.iLength;
+            while(op.iDone < op.iLength) {
+                int result = sendmsg(op.iSocket, sendMessage(op), op.iSendFlags);
+                if(result <= 0) {
+                    iResult = (result < 0) ? -errno : -EPIPE;
+                    break;
+                }
+                advanceSend(op, result);
+            }
+            completeOp(idx, iResult);
+        }
+        else {
+            int iResult = epollArm(idx);
+            if(iResult < 0) {
+                completeOp(idx, iResult);
+            }
+        }
+    }
+    vecQueued.clear();
+
+    struct epoll_event events[64];
+    int iWaitMs = vecReady.empty() ? iTimeoutMs : 0;
+    int iEvents = epoll_wait(iEpoll, events, sizeof(events) / sizeof(events[0]), iWaitMs);
+    if(iEvents < 0) {
+        if(!vecReady.empty()) {
+            return takeReady(completions, iMaxCompletions);
+        }
+        return -errno;
+    }
+    for(int i = 0; i < iEvents; i++) {
+        int fd = events[i].data.fd;
+        int idx = vecRecvOpByFd[fd];
+        if(idx < 0) {
+            continue;
+        }
+        SSocketOp & op = vecOps[idx];
+        int result = recv(fd, op.ucBuffer, op.iLength, MSG_DONTWAIT);
+        if((result < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            // spurious wakeup, wait again
+            epollArm(idx);
+            continue;
+        }
+        vecRecvOpByFd[fd] = -1;
+        completeOp(idx, (result < 0) ? -errno : result);
+    }
+    return takeReady(completions, iMaxCompletions);
+}
+
+void epollCancel(int iSocket)
+{
+    if(((size_t) iSocket < vecRecvOpByFd.size()) && (vecRecvOpByFd[iSocket] >= 0)) {
+        freeOp(vecRecvOpByFd[iSocket]);
+        vecRecvOpByFd[iSocket] = -1;
+    }
+    if(((size_t) iSocket < vecEpollAdded.size()) && vecEpollAdded[iSocket]) {
+        epoll_ctl(iEpoll, EPOLL_CTL_DEL, iSocket, NULL);
+        vecEpollAdded[iSocket] = 0;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------------
+// io_uring backend
+//---------------------------------------------------------------------------------------------------------
+#ifdef HAVE_IO_URING
+int uringEnter(unsigned toSubmit, unsigned minComplete, int iTimeoutMs)
+{
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void *argp = NULL;
+    size_t argsz = 0;
+    if(minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        memset(&arg, 0, sizeof(arg));
+        ts.tv_sec = iTimeoutMs / 1000;
+        ts.tv_nsec = (iTimeoutMs % 1000) * 1000000L;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+    int iResult = syscall(__NR_io_uring_enter, ring.fd, toSubmit, minComplete, flags, argp, argsz);
+    if(iResult < 0) {
+        return -errno;
+    }
+    ring.toSubmit -= iResult;
+    return iResult;
+}
+
+struct io_uring_sqe *uringGetSqe()
+{
+    unsigned head = __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring.sqTail;
+    if(tail - head >= ring.entries) {
+        // submission queue is full, hand the queued entries to the kernel first
+        if(uringEnter(ring.toSubmit, 0, 0) < 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE);
+        if(tail - head >= ring.entries) {
+            return NULL;
+        }
+    }
+    unsigned index = tail & *ring.sqMask;
+    struct io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring.toSubmit++;
+    return sqe;
+}
+
+void uringClose()
+{
+    if(ring.sqesSize) {
+        munmap(ring.sqes, ring.sqesSize);
+    }
+    if(ring.cqPtr && (ring.cqPtr != ring.sqPtr)) {
+        munmap(ring.cqPtr, ring.cqSize);
+    }
+    if(ring.sqPtr) {
+        munmap(ring.sqPtr, ring.sqSize);
+    }
+    if(ring.fd >= 0) {
+        // the registered buffers are released with the ring
+        close(ring.fd);
+    }
+    ring = closedRing();
+    vecFixedBuffers.clear();
+}
+
+// an empty table of one slot per socket, SocketRegisterBuffer() fills the slots (Linux 5.19)
+void uringRegisterTable(int iMaxSockets)
+{
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = (iMaxSockets < FIXED_MAX_BUFFERS) ? iMaxSockets : FIXED_MAX_BUFFERS;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if(syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS2, &reg, sizeof(reg)) == 0) {
+        struct iovec empty = { NULL, 0 };
+        vecFixedBuffers.assign(reg.nr, empty);
+    }
+}
+
+// replace the buffer of a slot of the table, an empty buffer clears the slot
+int uringUpdateBuffer(int iSlot, unsigned char *ucBuffer, int iLength)
+{
+    struct iovec iov;
+    iov.iov_base = ucBuffer;
+    iov.iov_len = iLength;
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = iSlot;
+    update.data = (uint64_t) (uintptr_t) &iov;
+    update.nr = 1;
+    if(syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) < 0) {
+        return -errno;
+    }
+    vecFixedBuffers[iSlot] = iov;
+    return 0;
+}
+
+int uringInit(int iMaxSockets)
+{
+    unsigned entries = 8;
+    while((entries < (unsigned) iMaxSockets * 2) && (entries < 32768)) {
+        entries <<= 1;
+    }
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(ring.fd < 0) {
+        ring.fd = -1;
+        return -errno;
+    }
+    // the timeout of SocketSubmit needs IORING_ENTER_EXT_ARG (Linux 5.11)
+    if(!(params.features & IORING_FEAT_EXT_ARG)) {
+        uringClose();
+        return -ENOSYS;
+    }
+    ring.entries = params.sq_entries;
+    ring.sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(ring.cqSize > ring.sqSize) {
+            ring.sqSize = ring.cqSize;
+        }
+        ring.cqSize = ring.sqSize;
+    }
+    ring.sqPtr = mmap(NULL, ring.sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if(ring.sqPtr == MAP_FAILED) {
+        ring.sqPtr = NULL;
+        uringClose();
+        return -ENOMEM;
+    }
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.cqPtr = ring.sqPtr;
+    }
+    else {
+        ring.cqPtr = mmap(NULL, ring.cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+        if(ring.cqPtr == MAP_FAILED) {
+            ring.cqPtr = NULL;
+            uringClose();
+            return -ENOMEM;
+        }
+    }
+    ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = (struct io_uring_sqe *) mmap(NULL, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if(ring.sqes == MAP_FAILED) {
+        ring.sqes = NULL;
+        ring.sqesSize = 0;
+        uringClose();
+        return -ENOMEM;
+    }
+    uint8_t *sq = (uint8_t *) ring.sqPtr;
+    uint8_t *cq = (uint8_t *) ring.cqPtr;
+    ring.sqHead = (unsigned *) (sq + params.sq_off.head);
+    ring.sqTail = (unsigned *) (sq + params.sq_off.tail);
+    ring.sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring.sqArray = (unsigned *) (sq + params.sq_off.array);
+    ring.cqHead = (unsigned *) (cq + params.cq_off.head);
+    ring.cqTail = (unsigned *) (cq + params.cq_off.tail);
+    ring.cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    // without the table the receives use IORING_OP_RECV
+    uringRegisterTable(iMaxSockets);
+    return SOCKET_BACKEND_IO_URING;
+}
+
+int uringPrepare(int idx)
+{
+    SSocketOp & op = vecOps[idx];
+    struct io_uring_sqe *sqe = uringGetSqe();
+    if(sqe == NULL) {
+        return -EBUSY;
+    }
+    sqe->fd = op.iSocket;
+    sqe->user_data = idx;
+    if(op.iOperation == SOCKET_OP_SEND) {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t) (uintptr_t) sendMessage(op);
+        sqe->len = 1;
+        sqe->msg_flags = op.iSendFlags;
+    }
+    else if(op.iFixedIndex >= 0) {
+        // the pages of the registered buffer are already pinned, the offset of a socket read is 0
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t) (uintptr_t) op.ucBuffer;
+        sqe->len = op.iLength;
+        sqe->buf_index = op.iFixedIndex;
+    }
+    else {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = (uint64_t) (uintptr_t) op.ucBuffer;
+        sqe->len = op.iLength;
+    }
+    op.bSubmitted = true;
+    ring.inFlight++;
+    return 0;
+}
+
+// collect all available completions, returns true if a partial send was re-queued
+bool uringReap()
+{
+    bool bRequeued = false;
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+        struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+        head++;
+        if(cqe->user_data == CANCEL_USER_DATA) {
+            continue;
+        }
+        int idx = (int) cqe->user_data;
+        SSocketOp & op = vecOps[idx];
+        ring.inFlight--;
+        op.bSubmitted = false;
+        if((op.iOperation == SOCKET_OP_SEND) && (cqe->res > 0) && !op.bCancelled) {
+            advanceSend(op, cqe->res);
+            if(op.iDone < op.iLength) {
+                vecQueued.push_back(idx);
+                bRequeued = true;
+                continue;
+            }
+            completeOp(idx, op.iLength);
+        }
+        else {
+            completeOp(idx, (op.iOperation == SOCKET_OP_SEND && cqe->res == 0) ? -EPIPE : cqe->res);
+        }
+    }
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    return bRequeued;
+}
+
+int uringSubmit(SSocketCompletion *completions, int iMaxCompletions, int iTimeoutMs)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += iTimeoutMs / 1000;
+    deadline.tv_nsec += (iTimeoutMs % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    do {
+        for(size_t i = 0; i < vecQueued.size(); i++) {
+            int iResult = uringPrepare(vecQueued[i]);
+            if(iResult < 0) {
+                completeOp(vecQueued[i], iResult);
+            }
+        }
+        vecQueued.clear();
+
+        // submit everything and wait in the same system call
+        unsigned minComplete = (vecReady.empty() && ring.inFlight) ? 1 : 0;
+        if(ring.toSubmit || minComplete) {
+            int iResult = uringEnter(ring.toSubmit, minComplete, remainingMs(&deadline));
+            if((iResult < 0) && (iResult != -ETIME)) {
+                if(iResult == -EINTR) {
+                    uringReap();
+                }
+                if(vecReady.empty()) {
+                    return iResult;
+                }
+            }
+        }
+        uringReap();
+    } while(vecReady.empty() && (!vecQueued.empty() || ring.inFlight) && (remainingMs(&deadline) > 0));
+
+    return takeReady(completions, iMaxCompletions);
+}
+
+void uringCancel(int iSocket)
+{
+    unsigned pending = 0;
+    for(size_t i = 0; i < vecOps.size(); i++) {
+        SSocketOp & op = vecOps[i];
+        if(op.bInUse && op.bSubmitted && (op.iSocket == iSocket)) {
+            op.bCancelled = true;
+            struct io_uring_sqe *sqe = uringGetSqe();
+            if(sqe == NULL) {
+                continue;
+            }
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = i;
+            sqe->user_data = CANCEL_USER_DATA;
+            pending++;
+        }
+    }
+    if(pending == 0) {
+        return;
+    }
+    // the buffers of the cancelled operations must not be touched by the kernel anymore when returning
+    uringEnter(ring.toSubmit, 0, 0);
+    for(int retry = 0; retry < 100; retry++) {
+        uringReap();
+        bool bOutstanding = false;
+        for(size_t i = 0; i < vecOps.size(); i++) {
+            if(vecOps[i].bInUse && vecOps[i].bSubmitted && (vecOps[i].iSocket == iSocket)) {
+                bOutstanding = true;
+                break;
+            }
+        }
+        if(!bOutstanding) {
+            break;
+        }
+        uringEnter(0, 1, 10);
+    }
+}
+#endif
+
+}// end of anonymous namespace
+
+int SocketTransportInit(int iRequestedBackend, int iMaxSockets)
+{
+    if(iBackend >= 0) {
+        SocketTransportClose();
+    }
+    if(iMaxSockets <= 0) {
+        return -EINVAL;
+    }
+    // one send and one receive per socket plus some reserve for partially completed operations
+    size_t ops = iMaxSockets * 2 + 16;
+    vecOps.assign(ops, SSocketOp());
+    vecFreeOps.clear();
+    for(size_t i = ops; i > 0; i--) {
+        vecFreeOps.push_back(i - 1);
+    }
+    vecQueued.reserve(ops);
+    vecReady.reserve(ops);
+
+    int iResult = -ENOSYS;
+#ifdef HAVE_IO_URING
+    if(iRequestedBackend == SOCKET_BACKEND_IO_URING) {
+        iResult = uringInit(iMaxSockets);
+    }
+#endif
+    if(iResult < 0) {
+        iResult = epollInit();
+    }
+    iBackend = (iResult < 0) ? -1 : iResult;
+    return iResult;
+}
+
+void SocketTransportClose()
+{
+#ifdef HAVE_IO_URING
+    if(iBackend == SOCKET_BACKEND_IO_URING) {
+        uringClose();
+    }
+#endif
+    epollClose();
+    iBackend = -1;
+    vecOps.clear();
+    vecFreeOps.clear();
+    vecQueued.clear();
+    vecReady.clear();
+}
+
+int SocketTransportBackend()
+{
+    return iBackend;
+}
+
+const char *SocketBackendName(int iBackend)
+{
+    switch (iBackend) {
+    case SOCKET_BACKEND_EPOLL:
+        return "epoll";
+    case SOCKET_BACKEND_IO_URING:
+        return "io_uring";
+    default:
+        return "none";
+    }
+}
+
+int SocketRegisterBuffer(unsigned char *ucBuffer, int iLength)
+{
+    if((ucBuffer == NULL) || (iLength <= 0)) {
+        return -EINVAL;
+    }
+#ifdef HAVE_IO_URING
+    if((iBackend == SOCKET_BACKEND_IO_URING) && !vecFixedBuffers.empty()) {
+        int iFree = -1;
+        for(size_t i = 0; i < vecFixedBuffers.size(); i++) {
+            if(vecFixedBuffers[i].iov_base == ucBuffer) {
+                return 0;
+            }
+            if((iFree < 0) && (vecFixedBuffers[i].iov_base == NULL)) {
+                iFree = i;
+            }
+        }
+        if(iFree < 0) {
+            return -ENOBUFS;
+        }
+        return uringUpdateBuffer(iFree, ucBuffer, iLength);
+    }
+#endif
+    return -EOPNOTSUPP;
+}
+
+void SocketUnregisterBuffer(unsigned char *ucBuffer)
+{
+#ifdef HAVE_IO_URING
+    for(size_t i = 0; i < vecFixedBuffers.size(); i++) {
+        if((ucBuffer != NULL) && (vecFixedBuffers[i].iov_base == ucBuffer)) {
+            uringUpdateBuffer(i, NULL, 0);
+            return;
+        }
+    }
+#else
+    (void) ucBuffer;
+#endif
+}
+
+int SocketQueueSend(int iSocket, const unsigned char *ucBuffer, int iLength, void *pUser)
+{
+    struct iovec iov;
+    iov.iov_base = (void *) ucBuffer;
+    iov.iov_len = (iLength > 0) ? iLength : 0;
+    return queueSend(iSocket, &iov, 1, 0, pUser);
+}
+
+int SocketQueueSendv(int iSocket, const struct iovec *iov, int iCount, int iFlags, void *pUser)
+{
+    return queueSend(iSocket, iov, iCount, iFlags, pUser);
+}
+
+int SocketQueueRecv(int iSocket, unsigned char *ucBuffer, int iLength, void *pUser)
+{
+    return queueRecv(iSocket, ucBuffer, iLength, pUser);
+}
+
+void SocketCancel(int iSocket)
+{
+    if(iBackend < 0) {
+        return;
+    }
+    // operations which were not handed to the kernel yet are just dropped
+    for(size_t i = 0; i < vecQueued.size(); ) {
+        if(vecOps[vecQueued[i]].iSocket == iSocket) {
+            freeOp(vecQueued[i]);
+            vecQueued.erase(vecQueued.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+#ifdef HAVE_IO_URING
+    if(iBackend == SOCKET_BACKEND_IO_URING) {
+        uringCancel(iSocket);
+    }
+#endif
+    if(iBackend == SOCKET_BACKEND_EPOLL) {
+        epollCancel(iSocket);
+    }
+    // completions which were not returned yet refer to the socket as well
+    for(size_t i = 0; i < vecReady.size(); ) {
+        if(vecReady[i].iSocket == iSocket) {
+            vecReady.erase(vecReady.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+int SocketSubmit(SSocketCompletion *completions, int iMaxCompletions, int iTimeoutMs)
+{
+    if((iBackend < 0) || (completions == NULL) || (iMaxCompletions <= 0)) {
+        return -EINVAL;
+    }
+    if(iTimeoutMs < 0) {
+        iTimeoutMs = 0;
+    }
+#ifdef HAVE_IO_URING
+    if(iBackend == SOCKET_BACKEND_IO_URING) {
+        return uringSubmit(completions, iMaxCompletions, iTimeoutMs);
+    }
+#endif
+    return epollSubmit(completions, iMaxCompletions, iTimeoutMs);
+}
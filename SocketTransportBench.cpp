@@ -0,0 +1,343 @@
+/*
+ * SocketTransportBench.cpp
+ *
+ * Localhost benchmark of the socket transport backends. A number of sessions is connected to the
+ * RSCP mock server (rscp-mock) and each scheduler tick sends one request frame on every session
+ * and waits until all responses were received. Throughput, tick latency and CPU time are reported
+ * so that the epoll and io_uring backends can be compared with the same workload.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <algorithm>
+#include <vector>
+#include <sys/resource.h>
+#include "e3dc_config.h"
+#include "RscpProtocol.h"
+#include "RscpTags.h"
+#include "SocketConnection.h"
+#include "RscpSession.h"
+
+#define BENCH_MAX_COMPLETIONS   256
+
+typedef struct {
+    char server_ip[128];
+    int  server_port;
+    char aes_password[128];
+    char user[128];
+    char password[128];
+    int  sessions;
+    int  cycles;
+    int  backend;
+}bench_config_t;
+
+typedef struct {
+    int  iAuthenticated;
+    long lFrames;
+    long lValues;
+}bench_session_t;
+
+static bench_config_t bench_config;
+
+static long monotonicUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000L;
+}
+
+static long timevalUs(const struct timeval & tv)
+{
+    return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+static int32_t handleBenchFrame(RscpSession * session, const uint8_t * data,
+				uint32_t length, void * /* context */)
+{
+    RscpProtocol protocol;
+    SRscpFrame frame;
+    int iResult = protocol.parseFrame(data, length, &frame);
+    if (iResult < 0) {
+	// check if frame length error occured
+	// in that case the full frame length was not received yet
+	// and the receive function must get more data
+	if (iResult == RSCP::ERR_INVALID_FRAME_LENGTH)
+	    return 0;
+	return iResult;
+    }
+    bench_session_t *state = (bench_session_t *) session->user;
+    for (size_t i = 0; i < frame.data.size(); i++) {
+	if (frame.data[i].tag == TAG_RSCP_AUTHENTICATION)
+	    state->iAuthenticated = protocol.getValueAsUChar8(&frame.data[i]);
+    }
+    state->lFrames++;
+    state->lValues += frame.data.size();
+    protocol.destroyFrameData(frame);
+    return iResult;
+}
+
+static void createBenchAuthRequest(SRscpFrameBuffer * frameBuffer)
+{
+    RscpProtocol protocol;
+    SRscpValue rootValue;
+    protocol.createContainerValue(&rootValue, 0);
+    SRscpValue authenContainer;
+    protocol.createContainerValue(&authenContainer, TAG_RSCP_REQ_AUTHENTICATION);
+    protocol.appendValue(&authenContainer, TAG_RSCP_AUTHENTICATION_USER, bench_config.user);
+    protocol.appendValue(&authenContainer, TAG_RSCP_AUTHENTICATION_PASSWORD, bench_config.password);
+    protocol.appendValue(&rootValue, authenContainer);
+    protocol.destroyValueData(authenContainer);
+    protocol.createFrameAsBuffer(frameBuffer, rootValue.data, rootValue.length, true);
+    protocol.destroyValueData(rootValue);
+}
+
+// same request as the main example with the EMS and the battery data enabled
+static void createBenchRequest(SRscpFrameBuffer * frameBuffer)
+{
+    RscpProtocol protocol;
+    SRscpValue rootValue;
+    protocol.createContainerValue(&rootValue, 0);
+    protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_PV);
+    protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_BAT);
+    protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_HOME);
+    protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_GRID);
+    protocol.appendValue(&rootValue, TAG_EMS_REQ_POWER_ADD);
+    SRscpValue batteryContainer;
+    protocol.createContainerValue(&batteryContainer, TAG_BAT_REQ_DATA);
+    protocol.appendValue(&batteryContainer, TAG_BAT_INDEX, (uint16_t) 0);
+    protocol.appendValue(&batteryContainer, TAG_BAT_REQ_RSOC);
+    protocol.appendValue(&batteryContainer, TAG_BAT_REQ_MODULE_VOLTAGE);
+    protocol.appendValue(&batteryContainer, TAG_BAT_REQ_CURRENT);
+    protocol.appendValue(&rootValue, batteryContainer);
+    protocol.destroyValueData(batteryContainer);
+    protocol.createFrameAsBuffer(frameBuffer, rootValue.data, rootValue.length, true);
+    protocol.destroyValueData(rootValue);
+}
+
+/*
+ * \brief Queue \var frameBuffer on all sessions and dispatch completions until every session received
+ *        a response frame.
+ * @return - 0 on success or a negative error code
+ */
+static int runTick(std::vector < RscpSession * >&sessions,
+		   const SRscpFrameBuffer & frameBuffer)
+{
+    std::vector < long >expectedFrames(sessions.size());
+    for (size_t i = 0; i < sessions.size(); i++) {
+	bench_session_t *state = (bench_session_t *) sessions[i]->user;
+	expectedFrames[i] = state->lFrames + 1;
+	int iResult = sessions[i]->queueFrame(frameBuffer);
+	if (iResult == RSCP::OK)
+	    iResult = sessions[i]->flush();
+	if (iResult == RSCP::OK)
+	    iResult = sessions[i]->queueReceive();
+	if (iResult < 0)
+	    return iResult;
+    }
+    size_t pending = sessions.size();
+    while (pending > 0) {
+	SSocketCompletion completions[BENCH_MAX_COMPLETIONS];
+	int iCount = SocketSubmit(completions, BENCH_MAX_COMPLETIONS, RECEIVE_TIMEOUT_MS);
+	if (iCount == -EINTR)
+	    continue;
+	if (iCount < 0)
+	    return iCount;
+	if (iCount == 0)
+	    return SOCKET_ERR_TIMEOUT;
+	RscpSession::dispatch(completions, iCount, handleBenchFrame, NULL);
+	pending = 0;
+	for (size_t i = 0; i < sessions.size(); i++) {
+	    if (sessions[i]->lastResult() < 0)
+		return sessions[i]->lastResult();
+	    bench_session_t *state = (bench_session_t *) sessions[i]->user;
+	    if (state->lFrames < expectedFrames[i])
+		pending++;
+	}
+    }
+    return 0;
+}
+
+void showhelp(char *prog)
+{
+    printf("Usage:\n");
+    printf("%s [-heu] [-i host] [-p port] [-k aes_password] [-n sessions] [-c cycles]\n", prog);
+    printf("  --help, -h         \tshows this help\n");
+    printf("  --host, -i         \tmock server address (default 127.0.0.1)\n");
+    printf("  --port, -p         \tmock server port (default 5033)\n");
+    printf("  --aes, -k          \tAES password (default rscp_password)\n");
+    printf("  --user, -U         \tE3DC user\n");
+    printf("  --password, -W     \tE3DC password\n");
+    printf("  --sessions, -n     \tnumber of parallel sessions (default 16)\n");
+    printf("  --cycles, -c       \tnumber of request cycles (default 1000)\n");
+    printf("  --epoll, -e        \tuse the epoll backend (default)\n");
+    printf("  --uring, -u        \tuse the io_uring backend\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    memset(&bench_config, 0, sizeof(bench_config));
+    strcpy(bench_config.server_ip, "127.0.0.1");
+    bench_config.server_port = 5033;
+    strcpy(bench_config.aes_password, "rscp_password");
+    bench_config.sessions = 16;
+    bench_config.cycles = 1000;
+    bench_config.backend = SOCKET_BACKEND_EPOLL;
+
+    while (1) {
+	static struct option long_options[] = {
+	    {"help",		no_argument,		0, 'h'},
+	    {"host",		required_argument,	0, 'i'},
+	    {"port",		required_argument,	0, 'p'},
+	    {"aes",		required_argument,	0, 'k'},
+	    {"user",		required_argument,	0, 'U'},
+	    {"password",	required_argument,	0, 'W'},
+	    {"sessions",	required_argument,	0, 'n'},
+	    {"cycles",		required_argument,	0, 'c'},
+	    {"epoll",		no_argument,		0, 'e'},
+	    {"uring",		no_argument,		0, 'u'},
+	    {0,			0,			0, 0 }
+	};
+	int option_index = 0;
+	opt = getopt_long(argc, argv, "hi:p:k:U:W:n:c:eu", long_options, &option_index);
+
+	if(opt == -1)
+	    break;
+
+	switch (opt) {
+	case 'h':
+	    showhelp(argv[0]);
+	    return 0;
+	case 'i':
+	    snprintf(bench_config.server_ip, sizeof(bench_config.server_ip), "%s", optarg);
+	    break;
+	case 'p':
+	    bench_config.server_port = atoi(optarg);
+	    break;
+	case 'k':
+	    snprintf(bench_config.aes_password, sizeof(bench_config.aes_password), "%s", optarg);
+	    break;
+	case 'U':
+	    snprintf(bench_config.user, sizeof(bench_config.user), "%s", optarg);
+	    break;
+	case 'W':
+	    snprintf(bench_config.password, sizeof(bench_config.password), "%s", optarg);
+	    break;
+	case 'n':
+	    bench_config.sessions = std::max(1, atoi(optarg));
+	    break;
+	case 'c':
+	    bench_config.cycles = std::max(1, atoi(optarg));
+	    break;
+	case 'e':
+	    bench_config.backend = SOCKET_BACKEND_EPOLL;
+	    break;
+	case 'u':
+	    bench_config.backend = SOCKET_BACKEND_IO_URING;
+	    break;
+	default:
+	    printf("%s: option '-%c' is invalid: ignored\n", argv[0], optopt);
+	    break;
+	}
+    }
+
+    int iBackend = SocketTransportInit(bench_config.backend, bench_config.sessions);
+    if (iBackend < 0) {
+	printf("Transport initialization failed. errno %i\n", -iBackend);
+	return -1;
+    }
+    if (iBackend != bench_config.backend)
+	printf("io_uring is not available, falling back to epoll\n");
+
+    std::vector < RscpSession * >sessions;
+    std::vector < bench_session_t > states(bench_config.sessions);
+    int iResult = 0;
+    for (int i = 0; i < bench_config.sessions; i++) {
+	SSocketConnectInfo info;
+	int iSocket = SocketConnect(bench_config.server_ip, bench_config.server_port,
+				    SOCKET_CONNECT_TIMEOUT_MS, &info);
+	if (iSocket < 0) {
+	    printf("Connection to %s:%i failed: %s\n", bench_config.server_ip,
+		   bench_config.server_port, SocketErrorString(iSocket));
+	    iResult = -1;
+	    break;
+	}
+	memset(&states[i], 0, sizeof(bench_session_t));
+	RscpSession *session = new RscpSession();
+	session->user = &states[i];
+	session->attach(iSocket);
+	session->setPassword(bench_config.aes_password);
+	sessions.push_back(session);
+    }
+
+    SRscpFrameBuffer authBuffer;
+    SRscpFrameBuffer requestBuffer;
+    RscpProtocol protocol;
+    createBenchAuthRequest(&authBuffer);
+    createBenchRequest(&requestBuffer);
+
+    if (iResult == 0) {
+	iResult = runTick(sessions, authBuffer);
+	for (size_t i = 0; (iResult == 0) && (i < sessions.size()); i++) {
+	    if (states[i].iAuthenticated <= 0) {
+		printf("Session %zu: authentication failed\n", i);
+		iResult = -1;
+	    }
+	}
+	for (size_t i = 0; i < states.size(); i++)
+	    states[i].lFrames = states[i].lValues = 0;
+    }
+
+    if (iResult == 0) {
+	std::vector < long >tickUs(bench_config.cycles);
+	struct rusage usageStart, usageEnd;
+	getrusage(RUSAGE_SELF, &usageStart);
+	long lStart = monotonicUs();
+	for (int cycle = 0; cycle < bench_config.cycles; cycle++) {
+	    long lTickStart = monotonicUs();
+	    iResult = runTick(sessions, requestBuffer);
+	    if (iResult < 0) {
+		printf("Cycle %i failed with error %i (errno %i)\n", cycle, iResult, errno);
+		break;
+	    }
+	    tickUs[cycle] = monotonicUs() - lTickStart;
+	}
+	long lElapsed = monotonicUs() - lStart;
+	getrusage(RUSAGE_SELF, &usageEnd);
+
+	if (iResult == 0) {
+	    long lFrames = 0;
+	    long lValues = 0;
+	    for (size_t i = 0; i < states.size(); i++) {
+		lFrames += states[i].lFrames;
+		lValues += states[i].lValues;
+	    }
+	    std::sort(tickUs.begin(), tickUs.end());
+	    long lUser = timevalUs(usageEnd.ru_utime) - timevalUs(usageStart.ru_utime);
+	    long lSys = timevalUs(usageEnd.ru_stime) - timevalUs(usageStart.ru_stime);
+	    printf("backend           %s\n", SocketBackendName(iBackend));
+	    printf("sessions          %i\n", bench_config.sessions);
+	    printf("cycles            %i\n", bench_config.cycles);
+	    printf("frames            %li (%li values)\n", lFrames, lValues);
+	    printf("elapsed           %.3f s\n", lElapsed / 1e6);
+	    printf("frames/s          %.0f\n", lFrames * 1e6 / lElapsed);
+	    printf("tick p50/p99/max  %li / %li / %li us\n",
+		   tickUs[tickUs.size() / 2], tickUs[(tickUs.size() * 99) / 100],
+		   tickUs.back());
+	    printf("cpu user/sys      %.3f / %.3f s (%.2f us/frame)\n",
+		   lUser / 1e6, lSys / 1e6, (double) (lUser + lSys) / lFrames);
+	}
+    }
+
+    protocol.destroyFrameData(authBuffer);
+    protocol.destroyFrameData(requestBuffer);
+    for (size_t i = 0; i < sessions.size(); i++)
+	delete sessions[i];
+    SocketTransportClose();
+    return (iResult == 0) ? 0 : -1;
+}
@@ -10,13 +10,19 @@
 #define AES_BLOCK_SIZE      32
 #define MAX_CONN_RETRY      3
 #define MAX_AUTH_RETRY      3
+#define RECEIVE_TIMEOUT_MS  3000
 
 typedef struct {
-    char server_ip[20];
+    char server_ip[128];
     int  server_port;
+    int  connect_timeout;
     char e3dc_user[128];
     char e3dc_password[128];
     char aes_password[128];
+    int  aes_mode;      // AES::TableMode
+    int  wb_min_current;    // charge current range of the wallbox control in A
+    int  wb_max_current;
+    int  wb_phases;
 }e3dc_config_t;
 
 typedef struct {
@@ -52,5 +58,10 @@ typedef struct {
 #define TAG_WEATHER_ENABLE	(1 << 3)
 #define TAG_WEATHER_ENABLE_F	(1 << 4)
 #define TAG_SET_IDLE_PERIODS	(1 << 5)
+#define TAG_PATHS		(1 << 6)
+#define TAG_BATTERY_CELLS	(1 << 7)
+#define TAG_PVI			(1 << 8)
+#define TAG_POWER_LIMITS	(1 << 9)
+#define TAG_ENERGY		(1 << 10)
 
 #endif